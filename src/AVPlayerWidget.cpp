@@ -17,6 +17,11 @@
 #include "clock/clock.h"
 #include "vdev/vdev.h"
 #include "adev/adev.h"
+#include "pool/pool.h"
+#include "engine/engine.h"
+#include "trace/trace.h"
+#include "lock/lock.h"
+#include "mem/mem.h"
 #if defined(_DEBUG) && defined(_WIN32)
 #define CRTDBG_MAP_ALLOC 
 #include <crtdbg.h>
@@ -31,13 +36,55 @@ extern "C"
 
 #define FILENAME "AVPlayerWidget.cpp"
 
+/* SDL subsystems used by a player */
+#define PLAYER_SDL_FLAGS    (SDL_INIT_AUDIO | SDL_INIT_VIDEO | SDL_INIT_EVENTS)
+
+static bool audio_params_equal (AudioParams a, AudioParams b)
+{
+    return (a.channels == b.channels
+            && a.channel_layout == b.channel_layout
+            && a.sample_fmt == b.sample_fmt
+            && a.sample_rate == b.sample_rate);
+}
+
+static void get_frame_audio_params (AVFrame *f, AudioParams *ap)
+{
+    ap->channels = f->channels;
+    ap->channel_layout = f->channel_layout <= 0 ?
+                         av_get_default_channel_layout(ap->channels) :
+                         f->channel_layout; // to fix *.wma
+    ap->nb_samples = f->nb_samples;
+    ap->sample_fmt = (AVSampleFormat)f->format;
+    ap->sample_rate = f->sample_rate;
+}
+
 void AVPlayerWidget::stop (int err_code)
 {
-    if (this->stop_req)
+    /* the threads return KEABORTED while stopping, not an error */
+    if (SDL_AtomicGet(&this->stop_req) || KERROR(KEABORTED) == err_code)
         return;
 
-    /* stop */
-    stop();
+    /* play over, the pipeline is kept for the next file */
+    if (KERROR(KEPLAY_OVER) == err_code) {
+        bool unloaded = false;
+
+        mutex_lock(op_mutex);
+        if (url && !stopped && demux && demux->is_eof()) { // not a file opened or spliced after it
+            unload_media();
+            force_refresh();
+            emit pos_changed(0.0);
+            unloaded = true;
+        }
+        mutex_unlock(op_mutex);
+
+        /* notice GUI, the next item is opened by it */
+        if (unloaded)
+            emit player_stopped(err_code);
+        return;
+    }
+
+    /* stop, the pending open request is kept */
+    do_stop();
 
     /* notice GUI */
 //    emit player_stopped(err_code);
@@ -66,22 +113,46 @@ void AVPlayerWidget::keyPressEvent (QKeyEvent * e)
 
 void AVPlayerWidget::force_refresh ()
 {
-    if (!inited || !vpaused)
+    if (!inited || WORKER_RUNNING == vstate.get())
         return;
 
-    force_refresh_req = true;
-    SDL_LockMutex(pause_mutex);
-    SDL_CondSignal(pause_cond);
-    SDL_UnlockMutex(pause_mutex);
-    while (!vpaused);
+    SDL_AtomicSet(&force_refresh_req, 1);
+    wake_vrefresh();
+
+    KLOGD("Force refresh.\n");
+}
+
+void AVPlayerWidget::wake_vrefresh ()
+{
+    mutex_lock(pause_mutex);
+    vwake_gen++;
+    mutex_unlock(pause_mutex);
+    vrefresh_task.wake();
+}
 
-    logger.debug("Force refresh.\n");
+void AVPlayerWidget::set_state (int state)
+{
+    int old_state;
+
+    /* called by several threads, the transition is checked against the state it replaces */
+    do {
+        old_state = this->state.get();
+        if (old_state == state)
+            return;
+        if (!player_state_can_set(old_state, state)) {
+            logger.warning("Invalid player state transition: %s -> %s.\n", 
+                           player_state_str(old_state), player_state_str(state));
+            return;
+        }
+    } while (!this->state.compare_set(old_state, state));
+    KLOGD("Player state: %s -> %s.\n", player_state_str(old_state), player_state_str(state));
 }
 
 void AVPlayerWidget::reset_members ()
 {
     wanted_vst = wanted_ast = -1;
     frame_drop = false;
+    fast_seek = false;
     infinite_buf = false;
     max_pktq_size = DEF_PKTQ_SIZE;
     max_pictq_len = DEF_PICTQ_LEN;
@@ -105,6 +176,18 @@ void AVPlayerWidget::reset_members ()
     continue_read_cond = NULL;
     priv_vf = NULL;
     cur_texture = NULL;
+    SDL_AtomicSet(&seek_req, 0);
+    SDL_AtomicSet(&seeking, 0);
+    seek_target = 0.0;
+    seek_req_time = 0;
+    next_url = NULL;
+    next_avfctx = NULL;
+    retired_avfctx = NULL;
+    serial = 0;
+    SDL_AtomicSet(&dropped, 0);
+    SDL_AtomicSet(&duplicated, 0);
+    SDL_AtomicSet(&underruns, 0);
+    av_diff = 0.0;
 }
 
 double AVPlayerWidget::compute_delay (Frame* priv_vf, Frame* cur_vf)
@@ -122,28 +205,23 @@ double AVPlayerWidget::compute_delay (Frame* priv_vf, Frame* cur_vf)
     } else {
         last_duration = 0.0;
     }
-    tgt_delay = last_duration;
 
     /* set primary clock when no audio stream */
     if (!ast) 
         priclk.set((av_gettime() - spare_clock) / (double)AV_TIME_BASE);
 
+    /* the correction is shared with the engine */
     double primary_clk = priclk.get();
     double video_clk = vclk.get();
-    double sync_threshold = FFMAX(AV_SYNC_THRESHOLD_MIN, FFMIN(AV_SYNC_THRESHOLD_MAX, tgt_delay));
-    double clock_diff = video_clk - primary_clk;
-    if (!isnan(clock_diff) && fabs(clock_diff) < (double)max_frame_duration) {
-        if (clock_diff < -sync_threshold)
-            tgt_delay = (frame_drop && clock_diff < -AV_SYNC_FRAMEDROP_THRESHOLD) ? clock_diff : FFMAX(0, tgt_delay + clock_diff);
-        else
-            tgt_delay = tgt_delay > AV_SYNC_FRAMEDUP_THRESHOLD ? tgt_delay + clock_diff : 2 * tgt_delay /* not clock_diff */;
-    }
+    tgt_delay = compute_sync_delay(last_duration, video_clk, primary_clk,
+                                   (double)max_frame_duration, frame_drop);
+    av_diff = primary_clk - video_clk;
 
-    logger.verbose("%7.2lfs, fps:%d, A-V: %lf, delay: %lf, buffer: %.2lfKB\n",
-                   primary_clk, get_fps(), -clock_diff, tgt_delay,
-                   (apktq ? (double)apktq->get_size() / 1024.0 : 0.0) + (vpktq ? (double)vpktq->get_size() / 1024.0 : 0.0));
+    KLOGV("%7.2lfs, fps:%d, A-V: %lf, delay: %lf, buffer: %.2lfKB\n",
+          primary_clk, get_fps(), primary_clk - video_clk, tgt_delay,
+          (apktq ? (double)apktq->get_size() / 1024.0 : 0.0) + (vpktq ? (double)vpktq->get_size() / 1024.0 : 0.0));
 
-    return min(tgt_delay, AV_SYNC_DELAY_MAX);
+    return tgt_delay;
 }
 
 void AVPlayerWidget::calculate_display_rect (AVFrame* vf, SDL_Rect* rect)
@@ -186,10 +264,12 @@ int AVPlayerWidget::video_refresh ()
     int      ret;
 
     /* update message or video */
-    if (!vst || force_refresh_req) { 
-        force_refresh_req = false;
+    if (!vst || SDL_AtomicGet(&force_refresh_req)) { 
+        SDL_AtomicSet(&force_refresh_req, 0);
         vdev->lock();
         if (priv_vf) {
+            if (!paused)
+                SDL_AtomicIncRef(&duplicated);
             calculate_display_rect(priv_vf->frame, &rect);
             ret = vdev->upload_texture(cur_texture, rect);
         } else { // no video frame, black background
@@ -205,33 +285,60 @@ int AVPlayerWidget::video_refresh ()
             logger.FATALN("[%s: %d]%s.\n", kerr2str(KEUPLOAD_TEXTURE_FAIL));
             GOTO_FAIL(KEUPLOAD_TEXTURE_FAIL);
         }
+        if (hud_on) {
+            update_hud();
+            vdev->upload_texture(hud_texture, hud_rect);
+        }
         vdev->unlock();
     } else {
-        step_req = false;
-    
-        /* destroy current texture */
-        SDL_DestroyTexture(cur_texture);
-        cur_texture = NULL;
+        bool step = SDL_AtomicGet(&step_req);
+
+        SDL_AtomicSet(&step_req, 0);
 
         /* update GUI play progress */
-        if (!adev && !close_req)
+        if (!adev && !SDL_AtomicGet(&close_req))
             emit pos_changed(get_pos());
 
         /* get next video frame */
-        if (vfq->get_len() <= 2) {
-            SDL_LockMutex(wait_mutex);
-            SDL_CondSignal(continue_read_cond);
-            SDL_UnlockMutex(wait_mutex);
+        if (demux->is_eof() && PLAYER_STATE_PLAYING == state.get())
+            set_state(PLAYER_STATE_DRAINING);
+
+        /* the frames of the spliced file wait until the audio reaches it */
+        if (ast) {
+            Frame *next_vf = vfq->peek_timeout(0);
+            if (next_vf && next_vf->serial != serial) {
+                delay = SPLICE_POLL_INTERVAL;
+                return 0;
+            }
         }
-        vf = vfq->get();
-        if (!vf) { // aborted or play over
-            if (vfq->is_eof())
+        vf = vfq->peek_timeout(0) ? vfq->get() : NULL; // unblocked, woken by the frame queue
+        if (!vf) { // not decoded yet or play over
+            if (vfq->is_eof()) {
                 ret = KERROR(KEPLAY_OVER);
-            else
-                ret = KERROR(KEABORTED);
+            } else {
+                SDL_AtomicSet(&step_req, step);
+                delay = 0.0;
+                ret = KERROR(KEAGAIN);
+            }
             goto fail;
         }
 
+        /* the first frame of the spliced file, the timestamps restart */
+        if (priv_vf && priv_vf->serial != vf->serial) {
+            vclk.set(vf->pts);
+            mem_frame_free(&mem, &priv_vf->frame);
+            delete priv_vf;
+            priv_vf = NULL;
+            if (!ast) {
+                spare_clock = av_gettime() - (int64_t)(vf->pts * (double)AV_TIME_BASE);
+                priclk.set(vf->pts);
+            }
+        }
+        if (!ast && vf->serial != serial) {
+            serial = vf->serial;
+            emit splice_reached();
+        }
+
         /* compute delay */
         delay = compute_delay(priv_vf, vf);
         if (delay < 0.0) { // drop a frame
@@ -241,12 +348,14 @@ int AVPlayerWidget::video_refresh ()
             vclk.set(vf->pts);
 
             /* save current frame */
-            av_frame_free(&priv_vf->frame);
+            if (priv_vf)
+                mem_frame_free(&mem, &priv_vf->frame);
             delete priv_vf;
             priv_vf = vf;
             vf = NULL;
+            SDL_AtomicIncRef(&dropped);
 
-            logger.verbose("frame drop.\n");
+            KLOGV("frame drop.\n");
         } else {
             /* calculate display rect */
             calculate_display_rect(vf->frame, &rect);
@@ -270,28 +379,98 @@ int AVPlayerWidget::video_refresh ()
                 logger.FATALN("[%s: %d]%s.\n", kerr2str(KEUPLOAD_TEXTURE_FAIL));
                 GOTO_FAIL(KEUPLOAD_TEXTURE_FAIL);
             }
+            if (hud_on) {
+                update_hud();
+                vdev->upload_texture(hud_texture, hud_rect);
+            }
             vdev->unlock();
 
             /* update video clock */
             vclk.set(vf->pts);
 
             /* save current frame */
-            av_frame_free(&priv_vf->frame);
+            if (priv_vf)
+                mem_frame_free(&mem, &priv_vf->frame);
             delete priv_vf;
             priv_vf = vf;
             vf = NULL;
+
+            /* the first frame at the seek target is displayed */
+            if (SDL_AtomicGet(&seeking))
+                finish_seek();
         }
     }
 
     ret = 0;
 fail:
-    if (ret < 0) {
-        av_frame_free(&vf->frame);
+    if (ret < 0 && vf) {
+        mem_frame_free(&mem, &vf->frame);
         delete vf;
     }
     return ret;
 }
 
+void AVPlayerWidget::update_hud ()
+{
+    static const SDL_Color color = {255, 255, 255, 255};
+    static const SDL_Color bg = {0, 0, 0, 160};
+    char                   text[HUD_MAX_TEXT];
+    MemUsage               usage;
+    int                    len = 0;
+    int64_t                now = av_gettime_relative();
+    int                    ret;
+
+    /* nothing to show when stopped */
+    if (!demux || !render) {
+        hud_texture = NULL;
+        return;
+    }
+    if (hud_time && now - hud_time < HUD_INTERVAL)
+        return;
+    hud_time = now;
+
+    /* rates over the last interval */
+    const StageRate &read_rate = read_meter.sample(demux->get_stats(), now, HUD_INTERVAL / 2);
+    const StageRate &vdec_rate = vdec ? vdec_meter.sample(vdec->get_stats(), now, HUD_INTERVAL / 2) : vdec_meter.get_rate();
+    const StageRate &adec_rate = adec ? adec_meter.sample(adec->get_stats(), now, HUD_INTERVAL / 2) : adec_meter.get_rate();
+    const StageRate &vrender_rate = vrender_meter.sample(render->get_vstats(), now, HUD_INTERVAL / 2);
+    const StageRate &present_rate = present_meter.sample(vdev->get_stats(), now, HUD_INTERVAL / 2);
+
+    len += snprintf(text + len, HUD_MAX_TEXT - len, "render %.1f fps, decode %.1f fps\n",
+                    present_rate.count, vdec_rate.count);
+    len += snprintf(text + len, HUD_MAX_TEXT - len, "dropped %d, duplicated %d, underruns %d\n",
+                    SDL_AtomicGet(&dropped), SDL_AtomicGet(&duplicated), SDL_AtomicGet(&underruns));
+    len += snprintf(text + len, HUD_MAX_TEXT - len, "A-V %+.3lfs\n", vst && ast ? av_diff : 0.0);
+    if (vst)
+        len += snprintf(text + len, HUD_MAX_TEXT - len, "video packets %.2lfs %.1lfKB, frames %d/%d %.2lfs %.1lfKB\n",
+                        vpktq->get_duration() * av_q2d(vst->time_base), vpktq->get_size() / 1024.0,
+                        vfq->get_len(), vfq->get_max_len(), vfq->get_duration(), vfq->get_size() / 1024.0);
+    if (ast)
+        len += snprintf(text + len, HUD_MAX_TEXT - len, "audio packets %.2lfs %.1lfKB, frames %d/%d %.2lfs %.1lfKB\n",
+                        apktq->get_duration() * av_q2d(ast->time_base), apktq->get_size() / 1024.0,
+                        afq->get_len(), afq->get_max_len(), afq->get_duration(), afq->get_size() / 1024.0);
+    len += snprintf(text + len, HUD_MAX_TEXT - len, "demux %.1lfKB/s, %.1lf packets/s\n",
+                    read_rate.bytes / 1024.0, read_rate.count);
+    mem_get_usage(&mem, &usage);
+    len += snprintf(text + len, HUD_MAX_TEXT - len, "memory %.1lfMB (peak %.1lfMB), packets %d %.1lfMB, frames %d %.1lfMB, textures %d %.1lfMB\n",
+                    usage.total / 1048576.0, usage.peak / 1048576.0,
+                    usage.count[MEM_PACKET], usage.bytes[MEM_PACKET] / 1048576.0,
+                    usage.count[MEM_FRAME], usage.bytes[MEM_FRAME] / 1048576.0,
+                    usage.count[MEM_TEXTURE], usage.bytes[MEM_TEXTURE] / 1048576.0);
+
+    /* time per packet or frame, and the share of the time */
+    len += snprintf(text + len, HUD_MAX_TEXT - len, "read %.2lfms %.0lf%%, video decode %.2lfms %.0lf%%, audio decode %.2lfms %.0lf%%\n",
+                    read_rate.avg_time, read_rate.load * 100.0, vdec_rate.avg_time, vdec_rate.load * 100.0, adec_rate.avg_time, adec_rate.load * 100.0);
+    snprintf(text + len, HUD_MAX_TEXT - len, "render %.2lfms %.0lf%%, present %.2lfms %.0lf%%",
+             vrender_rate.avg_time, vrender_rate.load * 100.0, present_rate.avg_time, present_rate.load * 100.0);
+
+    /* below the message */
+    hud_rect.x = 20;
+    hud_rect.y = 60;
+    ret = hud_msger->render_text(text, color, bg, &hud_rect);
+    hud_texture = ret < 0 ? NULL : hud_msger->get_texture();
+}
+
 bool AVPlayerWidget::is_realtime ()
 {
     const char *name = avfctx->iformat->name;
@@ -310,32 +489,68 @@ bool AVPlayerWidget::is_realtime ()
     return false;
 }
 
-int AVPlayerWidget::open_media_file (const char* url)
+int AVPlayerWidget::probe_media_file (const char* url, int (*interrupt)(void *),
+                                      AVFormatContext** avfctx, int* vst_idx, int* ast_idx)
 {
-    int ret;
-
-    /* copy url */
-    this->url = av_strdup(url);
-    if (!this->url)
-        return KERROR(KENOMEM);
+    AVStream *st = NULL;
+    int       ret;
 
     /* open input file */
-    avfctx = avformat_alloc_context();
-    if (!avfctx)
+    *avfctx = avformat_alloc_context();
+    if (!*avfctx)
         return KERROR(KENOMEM);
-    ret = avformat_open_input(&avfctx, url, NULL, NULL);
+    (*avfctx)->interrupt_callback.callback = interrupt;
+    (*avfctx)->interrupt_callback.opaque = this;
+    ret = avformat_open_input(avfctx, url, NULL, NULL);
     if (ret < 0) {
         logger.error("%s %s %s: \n", kerr2str(KEOPEN_INPUT_FAIL), url, av_err2str(ret));
         return KERROR(KEOPEN_INPUT_FAIL);
     }
 
     /* find stream info */
-    ret = avformat_find_stream_info(avfctx, NULL);
+    ret = avformat_find_stream_info(*avfctx, NULL);
     if (ret < 0) {
         logger.error("%s: %s.\n", kerr2str(KEFIND_STREAM_INFO_FAIL), av_err2str(ret));
         return KERROR(KEFIND_STREAM_INFO_FAIL);
     }
 
+    /* find streams */
+    *vst_idx = *ast_idx = -1;
+    if (wanted_vst >= 0 && wanted_vst < (*avfctx)->nb_streams) {
+        st = (*avfctx)->streams[wanted_vst];
+        if (AVMEDIA_TYPE_VIDEO == st->codecpar->codec_type) 
+            *vst_idx = wanted_vst;
+    }
+    if (wanted_ast >= 0 && wanted_ast < (*avfctx)->nb_streams) {
+        st = (*avfctx)->streams[wanted_ast];
+        if (AVMEDIA_TYPE_AUDIO == st->codecpar->codec_type)
+            *ast_idx = wanted_ast;
+    }
+    *vst_idx = av_find_best_stream(*avfctx, AVMEDIA_TYPE_VIDEO, *vst_idx, -1, NULL, 0);
+    *ast_idx = av_find_best_stream(*avfctx, AVMEDIA_TYPE_AUDIO, *ast_idx, -1, NULL, 0);
+    if (*vst_idx < 0 && *ast_idx < 0) {
+        logger.error("%s.\n", kerr2str(KENOAVST));
+        return KERROR(KENOAVST);
+    }
+
+    return 0;
+}
+
+int AVPlayerWidget::open_media_file (const char* url)
+{
+    int ret;
+
+    /* copy url */
+    this->url = av_strdup(url);
+    if (!this->url)
+        return KERROR(KENOMEM);
+
+    /* open input file and find streams */
+    ret = probe_media_file(url, interrupt_cb, &avfctx, &vst_idx, &ast_idx);
+    if (ret < 0)
+        return ret;
+    emit open_progress(40);
+
     /* set duration */
     duration = avfctx->duration / (double)AV_TIME_BASE;
     duration = duration <= 0 ? 0 : duration;
@@ -343,29 +558,11 @@ int AVPlayerWidget::open_media_file (const char* url)
     /* check whether the media stream is realtime */
     realtime = is_realtime();
 
-    /* find streams */
-    vst_idx = ast_idx = -1;
-    AVStream *st = NULL;
-    if (wanted_vst >= 0 && wanted_vst < avfctx->nb_streams) {
-        st = avfctx->streams[wanted_vst];
-        if (AVMEDIA_TYPE_VIDEO == st->codecpar->codec_type) 
-            vst_idx = wanted_vst;
-    }
-    if (wanted_ast >= 0 && wanted_ast < avfctx->nb_streams) {
-        st = avfctx->streams[wanted_ast];
-        if (AVMEDIA_TYPE_AUDIO == st->codecpar->codec_type)
-            ast_idx = wanted_ast;
-    }
-    vst_idx = av_find_best_stream(avfctx, AVMEDIA_TYPE_VIDEO, vst_idx, -1, NULL, 0);
-    ast_idx = av_find_best_stream(avfctx, AVMEDIA_TYPE_AUDIO, ast_idx, -1, NULL, 0);
+    /* set streams */
     if (vst_idx >= 0)
         vst = avfctx->streams[vst_idx];
     if (ast_idx >= 0)
         ast = avfctx->streams[ast_idx];
-    if (!ast && !vst) {
-        logger.error("%s.\n", kerr2str(KENOAVST));
-        return KERROR(KENOAVST);
-    }
 
     /* dump format */
     logger.dis_label();
@@ -386,9 +583,10 @@ int AVPlayerWidget::init_queues (int max_pictq_len, int max_sampleq_len)
         vfq = _New FrameQueue();
         if (!vpktq || !vfq)
             return KERROR(KENOMEM);
-        if (vpktq->init() < 0 || vfq->init(vpktq, max_pictq_len) < 0) {
+        if (vpktq->init(&mem) < 0 || vfq->init(vpktq, max_pictq_len) < 0) {
             return KERROR(KEQUEUE_INIT_FAIL);
         }
+        vfq->set_consumer(&vrefresh_task);
     }
     if (ast){
         apktq = _New PacketQueue();
@@ -396,7 +594,7 @@ int AVPlayerWidget::init_queues (int max_pictq_len, int max_sampleq_len)
         if (!apktq || !afq) {
             return KERROR(KENOMEM);
         }
-        if (apktq->init() < 0 || afq->init(apktq, max_pictq_len) < 0) {
+        if (apktq->init(&mem) < 0 || afq->init(apktq, max_sampleq_len) < 0) {
             return KERROR(KEQUEUE_INIT_FAIL);
         }
     }
@@ -404,18 +602,180 @@ int AVPlayerWidget::init_queues (int max_pictq_len, int max_sampleq_len)
     return 0;
 }
 
+int AVPlayerWidget::do_seek ()
+{
+    bool   _paused = paused;
+    double pos;
+    int    ret = 0;
+
+    if (!url || stopped)
+        return 0;
+
+    /* pause video refresh */
+    if (vst) // not "if (vdev)"
+        vpause();
+
+    /* pause audio */
+    if (adev)
+        adev->pause();
+
+    /* 
+    * take the latest target, requests arrived before this point are merged, 
+    * no frame of the old position can be displayed from now on 
+    */
+    mutex_lock(ctrl_mutex);
+    pos = seek_target;
+    SDL_AtomicSet(&seeking, SDL_AtomicGet(&seek_req));
+    SDL_AtomicSet(&seek_req, 0);
+    mutex_unlock(ctrl_mutex);
+    if (!SDL_AtomicGet(&seeking))
+        goto resume;
+    set_state(PLAYER_STATE_SEEKING);
+
+    logger.info("Seeking to %lfs.\n", pos);
+
+    /* pause decoder */
+    if (adec)
+        adec->pause();
+    if (vdec)
+        vdec->pause();
+
+    /* pause demux */
+    demux->pause();
+
+    /* 
+    * the demux has switched to the staged file but the splice is not played, 
+    * the packets of the old file are dropped, so the decoders switch here 
+    */
+    if (next_avfctx && !demux->is_staged()) {
+        if (vdec && vdec->get_serial() != demux->get_serial())
+            vdec->splice();
+        if (adec && adec->get_serial() != demux->get_serial())
+            adec->splice();
+        serial = demux->get_serial();
+        finish_splice();
+        emit player_spliced();
+    }
+
+    /* clear queues and avcodec buffer */
+    if (vdec)
+        vdec->flush();
+    if (adec)
+        adec->flush();
+
+    /* clear audio buffer */
+    if (adev)
+        adev->flush();
+
+    /* set clocks */
+    priclk.set(pos);
+    vclk.set(pos);
+    delay = 0.0;
+
+    /* seek */
+    ret = demux->seek(pos);
+    if (ret < 0) {
+        mutex_lock(ctrl_mutex);
+        SDL_AtomicSet(&seeking, 0);
+        mutex_unlock(ctrl_mutex);
+        set_state(paused ? PLAYER_STATE_PAUSED : PLAYER_STATE_PLAYING);
+    } else {
+        if (vdec)
+            vdec->seek(pos, !fast_seek);
+        if (adec)
+            adec->seek(pos, !fast_seek);
+    }
+
+    /* reset abort flag */
+    if (vpktq)
+        vpktq->restore();
+    if (apktq)
+        apktq->restore();
+
+    /* start demux */
+    demux->start();
+
+    /* start decoder */
+    if (adec)
+        adec->start();
+    if (vdec)
+        vdec->start();
+
+    /* free privious frame */
+    if (priv_vf)
+        mem_frame_free(&mem, &priv_vf->frame);
+    delete priv_vf;
+    priv_vf = NULL;
+
+resume:
+    /* start audio and video refresh */
+    if (!_paused) {
+        if (vst)
+            vplay();
+
+        if (adev)
+            adev->play();
+    } else if (vst) {
+        /* show the first frame at the target, finish_seek() is called by video_refresh() */
+        SDL_AtomicSet(&step_req, 1);
+        wake_vrefresh();
+    } else if (SDL_AtomicGet(&seeking)) { // no frame will be displayed
+        finish_seek();
+    }
+
+    return ret;
+}
+
+void AVPlayerWidget::finish_seek ()
+{
+    double latency;
+
+    mutex_lock(ctrl_mutex);
+
+    /* a newer request is pending, player_seeked will be emitted by it */
+    if (!SDL_AtomicGet(&seeking) || SDL_AtomicGet(&seek_req)) {
+        mutex_unlock(ctrl_mutex);
+        return;
+    }
+    SDL_AtomicSet(&seeking, 0);
+
+    /* update statistics */
+    latency = (av_gettime() - seek_req_time) / (double)AV_TIME_BASE;
+    seek_stats.count++;
+    seek_stats.last = latency;
+    if (1 == seek_stats.count) {
+        seek_stats.min = latency;
+        seek_stats.max = latency;
+    } else {
+        seek_stats.min = min(seek_stats.min, latency);
+        seek_stats.max = max(seek_stats.max, latency);
+    }
+    seek_stats.avg += (latency - seek_stats.avg) / seek_stats.count;
+
+    mutex_unlock(ctrl_mutex);
+
+    set_state(paused ? PLAYER_STATE_PAUSED : PLAYER_STATE_PLAYING);
+
+    KLOGD("Seek finished in %lfs.\n", latency);
+
+    /* notice GUI */
+    emit player_seeked();
+}
+
 void AVPlayerWidget::vplay ()
 {
-    vstop_req = false;
-    vstopped = false;
-    vpause_req = false;
+    mutex_lock(pause_mutex);
+    SDL_AtomicSet(&vstop_req, 0);
+    SDL_AtomicSet(&vpause_req, 0);
+    if (WORKER_STOPPED == vstate.get())
+        vstate.set(WORKER_PAUSED); // leave the stopped state, acknowledged with WORKER_RUNNING
+    vwake_gen++;
+    mutex_unlock(pause_mutex);
+    vrefresh_task.wake();
     if (vfq)
         vfq->abort();
-    SDL_LockMutex(pause_mutex);
-    SDL_CondSignal(pause_cond);
-    SDL_UnlockMutex(pause_mutex);
     if (vst)
-        while (vpaused);
+        vstate.wait(WORKER_RUNNING, STATE_WAIT_FOREVER);
 
     /*
     * to fix negative pts, set primary clock if no audio stream 
@@ -426,16 +786,25 @@ void AVPlayerWidget::vplay ()
     }
 }
 
+void AVPlayerWidget::vstop ()
+{
+    if (WORKER_STOPPED != vstate.get()) {
+        SDL_AtomicSet(&vstop_req, 1);
+        if (vfq)
+            vfq->abort();
+        wake_vrefresh();
+        vstate.wait(WORKER_STOPPED, STATE_WAIT_FOREVER);
+    }
+}
+
 void AVPlayerWidget::vpause ()
 {
     if (vst) {
-        vpause_req = true;
+        SDL_AtomicSet(&vpause_req, 1);
         if (vfq)
             vfq->abort();
-        SDL_LockMutex(pause_mutex);
-        SDL_CondSignal(pause_cond);
-        SDL_UnlockMutex(pause_mutex);
-        while (!vpaused);
+        wake_vrefresh();
+        vstate.wait_not(WORKER_RUNNING, STATE_WAIT_FOREVER);
     }
 }
 
@@ -456,14 +825,14 @@ int AVPlayerWidget::audio_fill_proc (void* data, SampleBuf* sample_buf)
     AVPlayerWidget *p = (AVPlayerWidget *)data;
     AudioParams     ap_tgt = p->render->get_ap_tgt();
     int             ret = 0;
+    TRACE_SCOPE("audio_fill_proc");
 
-    if (!p->stop_req && !p->close_req && !sample_buf->pos && !sample_buf->size) {
+    if (!SDL_AtomicGet(&p->stop_req) && !SDL_AtomicGet(&p->close_req) && !sample_buf->pos && !sample_buf->size) {
         /* get an audio frame, blocked */
-        if (p->afq->get_len() <= 2) {
-            SDL_LockMutex(p->wait_mutex);
-            SDL_CondSignal(p->continue_read_cond);
-            SDL_UnlockMutex(p->wait_mutex);
-        }
+        if (p->demux->is_eof() && PLAYER_STATE_PLAYING == p->state.get())
+            p->set_state(PLAYER_STATE_DRAINING);
+        if (!p->afq->get_len() && !p->afq->is_eof() && !SDL_AtomicGet(&p->seeking))
+            SDL_AtomicIncRef(&p->underruns);
         Frame *af = p->afq->get();
         if (!af) { // aborted or eof
 ////////////////////////////////////////////////////////
@@ -474,12 +843,32 @@ int AVPlayerWidget::audio_fill_proc (void* data, SampleBuf* sample_buf)
             goto err;
         }
 
+        /* the first frame of the spliced file, the resampler follows the new format */
+        if (af->serial != p->serial) {
+            AudioParams ap_src;
+
+            p->serial = af->serial;
+            get_frame_audio_params(af->frame, &ap_src);
+            if (!audio_params_equal(ap_src, p->render->get_ap_src())) {
+                p->render->close_arender();
+                ret = p->render->init_arender(ap_src, ap_tgt);
+                if (ret < 0) {
+                    logger.FATALN("[%s: %d]%s.\n", kerr2str(KERENDER_INIT_FAIL));
+                    ret = KERROR(KERENDER_INIT_FAIL);
+                    mem_frame_free(&p->mem, &af->frame);
+                    delete af;
+                    goto err;
+                }
+            }
+            emit p->splice_reached();
+        }
+
         /* resample */
         ret = p->render->resample(af->frame, sample_buf);
         if (ret < 0) {
             logger.FATALN("[%s: %d]%s.\n", kerr2str(KERESAMPLE_FAIL));
             ret = KERROR(KERESAMPLE_FAIL);
-            av_frame_free(&af->frame);
+            mem_frame_free(&p->mem, &af->frame);
             delete af;            
 err:
             emit p->err_occured(ret);
@@ -487,7 +876,7 @@ err:
         }
 
         double cur_af_pts = af->pts;
-        av_frame_free(&af->frame);
+        mem_frame_free(&p->mem, &af->frame);
         delete af;
 
         /* update audio clock */
@@ -497,111 +886,232 @@ err:
         p->priclk.set(p->adev->get_cur_af_pts() + (double)((sample_buf->pos - sample_buf->buf) / (double)byte_per_sec));
         p->adev->set_cur_af_pts(cur_af_pts);
         emit p->pos_changed(p->priclk.get());
+
+        /* no video stream, the first audio frame at the seek target is played */
+        if (!p->vst && SDL_AtomicGet(&p->seeking))
+            p->finish_seek();
     }
 
     return 0;
 }
 
-int AVPlayerWidget::get_media_info (const char* url, MediaInfo* info)
+int AVPlayerWidget::interrupt_cb (void* args)
 {
-    if (!inited)
-        return KERROR(KEUNINITED);
-    if (!url)
-        return -1;
+    AVPlayerWidget *p = (AVPlayerWidget *)args;
 
-    return 0;
+    /* cancelled, stopped, closed or the open takes too long */
+    return (SDL_AtomicGet(&p->open_abort) || SDL_AtomicGet(&p->stop_req) || SDL_AtomicGet(&p->close_req)
+            || (p->open_deadline && av_gettime() > p->open_deadline));
+}
+
+int AVPlayerWidget::prefetch_interrupt_cb (void* args)
+{
+    AVPlayerWidget *p = (AVPlayerWidget *)args;
+
+    /* cancelled, stopped, closed or the prefetch takes too long */
+    return (SDL_AtomicGet(&p->prefetch_abort) || SDL_AtomicGet(&p->stop_req) || SDL_AtomicGet(&p->close_req)
+            || (p->prefetch_deadline && av_gettime() > p->prefetch_deadline));
 }
 
-int SDLCALL AVPlayerWidget::vrefresh_thread (void* args)
+int AVPlayerWidget::vrefresh_proc (void* args)
 {
     AVPlayerWidget *p = (AVPlayerWidget *)args;
+    int             woken = VWAIT_NONE;
+    int64_t         remain;
+    int             ret;
+
+    if (SDL_AtomicGet(&p->close_req)) {
+        KLOGD("Video refresh task closed.\n");
+        return TASK_DONE;
+    }
 
-    logger.debug("Video refresh thread started.\n");
+    /* paused or stopped, sleep until woken by wake_vrefresh() */
+    if (VWAIT_PAUSE == p->vwait || VWAIT_STOP == p->vwait) {
+        mutex_lock(p->pause_mutex);
+        if (p->vwait_gen == p->vwake_gen) {
+            mutex_unlock(p->pause_mutex);
+            return TASK_WAIT;
+        }
+        woken = p->vwait;
+        p->vwait = VWAIT_NONE;
+        mutex_unlock(p->pause_mutex);
 
-    p->vstopped = false;   // controlled by vplay() and stop()
-    p->vstop_req = false;  // controlled by vplay() and stop()
-    p->vpaused = true;     // controlled by vrefresh_thread()
-    p->vpause_req = false; // controlled by vplay() and vpause()
-    p->step_req = false;   // controlled by step() and vrefresh_thread()
+        /* force refresh */
+        if (VWAIT_STOP == woken) {
+            if (SDL_AtomicGet(&p->force_refresh_req))
+                emit p->video_refresh();
+            return TASK_AGAIN;
+        }
+    }
 
-    p->delay = 0.0;
-    while (!p->close_req) {
-        if (p->vst && !p->vstop_req && !p->vstopped) { // playing or paused
-            p->vpaused = false;
+    if (p->vst && !SDL_AtomicGet(&p->vstop_req) && WORKER_STOPPED != p->vstate.get()) { // playing or paused
+        if (VWAIT_PAUSE == woken) {
+            p->vstate.set(WORKER_RUNNING);
+            KLOGD("Video refresh task resumed.\n");
+        } else if (VWAIT_DELAY != p->vwait) {
+            p->vstate.set(WORKER_RUNNING);
 
             /* pause */
-            if (p->vpause_req && !p->step_req) {
-                SDL_LockMutex(p->pause_mutex);
-                p->vpaused = true;
-                logger.debug("Video refresh thread paused.\n");
-                SDL_CondWait(p->pause_cond, p->pause_mutex);
-                p->vpaused = false;
-                logger.debug("Video refresh thread resumed.\n");
-                SDL_UnlockMutex(p->pause_mutex);
+            if (SDL_AtomicGet(&p->vpause_req) && !SDL_AtomicGet(&p->step_req)) {
+                mutex_lock(p->pause_mutex);
+                if (SDL_AtomicGet(&p->vpause_req) && !SDL_AtomicGet(&p->step_req) && !SDL_AtomicGet(&p->force_refresh_req)) {
+                    p->vwait = VWAIT_PAUSE;
+                    p->vwait_gen = p->vwake_gen;
+                    p->vstate.set(WORKER_PAUSED);
+                    mutex_unlock(p->pause_mutex);
+                    KLOGD("Video refresh task paused.\n");
+                    return TASK_WAIT;
+                }
+                mutex_unlock(p->pause_mutex);
             }
+        }
 
-            /* delay */
-            if (!p->close_req && !p->vpause_req 
-                && !p->vstop_req && !p->step_req 
-                && !p->force_refresh_req && p->delay > 0.0) 
-                av_usleep((int64_t)(p->delay * AV_TIME_BASE));
-
-            /* video refresh */
-            if ((!p->close_req && !p->vpause_req && !p->vstop_req) 
-                || p->force_refresh_req || p->step_req) 
-                {
-                int ret = emit p->video_refresh();
-                if (ret < 0) {
-                    emit p->err_occured(ret);
-                    p->vstop_req = true;
+        /* delay, the worker is free while waiting, interrupted by the requests */
+        if (!SDL_AtomicGet(&p->close_req) && !SDL_AtomicGet(&p->vpause_req)
+            && !SDL_AtomicGet(&p->vstop_req) && !SDL_AtomicGet(&p->step_req)
+            && !SDL_AtomicGet(&p->force_refresh_req))
+            {
+            if (VWAIT_DELAY != p->vwait && p->delay > 0.0) {
+                p->vrefresh_time = av_gettime() + (int64_t)(p->delay * AV_TIME_BASE);
+                p->vwait = VWAIT_DELAY;
+            }
+            if (VWAIT_DELAY == p->vwait) {
+                remain = p->vrefresh_time - av_gettime();
+                if (remain > 0) {
+                    p->vrefresh_task.set_timeout((int)((remain + 999) / 1000));
+                    return TASK_WAIT;
                 }
             }
-        } else { // stopped
-            p->vstop_req = false;
-            p->step_req = false;
+        }
+        p->vwait = VWAIT_NONE;
+
+        /* video refresh */
+        if ((!SDL_AtomicGet(&p->close_req) && !SDL_AtomicGet(&p->vpause_req) && !SDL_AtomicGet(&p->vstop_req))
+            || SDL_AtomicGet(&p->force_refresh_req) || SDL_AtomicGet(&p->step_req))
+            {
+            ret = emit p->video_refresh();
+            if (KERROR(KEAGAIN) == ret) // no frame decoded, woken by the frame queue
+                return TASK_WAIT;
+            if (ret < 0) {
+                emit p->err_occured(ret);
+                SDL_AtomicSet(&p->vstop_req, 1);
+            }
+        }
+    } else { // stopped
+        mutex_lock(p->pause_mutex);
+        SDL_AtomicSet(&p->vstop_req, 0);
+        SDL_AtomicSet(&p->step_req, 0);
+        p->vwait = VWAIT_STOP;
+        p->vwait_gen = p->vwake_gen;
+        p->vstate.set(WORKER_STOPPED);
+        mutex_unlock(p->pause_mutex);
+        return TASK_WAIT;
+    }
 
-            /* pause */
-            SDL_LockMutex(p->pause_mutex);
-            p->vst = NULL;
-            p->vstopped = true;
-            p->vpaused = true;
-            SDL_CondWait(p->pause_cond, p->pause_mutex);
-            SDL_UnlockMutex(p->pause_mutex);
-
-            /* force refresh */
-            if (p->force_refresh_req)
-                emit p->video_refresh();
+    return TASK_AGAIN;
+}
+
+int SDLCALL AVPlayerWidget::ctrl_thread (void* args)
+{
+    AVPlayerWidget *p = (AVPlayerWidget *)args;
+    char *          url;
+    char *          prefetch_url;
+    int             ret;
+
+    KLOGD("Control thread started.\n");
+
+    while (!SDL_AtomicGet(&p->close_req)) {
+        /* wait for a request */
+        mutex_lock(p->ctrl_mutex);
+        while (!p->open_req && !SDL_AtomicGet(&p->seek_req) && !p->prefetch_req && !SDL_AtomicGet(&p->close_req))
+            cond_wait(p->ctrl_cond, p->ctrl_mutex);
+        prefetch_url = NULL;
+        url = p->open_url;
+        p->open_url = NULL;
+        if (p->open_req) {
+            p->open_req = false;
+            SDL_AtomicSet(&p->open_abort, 0);
+        } else if (p->prefetch_req && !SDL_AtomicGet(&p->seek_req)) { // the open and seek requests go first
+            prefetch_url = p->prefetch_url;
+            p->prefetch_url = NULL;
+            p->prefetch_req = false;
+            SDL_AtomicSet(&p->prefetch_abort, 0);
+        }
+        mutex_unlock(p->ctrl_mutex);
+        if (SDL_AtomicGet(&p->close_req)) {
+            av_freep(&url);
+            av_freep(&prefetch_url);
+            break;
+        }
+
+        /* open */
+        if (url) {
+            ret = p->do_open(url);
+            av_freep(&url);
+            emit p->player_opened(ret);
+            continue;
+        }
+
+        /* prefetch */
+        if (prefetch_url) {
+            ret = p->do_prefetch(prefetch_url);
+            if (ret < 0 && KERROR(KEABORTED) != ret)
+                KLOGD("Prefetching %s failed: %s.\n", prefetch_url, kerr2str(-ret));
+            av_freep(&prefetch_url);
+            continue;
         }
+
+        /* seek */
+        mutex_lock(p->op_mutex);
+        ret = p->do_seek();
+        mutex_unlock(p->op_mutex);
+        if (ret < 0)
+            logger.error("%s.\n", kerr2str(KESEEK_FAIL));
     }
-    
-    logger.debug("Video refresh thread closed.\n");
+
+    KLOGD("Control thread closed.\n");
     return KERROR(KEABORTED);
 }
 
 int AVPlayerWidget::init (bool en_hw_acce)
 {
-    int flags = SDL_INIT_AUDIO | SDL_INIT_VIDEO | SDL_INIT_EVENTS;
     int ret;
 
     if (inited)
         return KERROR(KEREINIT);
 
     hw_acce = en_hw_acce;
-    step_req = false;
-    force_refresh_req = false;
-    stop_req = false;
-    close_req = false;
+    vwake_gen = 0;
+    SDL_AtomicSet(&step_req, 0);
+    SDL_AtomicSet(&force_refresh_req, 0);
+    SDL_AtomicSet(&stop_req, 0);
+    SDL_AtomicSet(&close_req, 0);
+    open_req = false;
+    SDL_AtomicSet(&open_abort, 0);
+    open_url = NULL;
+    open_deadline = 0;
+    prefetch_req = false;
+    SDL_AtomicSet(&prefetch_abort, 0);
+    prefetch_url = NULL;
+    prefetch_deadline = 0;
     msg_texture = NULL;
+    hud_on = false;
+    hud_texture = NULL;
+    hud_time = 0;
 
-    /* init FFmpeg components */
-    av_register_all();
-    avformat_network_init();
-
-    /* init SDL */
-    ret = SDL_Init(flags);
+    /* init FFmpeg, SDL and the task pool, shared with the other players and engines */
+    ret = engine_global_init(PLAYER_SDL_FLAGS, &pool);
     if (ret < 0) {
-        logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KESDL_INIT_FAIL), SDL_GetError());
-        GOTO_FAIL(KESDL_INIT_FAIL);
+        pool = NULL;
+        goto fail;
+    }
+
+    /* open a session, the tasks of the players are served in turn */
+    session = pool->open_session();
+    if (session < 0) {
+        logger.FATALN("[%s: %d]%s.\n", kerr2str(-session));
+        ret = session;
+        goto fail;
     }
 
     /* init vdev */
@@ -614,6 +1124,7 @@ int AVPlayerWidget::init (bool en_hw_acce)
         GOTO_FAIL(KEDEV_INIT_FAIL);
     }
     QObject::connect(this, SIGNAL(err_occured(int)), this, SLOT(stop(int)));
+    QObject::connect(this, SIGNAL(splice_reached()), this, SLOT(splice()), Qt::QueuedConnection);
 
     /* init msger */
     msger = _New Msger();
@@ -624,32 +1135,77 @@ int AVPlayerWidget::init (bool en_hw_acce)
         logger.fatal("[%s: %d]%s.\n", kerr2str(KEMSGER_INIT_FAIL));
         GOTO_FAIL(KEMSGER_INIT_FAIL);
     }
+    hud_msger = _New Msger();
+    if (!hud_msger)
+        GOTO_FAIL(KENOMEM);
+    ret = hud_msger->init("fonts/stkaiti.ttf", vdev->get_sdl_renderer());
+    if (ret < 0) {
+        logger.fatal("[%s: %d]%s.\n", kerr2str(KEMSGER_INIT_FAIL));
+        GOTO_FAIL(KEMSGER_INIT_FAIL);
+    }
 
     /* create mutex and cond */
-    pause_mutex = SDL_CreateMutex();
+    pause_mutex = mutex_create("pause_mutex");
     if (!pause_mutex) {
         logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_MUTEX_FAIL), SDL_GetError());
         GOTO_FAIL(KECREATE_SDL_MUTEX_FAIL);
     }
-    pause_cond = SDL_CreateCond();
-    if (!pause_cond) {
+    ctrl_mutex = mutex_create("ctrl_mutex");
+    op_mutex = mutex_create("op_mutex");
+    if (!ctrl_mutex || !op_mutex) {
+        logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_MUTEX_FAIL), SDL_GetError());
+        GOTO_FAIL(KECREATE_SDL_MUTEX_FAIL);
+    }
+    ctrl_cond = SDL_CreateCond();
+    if (!ctrl_cond) {
         logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_COND_FAIL), SDL_GetError());
         GOTO_FAIL(KECREATE_SDL_COND_FAIL);
     }
 
-    /* create video refresh thread */
-    vrefresh_thr = SDL_CreateThread(vrefresh_thread, "vrefresh_thread", this);
-    if (!vrefresh_thr) {
-        logger.fatal("[%s: %d]%s: %s.\n", kerr2str(KECREATE_THREAD_FAIL), SDL_GetError());
-        GOTO_FAIL(KECREATE_THREAD_FAIL);
-    }
-
-    /* init timer */
-    QObject::connect(&timer, SIGNAL(timeout()), this, SLOT(clear_msg()));
-
-    logger.debug("Player widget has been inited.\n");
+    /* init states */
+    ret = state.init(PLAYER_STATE_STOPPED);
+    if (ret < 0)
+        goto fail;
+    ret = vstate.init(WORKER_STOPPED);
+    if (ret < 0)
+        goto fail;
 
-    inited = true;
+    /* submit video refresh task to a thread of its own, the demux and the decoders share the pool */
+    SDL_AtomicSet(&vstop_req, 0);  // controlled by vplay() and stop()
+    SDL_AtomicSet(&vpause_req, 0); // controlled by vplay() and vpause()
+    vwait = VWAIT_NONE;
+    vwait_gen = 0;
+    delay = 0.0;
+    ret = vrefresh_pool.init(1);
+    if (ret < 0) {
+        logger.fatal("[%s: %d]%s.\n", kerr2str(-ret));
+        goto fail;
+    }
+    ret = vrefresh_pool.open_session();
+    if (ret < 0) {
+        logger.fatal("[%s: %d]%s.\n", kerr2str(-ret));
+        goto fail;
+    }
+    vrefresh_task.init(vrefresh_proc, this, "vrefresh_task");
+    ret = vrefresh_pool.submit(&vrefresh_task, ret);
+    if (ret < 0) {
+        logger.fatal("[%s: %d]%s.\n", kerr2str(-ret));
+        goto fail;
+    }
+
+    /* create control thread */
+    ctrl_thr = SDL_CreateThread(ctrl_thread, "ctrl_thread", this);
+    if (!ctrl_thr) {
+        logger.fatal("[%s: %d]%s: %s.\n", kerr2str(KECREATE_THREAD_FAIL), SDL_GetError());
+        GOTO_FAIL(KECREATE_THREAD_FAIL);
+    }
+
+    /* init timer */
+    QObject::connect(&timer, SIGNAL(timeout()), this, SLOT(clear_msg()));
+
+    KLOGD("Player widget has been inited.\n");
+
+    inited = true;
     ret = 0;
 fail:
     if (ret < 0)
@@ -660,13 +1216,60 @@ fail:
 
 int AVPlayerWidget::open (const char* url)
 {
-    int ret;
+    if (!inited)
+        return KERROR(KEUNINITED);
+    if (!url)
+        return KERROR(KEINVAL);
+
+    /* cancel the pending open request */
+    mutex_lock(ctrl_mutex);
+    open_req = false;
+    av_freep(&open_url);
+    SDL_AtomicSet(&open_abort, 0);
+    mutex_unlock(ctrl_mutex);
+
+    return do_open(url);
+}
 
+int AVPlayerWidget::open_async (const char* url)
+{
     if (!inited)
         return KERROR(KEUNINITED);
+    if (!url)
+        return KERROR(KEINVAL);
+
+    /* replace the pending request and cancel the running open, the result is noticed by player_opened */
+    mutex_lock(ctrl_mutex);
+    av_freep(&open_url);
+    open_url = av_strdup(url);
+    if (!open_url) {
+        mutex_unlock(ctrl_mutex);
+        return KERROR(KENOMEM);
+    }
+    open_req = true;
+    SDL_AtomicSet(&open_abort, 1);     // reset when the control thread takes the request
+    SDL_AtomicSet(&prefetch_abort, 1); // the staged file is useless now
+    SDL_CondSignal(ctrl_cond);
+    mutex_unlock(ctrl_mutex);
+
+    KLOGD("Open request: %s.\n", url);
+    return 0;
+}
+
+int AVPlayerWidget::do_open (const char* url)
+{
+    int64_t open_start = av_gettime();
+    bool    warm = false;
+    int     ret;
+
+    mutex_lock(op_mutex);
 
+    /* keep the pipeline of the playing file, only the contexts are swapped */
     if (this->url)
-        stop();
+        unload_media();
+    set_state(PLAYER_STATE_OPENING);
+    open_deadline = av_gettime() + (int64_t)OPEN_TIMEOUT * 1000;
+    emit open_progress(0);
 
     /* open media file */
     ret = open_media_file(url);
@@ -693,190 +1296,655 @@ int AVPlayerWidget::open (const char* url)
     priclk.set(start_time);
     vclk.set(start_time);
 
+    /* reuse the warm pipeline, build a new one if the streams do not match */
+    if (demux) {
+        ret = reload_pipeline();
+        if (ret < 0) {
+            if (interrupt_cb(this))
+                goto fail;
+            KLOGD("Pipeline can not be reused: %s.\n", kerr2str(-ret));
+            close_pipeline();
+        } else {
+            warm = true;
+        }
+    }
+    if (!demux) {
+        ret = init_pipeline();
+        if (ret < 0)
+            goto fail;
+    }
+
+    stopped = false;
+    SDL_AtomicSet(&stop_req, 0);
+    set_state(PLAYER_STATE_PAUSED);
+    emit open_progress(100);
+
+    logger.info("File %s is open.\n", url);
+    KLOGD("Pipeline %s in %lfs.\n", warm ? "reused" : "created",
+          (av_gettime() - open_start) / (double)AV_TIME_BASE);
+    ret = 0;
+fail:
+    open_deadline = 0;
+    if (ret < 0) {
+        if (SDL_AtomicGet(&open_abort) || SDL_AtomicGet(&close_req)) {
+            logger.info("Opening %s is cancelled.\n", url);
+            ret = KERROR(KEABORTED);
+        }
+
+        /* release what has been created */
+        stopped = false;
+        do_stop();
+        set_state(PLAYER_STATE_STOPPED);
+    }
+    mutex_unlock(op_mutex);
+    return ret;
+}
+
+int AVPlayerWidget::init_pipeline ()
+{
+    AudioParams   ap_src;
+    AudioParams   ap_tgt;
+    BudgetStreams streams;
+    BudgetPlan    plan;
+    int           ret;
+
     /* create mutex and cond */
-    wait_mutex = SDL_CreateMutex();
+    wait_mutex = mutex_create("wait_mutex");
     if (!wait_mutex) {
         logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_MUTEX_FAIL), SDL_GetError());
-        GOTO_FAIL(KECREATE_SDL_MUTEX_FAIL);
+        return KERROR(KECREATE_SDL_MUTEX_FAIL);
     }
     continue_read_cond = SDL_CreateCond();
-    if (!wait_mutex) {
+    if (!continue_read_cond) {
         logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_COND_FAIL), SDL_GetError());
-        GOTO_FAIL(KECREATE_SDL_COND_FAIL);
+        return KERROR(KECREATE_SDL_COND_FAIL);
     }
 
+    /* size the queues from the share of the memory budget */
+    budget_join(&budget, mem_budget);
+    budget_fill_streams(&streams, avfctx, vst, ast);
+    budget_plan(budget_get_share(&budget), &streams, &plan);
+    max_pktq_size = (int)plan.pktq_size;
+    max_pictq_len = plan.pictq_len;
+    max_sampleq_len = plan.sampleq_len;
+    KLOGD("Memory budget %.1lfMB: packets %.1lfMB, %d pictures, %d sample frames.\n",
+          budget_get_share(&budget) / 1048576.0, plan.pktq_size / 1048576.0, plan.pictq_len, plan.sampleq_len);
+
     /* init queues */
     ret = init_queues(max_pictq_len, max_sampleq_len);
     if (ret < 0) {
         logger.FATALN("[%s: %d]%s.\n", kerr2str(KEQUEUE_INIT_FAIL));
-        GOTO_FAIL(KEQUEUE_INIT_FAIL);
+        return KERROR(KEQUEUE_INIT_FAIL);
     }
+    emit open_progress(60);
     
     /* init demux */
-    demux = _New Demux(avfctx, 
-                       vpktq, apktq, 
-                       wait_mutex, continue_read_cond,
-                       vst_idx, ast_idx, 
+    demux = _New Demux(avfctx,
+                       vpktq, apktq,
+                       wait_mutex,
+                       vst_idx, ast_idx,
                        infinite_buf, max_pktq_size);
     if (!demux)
-        GOTO_FAIL(KENOMEM);
+        return KERROR(KENOMEM);
     QObject::connect(demux, SIGNAL(err_occured(int)), this, SLOT(stop(int)));
-    ret = demux->init();   
+    demux->set_budget(&budget);
+    ret = demux->init(pool, session);   
     if (ret < 0) {
         logger.FATALN("[%s: %d]%s.\n", kerr2str(KEDEMUX_INIT_FAIL));
-        GOTO_FAIL(KEDEMUX_INIT_FAIL);
+        return KERROR(KEDEMUX_INIT_FAIL);
     }
 
     /* init decoder */
     ret = 0;
     if (vst) {
-        vdec = _New Decoder(avfctx, vst_idx, vpktq, vfq, wait_mutex, continue_read_cond);
+        vdec = _New Decoder(avfctx, vst_idx, vpktq, vfq);
         if (!vdec)
-            GOTO_FAIL(KENOMEM);
+            return KERROR(KENOMEM);
         QObject::connect(vdec, SIGNAL(err_occured(int)), this, SLOT(stop(int)));
-        ret = vdec->init(priclk);
+        ret = vdec->init(priclk, pool, session);
     }
     if (!ret && ast) {
-        adec = _New Decoder(avfctx, ast_idx, apktq, afq, wait_mutex, continue_read_cond);
+        adec = _New Decoder(avfctx, ast_idx, apktq, afq);
         if (!adec)
-            GOTO_FAIL(KENOMEM);
+            return KERROR(KENOMEM);
         QObject::connect(adec, SIGNAL(err_occured(int)), this, SLOT(stop(int)));
-        ret = adec->init(priclk);
+        ret = adec->init(priclk, pool, session);
+        if (vdec)
+            adec->set_master(vdec);
     }
     if (ret < 0) {
         logger.FATALN("[%s: %d]%s.\n", kerr2str(KEDECODER_INIT_FAIL));
-        GOTO_FAIL(KEDECODER_INIT_FAIL);
+        return KERROR(KEDECODER_INIT_FAIL);
     }
+    emit open_progress(80);
 
     /* init adev */
-    AudioParams ap_src, ap_tgt;
     if (ast) {
         adev = _New Adev(audio_fill_proc, this);
         if (!adev)
-            GOTO_FAIL(KENOMEM);
+            return KERROR(KENOMEM);
         QObject::connect(adev, SIGNAL(err_occured(int)), this, SLOT(stop(int)));
-
-        /* wait for the first audio frame to be decode */
-        Frame *af = afq->peek();
-        if (!af)
-            GOTO_FAIL(KENO_FIRST_FRAME);
-
-        ap_src.channels = af->frame->channels;
-        ap_src.channel_layout = af->frame->channel_layout <= 0 ?
-                                av_get_default_channel_layout(ap_src.channels) :
-                                af->frame->channel_layout; // to fix *.wma
-        ap_src.nb_samples = af->frame->nb_samples;
-        ap_src.sample_fmt = (AVSampleFormat)af->frame->format;
-        ap_src.sample_rate = af->frame->sample_rate;
-        ret = adev->init(ap_src, &ap_tgt);
+        ret = get_audio_params(&ap_src);
+        if (ret < 0)
+            return ret;
+        ret = adev->init(ap_src, &ap_tgt, &mem);
         if (ret < 0) {
             logger.FATALN("[%s: %d]%s.\n", kerr2str(KEDEV_INIT_FAIL));
-            GOTO_FAIL(KEDEV_INIT_FAIL);
+            return KERROR(KEDEV_INIT_FAIL);
         }
     }
 
     /* init render */
     render = _New Render(vdev ? vdev->get_sdl_renderer() : NULL, vfq, afq, wait_mutex, continue_read_cond);
     if (!render)
-        GOTO_FAIL(KENOMEM);
+        return KERROR(KENOMEM);
     if (vdev)
         render->init_vrender();
     if (adev) {
         ret = render->init_arender(ap_src, ap_tgt);
         if (ret < 0) {
             logger.FATALN("[%s: %d]%s.\n", kerr2str(KERENDER_INIT_FAIL));
-            GOTO_FAIL(KERENDER_INIT_FAIL); 
+            return KERROR(KERENDER_INIT_FAIL); 
         }
     }
     render->set_speed(speed);
+    serial = 0;
 
-    stopped = false;
-    stop_req = false;
+    return 0;
+}
 
-    logger.info("File %s is open.\n", url);
+int AVPlayerWidget::reload_pipeline ()
+{
+    AudioParams   ap_src;
+    AudioParams   ap_tgt;
+    BudgetStreams streams;
+    BudgetPlan    plan;
+    bool          reopened = false;
+    int           ret;
+
+    /* the pipeline is built for the same kinds of streams */
+    if (!vst != !vdec || !ast != !adec)
+        return KERROR(KEINVAL);
+
+    /* and its frame queues fit in the budget with the new streams */
+    budget_fill_streams(&streams, avfctx, vst, ast);
+    budget_plan(budget_get_share(&budget), &streams, &plan);
+    if ((vfq && plan.pictq_len < vfq->get_max_len()) || (afq && plan.sampleq_len < afq->get_max_len()))
+        return KERROR(KEINVAL);
+
+    /* swap the format context and the codec contexts, the threads are paused */
+    ret = demux->reset(avfctx, vst_idx, ast_idx);
+    if (!ret && vdec)
+        ret = vdec->reset(avfctx, vst_idx, priclk);
+    if (!ret && adec)
+        ret = adec->reset(avfctx, ast_idx, priclk);
+    if (ret < 0)
+        return ret;
+    emit open_progress(60);
+
+    /* start demux and decoders */
+    if (vpktq)
+        vpktq->restore();
+    if (apktq)
+        apktq->restore();
+    demux->start();
+    if (adec)
+        adec->start();
+    if (vdec)
+        vdec->start();
+    emit open_progress(80);
+
+    /* reopen the audio device only if the output format changes */
+    if (adev) {
+        ret = get_audio_params(&ap_src);
+        if (ret < 0)
+            return ret;
+        ap_tgt = render->get_ap_tgt();
+        if (ap_src.channels != ap_tgt.channels
+            || ap_src.sample_rate != ap_tgt.sample_rate
+            || ap_src.nb_samples > ap_tgt.nb_samples) {
+            adev->close();
+            ret = adev->init(ap_src, &ap_tgt, &mem);
+            if (ret < 0) {
+                logger.FATALN("[%s: %d]%s.\n", kerr2str(KEDEV_INIT_FAIL));
+                return KERROR(KEDEV_INIT_FAIL);
+            }
+            reopened = true;
+            KLOGD("Audio device reopened.\n");
+        }
+
+        /* the resampler is kept if the input format matches */
+        if (reopened || !audio_params_equal(ap_src, render->get_ap_src())) {
+            render->close_arender();
+            ret = render->init_arender(ap_src, ap_tgt);
+            if (ret < 0) {
+                logger.FATALN("[%s: %d]%s.\n", kerr2str(KERENDER_INIT_FAIL));
+                return KERROR(KERENDER_INIT_FAIL); 
+            }
+        }
+        adev->set_cur_af_pts(start_time);
+    }
+
+    /* the serials go on from the previous file */
+    serial = adec ? adec->get_serial() : vdec->get_serial();
+
+    return 0;
+}
+
+int AVPlayerWidget::get_audio_params (AudioParams *ap_src)
+{
+    Frame *af = NULL;
+
+    /* wait for the first audio frame to be decode, cancellable */
+    while (!af && !interrupt_cb(this)) {
+        af = afq->peek_timeout(OPEN_POLL_INTERVAL);
+        if (!af && afq->is_eof())
+            break;
+    }
+    if (!af)
+        return KERROR(KENO_FIRST_FRAME);
+
+    get_frame_audio_params(af->frame, ap_src);
+
+    return 0;
+}
+
+int AVPlayerWidget::prefetch (const char* url)
+{
+    if (!inited)
+        return KERROR(KEUNINITED);
+
+    /* cancel the pending and the running prefetch, and drop the staged file */
+    if (!url) {
+        mutex_lock(ctrl_mutex);
+        prefetch_req = false;
+        av_freep(&prefetch_url);
+        SDL_AtomicSet(&prefetch_abort, 1);
+        mutex_unlock(ctrl_mutex);
+
+        mutex_lock(op_mutex);
+        cancel_prefetch();
+        mutex_unlock(op_mutex);
+        return 0;
+    }
+
+    /* replace the pending request, the running one is cancelled */
+    mutex_lock(ctrl_mutex);
+    av_freep(&prefetch_url);
+    prefetch_url = av_strdup(url);
+    if (!prefetch_url) {
+        mutex_unlock(ctrl_mutex);
+        return KERROR(KENOMEM);
+    }
+    SDL_AtomicSet(&prefetch_abort, 1);
+    prefetch_req = true;
+    SDL_CondSignal(ctrl_cond);
+    mutex_unlock(ctrl_mutex);
+
+    KLOGD("Prefetch request: %s.\n", url);
+    return 0;
+}
+
+int AVPlayerWidget::do_prefetch (const char* url)
+{
+    AVFormatContext *ctx = NULL;
+    AudioParams      ap_src;
+    AudioParams      ap_tgt;
+    int              vidx;
+    int              aidx;
+    int              ret;
+
+    /* only a local file played to the end can be spliced */
+    mutex_lock(op_mutex);
+    cancel_prefetch();
+    ret = (!this->url || stopped || !demux || realtime || next_avfctx) ? KERROR(KEINVAL) : 0;
+    mutex_unlock(op_mutex);
+    if (ret < 0)
+        return ret;
+
+    /* open the next file without holding op_mutex, cancellable */
+    prefetch_deadline = av_gettime() + (int64_t)OPEN_TIMEOUT * 1000;
+    ret = probe_media_file(url, prefetch_interrupt_cb, &ctx, &vidx, &aidx);
+    prefetch_deadline = 0;
+    if (ret < 0)
+        goto fail;
+
+    mutex_lock(op_mutex);
+
+    /* the pipeline has been changed or stopped while probing */
+    if (prefetch_interrupt_cb(this) || !this->url || stopped || !demux || next_avfctx) {
+        mutex_unlock(op_mutex);
+        GOTO_FAIL(KEABORTED);
+    }
+
+    /* the next file must be decoded by the same kinds of streams */
+    if ((vidx >= 0) != (NULL != vdec) || (aidx >= 0) != (NULL != adec)) {
+        mutex_unlock(op_mutex);
+        GOTO_FAIL(KEINVAL);
+    }
+
+    /* the audio device is kept, the sample rate and the buffer size must fit */
+    if (adec) {
+        ap_src = render->get_ap_src();
+        ap_tgt = render->get_ap_tgt();
+        if (ctx->streams[aidx]->codecpar->sample_rate != ap_src.sample_rate
+            || ctx->streams[aidx]->codecpar->frame_size <= 0
+            || ctx->streams[aidx]->codecpar->frame_size > ap_tgt.nb_samples) {
+            mutex_unlock(op_mutex);
+            GOTO_FAIL(KEINVAL);
+        }
+    }
+
+    /* open the codecs of the next file */
+    ctx->interrupt_callback.callback = interrupt_cb;
+    ret = vdec ? vdec->stage(ctx, vidx) : 0;
+    if (!ret && adec)
+        ret = adec->stage(ctx, aidx);
+    if (!ret) {
+        next_url = av_strdup(url);
+        if (!next_url)
+            ret = KERROR(KENOMEM);
+    }
+    if (ret < 0) {
+        if (vdec)
+            vdec->unstage();
+        if (adec)
+            adec->unstage();
+        mutex_unlock(op_mutex);
+        goto fail;
+    }
+    next_avfctx = ctx;
+    next_vst_idx = vidx;
+    next_ast_idx = aidx;
+    ctx = NULL;
+
+    /* the demux reads the next file after eof */
+    ret = demux->stage(next_avfctx, next_vst_idx, next_ast_idx);
+    if (ret < 0) {
+        release_prefetch();
+        mutex_unlock(op_mutex);
+        goto fail;
+    }
+
+    /* the decoders paused at eof go on with the splice packets */
+    if (vdec)
+        vdec->start();
+    if (adec)
+        adec->start();
+
+    mutex_unlock(op_mutex);
+    logger.info("File %s is prefetched.\n", url);
     ret = 0;
 fail:
-    if (ret < 0)
-        stop();
+    avformat_close_input(&ctx);
+    if (KERROR(KEINVAL) == ret)
+        KLOGD("File %s can not be spliced.\n", url);
     return ret;
 }
 
+void AVPlayerWidget::cancel_prefetch ()
+{
+    /* the demux has switched to it, too late */
+    if (!next_avfctx || (demux && !demux->unstage()))
+        return;
+
+    if (vdec)
+        vdec->unstage();
+    if (adec)
+        adec->unstage();
+    avformat_close_input(&next_avfctx);
+    av_freep(&next_url);
+    KLOGD("Prefetch cancelled.\n");
+}
+
+void AVPlayerWidget::release_prefetch ()
+{
+    /* the threads are paused or closed */
+    if (demux)
+        demux->unstage();
+    if (vdec)
+        vdec->unstage();
+    if (adec)
+        adec->unstage();
+    avformat_close_input(&next_avfctx);
+    avformat_close_input(&retired_avfctx);
+    av_freep(&next_url);
+}
+
+void AVPlayerWidget::finish_splice ()
+{
+    /* the packets of the old file have been decoded, close it at the next splice */
+    avformat_close_input(&retired_avfctx);
+    retired_avfctx = avfctx;
+    avfctx = next_avfctx;
+    next_avfctx = NULL;
+    av_freep(&url);
+    url = next_url;
+    next_url = NULL;
+    vst_idx = next_vst_idx;
+    ast_idx = next_ast_idx;
+    vst = vst_idx >= 0 ? avfctx->streams[vst_idx] : NULL;
+    ast = ast_idx >= 0 ? avfctx->streams[ast_idx] : NULL;
+
+    /* update file params, see do_open() */
+    duration = avfctx->duration / (double)AV_TIME_BASE;
+    duration = duration <= 0 ? 0 : duration;
+    start_time = (double)(AV_NOPTS_VALUE == avfctx->start_time ? 
+                          0.0 : 
+                          (double)avfctx->start_time / AV_TIME_BASE);
+    max_frame_duration = (avfctx->iformat->flags & AVFMT_TS_DISCONT) ? 
+                         10.0 :
+                         3600.0;
+    realtime = is_realtime();
+
+    logger.info("File %s is spliced.\n", url);
+}
+
+void AVPlayerWidget::splice ()
+{
+    bool spliced = false;
+
+    /* the first frame of the next file is played */
+    mutex_lock(op_mutex);
+    if (next_avfctx && url && !stopped && demux && !demux->is_staged()) {
+        finish_splice();
+        spliced = true;
+    }
+    mutex_unlock(op_mutex);
+
+    /* notice GUI */
+    if (spliced)
+        emit player_spliced();
+}
+
 void AVPlayerWidget::stop ()
 {
-    if (!url || stopped)
+    /* cancel the pending and the running open */
+    if (inited) {
+        mutex_lock(ctrl_mutex);
+        open_req = false;
+        av_freep(&open_url);
+        SDL_AtomicSet(&open_abort, 1);
+        prefetch_req = false;
+        av_freep(&prefetch_url);
+        SDL_AtomicSet(&prefetch_abort, 1);
+        mutex_unlock(ctrl_mutex);
+    }
+
+    do_stop();
+}
+
+void AVPlayerWidget::do_stop ()
+{
+    if ((!url || stopped) && !demux)
         return;
-    stop_req = true;
+    SDL_AtomicSet(&stop_req, 1);
+
+    /* wait for the running seek and cancel the pending one */
+    mutex_lock(op_mutex);
+    mutex_lock(ctrl_mutex);
+    SDL_AtomicSet(&seek_req, 0);
+    SDL_AtomicSet(&seeking, 0);
+    mutex_unlock(ctrl_mutex);
+
+    /* close threads, devices and queues */
+    close_pipeline();
+
+    /* close the staged and the spliced out files */
+    release_prefetch();
+
+#ifdef _DEBUG
+    /* everything of the pipeline has been freed */
+    mem_check_leaks(&mem, MEM_ALL_KINDS, "Player widget stopped");
+#endif /* _DEBUG */
+
+    /* close format context */
+    avformat_close_input(&avfctx);
+
+    /* free other memebers */
+    av_freep(&url);
+
+    /* reset members */
+    reset_members();
+
+    /* force refresh */
+    force_refresh();
+
+    /* update GUI */
+    emit pos_changed(0.0); // to fix bug
+
+    SDL_AtomicSet(&stop_req, 0);
+    set_state(PLAYER_STATE_STOPPED);
+    mutex_unlock(op_mutex);
+    KLOGD("Player widget stopped.\n");
+}
+
+void AVPlayerWidget::close_pipeline ()
+{
+    /* pause decoders, the threads blocked on the queues return */
+    if (vdec)
+        vdec->pause();
+    if (adec)
+        adec->pause();
 
     /* stop video refresh thread */
-    if (!vstopped) {
-        vstop_req = true;
-        if (vfq)
-            vfq->abort();
-        SDL_LockMutex(pause_mutex);
-        SDL_CondSignal(pause_cond);
-        SDL_UnlockMutex(pause_mutex);
-        while (!vstopped);
-    }
+    vstop();
         
-    /* destroy texture */
-    SDL_DestroyTexture(cur_texture);
+    /* the texture is owned by render */
     cur_texture = NULL;
 
     /* clear frames */
-    av_frame_free(&priv_vf->frame);
+    if (priv_vf)
+        mem_frame_free(&mem, &priv_vf->frame);
     delete priv_vf;
+    priv_vf = NULL;
 
     /* close audio device */
     if (adev) {
         adev->close();
         delete adev;
+        adev = NULL;
     }
 
     /* close render */
-    if (vst && render)
+    if (render) {
         render->close_vrender();
-    if (ast && render)
         render->close_arender();
-    delete render;
+        delete render;
+        render = NULL;
+    }
 
     /* close decoders */
     if (vdec) {
         vdec->close();
         delete vdec;
+        vdec = NULL;
     }
     if (adec) {
         adec->close();
         delete adec;
+        adec = NULL;
     }
 
     /* close demux */
     if (demux)
         demux->close();
     delete demux;
+    demux = NULL;
 
     /* clear queues */
     delete vfq;
     delete afq;
     delete vpktq;
     delete apktq;
+    vfq = afq = NULL;
+    vpktq = apktq = NULL;
 
-    /* close format context */
-    avformat_close_input(&avfctx);
+    /* destroy mutex and cond */
+    if (wait_mutex)
+        mutex_destroy(wait_mutex);
+    if (continue_read_cond)
+        SDL_DestroyCond(continue_read_cond);
+    wait_mutex = NULL;
+    continue_read_cond = NULL;
 
-    /* free other memebers */
-    av_freep(&url);
+    /* the other players get the share */
+    budget_leave(&budget);
+}
 
-    /* reset members */
-    reset_members();
+void AVPlayerWidget::unload_media ()
+{
+    /* cancel the pending seek, the running one holds op_mutex */
+    mutex_lock(ctrl_mutex);
+    SDL_AtomicSet(&seek_req, 0);
+    SDL_AtomicSet(&seeking, 0);
+    mutex_unlock(ctrl_mutex);
 
-    /* force refresh */
-    force_refresh();
+    /* pause demux before stop_req is set, so the reading is not interrupted */
+    if (demux)
+        demux->pause();
+    SDL_AtomicSet(&stop_req, 1);
 
-    /* update GUI */
-    emit pos_changed(0.0); // to fix bug
+    /* pause decoders, the threads blocked on the queues return */
+    if (vdec)
+        vdec->pause();
+    if (adec)
+        adec->pause();
+
+    /* stop video refresh thread and pause audio device */
+    vstop();
+    if (adev)
+        adev->pause();
+
+    /* clear queues, avcodec buffers and audio buffer */
+    if (vdec)
+        vdec->flush();
+    if (adec)
+        adec->flush();
+    if (adev)
+        adev->flush();
+
+    /* close the staged and the spliced out files */
+    release_prefetch();
+
+    /* free the previous frame, the texture is kept by render for the next file */
+    cur_texture = NULL;
+    if (priv_vf)
+        mem_frame_free(&mem, &priv_vf->frame);
+    delete priv_vf;
+    priv_vf = NULL;
+
+    /* close format context */
+    avformat_close_input(&avfctx);
+    av_freep(&url);
+    vst = ast = NULL;
+    vst_idx = ast_idx = -1;
 
-    stop_req = false;
-    logger.debug("Player widget stopped.\n");
+    paused = true;
+    stopped = true;
+    SDL_AtomicSet(&stop_req, 0);
+    set_state(PLAYER_STATE_STOPPED);
+    KLOGD("Media file unloaded, the pipeline is kept.\n");
 }
 
 void AVPlayerWidget::play ()
@@ -884,6 +1952,8 @@ void AVPlayerWidget::play ()
     if (!url || stopped)
         return;
 
+    mutex_lock(op_mutex);
+
     /* play audio */
     if (adev)
         aplay();
@@ -896,8 +1966,12 @@ void AVPlayerWidget::play ()
     delay = 0.0;
 
     paused = false;
+    if (PLAYER_STATE_SEEKING != state.get())
+        set_state(PLAYER_STATE_PLAYING);
+
+    mutex_unlock(op_mutex);
 
-    logger.debug("Player widget Playing.\n");
+    KLOGD("Player widget Playing.\n");
 }
 
 void AVPlayerWidget::pause ()
@@ -905,6 +1979,8 @@ void AVPlayerWidget::pause ()
     if (!url || stopped)
         return;
 
+    mutex_lock(op_mutex);
+
     /* pause audio */
     if (adev)
         apause();
@@ -914,8 +1990,12 @@ void AVPlayerWidget::pause ()
         vpause();
 
     paused = true;
+    if (PLAYER_STATE_SEEKING != state.get())
+        set_state(PLAYER_STATE_PAUSED);
 
-    logger.debug("Player widget paused.\n");
+    mutex_unlock(op_mutex);
+
+    KLOGD("Player widget paused.\n");
 }
 
 void AVPlayerWidget::close ()
@@ -926,63 +2006,85 @@ void AVPlayerWidget::close ()
         return;
     inited = false;
 
-    close_req = true;
+    SDL_AtomicSet(&close_req, 1);
+
+    /* destroy control thread, the running open is interrupted */
+    if (ctrl_thr) {
+        mutex_lock(ctrl_mutex);
+        SDL_CondSignal(ctrl_cond);
+        mutex_unlock(ctrl_mutex);
+        SDL_WaitThread(ctrl_thr, NULL);
+        ctrl_thr = NULL;
+    }
+    av_freep(&open_url);
+    av_freep(&prefetch_url);
 
-    /* stop */
-    if (!stopped)
-        stop();
+    /* stop, the kept pipeline is released too */
+    stop();
 
     /* stop timer */
     if (timer.isActive())
         timer.stop();
 
-    /* destroy video refresh thread */
-    if (vrefresh_thr) {
-        SDL_LockMutex(pause_mutex);
-        SDL_CondSignal(pause_cond);
-        SDL_UnlockMutex(pause_mutex);
-        SDL_WaitThread(vrefresh_thr, NULL);
-    }
+    /* finish video refresh task */
+    if (pause_mutex)
+        wake_vrefresh();
+    vrefresh_pool.join(&vrefresh_task);
+    vrefresh_pool.close();
 
     /* destroy mutex and cond */
     if (pause_mutex)
-        SDL_DestroyMutex(pause_mutex);
-    if (pause_cond)
-        SDL_DestroyCond(pause_cond);
+        mutex_destroy(pause_mutex);
+    if (ctrl_mutex)
+        mutex_destroy(ctrl_mutex);
+    if (ctrl_cond)
+        SDL_DestroyCond(ctrl_cond);
+    if (op_mutex)
+        mutex_destroy(op_mutex);
+    state.close();
+    vstate.close();
 
     /* clear msger */
     if (msger)
         msger->close();
     delete msger;
+    hud_texture = NULL;
+    if (hud_msger)
+        hud_msger->close();
+    delete hud_msger;
 
     /* clear vdev */
     if (vdev)
         vdev->close();
     delete vdev;
 
-    /* deinit SDL */
-    SDL_Quit();
-
-    /* deinit FFmpeg components */
-    avformat_network_deinit();
+    /* close the session, SDL and FFmpeg are deinited with the last player */
+    if (pool) {
+        if (session >= 0)
+            pool->close_session(session);
+        engine_global_deinit(PLAYER_SDL_FLAGS);
+    }
 
     /* reset members */
     reset_members();
 
     pause_mutex = NULL;
-    pause_cond = NULL;
+    ctrl_mutex = NULL;
+    ctrl_cond = NULL;
+    op_mutex = NULL;
     vdev = NULL;
-    vrefresh_thr = NULL;
+    pool = NULL;
+    session = -1;
+    ctrl_thr = NULL;
     msger = NULL;
+    hud_msger = NULL;
 
-    logger.debug("Player widget closed.\n");
+    KLOGD("Player widget closed.\n");
 }
 
 int AVPlayerWidget::seek (double pos)
 {
-    bool _paused = paused;
-
-    if (!url)
+    if (!url || stopped)
         return KERROR(KEUNINITED);
 
     if (pos > duration)
@@ -991,91 +2093,66 @@ int AVPlayerWidget::seek (double pos)
     if (pos - start_time < 0.001)
         pos = 0.0;
 
-    logger.info("Seeking to %lfs.\n", pos);
-
-    /* pause video refresh */
-    if (vst) // not "if (vdev)"
-        vpause();
-
-    /* pause audio */
-    if (adev)
-        adev->pause();
-
-    /* pause decoder */
-    if (adec)
-        adec->pause();
-    if (vdec)
-        vdec->pause();
-
-    /* pause demux */
-    demux->pause();
-
-    /* clear queues and avcodec buffer */
-    if (vdec)
-        vdec->flush();
-    if (adec)
-        adec->flush();
-
-    /* clear audio buffer */
-    if (adev)
-        adev->flush();
-
-    /* set clocks */
-    priclk.set(pos);
-    vclk.set(pos);
-    delay = 0.0;
+    /* 
+    * record the latest target only, the control thread takes it when the 
+    * previous seek is done, so the requests in a burst are merged into one 
+    */
+    mutex_lock(ctrl_mutex);
+    if (SDL_AtomicGet(&seek_req))
+        seek_stats.coalesced++;
+    else if (!SDL_AtomicGet(&seeking))
+        seek_req_time = av_gettime();
+    seek_target = pos;
+    SDL_AtomicSet(&seek_req, 1);
+    SDL_CondSignal(ctrl_cond);
+    mutex_unlock(ctrl_mutex);
+
+    KLOGD("Seek request: %lfs.\n", pos);
+    return 0;
+}
 
-    /* seek */
-    int ret = demux->seek(pos);
-    if (ret < 0)
-        return ret;
-    if (vdec)
-        vdec->seek(pos);
-    if (adec)
-        adec->seek(pos);
+double AVPlayerWidget::get_pos ()
+{
+    double target;
+    bool   pending;
 
-    /* reset abort flag */
-    if (vpktq)
-        vpktq->restore();
-    if (apktq)
-        apktq->restore();
+    if (!url || !ctrl_mutex)
+        return 0.0;
 
-    /* start demux */
-    demux->start();
+    /* the target position while seeking, so the nearby requests accumulate */
+    mutex_lock(ctrl_mutex);
+    pending = SDL_AtomicGet(&seek_req) || SDL_AtomicGet(&seeking);
+    target = seek_target;
+    mutex_unlock(ctrl_mutex);
 
-    /* start decoder */
-    if (adec)
-        adec->start();
-    if (vdec)
-        vdec->start();
-
-    /* wait for seeking */
-    while (adec && adec->is_seeking())
-    while (vdec && vdec->is_seeking())
-
-    /* free privious frame */
-    av_frame_free(&priv_vf->frame);
-    delete priv_vf;
-    priv_vf = NULL;
+    return pending ? target : priclk.get();
+}
 
-    /* start audio and video refresh */
-    if (!_paused) {
-        if (vst)
-            vplay();
+void AVPlayerWidget::get_seek_stats (SeekStats *stats)
+{
+    if (!stats)
+        return;
 
-        if (adev)
-            adev->play();
-    } else {
-        force_refresh();
-///////////////////////////
-    }
+    if (ctrl_mutex)
+        mutex_lock(ctrl_mutex);
+    *stats = seek_stats;
+    if (ctrl_mutex)
+        mutex_unlock(ctrl_mutex);
+}
 
-    return ret;
+void AVPlayerWidget::get_mem_usage (MemUsage *usage)
+{
+    if (usage)
+        mem_get_usage(&mem, usage);
 }
 
-double AVPlayerWidget::get_pos ()
+void AVPlayerWidget::reset_seek_stats ()
 {
-    return (url ? priclk.get() : 0.0);
+    if (ctrl_mutex)
+        mutex_lock(ctrl_mutex);
+    memset(&seek_stats, 0, sizeof(SeekStats));
+    if (ctrl_mutex)
+        mutex_unlock(ctrl_mutex);
 }
 
 int AVPlayerWidget::get_fps ()
@@ -1109,6 +2186,22 @@ void AVPlayerWidget::set_frame_drop (bool drop)
     frame_drop = drop;
 }
 
+void AVPlayerWidget::set_fast_seek (bool fast)
+{
+    fast_seek = fast;
+}
+
+void AVPlayerWidget::set_mem_budget (int64_t bytes)
+{
+    /* applied when the next pipeline is created */
+    mem_budget = bytes;
+}
+
+void AVPlayerWidget::set_process_mem_budget (int64_t bytes)
+{
+    budget_set_process_limit(bytes);
+}
+
 bool AVPlayerWidget::is_paused () const
 {
     return paused;
@@ -1119,6 +2212,11 @@ bool AVPlayerWidget::is_stopped () const
     return stopped;
 }
 
+int AVPlayerWidget::get_state ()
+{
+    return (inited ? state.get() : PLAYER_STATE_STOPPED);
+}
+
 void AVPlayerWidget::set_size (int w, int h)
 {
     if (!inited)
@@ -1127,7 +2225,7 @@ void AVPlayerWidget::set_size (int w, int h)
     vdev->resize(w, h);
 
     /* force refresh */
-    if (vpaused || !vst)
+    if (WORKER_RUNNING != vstate.get() || !vst)
        force_refresh();
 
     resize(w, h);
@@ -1162,7 +2260,7 @@ int AVPlayerWidget::show_msg (const char* msg, int ms)
     /* force refresh */
     force_refresh();
 
-    logger.debug("Show message: \"%s\" for %d ms.\n", msg, ms);
+    KLOGD("Show message: \"%s\" for %d ms.\n", msg, ms);
     return 0;
 }
 
@@ -1177,22 +2275,20 @@ void AVPlayerWidget::step ()
     if (!inited || stopped || !paused)
         return;
 
-    step_req = true;
-    SDL_LockMutex(pause_mutex);
-    SDL_CondSignal(pause_cond);
-    SDL_UnlockMutex(pause_mutex);
+    SDL_AtomicSet(&step_req, 1);
+    wake_vrefresh();
 
     /* sync audio */
     if (adec)
-        adec->seek(vclk.get());
+        adec->seek(vclk.get(), true);
 
-    logger.debug("step.\n");
+    KLOGD("step.\n");
 
 }
 
 void AVPlayerWidget::switch_fullscreen (bool fullscr)
 {
-    bool vpaused_old = vpaused;
+    bool vpaused_old = WORKER_RUNNING != vstate.get();
 
     if (!inited || !vdev->height() || !vdev->width())
         return;
@@ -1214,6 +2310,32 @@ void AVPlayerWidget::switch_fullscreen (bool fullscr)
         vplay();
 }
 
+void AVPlayerWidget::switch_hud ()
+{
+    if (!inited)
+        return;
+
+    /* the rates restart, the HUD is drawn at the next refresh */
+    hud_on = !hud_on;
+    if (hud_on) {
+        read_meter.reset();
+        vdec_meter.reset();
+        adec_meter.reset();
+        vrender_meter.reset();
+        present_meter.reset();
+    }
+    hud_texture = NULL;
+    hud_time = 0;
+    force_refresh();
+
+    KLOGD("Stats HUD %s.\n", hud_on ? "on" : "off");
+}
+
+bool AVPlayerWidget::is_hud_on () const
+{
+    return hud_on;
+}
+
 int AVPlayerWidget::clear_msg ()
 {
     if (!inited)
@@ -1229,7 +2351,7 @@ int AVPlayerWidget::clear_msg ()
     /* force_refresh */
     force_refresh();
 
-    logger.debug("Message cleared.\n");
+    KLOGD("Message cleared.\n");
     return 0;
 }
 
@@ -1238,10 +2360,22 @@ AVPlayerWidget::AVPlayerWidget (QWidget* parent)
 {
     inited = false;
     pause_mutex = NULL;
-    pause_cond = NULL;
+    ctrl_mutex = NULL;
+    ctrl_cond = NULL;
+    op_mutex = NULL;
     vdev = NULL;
-    vrefresh_thr = NULL;
+    pool = NULL;
+    session = -1;
+    ctrl_thr = NULL;
     msger = NULL;
+    hud_msger = NULL;
+    hud_on = false;
+    hud_texture = NULL;
+    open_url = NULL;
+    memset(&seek_stats, 0, sizeof(SeekStats));
+    mem_stats_reset(&mem);
+    memset(&budget, 0, sizeof(Budget));
+    mem_budget = 0;
     reset_members();
 
     /* does not refresh when the window changed */
@@ -14,6 +14,11 @@
 #include "vdev/vdev.h"
 #include "adev/adev.h"
 #include "log/log.h"
+#include "state/state.h"
+#include "pool/pool.h"
+#include "stats/stats.h"
+#include "mem/mem.h"
+#include "budget/budget.h"
 
 extern "C" 
 {
@@ -21,14 +26,32 @@ extern "C"
 #include "SDL2/SDL.h"
 }
 
-/* media info */
-class AVPLAYERWIDGET_EXPORT MediaInfo {
-private:
-    
-public:
-    MediaInfo ();
-    ~MediaInfo ();
-};
+/* open limits (unit: millisecond) */
+#define OPEN_TIMEOUT        15000 // hard upper bound of opening a media file
+#define OPEN_POLL_INTERVAL  50    // interval of checking the cancellation while waiting
+
+/* interval of checking whether the audio reaches the spliced file (unit: second) */
+#define SPLICE_POLL_INTERVAL 0.01
+
+/* what the video refresh task is waiting for */
+#define VWAIT_NONE          0
+#define VWAIT_PAUSE         1 // woken by wake_vrefresh()
+#define VWAIT_STOP          2 // woken by wake_vrefresh()
+#define VWAIT_DELAY         3 // woken at vrefresh_time
+
+/* stats HUD */
+#define HUD_INTERVAL        500000 // the HUD is updated so often (unit: microsecond)
+#define HUD_MAX_TEXT        1024
+
+/* seek statistics */
+typedef struct SeekStats {
+    int              count;     // number of seeks completed
+    int              coalesced; // number of requests merged into a later one
+    double           last;      // latency of the last seek (unit: second)
+    double           min;       // min latency (unit: second)
+    double           max;       // max latency (unit: second)
+    double           avg;       // average latency (unit: second)
+}SeekStats;
 
 class AVPLAYERWIDGET_EXPORT AVPlayerWidget : public QWidget {
     Q_OBJECT
@@ -39,21 +62,28 @@ private:
     int              wanted_vst;
     int              wanted_ast;
     bool             frame_drop;
+    bool             fast_seek;
     bool             hw_acce;
     bool             infinite_buf;
     int              max_pktq_size;
     int              max_pictq_len;
     int              max_sampleq_len;
+    Budget           budget;       // joined while the pipeline exists, the queues are sized from it
+    int64_t          mem_budget;   // 0 for the default
     bool             realtime;
     double           speed;
-    bool             close_req;
+    SDL_atomic_t     close_req;
     bool             paused;
-    bool             vstop_req;
-    bool             vstopped;
-    bool             stop_req;
+    SDL_atomic_t     vstop_req;
+    SDL_atomic_t     stop_req;
     bool             stopped;
-    bool             vpause_req;
-    bool             vpaused;
+    SDL_atomic_t     vpause_req;
+    int              vwake_gen;    // increased by wake_vrefresh() under pause_mutex
+    int              vwait;        // what the video refresh task is waiting for
+    int              vwait_gen;    // vwake_gen when the video refresh task paused or stopped
+    int64_t          vrefresh_time; // time to refresh the next frame (unit: microsecond)
+    State            vstate;       // acknowledged by the video refresh thread
+    State            state;        // player state
     double           start_time;
     double           duration;
     double           delay;
@@ -96,8 +126,17 @@ private:
     /* demux */
     Demux *          demux;
 
-    /* threads */
-    SDL_Thread *     vrefresh_thr;
+    /*
+    * tasks and threads,
+    * demux and decode run on the shared pool, a player adds two threads and the SDL audio thread:
+    * the refresh worker, the SDL renderer and SDL_ttf are bound to the thread using them,
+    * the control thread, an open blocks on the network and a seek waits for the tasks of the pool
+    */
+    TaskPool *       pool;         // shared by all players, NULL if not inited
+    int              session;      // session of the task pool
+    Task             vrefresh_task;
+    TaskPool         vrefresh_pool; // one worker of this player, the renderer is used by one thread
+    SDL_Thread *     ctrl_thr;     // blocked on the other tasks, not run by the pool
 
     /* clock */
     Clock            priclk;
@@ -108,7 +147,34 @@ private:
     SDL_mutex *      wait_mutex;
     SDL_cond *       continue_read_cond;
     SDL_mutex *      pause_mutex;
-    SDL_cond *       pause_cond;
+    SDL_mutex *      ctrl_mutex;   // protects the control requests
+    SDL_cond *       ctrl_cond;
+    SDL_mutex *      op_mutex;     // serializes stop, play, pause and seek
+
+    /* open */
+    bool             open_req;     // an open request is waiting for the control thread
+    SDL_atomic_t     open_abort;   // cancel the running open, checked by interrupt_cb()
+    char *           open_url;     // url of the open request
+    int64_t          open_deadline;
+
+    /* prefetch */
+    bool             prefetch_req;   // a prefetch request is waiting for the control thread
+    SDL_atomic_t     prefetch_abort; // cancel the running prefetch, checked by prefetch_interrupt_cb()
+    char *           prefetch_url;   // url of the prefetch request
+    int64_t          prefetch_deadline;
+    char *           next_url;       // url of the staged file
+    AVFormatContext *next_avfctx;    // staged file, spliced in at eof
+    int              next_vst_idx;
+    int              next_ast_idx;
+    AVFormatContext *retired_avfctx; // spliced out, closed at the next splice or stop
+    int              serial;         // serial of the frames being played
+
+    /* seek */
+    SDL_atomic_t     seek_req;     // a seek request is waiting for the control thread
+    SDL_atomic_t     seeking;      // waiting for the first frame at the target
+    double           seek_target;  // latest requested position (unit: second)
+    int64_t          seek_req_time;
+    SeekStats        seek_stats;
 
     /* video state */
     Frame *          priv_vf;
@@ -121,9 +187,28 @@ private:
     SDL_Rect         msg_rect;
     QTimer           timer;
 
+    /* stats HUD, drawn by the video refresh task from the counters of the stages */
+    bool             hud_on;
+    Msger *          hud_msger;
+    SDL_Texture *    hud_texture;
+    SDL_Rect         hud_rect;
+    int64_t          hud_time;
+    StageMeter       read_meter;
+    StageMeter       vdec_meter;
+    StageMeter       adec_meter;
+    StageMeter       vrender_meter;
+    StageMeter       present_meter;
+    SDL_atomic_t     dropped;      // late video frames dropped
+    SDL_atomic_t     duplicated;   // video frames presented again
+    SDL_atomic_t     underruns;    // the audio device waited for a frame
+    double           av_diff;      // A-V of the last video frame (unit: second)
+
+    /* memory of the session, checked for leaks when stopped in the debug builds */
+    MemStats         mem;
+
     /* force refresh */
-    bool             force_refresh_req;
-    bool             step_req;
+    SDL_atomic_t     force_refresh_req;
+    SDL_atomic_t     step_req;
     SDL_Texture *    cur_texture;
 
 signals:
@@ -132,12 +217,17 @@ signals:
     void               player_stopped         (int);
     void               player_seeked          ();
     void               pos_changed            (double);
+    void               player_opened          (int);
+    void               open_progress          (int);
+    void               player_spliced         ();
 
 signals:
     void               err_occured            (int);
+    void               splice_reached         ();
 
 private slots:
     void               stop                   (int err_code);
+    void               splice                 ();
 
 private:
     void               mouseDoubleClickEvent  (QMouseEvent *e);
@@ -145,48 +235,80 @@ private:
 
 private:
     void               force_refresh          ();
+    void               wake_vrefresh          ();
+    void               set_state              (int state);
     void               reset_members          ();
     double             compute_delay          (Frame *priv_vf, Frame *cur_vf);
     void               calculate_display_rect (AVFrame *vf, SDL_Rect *rect);
     int                video_refresh          ();
+    void               update_hud             ();
     bool               is_realtime            ();
+    int                probe_media_file       (const char *url, int (*interrupt)(void *),
+                                               AVFormatContext **avfctx, int *vst_idx, int *ast_idx);
     int                open_media_file        (const char *url);
+    int                do_open                (const char *url);
+    void               do_stop                ();
+    int                init_pipeline          ();
+    int                reload_pipeline        ();
+    void               close_pipeline         ();
+    void               unload_media           ();
+    int                get_audio_params       (AudioParams *ap_src);
+    int                do_prefetch            (const char *url);
+    void               cancel_prefetch        ();
+    void               release_prefetch       ();
+    void               finish_splice          ();
     int                init_queues            (int max_pictq_len, int max_sampleq_len);
+    int                do_seek                ();
+    void               finish_seek            ();
     void               vplay                  ();
     void               vpause                 ();
+    void               vstop                  ();
     void               aplay                  ();
     void               apause                 ();
 
 private:
     static int         audio_fill_proc        (void *data, SampleBuf *sample_buf);
+    static int         interrupt_cb           (void *args);
+    static int         prefetch_interrupt_cb  (void *args);
 
 public:
-    int                get_media_info         (const char *url, MediaInfo *info);
 
 private:
-    static int SDLCALL vrefresh_thread        (void *args);
+    static int         vrefresh_proc          (void *args);
+    static int SDLCALL ctrl_thread            (void *args);
 
 public:
     int                init                   (bool en_hw_acce);
     int                open                   (const char *url);
+    int                open_async             (const char *url);
+    int                prefetch               (const char *url);
     void               stop                   ();
     void               play                   ();
     void               pause                  ();
     void               close                  ();
     int                seek                   (double pos);
     double             get_pos                ();
+    void               get_seek_stats         (SeekStats *stats);
+    void               get_mem_usage          (MemUsage *usage);
+    void               reset_seek_stats       ();
     int                get_fps                ();
     double             get_duration           ();
     void               set_volume             (int vol);
     int                get_volume             () const;
     void               set_frame_drop         (bool drop);
+    void               set_fast_seek          (bool fast);
+    void               set_mem_budget         (int64_t bytes);
+    static void        set_process_mem_budget (int64_t bytes);
     bool               is_paused              () const;
     bool               is_stopped             () const;
+    int                get_state              ();
     void               set_size               (int w, int h);
     int                show_msg               (const char *msg, int ms);
     void               update_video           ();
     void               step                   ();
     void               switch_fullscreen      (bool fullscr);
+    void               switch_hud             ();
+    bool               is_hud_on              () const;
 
 public slots:
     int                clear_msg              ();
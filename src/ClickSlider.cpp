@@ -1,5 +1,6 @@
 #include <QCoreApplication>
 #include <QMouseEvent>
+#include <QPainter>
 #include "ClickSlider.h"
 #include "moc_ClickSlider.cpp"
 
@@ -12,14 +13,63 @@ void ClickSlider::mousePressEvent (QMouseEvent * e)
     emit clicked();
 }
 
+void ClickSlider::mouseMoveEvent (QMouseEvent * e)
+{
+    QSlider::mouseMoveEvent(e);
+
+    double ratio = e->pos().x() / (double)width();
+    emit hovered(ratio < 0.0 ? 0.0 : (ratio > 1.0 ? 1.0 : ratio));
+}
+
+void ClickSlider::leaveEvent (QEvent * e)
+{
+    QSlider::leaveEvent(e);
+
+    emit hoverLeft();
+}
+
+void ClickSlider::paintEvent (QPaintEvent * e)
+{
+    QSlider::paintEvent(e);
+    if (m_wave.isEmpty() || width() <= 0)
+        return;
+
+    /* a column per pixel, the peaks of its buckets and the loudness inside */
+    QPainter painter(this);
+    int      mid = height() / 2;
+    double   scale = (height() / 2 - 1) / 32767.0;
+    for (int x = 0; x < width(); x++) {
+        int from = x * m_wave.size() / width();
+        int to = (x + 1) * m_wave.size() / width();
+        int min = 0, max = 0, rms = 0;
+        for (int i = from; i < (to > from ? to : from + 1); i++) {
+            min = m_wave[i].min < min ? m_wave[i].min : min;
+            max = m_wave[i].max > max ? m_wave[i].max : max;
+            rms = m_wave[i].rms > rms ? m_wave[i].rms : rms;
+        }
+        painter.setPen(QColor(90, 140, 200, 110));
+        painter.drawLine(x, mid - (int)(max * scale), x, mid - (int)(min * scale));
+        painter.setPen(QColor(140, 190, 250, 150));
+        painter.drawLine(x, mid - (int)(rms * scale), x, mid + (int)(rms * scale));
+    }
+}
+
+void ClickSlider::setWaveform (const QVector<WaveBucket> &wave)
+{
+    m_wave = wave;
+    update();
+}
+
 ClickSlider::ClickSlider (QWidget * parent)
     : QSlider (parent)
 {
+    setMouseTracking(true);
 }
 
 ClickSlider::ClickSlider (Qt::Orientation orientation, QWidget * parent)
     :QSlider (orientation, parent)
 {
+    setMouseTracking(true);
 }
 
 
@@ -4,16 +4,30 @@
 #include <Qt>
 #include <QSlider>
 #include <QMouseEvent>
+#include <QPaintEvent>
+#include <QVector>
+#include "wave/wave_cache.h"
 
 class ClickSlider : public QSlider
 {
     Q_OBJECT
 
+private:
+    QVector<WaveBucket> m_wave; // drawn over the groove, empty if none
+
 Q_SIGNALS:
     void     clicked         ();   
+    void     hovered         (double ratio); // of the width, the mouse tracking is enabled
+    void     hoverLeft       ();
 
 protected:
     void     mousePressEvent (QMouseEvent *e);
+    void     mouseMoveEvent  (QMouseEvent *e);
+    void     leaveEvent      (QEvent *e);
+    void     paintEvent      (QPaintEvent *e);
+
+public:
+    void     setWaveform     (const QVector<WaveBucket> &wave);
 
 public:
     explicit ClickSlider     (QWidget *parent = nullptr);
@@ -1,5 +1,6 @@
 ﻿#include <QEvent>
 #include <QDir>
+#include <QFile>
 #include <QDialog>
 #include <QSize>
 #include <QTime>
@@ -8,7 +9,6 @@
 #include <QString>
 #include <QMenu>
 #include <QKeyEvent>
-#include <QListWidgetItem>
 #include <QInputDialog>
 #include <QColor>
 #include <QPushButton>
@@ -18,16 +18,18 @@
 #include <QFileDialog>
 #include <QInputDialog>
 #include <QUrl>
-#include <QListWidget>
 #include <QCoreApplication>
 #include <QApplication>
 #include <QDesktopWidget>
+#include <QPixmap>
 #include <cstring>
 #include "KAVPlayer.h"
 #include "ClickSlider.h"
 #include "AVPlayerWidget.h"
 #include "error/error.h"
 #include "log/log.h"
+#include "trace/trace.h"
+#include "lock/lock.h"
 #include "inifile/inifile.h"
 
 extern "C" 
@@ -41,6 +43,7 @@ using namespace inifile;
 
 const char *fileTypeStr = "Video file(*.mp4 *.avi *mkv *.mpeg *.h264 *.h265 *.mov *.wmv *.flv);;"\
                           "Music file(*.mp3 *.mp2 *.aac *.ape *.flac *.ogg *.aiff *.m4a *.wav *.wma);;"\
+                          "Playlist(*.m3u *.m3u8 *.pls);;"\
                           "All files(*.*)";
 
 QRect Rect::toQRect ()
@@ -58,6 +61,12 @@ void Rect::setFromQRect(QRect rect)
 
 void KAVPlayer::errProc (int err_code)
 {
+    /* play over, go on with the next item */
+    if (KERROR(KEPLAY_OVER) == err_code) {
+        playNextListItem();
+        return;
+    }
+
     /* stop */
     stop();
 
@@ -83,11 +92,28 @@ void KAVPlayer::stop ()
         m_videoWidget->show_msg("Stopped", 3000);
     }
 
-    /* reset widgets */   
+    /* reset widgets */
+    resetWidgets();
+}
+
+void KAVPlayer::resetWidgets ()
+{
+    /* the prefetched item is dropped by the player */
+    m_prefetched = false;
+    m_prefetchUrl.clear();
+
     m_infoLabel->setText(" 00:00:00.000 / 00:00:00.000");
     m_progressSlider->setSliderPosition(0);
     m_progressSlider->setDisabled(true);
 
+    /* the thumbnails and the waveform of the closed file are not shown */
+    if (m_thumbs)
+        m_thumbs->open(NULL);
+    progressLeft();
+    if (m_waves)
+        m_waves->open(NULL);
+    m_progressSlider->setWaveform(QVector<WaveBucket>());
+
     /* change icon */
     m_pause->setIcon(m_iconPlay);
 
@@ -104,104 +130,69 @@ void KAVPlayer::stop ()
 
 void KAVPlayer::priv ()
 {
-    if (m_playlist.isEmpty())
-        return;
-
-    /* play privious item */
-    QMutableLinkedListIterator<PlaylistItem> iterator(m_playlist);
-    while (iterator.hasNext()) {
-        PlaylistItem next = iterator.next();
-        if (iterator.peekNext().widgetItem == m_nextItem.widgetItem) {
-            m_nextItem = next;
+    int row;
 
-            /* close the item that is playing and play new item */
-            stop();
-            pause();
+    if (!m_playlistModel->count())
+        return;
 
-            /* set focus */
-            setFocus();
-            return;
-        }    
-    }
+    /* play privious item, the first item if no privious item */
+    row = m_playlistModel->rowOf(m_nextUrl);
+    if (PLAY_MODE_RANDOM == m_playMode)
+        row = m_playlistModel->shufflePrev(row);
+    else
+        row = row > 0 ? row - 1 : 0;
+    m_nextUrl = m_playlistModel->urlAt(row);
 
-    /* play first item if no privious item */
-    m_nextItem = m_playlist.first();
-
-    /* close the item that is playing and play new item */
-    stop();
-    pause();
+    /* play new item, the item that is playing is replaced */
+    switchItem();
 
     /* set focus */
     setFocus();
 }
 
-void KAVPlayer::pause ()
+void KAVPlayer::switchItem ()
 {
-    if (m_videoWidget->is_stopped()) { // player closed
-        if (!m_nextItem.widgetItem)
-            return;
+    /* cancel the running open, a pending open request is replaced only */
+    if (PLAYER_STATE_OPENING == m_videoWidget->get_state())
+        m_videoWidget->stop();
 
-        /* select current item */
-        m_nextItem.widgetItem->setSelected(true);
+    /* reset widgets, the player keeps its pipeline and swaps the media file */
+    resetWidgets();
 
-        /* set cursor */
-        this->setCursor(Qt::WaitCursor);
+    /* open new item */
+    openItem();
+}
 
-        /* open next file */
-        int ret = m_videoWidget->open(m_nextItem.url.toStdString().c_str());
-        if (ret < 0) {
-            /* show message */
-            QFileInfo info(m_nextItem.url);
-            m_videoWidget->show_msg(("Failed to open file, Error code: " + QString::number(ret))
-                                    .toStdString().c_str(), 0);
-            logger.error(("Failed to open file \"" + m_nextItem.widgetItem->text() + "\" : " + getErrString(ret) + ".\n")
-                                    .toStdString().c_str());
+void KAVPlayer::openItem ()
+{
+    if (m_nextUrl.isEmpty() 
+        || PLAYER_STATE_OPENING == m_videoWidget->get_state())
+        return;
 
-            /* set cursor */
-            this->setCursor(Qt::ArrowCursor);
+    /* select current item */
+    selectItem(m_nextUrl);
 
-            /* set focus */
-            setFocus();
-            return;
-        }
-        if (m_autoFullscreen && !m_videoWidget->isFullScreen())
-                m_videoWidget->switch_fullscreen(true);
-        
-        /* set options */
-        m_videoWidget->set_volume(m_vol * 2);
-        m_videoWidget->set_frame_drop(false); // unsolved bug
-
-        /* get media info */
-
-        /* init widgets */
-        m_duration = m_videoWidget->get_duration();
-        int h = (int)m_duration / 3600;
-        int m = (int)m_duration % 3600 / 60;
-        int s = (int)m_duration % 60;
-        int ms = (int)(m_duration * 1000.0) % 1000;
-        QTime t(h, m, s);
-        m_strDuration = t.toString() + ".";
-        m_strDuration .append(QString("%1").arg(ms,3,10,QLatin1Char('0')));
-        m_infoLabel->setText(" 00:00:00.000 / " + m_strDuration);
-        m_progressSlider->setSliderPosition(0);
-        m_progressSlider->setDisabled(false);
-        
-        /* play */
-        m_videoWidget->play();
-
-        /* change icon */
-        m_pause->setIcon(m_iconPause);
-
-        /* set window title */
-        setWindowTitle(m_nextItem.url);
+    /* set cursor */
+    this->setCursor(Qt::WaitCursor);
 
-        /* show message */
-        QFileInfo info(m_nextItem.url);
-        m_videoWidget->show_msg(("File " + info.fileName() + " is playing")
-                                .toStdString().c_str(), 3000);
+    /* open next file, the result is noticed by playerOpened() */
+    m_videoWidget->set_mem_budget((int64_t)m_memBudget << 20);
+    int ret = m_videoWidget->open_async(m_nextUrl.toStdString().c_str());
+    if (ret < 0) {
+        playerOpened(ret);
+        return;
+    }
 
-        /* set cursor */
-        this->setCursor(Qt::ArrowCursor);
+    /* show message */
+    QFileInfo info(m_nextUrl);
+    m_videoWidget->show_msg(("Opening " + info.fileName() + "...")
+                            .toStdString().c_str(), 0);
+}
+
+void KAVPlayer::pause ()
+{
+    if (m_videoWidget->is_stopped()) { // player closed
+        openItem();
     } else { // player has opened a media file
         if (m_videoWidget->is_paused()) { // to play
             /* play */
@@ -228,6 +219,71 @@ void KAVPlayer::pause ()
     setFocus();
 }
 
+void KAVPlayer::playerOpened (int ret)
+{
+    /* cancelled by stop() */
+    if (KERROR(KEABORTED) == ret) {
+        this->setCursor(Qt::ArrowCursor);
+        return;
+    }
+
+    if (ret < 0) {
+        /* show message */
+        QFileInfo info(m_nextUrl);
+        m_videoWidget->show_msg(("Failed to open file, Error code: " + QString::number(ret))
+                                .toStdString().c_str(), 0);
+        logger.error(("Failed to open file \"" + PlaylistModel::nameOf(m_nextUrl) + "\" : " + getErrString(ret) + ".\n")
+                                .toStdString().c_str());
+
+        /* set cursor */
+        this->setCursor(Qt::ArrowCursor);
+
+        /* set focus */
+        setFocus();
+        return;
+    }
+    if (m_autoFullscreen && !m_videoWidget->isFullScreen())
+            m_videoWidget->switch_fullscreen(true);
+    
+    /* set options */
+    m_videoWidget->set_volume(m_vol * 2);
+    m_videoWidget->set_frame_drop(false); // unsolved bug
+    m_videoWidget->set_fast_seek(m_fastSeek);
+
+    /* get media info */
+
+    /* init widgets */
+    initProgress();
+    
+    /* play */
+    m_videoWidget->play();
+
+    /* change icon */
+    m_pause->setIcon(m_iconPause);
+
+    /* show message */
+    QFileInfo info(m_nextUrl);
+    m_videoWidget->show_msg(("File " + info.fileName() + " is playing")
+                            .toStdString().c_str(), 3000);
+
+    /* set cursor */
+    this->setCursor(Qt::ArrowCursor);
+
+    /* set focus */
+    setFocus();
+}
+
+void KAVPlayer::openProgress (int percent)
+{
+    if (m_nextUrl.isEmpty())
+        return;
+
+    /* show message */
+    QFileInfo info(m_nextUrl);
+    m_videoWidget->show_msg(("Opening " + info.fileName() + "... " + QString::number(percent) + "%")
+                            .toStdString().c_str(), 0);
+}
+
 void KAVPlayer::next ()
 {
     /* play next */
@@ -311,7 +367,7 @@ void KAVPlayer::seek ()
                      .toStdString().c_str() , 3000);
             int ret = m_videoWidget->seek(pos);
             if (ret) {
-                QFileInfo info(m_nextItem.url);
+                QFileInfo info(m_nextUrl);
                 m_videoWidget->show_msg(("Seeking failure, Error code: " + QString::number(ret))
                                         .toStdString().c_str(), 3000);
 
@@ -345,6 +401,15 @@ void KAVPlayer::updatePorgressPos (double pos)
     strCurPos.append(t.toString() + ".");
     strCurPos.append(QString("%1").arg(ms, 3, 10, QLatin1Char('0'))); 
     m_infoLabel->setText(strCurPos + " / " + m_strDuration);
+
+    /* prefetch the next item, it is spliced without a gap */
+    if (!m_prefetched && !m_videoWidget->is_stopped() 
+        && m_duration > 0.0 && m_duration - pos < PREFETCH_TIME) {
+        m_prefetched = true;
+        m_prefetchUrl = getNextListItem();
+        if (!m_prefetchUrl.isEmpty())
+            m_videoWidget->prefetch(m_prefetchUrl.toStdString().c_str());
+    }
 }
 
 void KAVPlayer::stopUpdateProgressPos ()
@@ -352,39 +417,103 @@ void KAVPlayer::stopUpdateProgressPos ()
     m_stopUpdateProgressPos = true;
 }
 
-void KAVPlayer::selListItem (QListWidgetItem * item)
+void KAVPlayer::progressHovered (double ratio)
 {
-    QMutableLinkedListIterator<PlaylistItem> iterator(m_playlist);
-    while (iterator.hasNext()) {
-        PlaylistItem next = iterator.next();
-        if (next.widgetItem == item) {
-           m_nextItem = next;
-           return;
-        }
-    }
-    m_nextItem.widgetItem = NULL;
+    QImage image;
+
+    if (!m_thumbs || !m_progressSlider->isEnabled() || m_duration <= 0.0)
+        return;
+
+    /* a cached thumbnail is shown at once, the others are noticed by thumbReady() */
+    m_thumbRatio = ratio;
+    if (m_thumbs->get(ratio * m_duration, &image))
+        showThumb(image);
+}
+
+void KAVPlayer::progressLeft ()
+{
+    m_thumbRatio = -1.0;
+    if (m_thumbLabel)
+        m_thumbLabel->hide();
+}
+
+void KAVPlayer::thumbReady (double pos, const QImage &image)
+{
+    /* the mouse may have moved on, the newest request follows */
+    if (m_thumbRatio < 0.0 || !m_progressSlider->isEnabled())
+        return;
+    showThumb(image);
+}
+
+void KAVPlayer::waveReady (const QString &url, const QVector<WaveBucket> &buckets)
+{
+    /* the playing item only, the others were cancelled */
+    if (url != m_nextUrl || !m_progressSlider->isEnabled())
+        return;
+    m_progressSlider->setWaveform(buckets);
+}
+
+void KAVPlayer::showThumb (const QImage &image)
+{
+    QPoint origin;
+    int    x;
+
+    if (!m_thumbLabel || image.isNull())
+        return;
+
+    /* above the hovered position, inside the progress bar */
+    m_thumbLabel->setPixmap(QPixmap::fromImage(image));
+    m_thumbLabel->resize(image.size());
+    origin = m_progressSlider->mapToGlobal(QPoint(0, 0));
+    x = (int)(m_thumbRatio * m_progressSlider->width()) - image.width() / 2;
+    x = x > m_progressSlider->width() - image.width() ? m_progressSlider->width() - image.width() : x;
+    x = x < 0 ? 0 : x;
+    m_thumbLabel->move(origin.x() + x, origin.y() - image.height() - THUMB_MARGIN);
+    m_thumbLabel->show();
+}
+
+void KAVPlayer::selListItem (const QModelIndex & index)
+{
+    m_nextUrl = m_playlistModel->urlAt(index.row());
 
     /* set focus */
     setFocus();
 }
 
-void KAVPlayer::playListItem (QListWidgetItem * item)
+void KAVPlayer::playListItem (const QModelIndex & index)
 {
-    QMutableLinkedListIterator<PlaylistItem> iterator(m_playlist);
-    while (iterator.hasNext()) {
-        PlaylistItem next = iterator.next();
-        if (next.widgetItem == item) {
-            m_nextItem = next;
+    m_nextUrl = m_playlistModel->urlAt(index.row());
+    if (m_nextUrl.isEmpty())
+        return;
 
-            /* close the media file that is playing and play new media file */
-            stop();
-            pause();
+    /* play new media file, the media file that is playing is replaced */
+    switchItem();
 
-            /* set focus */
-            setFocus();
-            return;
-        }
+    /* set focus */
+    setFocus();
+}
+
+void KAVPlayer::selectItem (const QString & url)
+{
+    QModelIndex index = m_playlistModel->index(m_playlistModel->rowOf(url));
+
+    if (!index.isValid())
+        return;
+    m_playlistView->selectionModel()->setCurrentIndex(index, QItemSelectionModel::ClearAndSelect);
+    m_playlistView->scrollTo(index);
+}
+
+void KAVPlayer::addItem (const QString & url)
+{
+    /* add new item to playlist and the playlist file, the duplicates are played only */
+    if (m_playlistModel->add(url)) {
+        m_store.add(url.toStdString());
+        m_store.flush();
+        if (m_prober)
+            m_prober->request(QStringList(url));
     }
+    m_nextUrl = url;
+    selectItem(url);
 }
 
 void KAVPlayer::openFile ()
@@ -397,40 +526,94 @@ void KAVPlayer::openFile ()
         return;
     QFileInfo lastOpenedFile(url);
     m_lastOpenedPath = lastOpenedFile.path();
-    QFileInfo info = QFileInfo(url);
-    PlaylistItem item;
-    item.url = url;
-
-    /* check for duplicates */
-    QMutableLinkedListIterator<PlaylistItem> iterator(m_playlist);
-    while (iterator.hasNext()) {
-        PlaylistItem item = iterator.next();
-        if (url == item.url)
-            goto play;
-    }
 
-    /* add net item to list widget */
-    item.widgetItem = new(std::nothrow) QListWidgetItem;
-    item.widgetItem->setText(info.fileName());
-    item.widgetItem->setToolTip(item.url);
-    item.widgetItem->setBackgroundColor(QColor(51, 51, 51));
-    item.widgetItem->setIcon(m_iconVideo);
-    m_playlistWidget->addItem(item.widgetItem);
-    m_nextItem = item;
+    /* the items of a playlist file are added, nothing is played */
+    if (PlaylistImport::is_playlist(url.toLocal8Bit().constData())) {
+        importPlaylist(url);
+        setFocus();
+        return;
+    }
 
     /* add new item to playlist */
-    m_playlist.append(item);
-    item.widgetItem->setSelected(true);
+    addItem(url);
 
-play:
-    /* close the media file that is playing and play new media file */
-    stop();
-    pause();
+    /* play new media file, the media file that is playing is replaced */
+    switchItem();
 
     /* set focus */
     setFocus();
 }
 
+void KAVPlayer::importPlaylist (const QString & path)
+{
+    if (m_import.is_open()) {
+        m_videoWidget->show_msg("Import in progress", 3000);
+        return;
+    }
+    if (m_import.open(path.toLocal8Bit().toStdString()) < 0) {
+        m_videoWidget->show_msg(("Failed to open playlist " + QFileInfo(path).fileName()).toStdString().c_str(), 3000);
+        return;
+    }
+    m_importDir = QFileInfo(path).absoluteDir();
+    m_importCount = 0;
+
+    /* read in batches from the event loop, so the window is never blocked by a large file */
+    QTimer::singleShot(0, this, SLOT(importPlaylistBatch()));
+}
+
+void KAVPlayer::importPlaylistBatch ()
+{
+    std::vector<ImportEntry> entries;
+    std::vector<size_t>      added;  // entries of urls
+    QStringList              urls;
+    QStringList              unknown; // urls without a duration, probed
+    QString                  url;
+    int                      ret;
+
+    if (!m_import.is_open())
+        return;
+
+    /* the relative paths are relative to the playlist file */
+    ret = m_import.read(entries, PLIMPORT_BATCH);
+    for (size_t i = 0; i < entries.size(); i++) {
+        url = QString::fromUtf8(entries[i].url.data, entries[i].url.size);
+        if (!url.contains("://") && QDir::isRelativePath(url))
+            url = QDir::cleanPath(m_importDir.absoluteFilePath(url));
+        if (!m_playlistModel->contains(url)) {
+            urls.append(url);
+            added.push_back(i);
+        }
+    }
+    if (!urls.isEmpty()) {
+        for (int i = 0; i < urls.size(); i++)
+            m_store.add(urls[i].toStdString());
+        m_store.flush();
+        m_importCount += m_playlistModel->add(urls);
+
+        /* the title of #EXTINF names the item, its duration is kept until the item is probed */
+        for (int i = 0; i < urls.size(); i++) {
+            const ImportEntry &e = entries[added[i]];
+            if (e.title.size)
+                m_playlistModel->setName(urls[i], QString::fromUtf8(e.title.data, e.title.size));
+            if (e.duration > 0)
+                m_playlistModel->setDuration(urls[i], (qint64)e.duration * 1000000);
+            else
+                unknown.append(urls[i]);
+        }
+        if (m_prober && !unknown.isEmpty())
+            m_prober->request(unknown);
+    }
+
+    if (ret > 0) {
+        m_videoWidget->show_msg(("Importing playlist... " + QString::number(m_import.get_progress()) + "%")
+                                .toStdString().c_str(), 3000);
+        QTimer::singleShot(0, this, SLOT(importPlaylistBatch()));
+        return;
+    }
+    m_import.close();
+    m_videoWidget->show_msg((QString::number(m_importCount) + " items imported").toStdString().c_str(), 3000);
+}
+
 void KAVPlayer::openUrl ()
 {
     /* input URL */
@@ -441,67 +624,138 @@ void KAVPlayer::openUrl ()
         return;
     QFileInfo lastOpenedFile(url);
     m_lastOpenedPath = lastOpenedFile.path();
-    QFileInfo info = QFileInfo(url);
-    PlaylistItem item;
-    item.url = url;
 
     bool match = QRegExp("([A-Za-z]{3,9}://[-A-Za-z0-9+&@#/%?=~_|!:,.;]+[-A-Za-z0-9+&@#/%=~_|])")
-                 .exactMatch(item.url);
+                 .exactMatch(url);
     if (!match) {
         m_videoWidget->show_msg("Invalid Url", 3000);
         return;
     }
 
-    /* check for duplicates */
-    QMutableLinkedListIterator<PlaylistItem> iterator(m_playlist);
-    while (iterator.hasNext()) {
-        PlaylistItem next = iterator.next();
-        if (url == next.url) {
-            m_nextItem = item;
-            goto play;
-        }
-    }
+    /* add new item to playlist */
+    addItem(url);
 
-    /* add net item to list widget */
-    item.widgetItem = new(std::nothrow) QListWidgetItem;
-    if (!item.widgetItem)
-        QApplication::exit(KENOMEM);
-    item.widgetItem->setText(match ? item.url : info.fileName());
-    item.widgetItem->setToolTip(item.url);
-    item.widgetItem->setBackgroundColor(QColor(51, 51, 51));
-    item.widgetItem->setIcon(m_iconVideo);
-    m_playlistWidget->addItem(item.widgetItem);
-    m_nextItem = item;
+    /* play new media file, the media file that is playing is replaced */
+    switchItem();
 
-    /* add new item to playlist */
-    m_playlist.append(item);
-    item.widgetItem->setSelected(true);
+    /* set focus */
+    setFocus();
+}
 
-play:
-    /* close the media file that is playing and play new media file */
-    stop();
-    pause();
+void KAVPlayer::importFolder ()
+{
+    int ret;
+
+    /* select a folder */
+    QString dir = QFileDialog::getExistingDirectory(this, "Import Folder",
+                                                    (m_lastOpenedPath.isEmpty()) ? QDir::homePath() : m_lastOpenedPath);
+    if (dir.isEmpty())
+        return;
+    m_lastOpenedPath = dir;
+
+    /* the media files are added to the playlist while they are found */
+    ret = m_scanner ? m_scanner->scan(QStringList(dir)) : KERROR(KEUNINITED);
+    if (ret < 0)
+        m_videoWidget->show_msg(KEAGAIN == -ret ? "Import in progress" : "Import failed", 3000);
+    else
+        m_videoWidget->show_msg(("Importing " + QFileInfo(dir).fileName() + "...").toStdString().c_str(), 3000);
 
     /* set focus */
     setFocus();
 }
 
+void KAVPlayer::libraryScanned (const QVector<LibraryItem> &items)
+{
+    QStringList urls;
+    QString     url;
+
+    /* a batch of the scan, the items in the playlist are skipped */
+    for (int i = 0; i < items.size(); i++) {
+        url = QString::fromStdString(items[i].url);
+        if (m_playlistModel->contains(url))
+            continue;
+        urls.append(url);
+        m_store.add(items[i].url);
+    }
+    if (!urls.isEmpty()) {
+        m_playlistModel->add(urls);
+        m_store.flush();
+        m_videoWidget->show_msg((QString::number(m_playlistModel->count()) + " items in playlist")
+                                .toStdString().c_str(), 3000);
+    }
+
+    /* the durations are probed by the scan */
+    itemsProbed(items);
+}
+
+void KAVPlayer::libraryFinished (int nb_items)
+{
+    m_videoWidget->show_msg((QString::number(nb_items) + " media files imported").toStdString().c_str(), 3000);
+}
+
+void KAVPlayer::itemsProbed (const QVector<LibraryItem> &items)
+{
+    for (int i = 0; i < items.size(); i++) {
+        if (items[i].duration > 0)
+            m_playlistModel->setDuration(QString::fromStdString(items[i].url), items[i].duration);
+    }
+}
+
+void KAVPlayer::playerSpliced ()
+{
+    /* the prefetched item is playing now */
+    m_prefetched = false;
+    if (!m_prefetchUrl.isEmpty()) {
+        m_nextUrl = m_prefetchUrl;
+        selectItem(m_nextUrl);
+    }
+    m_prefetchUrl.clear();
+
+    /* init widgets */
+    initProgress();
+
+    /* show message */
+    QFileInfo info(m_nextUrl);
+    m_videoWidget->show_msg(("File " + info.fileName() + " is playing")
+                            .toStdString().c_str(), 3000);
+}
+
+void KAVPlayer::initProgress ()
+{
+    m_duration = m_videoWidget->get_duration();
+    int h = (int)m_duration / 3600;
+    int m = (int)m_duration % 3600 / 60;
+    int s = (int)m_duration % 60;
+    int ms = (int)(m_duration * 1000.0) % 1000;
+    QTime t(h, m, s);
+    m_strDuration = t.toString() + ".";
+    m_strDuration .append(QString("%1").arg(ms,3,10,QLatin1Char('0')));
+    m_infoLabel->setText(" 00:00:00.000 / " + m_strDuration);
+    m_progressSlider->setSliderPosition(0);
+    m_progressSlider->setDisabled(false);
+
+    /* the strip of thumbnails and the waveform are computed in background */
+    if (m_thumbs)
+        m_thumbs->open(m_nextUrl.toStdString().c_str());
+    m_progressSlider->setWaveform(QVector<WaveBucket>());
+    if (m_waves)
+        m_waves->open(m_nextUrl.toStdString().c_str());
+
+    /* set window title */
+    setWindowTitle(m_nextUrl);
+}
+
 void KAVPlayer::deleteItem ()
 {
     /* delete item selected */
-    if (m_nextItem.widgetItem) {
-        QMutableLinkedListIterator<PlaylistItem> iterator(m_playlist);
-        while (iterator.hasNext()) {
-            PlaylistItem &item = iterator.next();
-            if (item.widgetItem == m_nextItem.widgetItem) {
-                iterator.remove();
-                m_playlistWidget->removeItemWidget(m_nextItem.widgetItem);
-                delete m_nextItem.widgetItem;
-                m_nextItem.widgetItem = NULL;
-                break;
-            }
-        }
+    if (m_playlistModel->contains(m_nextUrl)) {
+        if (m_prefetchUrl == m_nextUrl)
+            cancelPrefetch();
+        m_store.remove(m_nextUrl.toStdString());
+        m_store.flush();
+        m_playlistModel->remove(m_nextUrl);
     }
+    m_nextUrl.clear();
 
     /* set focus */
     setFocus();
@@ -513,9 +767,10 @@ void KAVPlayer::clearList ()
     stop();
 
     /* clear list */
-    m_playlist.clear();
-    m_playlistWidget->clear();
-    m_nextItem.widgetItem = NULL;
+    m_playlistModel->clear();
+    m_store.clear();
+    m_store.flush();
+    m_nextUrl.clear();
 
     /* set focus */
     setFocus();
@@ -523,14 +778,17 @@ void KAVPlayer::clearList ()
 
 void KAVPlayer::playNextListItem ()
 {
-    /* close the item that is playing */
-    stop();
-
-    /* select next item */
-    selNextListItem();
+    /* select next item, the prefetched one is chosen already */
+    if (!m_prefetchUrl.isEmpty())
+        m_nextUrl = m_prefetchUrl;
+    else
+        selNextListItem();
 
-    /* play new item */
-    pause();
+    /* play new item, stop if there is no next item */
+    if (!m_nextUrl.isEmpty())
+        switchItem();
+    else
+        stop();
 
     /* set focus */
     setFocus();
@@ -540,6 +798,11 @@ void KAVPlayer::nextPlayMode ()
 {
     m_playMode = ++m_playMode > PLAY_MODE_SINGLE ? PLAY_MODE_LIST_SEQUENCE : m_playMode;
 
+    /* the next item may be changed */
+    cancelPrefetch();
+    if (PLAY_MODE_RANDOM == m_playMode)
+        m_playlistModel->reshuffle();
+
     /* change icon */
     switch (m_playMode) {
     case PLAY_MODE_LIST_SEQUENCE:
@@ -631,6 +894,7 @@ void KAVPlayer::switchToExactSeekMode ()
     menu->findChild<QAction *>("2-0-0")->setIcon(m_iconYes);
     menu->findChild<QAction *>("2-0-1")->setIcon(m_iconNo);
     m_fastSeek = false;
+    m_videoWidget->set_fast_seek(m_fastSeek);
 }
 
 void KAVPlayer::switchToFastSeekMode ()
@@ -639,6 +903,7 @@ void KAVPlayer::switchToFastSeekMode ()
     menu->findChild<QAction *>("2-0-0")->setIcon(m_iconNo);
     menu->findChild<QAction *>("2-0-1")->setIcon(m_iconYes);
     m_fastSeek = true;
+    m_videoWidget->set_fast_seek(m_fastSeek);
 }
 
 void KAVPlayer::step ()
@@ -651,6 +916,34 @@ void KAVPlayer::step ()
 
 void KAVPlayer::showMediaFileInfo ()
 {
+    /* the item selected or playing */
+    if (m_nextUrl.isEmpty()) {
+        m_videoWidget->show_msg("No file selected", 3000);
+        return;
+    }
+
+    /*
+    * probed by the probe service, the result is shown by mediaInfoProbed(),
+    * the probe cache only keeps a summary, so the full report is always probed
+    */
+    if (!m_prober) {
+        m_videoWidget->show_msg("Failed to get file information", 3000);
+        return;
+    }
+    m_prober->request_info(m_nextUrl);
+    m_videoWidget->show_msg("Getting file information", 1000);
+}
+
+void KAVPlayer::mediaInfoProbed (const QString &url, int ret, const QString &text, qint64 duration)
+{
+    if (ret < 0) {
+        m_videoWidget->show_msg(("Failed to get file information, Error code: " + QString::number(ret))
+                                .toStdString().c_str(), 3000);
+        return;
+    }
+    if (duration > 0)
+        m_playlistModel->setDuration(url, duration);
+    QMessageBox::information(this, "File information", text, QMessageBox::Ok);
 }
 
 void KAVPlayer::switchHWAcce ()
@@ -728,8 +1021,8 @@ void KAVPlayer::resizeEvent (QResizeEvent * e)
     m_volumeSlider->setGeometry(m_progressPane->width() - PROGRESS_BAR_H / 4 - VOLUME_BAR_W, PROGRESS_BAR_H / 4,
                                 VOLUME_BAR_W, PROGRESS_BAR_H / 2);
 #endif
-    m_playlistWidget->setGeometry(0, 0, m_listPaneRect.w,
-                                  m_listPaneRect.h - BTN_W - DIV_LINE_W);
+    m_playlistView->setGeometry(0, 0, m_listPaneRect.w,
+                                m_listPaneRect.h - BTN_W - DIV_LINE_W);
     m_open->setGeometry(BTN1_DIV_W, m_listPaneRect.h - BTN_W * 5 / 6,
                         BTN1_W, BTN1_W);
     m_delete->setGeometry(2 * BTN1_DIV_W + BTN1_W, m_listPaneRect.h - BTN_W * 5 / 6, 
@@ -822,6 +1115,35 @@ void KAVPlayer::keyPressEvent (QKeyEvent * e)
     case Qt::Key_M:
         switchMute();
         break;
+    case Qt::Key_H:
+        m_videoWidget->switch_hud();
+        break;
+    case Qt::Key_T:
+        /* start tracing the pipeline, or stop and write the trace */
+        if (!trace_is_enabled()) {
+            trace_reset();
+            trace_enable(true);
+            m_videoWidget->show_msg("Tracing started", 3000);
+        } else {
+            trace_enable(false);
+            QString file = m_appDirPath + "/log/trace-"
+                           + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss") + ".json";
+            ret = trace_dump(file.toLocal8Bit());
+            if (ret < 0) {
+                logger.error("%s: %s.\n", getErrString(-ret), file.toLocal8Bit().data());
+                m_videoWidget->show_msg(("Failed to write the trace: " + QString(getErrString(-ret)))
+                                        .toStdString().c_str(), 3000);
+            } else {
+                m_videoWidget->show_msg(("Trace written to " + file).toStdString().c_str(), 3000);
+            }
+        }
+        break;
+    case Qt::Key_L:
+        /* write the lock profile to the log */
+        lock_report(NULL);
+        m_videoWidget->show_msg(lock_is_profiled() ? "Lock profile written to the log"
+                                                   : "Lock profiling is not built in", 3000);
+        break;
     case Qt::Key_Up:
         setVolume(m_vol + 1);
         break;
@@ -862,7 +1184,7 @@ to_seek:
                          .toStdString().c_str() , 3000);
                 int ret = m_videoWidget->seek(pos);
                 if (ret) {
-                    QFileInfo info(m_nextItem.url);
+                    QFileInfo info(m_nextUrl);
                     m_videoWidget->show_msg(("Seeking failure, Error code: " + QString::number(ret))
                                             .toStdString().c_str(), 3000);
 
@@ -889,6 +1211,11 @@ void KAVPlayer::closeEvent (QCloseEvent * e)
 {
     /* stop */
     m_videoWidget->stop();
+    if (m_scanner)
+        m_scanner->cancel();
+    if (m_prober)
+        m_prober->cancel();
+    m_import.close();
 
     /* save setting */
     saveSetting();
@@ -899,71 +1226,49 @@ void KAVPlayer::closeEvent (QCloseEvent * e)
     QMainWindow::closeEvent(e);
 }
 
-void KAVPlayer::selNextListItem ()
+QString KAVPlayer::getNextListItem ()
 {
-    QMutableLinkedListIterator<PlaylistItem> iterator(m_playlist);
-    QListWidgetItem *                        sleectedItem = NULL;
-    int                                      i;
+    int row = m_playlistModel->rowOf(m_nextUrl);
+    int len = m_playlistModel->count();
 
-    if (m_playlist.isEmpty())
-        return;
+    if (!len)
+        return QString();
 
     switch (m_playMode) {
     case PLAY_MODE_LIST_SEQUENCE:
-        while (iterator.hasNext()) {
-            PlaylistItem next = iterator.next();
-            if (next.widgetItem == m_nextItem.widgetItem) {
-                if (iterator.hasNext()) {
-                    next = iterator.next();
-                    m_nextItem = next;
-                    return;
-                }
-            }
-        }
-        m_nextItem.widgetItem = NULL;
-        sleectedItem = (m_playlistWidget->selectedItems().isEmpty() ? NULL : m_playlistWidget->selectedItems().first());
-        if (sleectedItem)
-            sleectedItem->setSelected(false);
-        break;
+        return row >= 0 && row + 1 < len ? m_playlistModel->urlAt(row + 1) : QString();
     case PLAY_MODE_LIST_CYCLE:
-        while (iterator.hasNext()) {
-            PlaylistItem next = iterator.next();
-            if (next.widgetItem == m_nextItem.widgetItem) {
-                if (iterator.hasNext()) {
-                    next = iterator.next();
-                    m_nextItem = next;
-                    return;
-                }
-                break;
-            }
-        }
-        m_nextItem = m_playlist.first();
-        break;
+        return m_playlistModel->urlAt((row + 1) % len);
     case PLAY_MODE_SIGNAL_CYCLE:
-        break;
+        return row >= 0 ? m_nextUrl : QString();
     case PLAY_MODE_RANDOM:
-        m_nextItem.widgetItem = NULL;
-        if (!m_playlist.size())
-            break;
-        srand(time(NULL));
-        i = abs(rand() % m_playlist.size());
-        while (i >= 0) {
-            PlaylistItem next = iterator.next();
-            if (!i) {
-                if (next.widgetItem == m_nextItem.widgetItem)
-                    m_nextItem = m_playlist.first();
-                else 
-                    m_nextItem = next;
-            }
-            i--;
-        }
-        break;
+        return m_playlistModel->urlAt(m_playlistModel->shuffleNext(row));
     case PLAY_MODE_SINGLE:
-        m_nextItem.widgetItem = NULL;
-        break;
+    default:
+        return QString();
     }
 }
 
+void KAVPlayer::selNextListItem ()
+{
+    if (!m_playlistModel->count())
+        return;
+
+    m_nextUrl = getNextListItem();
+
+    /* the end of the list */
+    if (m_nextUrl.isEmpty() && PLAY_MODE_LIST_SEQUENCE == m_playMode)
+        m_playlistView->clearSelection();
+}
+
+void KAVPlayer::cancelPrefetch ()
+{
+    if (m_prefetched)
+        m_videoWidget->prefetch(NULL);
+    m_prefetched = false;
+    m_prefetchUrl.clear();
+}
+
 void KAVPlayer::loadSetting ()
 { 
     int       ret;
@@ -1023,6 +1328,10 @@ void KAVPlayer::loadSetting ()
     tempInt = loader.getIntValue("PLAYER_STATUS", "HW_ACCE", ret); 
     m_hwAcce = ret < 0 ? false : !!tempInt;
 
+    /* load memory budget */
+    tempInt = loader.getIntValue("PLAYER_STATUS", "MEM_BUDGET", ret);
+    m_memBudget = ret < 0 ? 0 : max(0, tempInt);
+
     /* load window rect */
     tempInt = loader.getIntValue("WINDOW_RECT", "W", ret); 
     m_windowRect.w = max(m_showList ? MIN_WINDOW_W : MIN_WINDOW_W_NOLIST, ret < 0 ? DEF_WINDOW_W: tempInt);
@@ -1104,129 +1413,70 @@ void KAVPlayer::saveSetting()
     saver.setValue("PLAYER_STATUS", "VOLUME", std::to_string(m_vol));
     saver.setValue("PLAYER_STATUS", "FAST_SEEK", std::to_string(m_fastSeek));
     saver.setValue("PLAYER_STATUS", "HW_ACCE", m_hwAcce ? "1" : "0");
+    saver.setValue("PLAYER_STATUS", "MEM_BUDGET", std::to_string(m_memBudget));
     saver.saveas(fileName.toLocal8Bit().toStdString());
 }
 
 void KAVPlayer::loadPlaylist ()
 {
-    QMutableLinkedListIterator<PlaylistItem> iterator(m_playlist);
-    QListWidgetItem *                        widget;
-    QString                                  tempString;
-    IniFile                                  loader;
-    QFileInfo                                info;
-    QString                                  key;
-    FILE *                                   fp = NULL;
-    int                                      ret;
-    int                                      tempInt;
-    double                                   tempDouble;
-
-    /* load window playlist from playlist file */
+    QRegExp                  urlExp("([A-Za-z]{3,9}://[-A-Za-z0-9+&@#/%?=~_|!:,.;]+[-A-Za-z0-9+&@#/%=~_|])");
+    std::vector<std::string> urls;
+    QStringList              list;
+    int                      ret;
+
+    /* open playlist file */
     QString path = m_appDirPath + "/playlist/";
-    QString fileName = path + "playlist.pl";
-    ret = loader.load(fileName.toLocal8Bit().toStdString());
+    QString fileName = path + "playlist.kpl";
+    QDir dir(path);
+    if (!dir.exists(path) && !dir.mkpath(path))
+        return;
+    ret = m_store.open(fileName.toLocal8Bit().toStdString());
     if (ret < 0)
         return;
 
-    /* get setting version */
-    tempString = QString::fromStdString(loader.getStringValue("PLAYLIST_VERSION", "VER_ID", ret));
-    if (ret < 0 || tempString != VERSION)
-        loader.clear();
-
-    /* load play history */
-    m_nextItem.url = QString::fromStdString(loader.getStringValue("PLAY_HISTORY", "URL", ret));
-    m_nextItem.widgetItem = NULL;
-    if (!QRegExp("([A-Za-z]{3,9}://[-A-Za-z0-9+&@#/%?=~_|!:,.;]+[-A-Za-z0-9+&@#/%=~_|])")
-         .exactMatch(m_nextItem.url)) {
-        QFileInfo fileInfo(m_nextItem.url);
-        if (!fileInfo.exists()) 
-            m_nextItem.url.clear();
+    /* import the INI playlist of the old versions once */
+    QString iniFileName = path + "playlist.pl";
+    if (QFileInfo(iniFileName).isFile()
+        && m_store.import_ini(iniFileName.toLocal8Bit().toStdString()) >= 0) {
+        QFile::remove(iniFileName + ".bak");
+        QFile::rename(iniFileName, iniFileName + ".bak");
     }
 
+    /* load play history */
+    m_nextUrl = QString::fromStdString(m_store.get_history());
 
-    /* load playlist */
-    tempInt = loader.getIntValue("PLAY_LIST", "LIST_LEN", ret);
-    for (int i = 0; i < tempInt; i++) {
-        /* read a playlist item */
-        PlaylistItem item;
-        key = "URL" + QString::number(i);
-        item.url = QString::fromStdString(loader.getStringValue("PLAY_LIST", key.toStdString(), ret));
-        if (item.url.isEmpty() || ret < 0)
-            break;
+    /* load playlist, the store has no duplicates */
+    m_store.get_urls(urls);
+    list.reserve((int)urls.size());
+    for (size_t i = 0; i < urls.size(); i++) {
+        QString url = QString::fromStdString(urls[i]);
 
         /* if the file does not exist and is not a URL, throw it */
-        bool match = QRegExp("([A-Za-z]{3,9}://[-A-Za-z0-9+&@#/%?=~_|!:,.;]+[-A-Za-z0-9+&@#/%=~_|])")
-                     .exactMatch(item.url);
-        if (!match) {
-            QFileInfo fileInfo(item.url);
-            if (!fileInfo.exists()) 
-                goto throw_item;
+        if (!urlExp.exactMatch(url) && !QFileInfo::exists(url)) {
+            m_store.remove(urls[i]);
+            continue;
         }
-
-        /* check for duplicates */
-        iterator = m_playlist;
-        while (iterator.hasNext()) {
-            PlaylistItem next = iterator.next();
-            if (next.url == item.url)
-                goto throw_item;
-        }
-
-        /* add a playlist item to list widget */
-        widget = new(std::nothrow) QListWidgetItem();
-        if (!widget)
-            QApplication::exit(KENOMEM);
-        info = item.url;
-        widget->setText(match ? item.url : info.fileName());
-        widget->setToolTip(item.url);
-        widget->setBackgroundColor(QColor(51, 51, 51));
-        widget->setIcon(m_iconVideo);
-        item.widgetItem = widget;
-        m_playlistWidget->addItem(widget);
-        if (item.url == m_nextItem.url) {
-            m_nextItem.widgetItem = widget;
-            widget->setSelected(true);
-        }
-
-        /* add new item to playlist */
-        m_playlist.append(item);
-throw_item:
-        continue;
+        list.append(url);
     }
+    m_store.flush();
+
+    /* the view is filled at once */
+    m_playlistModel->add(list);
+    if (m_playlistModel->contains(m_nextUrl))
+        selectItem(m_nextUrl);
+    else
+        m_nextUrl.clear();
 }
 
 void KAVPlayer::savePlaylist()
 { 
-    /* make playlist directory and playlist file */
-    QString path = m_appDirPath + "/playlist/";
-    QString fileName = path + "playlist.pl";
-    QFileInfo file(fileName);
-    QDir dir(path);
-    if (!dir.exists(path) && !dir.mkpath(path))
-        return;
-    if (!file.isFile()) {
-        FILE *fp = fopen(fileName.toLocal8Bit(), "w+");
-        if (!fp)
-            return;
-        fclose(fp);
-        fp = NULL;
-    }
-
-    /* save playlist and play history */
+    /* the items are written as they change, save play history and close the file */
     if (m_autoCleanList) {
-        m_playlist.clear();
-        m_playlistWidget->clear();
+        m_playlistModel->clear();
+        m_store.clear();
     }
-    IniFile saver;
-    saver.setValue("PLAYLIST_VERSION", "VER_ID", VERSION);
-    if (m_nextItem.widgetItem)
-        saver.setValue("PLAY_HISTORY", "URL", m_nextItem.url.toStdString());
-    int len = m_playlist.size();
-    saver.setValue("PLAY_LIST", "LIST_LEN", std::to_string(len));
-    QMutableLinkedListIterator<PlaylistItem> iterator(m_playlist);
-    for (int i = 0; i < len; i++) {
-        PlaylistItem item = iterator.next();
-        saver.setValue("PLAY_LIST", "URL" + std::to_string(i), item.url.toStdString());
-    }
-    saver.saveas(fileName.toLocal8Bit().toStdString());
+    m_store.set_history(m_playlistModel->contains(m_nextUrl) ? m_nextUrl.toStdString() : "");
+    m_store.close();
 }
 
 void KAVPlayer::loadIcons ()
@@ -1286,17 +1536,25 @@ int KAVPlayer::initWindow ()
     QObject::connect(m_splitter, SIGNAL(splitterMoved(int, int)), this, SLOT(changeListWidth(int)));
 
     /* init playlist widget */
-    m_playlistWidget = new(std::nothrow) QListWidget(m_listPane);
-    if (!m_playlistWidget)
+    m_playlistModel = new(std::nothrow) PlaylistModel(this);
+    if (!m_playlistModel)
         QApplication::exit(KENOMEM);
-    m_playlistWidget->setStyleSheet("QListWidget{background-color:rgb(40, 40, 40);color:white;border:0px;font-size:14px}"
-                                    "QListWidget::item:selected{background:gray}");
-    m_playlistWidget->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-    m_playlistWidget->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-    QObject::connect(m_playlistWidget, SIGNAL(itemDoubleClicked(QListWidgetItem *)), 
-                     this, SLOT(playListItem(QListWidgetItem *)));
-    QObject::connect(m_playlistWidget, SIGNAL(itemClicked(QListWidgetItem *)), 
-                     this, SLOT(selListItem(QListWidgetItem *)));
+    m_playlistModel->setIcon(m_iconVideo);
+    m_playlistView = new(std::nothrow) QListView(m_listPane);
+    if (!m_playlistView)
+        QApplication::exit(KENOMEM);
+    m_playlistView->setModel(m_playlistModel);
+    m_playlistView->setUniformItemSizes(true); // rows are laid out without asking each of them
+    m_playlistView->setSelectionMode(QAbstractItemView::SingleSelection);
+    m_playlistView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_playlistView->setStyleSheet("QListView{background-color:rgb(40, 40, 40);color:white;border:0px;font-size:14px}"
+                                  "QListView::item:selected{background:gray}");
+    m_playlistView->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    m_playlistView->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    QObject::connect(m_playlistView, SIGNAL(doubleClicked(const QModelIndex &)), 
+                     this, SLOT(playListItem(const QModelIndex &)));
+    QObject::connect(m_playlistView, SIGNAL(clicked(const QModelIndex &)), 
+                     this, SLOT(selListItem(const QModelIndex &)));
 
     /* init file open button */
     m_open = new(std::nothrow) QPushButton(m_listPane);
@@ -1309,6 +1567,8 @@ int KAVPlayer::initWindow ()
     m_openMenu->addAction(m_iconFile, "Open File", this, SLOT(openFile()));
     m_openMenu->addSeparator();
     m_openMenu->addAction(m_iconUrl, "Open URL", this, SLOT(openUrl()));
+    m_openMenu->addSeparator();
+    m_openMenu->addAction(m_iconFile, "Import Folder", this, SLOT(importFolder()));
     m_open->setMenu(m_openMenu);
 
     /* init item delete button */
@@ -1471,8 +1731,17 @@ int KAVPlayer::initWindow ()
 //    QObject::connect(m_progressSlider, SIGNAL(sliderPressed()), this, SLOT(stopUpdateProgressPos()));
 //    QObject::connect(m_progressSlider, SIGNAL(sliderReleased()), this, SLOT(seek()));
     QObject::connect(m_progressSlider, SIGNAL(clicked()), this, SLOT(seek()));
+    QObject::connect(m_progressSlider, SIGNAL(hovered(double)), this, SLOT(progressHovered(double)));
+    QObject::connect(m_progressSlider, SIGNAL(hoverLeft()), this, SLOT(progressLeft()));
     m_progressSlider->setDisabled(true);
 
+    /* thumbnail popup, a tool window over the video, which is a native window */
+    m_thumbLabel = new(std::nothrow) QLabel(this, Qt::ToolTip | Qt::FramelessWindowHint);
+    if (!m_thumbLabel)
+        QApplication::exit(KENOMEM);
+    m_thumbLabel->setStyleSheet("border:1px solid rgb(128, 128, 128)");
+    m_thumbLabel->hide();
+
     /* init mute button */
     m_mute = new(std::nothrow) QPushButton(m_progressPane);
     if (!m_mute)
@@ -1494,6 +1763,9 @@ int KAVPlayer::initWindow ()
         QApplication::exit(KENOMEM);
     m_videoWidget->setGeometry(m_videoRect.toQRect());
     QObject::connect(m_videoWidget, SIGNAL(player_stopped(int)), this, SLOT(errProc(int)));
+    QObject::connect(m_videoWidget, SIGNAL(player_opened(int)), this, SLOT(playerOpened(int)), Qt::QueuedConnection);
+    QObject::connect(m_videoWidget, SIGNAL(player_spliced()), this, SLOT(playerSpliced()), Qt::QueuedConnection);
+    QObject::connect(m_videoWidget, SIGNAL(open_progress(int)), this, SLOT(openProgress(int)), Qt::QueuedConnection);
     QObject::connect(m_videoWidget, SIGNAL(pos_changed(double)), this, SLOT(updatePorgressPos(double)), Qt::QueuedConnection); 
 // progress slider and info label can't update, why?
 //////////////////////////////////////
@@ -1552,6 +1824,74 @@ int KAVPlayer::run ()
 
     /* load playlist */
     loadPlaylist();
+
+    /* the probe results are kept in memory if the cache file can not be opened */
+    ret = m_probeCache.load((m_appDirPath + "/playlist/library.cache").toLocal8Bit().toStdString());
+    if (ret < 0)
+        logger.warning("Probe cache is not saved: %s.\n", getErrString(-ret));
+
+    /* init media library scanner, the folders can not be imported without it */
+    m_scanner = new(std::nothrow) LibraryScanner(this);
+    if (m_scanner) {
+        connect(m_scanner, SIGNAL(scanned(const QVector<LibraryItem> &)),
+                this, SLOT(libraryScanned(const QVector<LibraryItem> &)), Qt::QueuedConnection);
+        connect(m_scanner, SIGNAL(finished(int)), this, SLOT(libraryFinished(int)), Qt::QueuedConnection);
+        ret = m_scanner->init(&m_probeCache, 0);
+        if (ret < 0) {
+            logger.error("%s.\n", getErrString(-ret));
+            delete m_scanner;
+            m_scanner = NULL;
+        }
+    }
+
+    /* init probe service, the durations of the playlist are shown as they are probed */
+    m_prober = new(std::nothrow) ProbeService(this);
+    if (m_prober) {
+        connect(m_prober, SIGNAL(probed(const QVector<LibraryItem> &)),
+                this, SLOT(itemsProbed(const QVector<LibraryItem> &)), Qt::QueuedConnection);
+        connect(m_prober, SIGNAL(info_probed(const QString &, int, const QString &, qint64)),
+                this, SLOT(mediaInfoProbed(const QString &, int, const QString &, qint64)), Qt::QueuedConnection);
+        ret = m_prober->init(&m_probeCache, 0);
+        if (ret < 0) {
+            logger.error("%s.\n", getErrString(-ret));
+            delete m_prober;
+            m_prober = NULL;
+        } else {
+            QStringList urls;
+            for (int i = 0; i < m_playlistModel->count(); i++)
+                urls.append(m_playlistModel->urlAt(i));
+            m_prober->request(urls);
+        }
+    }
+
+    /* init thumbnail engine, the progress bar works without it */
+    m_thumbs = new(std::nothrow) ThumbEngine(this);
+    if (m_thumbs) {
+        connect(m_thumbs, SIGNAL(thumb_ready(double, const QImage &)),
+                this, SLOT(thumbReady(double, const QImage &)), Qt::QueuedConnection);
+        ret = m_thumbs->init();
+        if (ret < 0) {
+            logger.error("%s.\n", getErrString(-ret));
+            delete m_thumbs;
+            m_thumbs = NULL;
+        }
+    }
+
+    /* init waveform service, the waveforms are cached beside the probe cache */
+    m_waves = new(std::nothrow) WaveService(this);
+    if (m_waves) {
+        connect(m_waves, SIGNAL(wave_ready(const QString &, const QVector<WaveBucket> &)),
+                this, SLOT(waveReady(const QString &, const QVector<WaveBucket> &)), Qt::QueuedConnection);
+        path = m_appDirPath + "/playlist/wave/";
+        if (!dir.exists(path) && !dir.mkpath(path))
+            path.clear();
+        ret = m_waves->init(path.toLocal8Bit().toStdString().c_str());
+        if (ret < 0) {
+            logger.error("%s.\n", getErrString(-ret));
+            delete m_waves;
+            m_waves = NULL;
+        }
+    }
     
     /* show window */
     show();
@@ -1581,6 +1921,7 @@ KAVPlayer::KAVPlayer ()
     m_duration = 0.0;
     m_currentPos = 0.0;
     m_stopUpdateProgressPos = false;
+    m_prefetched = false;
     m_playerWidget = NULL;
     m_playerPane = NULL;
     m_listPane = NULL;
@@ -1597,10 +1938,18 @@ KAVPlayer::KAVPlayer ()
     m_msgLabel = NULL;
     m_progressSlider = NULL;
     m_volumeSlider = NULL;
-    m_playlistWidget = NULL;
+    m_playlistView = NULL;
+    m_playlistModel = NULL;
     m_delete = NULL;
     m_open = NULL;
     m_openMenu = NULL;
+    m_scanner = NULL;
+    m_prober = NULL;
+    m_importCount = 0;
+    m_thumbs = NULL;
+    m_thumbRatio = -1.0;
+    m_waves = NULL;
+    m_thumbLabel = NULL;
     m_playModeSwitch = NULL;
     m_clear = NULL;
     m_setting = NULL;
@@ -1608,18 +1957,12 @@ KAVPlayer::KAVPlayer ()
 
 KAVPlayer::~KAVPlayer ()
 {
-    /* free playlist */
-    QMutableLinkedListIterator<PlaylistItem> iterator(m_playlist);
-    while (iterator.hasNext()) {
-        PlaylistItem &item = iterator.next();
-        delete item.widgetItem;
-        item.widgetItem = NULL;
-    }
-    m_playlist.clear();
-    if (m_playlistWidget)
-        m_playlistWidget->clear();
-
     /* free members */
+    delete m_waves;
+    delete m_thumbs;
+    delete m_thumbLabel;
+    delete m_prober;
+    delete m_scanner;
     delete m_videoWidget;
     delete m_stop;
     delete m_priv;
@@ -1631,7 +1974,8 @@ KAVPlayer::~KAVPlayer ()
     delete m_msgLabel;
     delete m_progressSlider;
     delete m_volumeSlider;
-    delete m_playlistWidget;
+    delete m_playlistView;
+    delete m_playlistModel;
     delete m_delete;
     delete m_open;
     delete m_openMenu;
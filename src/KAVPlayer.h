@@ -12,13 +12,18 @@
 #include <QTextEdit>
 #include <QTimer>
 #include <QSlider>
-#include <QLinkedList>
-#include <QListWidgetItem>
-#include <QListWidget>
+#include <QListView>
+#include <QDir>
 #include <iterator>
 #include <QWidget>
 #include "ClickSlider.h"
 #include "AVPlayerWidget.h"
+#include "PlaylistModel.h"
+#include "plstore/plstore.h"
+#include "library/library.h"
+#include "plimport/plimport.h"
+#include "thumb/thumb.h"
+#include "wave/wave.h"
 
 /* application version */
 #define VERSION                 "1.0"
@@ -43,6 +48,12 @@
 /* max volume */
 #define MAX_VOL                 64
 
+/* gap between the thumbnail and the progress bar */
+#define THUMB_MARGIN            4
+
+/* prefetch the next item before the end of the playing one (unit: second) */
+#define PREFETCH_TIME           10.0
+
 /* button style sheet */
 ;
 #define BTN_STYLE_SHEET  "QPushButton{background-color:rgb(40, 40, 40);border:0px}"\
@@ -76,11 +87,6 @@ enum FileType {
     FILE_TYPE_PICTURE = 2
 };
 
-struct PlaylistItem {
-    QString          url;
-    QListWidgetItem *widgetItem;
-};
-
 class KAVPlayer : public QMainWindow {
     Q_OBJECT
 
@@ -91,7 +97,9 @@ private:
     QString                   m_lastOpenedPath;
     bool                      m_stopUpdateProgressPos;
     QString                   m_strDuration;
-    PlaylistItem              m_nextItem;
+    QString                   m_nextUrl;      // the item selected or playing, empty if none
+    QString                   m_prefetchUrl;
+    bool                      m_prefetched;
     QTimer                    m_msgLabelTimer;
 
 private:
@@ -113,7 +121,8 @@ private:
     QLabel *                  m_msgLabel;
     ClickSlider *             m_progressSlider;
     ClickSlider *             m_volumeSlider;
-    QListWidget *             m_playlistWidget;
+    QLabel *                  m_thumbLabel; // thumbnail of the position hovered on the progress bar
+    QListView *               m_playlistView;
     QPushButton *             m_delete;
     QPushButton *             m_open;
     QMenu *                   m_openMenu;
@@ -140,6 +149,7 @@ private:
     bool                      m_fastSeek;
     bool                      m_autoCleanList;
     bool                      m_hwAcce;
+    int                       m_memBudget; // memory budget of the player, 0 for the default (unit: MB)
     int                       m_audioDevice;
     bool                      m_autoFullscreen;
     bool                      m_savePos;
@@ -167,13 +177,29 @@ private:
 
 private:
     /* playlist*/
-    QLinkedList<PlaylistItem> m_playlist;
+    PlaylistModel *           m_playlistModel;
+    PlaylistStore             m_store;    // the playlist file, changed with m_playlistModel
+    LibraryCache              m_probeCache; // probe results of m_scanner and m_prober
+    LibraryScanner *          m_scanner;  // imports the folders in background
+    ProbeService *            m_prober;   // durations of the items
+    PlaylistImport            m_import;   // the M3U or PLS file being imported
+    QDir                      m_importDir;
+    int                       m_importCount;
+
+private:
+    /* thumbnails */
+    ThumbEngine *             m_thumbs;
+    double                    m_thumbRatio; // hovered on the progress bar, -1 if not hovered
+    WaveService *             m_waves;      // waveform overview of the progress bar
 
 private slots:
     void errProc               (int err_code);
     void stop                  ();
     void priv                  ();
     void pause                 ();
+    void playerOpened          (int ret);
+    void playerSpliced         ();
+    void openProgress          (int percent);
     void next                  ();
     void switchList            ();
     void setVolume             (int value);
@@ -181,10 +207,20 @@ private slots:
     void seek                  ();
     void updatePorgressPos     (double pos);
     void stopUpdateProgressPos ();
-    void selListItem           (QListWidgetItem *item);
-    void playListItem          (QListWidgetItem *item);
+    void progressHovered       (double ratio);
+    void progressLeft          ();
+    void thumbReady            (double pos, const QImage &image);
+    void waveReady             (const QString &url, const QVector<WaveBucket> &buckets);
+    void selListItem           (const QModelIndex &index);
+    void playListItem          (const QModelIndex &index);
     void openFile              ();
     void openUrl               ();
+    void importFolder          ();
+    void libraryScanned        (const QVector<LibraryItem> &items);
+    void libraryFinished       (int nb_items);
+    void itemsProbed           (const QVector<LibraryItem> &items);
+    void mediaInfoProbed       (const QString &url, int ret, const QString &text, qint64 duration);
+    void importPlaylistBatch   ();
     void deleteItem            ();
     void clearList             ();
     void playNextListItem      ();
@@ -211,7 +247,17 @@ private:
     void closeEvent            (QCloseEvent *e);
 
 private:
+    QString getNextListItem    ();
     void selNextListItem       ();
+    void selectItem            (const QString &url);
+    void addItem               (const QString &url);
+    void importPlaylist        (const QString &path);
+    void cancelPrefetch        ();
+    void showThumb             (const QImage &image);
+    void resetWidgets          ();
+    void initProgress          ();
+    void switchItem            ();
+    void openItem              ();
     void loadSetting           ();
     void saveSetting           ();
     void loadPlaylist          ();
@@ -0,0 +1,230 @@
+#include <QColor>
+#include <QFileInfo>
+#include <QRegExp>
+#include <ctime>
+#include "PlaylistModel.h"
+
+int PlaylistModel::rowCount (const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_entries.size();
+}
+
+QVariant PlaylistModel::data (const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_entries.size())
+        return QVariant();
+
+    /* only the rows in the view are asked for */
+    const PlaylistEntry &entry = m_entries[index.row()];
+    switch (role) {
+    case Qt::DisplayRole:
+        if (entry.duration < 0)
+            return entry.name;
+        return entry.name + "  [" + durationText(entry.duration) + "]";
+    case DurationRole:
+        return entry.duration;
+    case Qt::ToolTipRole:
+    case UrlRole:
+        return entry.url;
+    case Qt::DecorationRole:
+        return m_icon;
+    case Qt::BackgroundRole:
+        return QColor(51, 51, 51);
+    default:
+        return QVariant();
+    }
+}
+
+bool PlaylistModel::add (const QString &url)
+{
+    int row = m_entries.size();
+
+    if (m_index.contains(url))
+        return false;
+
+    beginInsertRows(QModelIndex(), row, row);
+    m_entries.append(PlaylistEntry{url, nameOf(url), -1});
+    m_index.insert(url, row);
+    shuffleIn(row);
+    endInsertRows();
+
+    return true;
+}
+
+int PlaylistModel::add (const QStringList &urls)
+{
+    QStringList added;
+    int         first = m_entries.size();
+
+    /* the view is told once */
+    for (int i = 0; i < urls.size(); i++) {
+        if (m_index.contains(urls[i]))
+            continue;
+        m_index.insert(urls[i], first + added.size());
+        added.append(urls[i]);
+    }
+    if (added.isEmpty())
+        return 0;
+
+    beginInsertRows(QModelIndex(), first, first + added.size() - 1);
+    m_entries.reserve(first + added.size());
+    for (int i = 0; i < added.size(); i++) {
+        m_entries.append(PlaylistEntry{added[i], nameOf(added[i]), -1});
+        shuffleIn(first + i);
+    }
+    endInsertRows();
+
+    return added.size();
+}
+
+bool PlaylistModel::remove (const QString &url)
+{
+    int row = rowOf(url);
+    int pos;
+
+    if (row < 0)
+        return false;
+
+    beginRemoveRows(QModelIndex(), row, row);
+    m_entries.remove(row);
+    m_index.remove(url);
+    for (int i = row; i < m_entries.size(); i++)
+        m_index[m_entries[i].url] = i;
+
+    /* drop the row from the permutation, the rows after it move up */
+    pos = m_shufflePos[row];
+    m_shuffle.remove(pos);
+    m_shufflePos.remove(row);
+    for (int i = 0; i < m_shuffle.size(); i++) {
+        if (m_shuffle[i] > row)
+            m_shuffle[i]--;
+        m_shufflePos[m_shuffle[i]] = i;
+    }
+    endRemoveRows();
+
+    return true;
+}
+
+void PlaylistModel::clear ()
+{
+    beginResetModel();
+    m_entries.clear();
+    m_index.clear();
+    m_shuffle.clear();
+    m_shufflePos.clear();
+    endResetModel();
+}
+
+int PlaylistModel::rowOf (const QString &url) const
+{
+    return m_index.value(url, -1);
+}
+
+bool PlaylistModel::contains (const QString &url) const
+{
+    return m_index.contains(url);
+}
+
+QString PlaylistModel::urlAt (int row) const
+{
+    return row >= 0 && row < m_entries.size() ? m_entries[row].url : QString();
+}
+
+int PlaylistModel::count () const
+{
+    return m_entries.size();
+}
+
+int PlaylistModel::shuffleNext (int row) const
+{
+    if (m_shuffle.isEmpty())
+        return -1;
+    if (row < 0 || row >= m_shuffle.size())
+        return m_shuffle.first();
+
+    return m_shuffle[(m_shufflePos[row] + 1) % m_shuffle.size()];
+}
+
+int PlaylistModel::shufflePrev (int row) const
+{
+    if (m_shuffle.isEmpty())
+        return -1;
+    if (row < 0 || row >= m_shuffle.size())
+        return m_shuffle.last();
+
+    return m_shuffle[(m_shufflePos[row] + m_shuffle.size() - 1) % m_shuffle.size()];
+}
+
+void PlaylistModel::reshuffle ()
+{
+    /* Fisher-Yates */
+    for (int i = m_shuffle.size() - 1; i > 0; i--) {
+        int j = std::uniform_int_distribution<int>(0, i)(m_rand);
+        qSwap(m_shuffle[i], m_shuffle[j]);
+        m_shufflePos[m_shuffle[i]] = i;
+        m_shufflePos[m_shuffle[j]] = j;
+    }
+}
+
+void PlaylistModel::shuffleIn (int row)
+{
+    /* inside-out Fisher-Yates, the new row takes a random position */
+    int j = std::uniform_int_distribution<int>(0, m_shuffle.size())(m_rand);
+
+    m_shufflePos.append(0);
+    if (j == m_shuffle.size()) {
+        m_shuffle.append(row);
+    } else {
+        m_shuffle.append(m_shuffle[j]);
+        m_shufflePos[m_shuffle[j]] = m_shuffle.size() - 1;
+        m_shuffle[j] = row;
+    }
+    m_shufflePos[row] = j;
+}
+
+void PlaylistModel::setIcon (const QIcon &icon)
+{
+    m_icon = icon;
+}
+
+void PlaylistModel::setDuration (const QString &url, qint64 duration)
+{
+    int row = rowOf(url);
+
+    if (row < 0 || m_entries[row].duration == duration)
+        return;
+    m_entries[row].duration = duration;
+    emit dataChanged(index(row), index(row), QVector<int>() << Qt::DisplayRole << DurationRole);
+}
+
+void PlaylistModel::setName (const QString &url, const QString &name)
+{
+    int row = rowOf(url);
+
+    if (row < 0 || name.isEmpty() || m_entries[row].name == name)
+        return;
+    m_entries[row].name = name;
+    emit dataChanged(index(row), index(row), QVector<int>() << Qt::DisplayRole);
+}
+
+QString PlaylistModel::durationText (qint64 duration)
+{
+    int s = (int)(duration / 1000000);
+
+    if (s >= 3600)
+        return QString("%1:%2:%3").arg(s / 3600).arg(s / 60 % 60, 2, 10, QChar('0')).arg(s % 60, 2, 10, QChar('0'));
+
+    return QString("%1:%2").arg(s / 60, 2, 10, QChar('0')).arg(s % 60, 2, 10, QChar('0'));
+}
+
+QString PlaylistModel::nameOf (const QString &url)
+{
+    static const QRegExp urlExp("([A-Za-z]{3,9}://[-A-Za-z0-9+&@#/%?=~_|!:,.;]+[-A-Za-z0-9+&@#/%=~_|])");
+
+    return urlExp.exactMatch(url) ? url : QFileInfo(url).fileName();
+}
+
+PlaylistModel::PlaylistModel (QObject *parent)
+    : QAbstractListModel (parent), m_rand((unsigned)time(NULL))
+{
+}
@@ -0,0 +1,77 @@
+#ifndef _PLAYLISTMODEL_H_
+#define _PLAYLISTMODEL_H_
+
+#include <QAbstractListModel>
+#include <QVector>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QIcon>
+#include <random>
+
+/*
+* items of the playlist, kept in a vector in the order of the list,
+* a url is found by a hash to its row,
+* the shuffled order is a permutation of the rows, so the next and the previous are O(1)
+*/
+
+/* playlist item */
+struct PlaylistEntry {
+    QString url;
+    QString name;    // shown in the list, the file name, or the url of a network stream
+    qint64  duration; // shown after the name, -1 if not probed yet (unit: microsecond)
+};
+
+class PlaylistModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum {
+        UrlRole = Qt::UserRole,
+        DurationRole
+    };
+
+private:
+    QVector<PlaylistEntry> m_entries;
+    QHash<QString, int>    m_index;      // url to row
+    QVector<int>           m_shuffle;    // rows in the shuffled order
+    QVector<int>           m_shufflePos; // row to its position in m_shuffle
+    QIcon                  m_icon;
+    std::mt19937           m_rand;
+
+public:
+    int      rowCount    (const QModelIndex &parent = QModelIndex()) const;
+    QVariant data        (const QModelIndex &index, int role = Qt::DisplayRole) const;
+
+public:
+    bool     add         (const QString &url);      // false if the url is in the list
+    int      add         (const QStringList &urls); // inserted at once, returns the number of new items
+    bool     remove      (const QString &url);
+    void     clear       ();
+
+    int      rowOf       (const QString &url) const; // -1 if not in the list
+    bool     contains    (const QString &url) const;
+    QString  urlAt       (int row) const;
+    int      count       () const;
+
+    /* the rows around row in the shuffled order, -1 if the list is empty */
+    int      shuffleNext (int row) const;
+    int      shufflePrev (int row) const;
+    void     reshuffle   ();
+
+    void     setIcon     (const QIcon &icon);
+    void     setDuration (const QString &url, qint64 duration);
+    void     setName     (const QString &url, const QString &name); // the title of an imported playlist
+
+    static QString nameOf       (const QString &url);
+    static QString durationText (qint64 duration); // h:mm:ss, or mm:ss under an hour
+
+private:
+    void     shuffleIn   (int row);
+
+public:
+    explicit PlaylistModel (QObject *parent = nullptr);
+};
+
+#endif /* _PLAYLISTMODEL_H_ */
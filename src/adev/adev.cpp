@@ -2,6 +2,7 @@
 #include "adev.h"
 #include "error/error.h"
 #include "log/log.h"
+#include "mem/mem.h"
 
 extern "C" {
 #include "libavformat/avformat.h"
@@ -22,7 +23,7 @@ void SDLCALL Adev::sdl_audio_callback (void * userdata, Uint8 * stream, int len)
             ret = (p->audio_fill_proc)(p->data, &p->sample_buf);
             if (ret < 0) {
                 p->abort_req = true;
-                if (KERROR(KEABORTED) != ret && KERROR(KEEOF) != ret)
+                if (KERROR(KEABORTED) != ret && KERROR(KEEOF) != ret && KERROR(KEPLAY_OVER) != ret)
                     emit p->err_occured(KERROR(KEAUDIO_FILL_FAIL));
                 return;
             }
@@ -47,6 +48,7 @@ Adev::Adev (AudioFillProc audio_fill_proc, void *data)
 {
     this->audio_fill_proc = audio_fill_proc;
     this->data = data;
+    adev_id = 0;
     volume = SDL_MIX_MAXVOLUME;
     paused = true;
     muted = !volume ? true : false;
@@ -54,6 +56,8 @@ Adev::Adev (AudioFillProc audio_fill_proc, void *data)
     cur_af_pts = 0.0;
     sample_buf.buf = sample_buf.pos = NULL;
     sample_buf.size = 0;
+    buf_size = 0;
+    mem = NULL;
     err_code = 0;
 }
 
@@ -61,7 +65,7 @@ Adev::~Adev ()
 {
 }
 
-int Adev::init (AudioParams wanted_params, AudioParams *tgt_params)
+int Adev::init (AudioParams wanted_params, AudioParams *tgt_params, MemStats *mem)
 {
     SDL_AudioSpec wanted_spec;
     int           next_sample_rate_idx = FF_ARRAY_ELEMS(next_sample_rates) - 1;
@@ -122,11 +126,14 @@ int Adev::init (AudioParams wanted_params, AudioParams *tgt_params)
     sample_buf.buf = (uint8_t *)av_mallocz((size_t)sample_buf_size);
     if (!sample_buf.buf)
         return KERROR(KENOMEM);
+    this->mem = mem;
+    buf_size = sample_buf_size;
+    mem_add(mem, MEM_SAMPLES, 1, buf_size);
 
     /* pause */
     SDL_PauseAudioDevice(adev_id, 1);
 
-    logger.debug("Audio device has been inited.\n");
+    KLOGD("Audio device has been inited.\n");
 
     return 0;
 }
@@ -140,7 +147,7 @@ void Adev::pause ()
     SDL_PauseAudioDevice(adev_id, 1);
     paused = true;
 
-    logger.debug("Audio device paused.\n");
+    KLOGD("Audio device paused.\n");
 }
 
 void Adev::play ()
@@ -152,7 +159,7 @@ void Adev::play ()
     SDL_PauseAudioDevice(adev_id, 0);
     paused = false;
 
-    logger.debug("Audio device started.\n");
+    KLOGD("Audio device started.\n");
 }
 
 void Adev::close ()
@@ -162,9 +169,15 @@ void Adev::close ()
 
     abort_req = true;
     SDL_CloseAudioDevice(adev_id);
+    adev_id = 0;
+    if (sample_buf.buf)
+        mem_add(mem, MEM_SAMPLES, -1, -buf_size);
     av_freep(&sample_buf.buf);
+    buf_size = 0;
+    sample_buf.pos = NULL;
+    sample_buf.size = 0;
     
-    logger.debug("Audio device closed.\n");
+    KLOGD("Audio device closed.\n");
 }
 
 void Adev::flush ()
@@ -172,7 +185,13 @@ void Adev::flush ()
     if (paused && adev_id)
         SDL_ClearQueuedAudio(adev_id);
 
-    logger.debug("Audio device flushed.\n");
+    /* drop the samples left from the old position */
+    if (paused) {
+        sample_buf.pos = NULL;
+        sample_buf.size = 0;
+    }
+
+    KLOGD("Audio device flushed.\n");
 }
 
 void Adev::set_volume (int vol)
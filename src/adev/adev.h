@@ -26,6 +26,8 @@ typedef struct SampleBuf {
 
 typedef int (*AudioFillProc) (void *, SampleBuf *);
 
+struct MemStats;
+
 class Adev : public QObject {
     Q_OBJECT
 
@@ -38,6 +40,8 @@ private:
 
     /* audio buffer */
     SampleBuf     sample_buf;
+    int           buf_size;
+    MemStats *    mem;            // counts the audio buffer
 
     /* fill proc */
     AudioFillProc audio_fill_proc; // audio fill process function 
@@ -68,7 +72,7 @@ private:
     static void SDLCALL sdl_audio_callback (void *userdata, Uint8 * stream, int len);
 
 public:
-    int                 init               (AudioParams wanted_params, AudioParams *tgt_params);
+    int                 init               (AudioParams wanted_params, AudioParams *tgt_params, MemStats *mem);
     void                pause              ();
     void                play               ();
     void                close              ();
@@ -0,0 +1,151 @@
+#include <cstring>
+#include <ctime>
+#include "bench.h"
+#include "error/error.h"
+#include "utils/utils.h"
+
+extern "C"
+{
+#include "libavutil/time.h"
+}
+
+#define FILENAME "bench.cpp"
+
+static void print_json_string (FILE *fp, const char *str)
+{
+    fputc('"', fp);
+    for (; *str; str++) {
+        if ('"' == *str || '\\' == *str)
+            fputc('\\', fp);
+        fputc(*str, fp);
+    }
+    fputc('"', fp);
+}
+
+void Bench::set_min_time (double min_time)
+{
+    this->min_time = min_time > 0.0 ? min_time : BENCH_DEF_MIN_TIME;
+}
+
+void Bench::set_filter (const char *filter)
+{
+    this->filter = filter;
+}
+
+bool Bench::is_selected (const char *name) const
+{
+    return !filter || strstr(name, filter);
+}
+
+int Bench::run (const char *name, BenchProc proc, void *args)
+{
+    BenchResult   r;
+    BenchCounters counters;
+    int64_t       iters = 1;
+    int64_t       start;
+    double        cpu_start;
+    double        elapsed;
+    double        cpu;
+    int           ret;
+
+    if (!name || !proc)
+        return KERROR(KEINVAL);
+    if (!is_selected(name))
+        return 0;
+
+    memset(&r, 0, sizeof(BenchResult));
+    snprintf(r.name, sizeof(r.name), "%s", name);
+
+    /* grow the iterations until a run is long enough to be measured */
+    while (true) {
+        memset(&counters, 0, sizeof(BenchCounters));
+        start = av_gettime_relative();
+        cpu_start = get_cpu_time();
+        ret = proc(args, iters, &counters);
+        elapsed = (av_gettime_relative() - start) / 1e6;
+        cpu = get_cpu_time() - cpu_start;
+        if (ret < 0) {
+            r.error = ret;
+            break;
+        }
+        if (elapsed >= min_time || iters >= BENCH_MAX_ITERATIONS) {
+            r.iterations = iters;
+            r.real_time = elapsed * 1e9 / iters;
+            r.cpu_time = cpu * 1e9 / iters;
+            r.items_rate = elapsed > 0.0 ? counters.items / elapsed : 0.0;
+            r.bytes_rate = elapsed > 0.0 ? counters.bytes / elapsed : 0.0;
+            break;
+        }
+
+        /* aim at 1.4 times the min time, never more than 10 times the last run */
+        double mul = elapsed > 0.0 ? min_time * 1.4 / elapsed : 10.0;
+        mul = mul > 10.0 ? 10.0 : mul;
+        iters = (int64_t)(iters * mul) > iters ? (int64_t)(iters * mul) : iters + 1;
+        if (iters > BENCH_MAX_ITERATIONS)
+            iters = BENCH_MAX_ITERATIONS;
+    }
+    results.push_back(r);
+    fprintf(stderr, "%-48s %s\n", name, r.error < 0 ? kerr2str(-r.error) : "done");
+
+    return ret < 0 ? ret : 0;
+}
+
+void Bench::print_text (FILE *fp) const
+{
+    fprintf(fp, "%-48s %14s %14s %12s %14s %14s\n",
+            "benchmark", "time(ns)", "cpu(ns)", "iterations", "items/s", "bytes/s");
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult *r = &results[i];
+        if (r->error < 0) {
+            fprintf(fp, "%-48s error: %s\n", r->name, kerr2str(-r->error));
+            continue;
+        }
+        fprintf(fp, "%-48s %14.1lf %14.1lf %12lld %14.4g %14.4g\n",
+                r->name, r->real_time, r->cpu_time, (long long)r->iterations,
+                r->items_rate, r->bytes_rate);
+    }
+}
+
+void Bench::print_json (FILE *fp) const
+{
+    char   date[64];
+    time_t now = time(NULL);
+
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+    fprintf(fp, "{\n  \"context\": {\n");
+    fprintf(fp, "    \"date\": \"%s\",\n", date);
+    fprintf(fp, "    \"num_cpus\": %d,\n", SDL_GetCPUCount());
+#ifdef _DEBUG
+    fprintf(fp, "    \"library_build_type\": \"debug\"\n");
+#else /* _DEBUG */
+    fprintf(fp, "    \"library_build_type\": \"release\"\n");
+#endif /* _DEBUG */
+    fprintf(fp, "  },\n  \"benchmarks\": [");
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult *r = &results[i];
+        fprintf(fp, "%s\n    {\n      \"name\": ", i ? "," : "");
+        print_json_string(fp, r->name);
+        if (r->error < 0) {
+            fprintf(fp, ",\n      \"error_occurred\": true,\n      \"error_message\": ");
+            print_json_string(fp, kerr2str(-r->error));
+            fprintf(fp, "\n    }");
+            continue;
+        }
+        fprintf(fp, ",\n      \"iterations\": %lld,\n", (long long)r->iterations);
+        fprintf(fp, "      \"real_time\": %.3lf,\n", r->real_time);
+        fprintf(fp, "      \"cpu_time\": %.3lf,\n", r->cpu_time);
+        fprintf(fp, "      \"time_unit\": \"ns\"");
+        if (r->items_rate > 0.0)
+            fprintf(fp, ",\n      \"items_per_second\": %.3lf", r->items_rate);
+        if (r->bytes_rate > 0.0)
+            fprintf(fp, ",\n      \"bytes_per_second\": %.3lf", r->bytes_rate);
+        fprintf(fp, "\n    }");
+    }
+    fprintf(fp, "\n  ]\n}\n");
+}
+
+Bench::Bench ()
+{
+    min_time = BENCH_DEF_MIN_TIME;
+    filter = NULL;
+}
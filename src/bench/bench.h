@@ -0,0 +1,59 @@
+#ifndef _AVPLAYERWIDGET_BENCH_H_
+#define _AVPLAYERWIDGET_BENCH_H_
+
+#include <cstdio>
+#include <vector>
+
+extern "C"
+{
+#include "SDL2/SDL.h"
+}
+
+/* a benchmark runs until it takes so long (unit: second) */
+#define BENCH_DEF_MIN_TIME      0.5
+#define BENCH_MAX_ITERATIONS    1000000000LL
+#define BENCH_MAX_NAME          128
+
+/* work done by a run, 0 if not counted */
+typedef struct BenchCounters {
+    int64_t          items;
+    int64_t          bytes;
+}BenchCounters;
+
+/* runs the benchmark iters times, returns 0 or a negative error code */
+typedef int (*BenchProc) (void *args, int64_t iters, BenchCounters *counters);
+
+/* result of a benchmark, times are per iteration */
+typedef struct BenchResult {
+    char             name[BENCH_MAX_NAME];
+    int64_t          iterations;
+    double           real_time;  // unit: nanosecond
+    double           cpu_time;   // cpu time of the process, threads included (unit: nanosecond)
+    double           items_rate; // items per second
+    double           bytes_rate; // bytes per second
+    int              error;
+}BenchResult;
+
+/*
+* a small harness with the JSON output of Google Benchmark,
+* the iterations grow until a run takes the min time
+*/
+class Bench {
+private:
+    std::vector<BenchResult> results;
+    double           min_time;
+    const char *     filter;     // substring of the names to run, all if NULL
+
+public:
+    void             set_min_time (double min_time);
+    void             set_filter   (const char *filter);
+    bool             is_selected  (const char *name) const;
+    int              run          (const char *name, BenchProc proc, void *args);
+    void             print_text   (FILE *fp) const;
+    void             print_json   (FILE *fp) const;
+
+public:
+    Bench                         ();
+};
+
+#endif /* _AVPLAYERWIDGET_BENCH_H_ */
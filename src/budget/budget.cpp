@@ -0,0 +1,138 @@
+#include <cstring>
+#include "budget.h"
+#include "queue/packet_queue.h"
+#include "queue/frame_queue.h"
+#include "error/error.h"
+#include "log/log.h"
+
+extern "C"
+{
+#include "libavutil/imgutils.h"
+#include "libavutil/samplefmt.h"
+}
+
+#define FILENAME "budget.cpp"
+
+/* the players joined, protected by budget_lock */
+static SDL_SpinLock budget_lock = 0;
+static Budget *     budgets = NULL;
+static int          nb_budgets = 0;
+static int64_t      process_limit = 0;
+
+void budget_set_process_limit (int64_t bytes)
+{
+    SDL_AtomicLock(&budget_lock);
+    process_limit = bytes > 0 ? FFMAX(bytes, BUDGET_MIN_SIZE) : 0;
+    SDL_AtomicUnlock(&budget_lock);
+}
+
+int64_t budget_get_process_limit ()
+{
+    int64_t ret;
+
+    SDL_AtomicLock(&budget_lock);
+    ret = process_limit;
+    SDL_AtomicUnlock(&budget_lock);
+
+    return ret;
+}
+
+void budget_join (Budget *b, int64_t limit)
+{
+    SDL_AtomicLock(&budget_lock);
+    b->limit = limit > 0 ? FFMAX(limit, BUDGET_MIN_SIZE) : BUDGET_DEF_SIZE;
+    if (!b->joined) {
+        b->joined = true;
+        b->next = budgets;
+        budgets = b;
+        nb_budgets++;
+    }
+    SDL_AtomicUnlock(&budget_lock);
+}
+
+void budget_leave (Budget *b)
+{
+    SDL_AtomicLock(&budget_lock);
+    if (b->joined) {
+        for (Budget **p = &budgets; *p; p = &(*p)->next) {
+            if (*p == b) {
+                *p = b->next;
+                break;
+            }
+        }
+        b->joined = false;
+        b->next = NULL;
+        nb_budgets--;
+    }
+    SDL_AtomicUnlock(&budget_lock);
+}
+
+int64_t budget_get_share (Budget *b)
+{
+    int64_t ret;
+
+    SDL_AtomicLock(&budget_lock);
+    ret = b->joined ? b->limit : BUDGET_DEF_SIZE;
+
+    /* the players share the process budget, the share shrinks as players join */
+    if (process_limit && nb_budgets)
+        ret = FFMIN(ret, FFMAX(process_limit / nb_budgets, BUDGET_MIN_SIZE));
+    SDL_AtomicUnlock(&budget_lock);
+
+    return ret;
+}
+
+void budget_fill_streams (BudgetStreams *s, AVFormatContext *avfctx, AVStream *vst, AVStream *ast)
+{
+    AVCodecParameters *par;
+    int                size;
+
+    memset(s, 0, sizeof(BudgetStreams));
+    if (vst) {
+        par = vst->codecpar;
+        size = av_image_get_buffer_size((AVPixelFormat)par->format, par->width, par->height, 1);
+
+        /* the format is unknown before decoding for some files, take 16 bits a pixel */
+        s->frame_size = size > 0 ? size : (int64_t)par->width * par->height * 2;
+    }
+    if (ast) {
+        par = ast->codecpar;
+        size = av_samples_get_buffer_size(NULL, FFMAX(par->channels, 1),
+                                          par->frame_size > 0 ? par->frame_size : 1024,
+                                          par->format >= 0 ? (AVSampleFormat)par->format : AV_SAMPLE_FMT_FLTP, 1);
+        s->sample_size = size > 0 ? size : 8192;
+    }
+    if (avfctx)
+        s->bit_rate = avfctx->bit_rate;
+}
+
+void budget_plan (int64_t budget, const BudgetStreams *s, BudgetPlan *plan)
+{
+    int64_t frames = 0;
+    int64_t remain;
+    int64_t len;
+
+    /* the default sizes are kept when the budget allows them */
+    plan->pictq_len = DEF_PICTQ_LEN;
+    plan->sampleq_len = DEF_SAMPLEQ_LEN;
+
+    /* the video frames and the texture of the same size */
+    if (s->frame_size > 0) {
+        len = budget / BUDGET_FRAME_SHARE / s->frame_size - BUDGET_HELD_FRAMES - 1;
+        plan->pictq_len = (int)FFMAX(FFMIN(len, (int64_t)DEF_PICTQ_LEN), (int64_t)MIN_PICTQ_LEN);
+        frames += (plan->pictq_len + BUDGET_HELD_FRAMES + 1) * s->frame_size;
+    }
+    if (s->sample_size > 0) {
+        len = budget / BUDGET_FRAME_SHARE / s->sample_size - BUDGET_HELD_FRAMES;
+        plan->sampleq_len = (int)FFMAX(FFMIN(len, (int64_t)DEF_SAMPLEQ_LEN), (int64_t)MIN_SAMPLEQ_LEN);
+        frames += (plan->sampleq_len + BUDGET_HELD_FRAMES) * s->sample_size;
+    }
+
+    /* the packets take the rest, no more than a while of the bitrate */
+    remain = budget - frames;
+    if (s->bit_rate > 0)
+        remain = FFMIN(remain, s->bit_rate / 8 * BUDGET_PKTQ_DURATION);
+    else
+        remain = FFMIN(remain, (int64_t)DEF_PKTQ_SIZE);
+    plan->pktq_size = FFMAX(FFMIN(remain, (int64_t)MAX_PKTQ_SIZE), (int64_t)MIN_PKTQ_SIZE);
+}
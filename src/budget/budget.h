@@ -0,0 +1,53 @@
+#ifndef _AVPLAYERWIDGET_BUDGET_H_
+#define _AVPLAYERWIDGET_BUDGET_H_
+
+extern "C"
+{
+#include "libavformat/avformat.h"
+#include "SDL2/SDL.h"
+}
+
+/*
+* memory budget of the players,
+* a player gets its own budget, or an equal part of the process budget if smaller,
+* the queues are sized from the budget when the pipeline is created,
+* and the demux holds while the memory of the session is above the budget
+*/
+
+#define BUDGET_DEF_SIZE      ((int64_t)512 * 1024 * 1024) // a player
+#define BUDGET_MIN_SIZE      ((int64_t)32 * 1024 * 1024)
+#define BUDGET_PKTQ_DURATION 60   // the packet queue holds no more of the bitrate (unit: second)
+#define BUDGET_FRAME_SHARE   4    // the decoded frames take 1/4 of the budget at most
+#define BUDGET_HELD_FRAMES   2    // frames out of the queue, held by the decoder and the renderer
+
+/* what the queues hold */
+typedef struct BudgetStreams {
+    int64_t frame_size;  // bytes of a decoded video frame, 0 without video
+    int64_t sample_size; // bytes of a decoded audio frame, 0 without audio
+    int64_t bit_rate;    // of the file, 0 if unknown (unit: bit/s)
+}BudgetStreams;
+
+/* sizes of the queues */
+typedef struct BudgetPlan {
+    int64_t pktq_size;   // packets of all streams
+    int     pictq_len;
+    int     sampleq_len;
+}BudgetPlan;
+
+/* a share of the process budget */
+typedef struct Budget {
+    int64_t  limit;      // budget of the player
+    bool     joined;
+    Budget * next;
+}Budget;
+
+void    budget_set_process_limit (int64_t bytes); // 0 for no process budget
+int64_t budget_get_process_limit ();
+void    budget_join              (Budget *b, int64_t limit);
+void    budget_leave             (Budget *b);
+int64_t budget_get_share         (Budget *b);
+
+void    budget_fill_streams      (BudgetStreams *s, AVFormatContext *avfctx, AVStream *vst, AVStream *ast);
+void    budget_plan              (int64_t budget, const BudgetStreams *s, BudgetPlan *plan);
+
+#endif /* _AVPLAYERWIDGET_BUDGET_H_ */
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include "budget.h"
+#include "queue/packet_queue.h"
+#include "queue/frame_queue.h"
+
+#define MB ((int64_t)1024 * 1024)
+
+TEST(budget_test, plan)
+{
+    BudgetStreams s;
+    BudgetPlan    plan;
+
+    /* 480p with a small bitrate keeps the default frame queues */
+    memset(&s, 0, sizeof(BudgetStreams));
+    s.frame_size = 640 * 480 * 3 / 2;
+    s.sample_size = 1024 * 2 * 4;
+    s.bit_rate = 2000000;
+    budget_plan(BUDGET_DEF_SIZE, &s, &plan);
+    EXPECT_EQ(DEF_PICTQ_LEN, plan.pictq_len);
+    EXPECT_EQ(DEF_SAMPLEQ_LEN, plan.sampleq_len);
+    EXPECT_EQ(FFMAX(2000000 / 8 * BUDGET_PKTQ_DURATION, (int64_t)MIN_PKTQ_SIZE), plan.pktq_size);
+
+    /* 4K P010, a 25MB frame, gets a shorter queue in 512MB */
+    s.frame_size = 3840 * 2160 * 3;
+    s.bit_rate = 80000000;
+    budget_plan(512 * MB, &s, &plan);
+    EXPECT_EQ(2, 128 * MB / s.frame_size - BUDGET_HELD_FRAMES - 1);
+    EXPECT_EQ(MIN_PICTQ_LEN, plan.pictq_len);
+    EXPECT_LE(plan.pktq_size + (plan.pictq_len + BUDGET_HELD_FRAMES + 1) * s.frame_size, 512 * MB);
+
+    /* 2GB fits the default queues of 4K */
+    budget_plan(2048 * MB, &s, &plan);
+    EXPECT_EQ(DEF_PICTQ_LEN, plan.pictq_len);
+
+    /* unknown bitrate, the default packet queue at most */
+    s.bit_rate = 0;
+    budget_plan(2048 * MB, &s, &plan);
+    EXPECT_EQ(DEF_PKTQ_SIZE, plan.pktq_size);
+
+    /* the packet queue never goes below the minimum */
+    budget_plan(BUDGET_MIN_SIZE, &s, &plan);
+    EXPECT_EQ(MIN_PKTQ_SIZE, plan.pktq_size);
+}
+
+TEST(budget_test, share)
+{
+    Budget a;
+    Budget b;
+
+    memset(&a, 0, sizeof(Budget));
+    memset(&b, 0, sizeof(Budget));
+
+    /* the own budget without a process budget */
+    budget_set_process_limit(0);
+    budget_join(&a, 0);
+    EXPECT_EQ(BUDGET_DEF_SIZE, budget_get_share(&a));
+    budget_join(&b, 256 * MB);
+    EXPECT_EQ(256 * MB, budget_get_share(&b));
+
+    /* the process budget is split between the players */
+    budget_set_process_limit(600 * MB);
+    EXPECT_EQ(300 * MB, budget_get_share(&a));
+    EXPECT_EQ(256 * MB, budget_get_share(&b));
+    budget_leave(&b);
+    EXPECT_EQ(BUDGET_DEF_SIZE, budget_get_share(&a));
+    budget_leave(&b);
+    budget_leave(&a);
+    budget_set_process_limit(0);
+}
@@ -1,3 +1,4 @@
+#include <cmath>
 #include "clock.h"
 
 Clock::Clock ()
@@ -17,4 +18,21 @@ void Clock::set (double time)
 double Clock::get () const
 {
 	return time;
-}
\ No newline at end of file
+}
+
+double compute_sync_delay (double last_duration, double video_clk, double primary_clk,
+                           double max_frame_duration, bool frame_drop)
+{
+    double tgt_delay = last_duration;
+    double sync_threshold = fmax(AV_SYNC_THRESHOLD_MIN, fmin(AV_SYNC_THRESHOLD_MAX, tgt_delay));
+    double clock_diff = video_clk - primary_clk;
+
+    if (!std::isnan(clock_diff) && fabs(clock_diff) < max_frame_duration) {
+        if (clock_diff < -sync_threshold)
+            tgt_delay = (frame_drop && clock_diff < -AV_SYNC_FRAMEDROP_THRESHOLD) ? clock_diff : fmax(0, tgt_delay + clock_diff);
+        else
+            tgt_delay = tgt_delay > AV_SYNC_FRAMEDUP_THRESHOLD ? tgt_delay + clock_diff : 2 * tgt_delay /* not clock_diff */;
+    }
+
+    return fmin(tgt_delay, AV_SYNC_DELAY_MAX);
+}
@@ -1,6 +1,12 @@
 #ifndef _AVPLAYERWIDGET_CLOCK_H_
 #define _AVPLAYERWIDGET_CLOCK_H_
 
+#define AV_SYNC_THRESHOLD_MIN       0.04 // no AV sync correction is done if below the minimum AV sync threshold
+#define AV_SYNC_THRESHOLD_MAX       0.1  // AV sync correction is done if above the maximum AV sync threshold 
+#define AV_SYNC_FRAMEDUP_THRESHOLD  0.1  // if a frame duration is longer than this, it will not be duplicated to compensate AV sync
+#define AV_SYNC_FRAMEDROP_THRESHOLD 0.5 
+#define AV_SYNC_DELAY_MAX           2.0  // max delay in seconds
+
 /* clock */
 class Clock {
 private:
@@ -13,4 +19,12 @@ public:
 	double get () const;
 };
 
+/*
+* the time to keep the last video frame on the screen before the next one (unit: second),
+* corrected by the distance of the video clock to the primary clock,
+* negative if the next frame is late enough to be dropped
+*/
+double compute_sync_delay (double last_duration, double video_clk, double primary_clk,
+                           double max_frame_duration, bool frame_drop);
+
 #endif /* _AVPLAYERWIDGET_CLOCK_H_ */
\ No newline at end of file
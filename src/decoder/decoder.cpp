@@ -1,6 +1,10 @@
 #include "decoder.h"
+#include "pool/pool.h"
 #include "error/error.h"
 #include "log/log.h"
+#include "trace/trace.h"
+#include "lock/lock.h"
+#include "mem/mem.h"
 #include <cstring>
 
 extern "C"
@@ -12,217 +16,170 @@ extern "C"
 
 #define FILENAME "decoder.cpp"
 
-int SDLCALL Decoder::vdec_thread (void* args)
+int Decoder::dec_proc (void* args)
 {
-    Decoder    *d = (Decoder *)args;
-    AVFrame    *f = NULL;
-    AVRational  frame_rate = av_guess_frame_rate(d->avfctx, d->st, NULL);
-    int         got_frame;
-    int         ret;
-
-    logger.debug("Video decoder thread started.\n");
-
-    while (!d->abort_req) {
-        /* pause */
-        if (d->pause_req) {
-            got_frame = 0;
-            goto pause;
-        }
-
-        /* alloc a frame */
-        f = av_frame_alloc();
-        if (!f)
-            GOTO_FAIL(KENOMEM);
-
-        /* get a packet and decode it */
-        got_frame = d->decode_packets(f);
-        ret = 0;
-put_frame:
-        if (d->abort_req)
-            break;
-        if (d->pause_req) {
-pause:            
-            SDL_LockMutex(d->pause_mutex);
-            d->pause_req = false;
-            d->paused = true;
-            logger.debug("Video decoder thread paused.\n");
-            SDL_CondWait(d->pause_cond, d->pause_mutex);
-            logger.debug("Video decoder thread resumed.\n");
-            d->paused = false;
-            SDL_UnlockMutex(d->pause_mutex);
-            if (d->seek_req) {
-                d->seek_req = false;
-                av_frame_free(&f);
-                continue;
-            }
-            if (1 == got_frame)
-                goto put_frame;
-        }
-        if (1 == got_frame) {
-            double pts = f->pts == AV_NOPTS_VALUE ? d->clk.get() : f->pts * av_q2d(d->st->time_base);
-            double duration = (frame_rate.num && frame_rate.den) ?
-                               av_q2d((AVRational){frame_rate.den, frame_rate.num}) :
-                               0;
-            if (!ret)
-                d->clk.set(f->pts == AV_NOPTS_VALUE ? d->clk.get() + duration : pts);
-
-            /* seeking */
-            if (d->seeking) {
-                // logger.verbose("Video decoder seeking vpts: %lf\n", pts);
-                if (pts < d->seek_pos) {
-                    av_frame_free(&f);
-                    continue;
-                } else {
-                    d->seeking = false;
-                }
-            }
-
-            /* put frame to queue, unblocked */
-            ret = d->fq->put(f, f->pkt_pos, pts, duration);
-            if (ret < 0) {
-                if (KERROR(KEAGAIN) == ret) { // frame_queue is full
-                    //logger.debug("Video frame queue is full.\n");
-                    av_usleep(10000); // wait 10ms
-////////////////////////////////////////////
-                    goto put_frame;
-                } else { // KERROR(KENOMEM)
-                    GOTO_FAIL(KENOMEM);
-                }
-            } else {
-                //logger.verbose("+vfq:%d\n", d->fq->get_len());
-            }
-        } else if (!got_frame) {
-            av_frame_free(&f);
-            continue;
-        } else {
-            if (d->abort_req)
-                continue;
-            if (KERROR(KEABORTED) == got_frame)
-                continue;
-            else if (KERROR(KEEOF) == got_frame)
-                goto pause;
-            logger.FATALN("[%s: %d]%s.\n", kerr2str(KEDECODE_PACKETS_FAIL));
-            GOTO_FAIL(KEDECODE_PACKETS_FAIL);
-        }
+    Decoder *d = (Decoder *)args;
+    int      ret;
+
+    /* decode a few frames, then give way to the other tasks */
+    for (int i = 0; i < DECODER_TASK_SLICE; i++) {
+        ret = d->decode_frame();
+        if (TASK_AGAIN != ret)
+            return ret;
     }
 
-    ret = 0;
-fail:
-    av_frame_free(&f);
-    if (ret < 0)
-        emit d->err_occured(ret);
+    return TASK_AGAIN;
+}
 
-    logger.debug("Video decoder thread stopped.\n");
-    return ret;
+void Decoder::enter_pause ()
+{
+    mutex_lock(pause_mutex);
+    SDL_AtomicSet(&pause_req, 0);
+    paused = true;
+    pause_gen = resume_gen;
+    mutex_unlock(pause_mutex);
+    state.set(WORKER_PAUSED);
+
+    KLOGD("%s decoder task paused.\n", AVMEDIA_TYPE_VIDEO == avctx->codec_type ? "Video" : "Audio");
 }
 
-int SDLCALL Decoder::adec_thread (void* args)
+int Decoder::decode_frame ()
 {
-    Decoder    *d = (Decoder *)args;
-    AVFrame    *f = NULL;
-    int         got_frame;
-    int         ret;
-
-    logger.debug("Audio decoder thread started.\n");
-
-    while (!d->abort_req) {
-        /* pause */
-        if (d->pause_req) {
-            got_frame = 0;
-            goto pause;
+    bool   video = AVMEDIA_TYPE_VIDEO == avctx->codec_type;
+    double pts;
+    double duration;
+    int    ret;
+
+    if (SDL_AtomicGet(&abort_req)) {
+        mem_frame_free(mem, &f);
+        got_frame = false;
+        state.set(WORKER_STOPPED);
+        KLOGD("%s decoder task stopped.\n", video ? "Video" : "Audio");
+        return TASK_DONE;
+    }
+
+    /* pause, the decoded frame is held until resumed */
+    if (SDL_AtomicGet(&pause_req))
+        enter_pause();
+    if (paused) {
+        mutex_lock(pause_mutex);
+        if (pause_gen == resume_gen) { // sleep until woken by start()
+            mutex_unlock(pause_mutex);
+            return TASK_WAIT;
+        }
+        paused = false;
+        mutex_unlock(pause_mutex);
+        state.set(WORKER_RUNNING);
+        KLOGD("%s decoder task resumed.\n", video ? "Video" : "Audio");
+        if (seek_req) {
+            seek_req = false;
+            got_frame = false;
+            retry = false;
+            if (f)
+                mem_frame_unref(mem, f);
+        }
+    }
+
+    if (!got_frame) {
+        /*
+        * hold until the video decoder lands, then start from the landed
+        * position, so no audio is decoded for the skipped range
+        */
+        if (SDL_AtomicGet(&seeking) && master) {
+            if (master->is_seeking()) // woken by land() of the master
+                return TASK_WAIT;
+            if (master->get_landed_pts() > seek_pos)
+                seek_pos = master->get_landed_pts();
         }
 
-        /* alloc a frame */
-        f = av_frame_alloc();
+        /* alloc a frame, the dropped one is reused */
+        if (!f)
+            f = mem_frame_alloc(mem);
         if (!f)
             GOTO_FAIL(KENOMEM);
 
         /* get a packet and decode it */
-        got_frame = d->decode_packets(f);
-        ret = 0;
-put_frame:
-        if (d->abort_req)
-            break;
-        if (d->pause_req) {
-pause:            
-            SDL_LockMutex(d->pause_mutex);
-            d->pause_req = false;
-            d->paused = true;
-            logger.debug("Audio decoder thread paused.\n");
-            SDL_CondWait(d->pause_cond, d->pause_mutex);
-            logger.debug("Audio decoder thread resumed.\n");
-            d->paused = false;
-            SDL_UnlockMutex(d->pause_mutex);
-            if (d->seek_req) {
-                d->seek_req = false;
-                av_frame_free(&f);
-                continue;
-            }
-            if (1 == got_frame)
-                goto put_frame;
+        ret = decode_packets(f);
+        if (KERROR(KEAGAIN) == ret) { // no packet, woken by the packet queue
+            return TASK_WAIT;
+        } else if (KERROR(KEEOF) == ret) { // sleep until seeked or spliced
+            enter_pause();
+            return TASK_WAIT;
+        } else if (ret < 0) {
+            logger.FATALN("[%s: %d]%s.\n", kerr2str(KEDECODE_PACKETS_FAIL));
+            GOTO_FAIL(KEDECODE_PACKETS_FAIL);
+        } else if (!ret) {
+            mem_frame_unref(mem, f);
+            return TASK_AGAIN;
         }
-        if (1 == got_frame) {
-            double pts = f->pts == AV_NOPTS_VALUE ? d->clk.get() : f->pts * av_q2d(d->st->time_base);
-            double duration = av_q2d((AVRational){f->nb_samples, f->sample_rate});
-            if (!ret)
-                d->clk.set(f->pts == AV_NOPTS_VALUE ? d->clk.get() + duration : pts);
-
-            /* seeking */
-            if (d->seeking) {
-                // logger.verbose("Audio decoder seeking apts: %lf\n", pts);
-                if (pts < d->seek_pos) {
-                    av_frame_free(&f);
-                    continue;
-                } else {
-                    d->seeking = false;
-                }
-            }
+        got_frame = true;
+        retry = false;
+    }
 
-            /* put frame to queue, unblocked */
-            ret = d->fq->put(f, f->pkt_pos, pts, duration);
-            if (ret < 0) {
-                if (KERROR(KEAGAIN) == ret) { // frame_queue is full
-                    //logger.debug("Audio frame queue is full.\n");
-                    av_usleep(10000); // wait 10ms
-////////////////////////////////////////////
-                    goto put_frame;
-                } else { // KERROR(KENOMEM)
-                    GOTO_FAIL(KENOMEM);
-                }
-            } else {
-                //logger.verbose("+afq:%d\n", d->fq->get_len());
+    pts = f->pts == AV_NOPTS_VALUE ? clk.get() : f->pts * av_q2d(st->time_base);
+    if (video)
+        duration = (frame_rate.num && frame_rate.den) ? av_q2d((AVRational){frame_rate.den, frame_rate.num}) : 0;
+    else
+        duration = av_q2d((AVRational){f->nb_samples, f->sample_rate});
+    if (!retry)
+        clk.set(f->pts == AV_NOPTS_VALUE ? clk.get() + duration : pts);
+
+    /* seeking, the frames before the target never reach the frame queue */
+    if (SDL_AtomicGet(&seeking)) {
+        if (video) {
+            if (exact_seek && pts < seek_pos) {
+                if (pts >= seek_pos - SEEK_NEAR_THRESHOLD)
+                    set_discard(false);
+                mem_frame_unref(mem, f);
+                got_frame = false;
+                return TASK_AGAIN;
             }
-        } else if (!got_frame) {
-            av_frame_free(&f);
-            continue;
+            set_discard(false);
+            landed_pts = pts;
+            land();
         } else {
-            if (d->abort_req)
-                continue;
-            if (KERROR(KEABORTED) == got_frame)
-                continue;
-            else if (KERROR(KEEOF) == got_frame)
-                goto pause;
-            logger.FATALN("[%s: %d]%s.\n", kerr2str(KEDECODE_PACKETS_FAIL));
-            GOTO_FAIL(KEDECODE_PACKETS_FAIL);
+            if (pts < seek_pos) {
+                mem_frame_unref(mem, f);
+                got_frame = false;
+                return TASK_AGAIN;
+            }
+            SDL_AtomicSet(&seeking, 0);
         }
     }
 
-    ret = 0;
+    /* put frame to queue, unblocked */
+    ret = fq->put(f, f->pkt_pos, pts, duration, serial);
+    if (!ret) {
+        f = NULL;
+        got_frame = false;
+        retry = false;
+        return TASK_AGAIN;
+    } else if (KERROR(KEAGAIN) == ret) { // frame_queue is full, woken when a frame is taken
+        retry = true;
+        return TASK_WAIT;
+    }
+    ret = KERROR(KENOMEM);
+
 fail:
-    av_frame_free(&f);
-    if (ret < 0)
-        emit d->err_occured(ret);
+    mem_frame_free(mem, &f);
+    got_frame = false;
+    state.set(WORKER_STOPPED);
+    emit err_occured(ret);
 
-    logger.debug("Audio decoder thread stopped.\n");
-    return ret;
+    KLOGD("%s decoder task stopped.\n", video ? "Video" : "Audio");
+    return TASK_DONE;
 }
 
 int Decoder::decode_packets (AVFrame* f)
 {
     AVPacket *pkt = NULL;
+    int64_t   span;
+    int64_t   begin;
     int       ret;
 
-    while (!abort_req) {
+    while (!SDL_AtomicGet(&abort_req)) {
+        span = trace_begin();
+        begin = av_gettime_relative();
         switch (avctx->codec_type) {
         case AVMEDIA_TYPE_VIDEO:
             ret = avcodec_receive_frame(avctx, f);
@@ -233,10 +190,19 @@ int Decoder::decode_packets (AVFrame* f)
         default:
             return KERROR(KEUNSUPPORTED_MEDIA_STREAM_TYPE);
         }
+        stage_stats_add(&stats, ret >= 0 ? 1 : 0, 0, av_gettime_relative() - begin);
+        trace_end("avcodec_receive_frame", span);
         if (AVERROR(EAGAIN) != ret) {
             if (AVERROR_EOF == ret) {
+                /* the old codec is drained, go on with the next file */
+                if (splice_req) {
+                    splice_req = false;
+                    splice();
+                    continue;
+                }
                 return 0;
             } else if (ret >= 0) { // success
+                mem_frame_fill(mem, f);
                 return 1;
             } else { // get an error
                 logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KERECEIVE_FRAME_FAIL), av_err2str(ret));
@@ -247,20 +213,35 @@ int Decoder::decode_packets (AVFrame* f)
                 return KERROR(KEEOF);
         }
 
-        /* get a packet from queue, blocked */
+        /* get a packet from queue, unblocked, the demux is woken when the queue runs low */
 get_pkt:
-        if (pktq->get_len() <= 2) {
-            SDL_LockMutex(wait_mutex);
-            SDL_CondSignal(empty_queue_cond);
-            SDL_UnlockMutex(wait_mutex);
-        }
-        pkt = pktq->get();
+        pkt = pktq->try_get();
         //logger.verbose("-vpktq:%d\n", pktq->get_len());
-        if (!pkt) // aborted or eof
-            return pktq->is_eof() ?  KERROR(EOF): KERROR(KEABORTED);
+        if (!pkt) // empty, aborted or eof
+            return pktq->is_eof() ? KERROR(KEEOF) : KERROR(KEAGAIN);
+
+        /* the packets of the next file follow, drain the old codec before splicing */
+        if (SPLICE_PKT_STREAM_INDEX == pkt->stream_index) {
+            mem_packet_free(mem, &pkt);
+            avcodec_send_packet(avctx, NULL);
+            splice_req = true;
+            continue;
+        }
+
+        /* drop the audio packets which end before the seek target without decoding */
+        if (SDL_AtomicGet(&seeking) && AVMEDIA_TYPE_AUDIO == avctx->codec_type
+            && AV_NOPTS_VALUE != pkt->pts
+            && (pkt->pts + pkt->duration) * av_q2d(st->time_base) < seek_pos) {
+            mem_packet_free(mem, &pkt);
+            goto get_pkt;
+        }
 
         /* if get a common packet, send it to decoder */
+        span = trace_begin();
+        begin = av_gettime_relative();
         ret = avcodec_send_packet(avctx, pkt);
+        stage_stats_add(&stats, 0, pkt->size, av_gettime_relative() - begin);
+        trace_end("avcodec_send_packet", span);
         if (ret < 0) {
              if (AVERROR(EAGAIN) == ret) {
                  logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KESEND_PACKET_FAIL), av_err2str(ret));
@@ -277,209 +258,396 @@ get_pkt:
                   GOTO_FAIL(KESEND_PACKET_FAIL);
              }
         }
-        av_packet_free(&pkt);
+        mem_packet_free(mem, &pkt);
     }
 
     ret = 0;
 fail:
     if (pkt)
-        av_packet_free(&pkt);
+        mem_packet_free(mem, &pkt);
     return ret;
 }
 
-int Decoder::init (Clock clk)
+int Decoder::init (Clock clk, TaskPool *pool, int session)
 {
     int ret;
 
-    if (dec_thr)
+    if (this->pool)
         return KERROR(KEREINIT);
 
-    abort_req = false;
-    pause_req = false;
+    SDL_AtomicSet(&abort_req, 0);
+    SDL_AtomicSet(&pause_req, 0);
     paused = false;
-    seeking = false;
+    resume_gen = 0;
+    pause_gen = 0;
+    got_frame = false;
+    retry = false;
+    SDL_AtomicSet(&seeking, 0);
     seek_req = false;
+    exact_seek = true;
+    landed_pts = 0.0;
+    splice_req = false;
+    serial = 0;
+
+    /* init state */
+    ret = state.init(WORKER_RUNNING);
+    if (ret < 0)
+        return ret;
 
-    /* create mutex and cond */
-    pause_mutex = SDL_CreateMutex();
+    /* create mutex */
+    pause_mutex = mutex_create("decoder pause_mutex");
     if (!pause_mutex) {
         logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_MUTEX_FAIL), SDL_GetError());
         return KERROR(KECREATE_SDL_MUTEX_FAIL);
     }
-    pause_cond = SDL_CreateCond();
-    if (!pause_cond) {
-        logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_COND_FAIL), SDL_GetError());
-        return KERROR(KECREATE_SDL_COND_FAIL);
-    }
-
-    /* find decoder */
-    avctx = avcodec_alloc_context3(NULL);
-    if (!avctx)
-        return KERROR(KENOMEM);
-    ret = avcodec_parameters_to_context(avctx, st->codecpar);
-    if (ret < 0) {
-        logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECOPY_CODEC_PARAMS_FAIL), av_err2str(ret));
-        return KERROR(KECOPY_CODEC_PARAMS_FAIL);
-    }
-    codec = avcodec_find_decoder(avctx->codec_id);
-    if (!codec) {
-        logger.FATALN("[%s: %d]%s.\n", kerr2str(KEAVCODEC_FIND_DECODER_FAIL));
-        return KERROR(KEAVCODEC_FIND_DECODER_FAIL);
-    }
 
     /* open decoder */
-    ret = avcodec_open2(avctx, codec, NULL);
-    if (ret < 0) {
-        logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KEOPEN_DECODER_FAIL), av_err2str(ret));
-        return KERROR(KEOPEN_DECODER_FAIL);
-    }
+    ret = open_codec(st, &avctx, &codec);
+    if (ret < 0)
+        return ret;
+    frame_rate = av_guess_frame_rate(avfctx, st, NULL);
 
     /* set clock */
     this->clk.set(clk.get());
 
-    /* create video decoder thread */
+    /* submit decoder task, woken by the queues */
     switch (avctx->codec_type) {
     case AVMEDIA_TYPE_VIDEO:
-        dec_thr = SDL_CreateThread(vdec_thread, "vdec_thread", this);
+        dec_task.init(dec_proc, this, "vdec_task");
         break;
     case AVMEDIA_TYPE_AUDIO:
-        dec_thr = SDL_CreateThread(adec_thread, "adec_thread", this);
+        dec_task.init(dec_proc, this, "adec_task");
         break;
     default:
         logger.FATALN("[%s: %d]%s.\n", kerr2str(KEUNSUPPORTED_MEDIA_STREAM_TYPE));
         return KERROR(KEUNSUPPORTED_MEDIA_STREAM_TYPE);
     }
-    if (!dec_thr) {
-        logger.FATALN("[%s: %d]%s.\n", kerr2str(KECREATE_THREAD_FAIL));
-        return KERROR(KECREATE_THREAD_FAIL);
+    pktq->set_consumer(&dec_task);
+    fq->set_producer(&dec_task);
+    ret = pool->submit(&dec_task, session);
+    if (ret < 0) {
+        pktq->set_consumer(NULL);
+        fq->set_producer(NULL);
+        logger.FATALN("[%s: %d]%s.\n", kerr2str(-ret));
+        return ret;
     }
+    this->pool = pool;
 
     if (AVMEDIA_TYPE_VIDEO == avctx->codec_type)
-        logger.debug("Video decoder has been inited.\n");
-    else if (AVMEDIA_TYPE_VIDEO == avctx->codec_type)
-        logger.debug("Audio decoder has been inited.\n");
+        KLOGD("Video decoder has been inited.\n");
+    else if (AVMEDIA_TYPE_AUDIO == avctx->codec_type)
+        KLOGD("Audio decoder has been inited.\n");
     return 0;
 }
 
+int Decoder::open_codec (AVStream *st, AVCodecContext **avctx, AVCodec **codec)
+{
+    int ret;
+
+    /* find decoder */
+    *avctx = avcodec_alloc_context3(NULL);
+    if (!*avctx)
+        return KERROR(KENOMEM);
+    ret = avcodec_parameters_to_context(*avctx, st->codecpar);
+    if (ret < 0) {
+        logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECOPY_CODEC_PARAMS_FAIL), av_err2str(ret));
+        GOTO_FAIL(KECOPY_CODEC_PARAMS_FAIL);
+    }
+    *codec = avcodec_find_decoder((*avctx)->codec_id);
+    if (!*codec) {
+        logger.FATALN("[%s: %d]%s.\n", kerr2str(KEAVCODEC_FIND_DECODER_FAIL));
+        GOTO_FAIL(KEAVCODEC_FIND_DECODER_FAIL);
+    }
+
+    /* open decoder */
+    ret = avcodec_open2(*avctx, *codec, NULL);
+    if (ret < 0) {
+        logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KEOPEN_DECODER_FAIL), av_err2str(ret));
+        GOTO_FAIL(KEOPEN_DECODER_FAIL);
+    }
+
+    ret = 0;
+fail:
+    if (ret < 0)
+        avcodec_free_context(avctx);
+    return ret;
+}
+
 void Decoder::close ()
 {
-    int         ret;
     AVMediaType type = avctx->codec_type;
 
-    if (!dec_thr)
+    if (!pool)
         return;
 
-    /* stop decoder thread */
-    abort_req = true;
-    SDL_LockMutex(pause_mutex);
-    SDL_CondSignal(pause_cond);
-    SDL_UnlockMutex(pause_mutex);
-    SDL_WaitThread(dec_thr, NULL);
+    /* stop decoder task, no task is woken by the queues after it finished */
+    SDL_AtomicSet(&abort_req, 1);
+    dec_task.wake();
+    pool->join(&dec_task);
+    pktq->set_consumer(NULL);
+    fq->set_producer(NULL);
 
     /* clear all */
-    SDL_DestroyMutex(pause_mutex);
-    SDL_DestroyCond(pause_cond);
+    mutex_destroy(pause_mutex);
     avcodec_close(avctx);
     avcodec_free_context(&avctx);
+    unstage();
 
-    dec_thr = NULL;
-    paused = true;
-    seeking = false;
+    state.close();
+    pool = NULL;
+    land();
 
     if (AVMEDIA_TYPE_VIDEO == type)
-        logger.debug("Video decoder closed.\n");
-    else if (AVMEDIA_TYPE_VIDEO == type)
-        logger.debug("Audio decoder closed.\n");
+        KLOGD("Video decoder closed.\n");
+    else if (AVMEDIA_TYPE_AUDIO == type)
+        KLOGD("Audio decoder closed.\n");
+}
+
+int Decoder::reset (AVFormatContext *avfctx, int st_idx, Clock clk)
+{
+    AVStream *      new_st;
+    AVCodecContext *new_avctx;
+    AVCodec *       new_codec;
+    int             ret;
+
+    /* the codec context is swapped while the task is paused */
+    if (!pool || WORKER_PAUSED != state.get())
+        return KERROR(KEUNINITED);
+    new_st = avfctx->streams[st_idx];
+    if (new_st->codecpar->codec_type != avctx->codec_type)
+        return KERROR(KEINVAL);
+
+    /* open the decoder of the new stream, the old one is kept if failed */
+    ret = open_codec(new_st, &new_avctx, &new_codec);
+    if (ret < 0)
+        return ret;
+    avcodec_free_context(&avctx);
+    avctx = new_avctx;
+    codec = new_codec;
+    this->avfctx = avfctx;
+    this->st_idx = st_idx;
+    st = new_st;
+    frame_rate = av_guess_frame_rate(avfctx, st, NULL);
+
+    /* reset decoder state, the frame held by the task is of the old stream */
+    unstage();
+    splice_req = false;
+    this->clk.set(clk.get());
+    land();
+    exact_seek = true;
+    landed_pts = 0.0;
+    seek_req = true;
+
+    if (AVMEDIA_TYPE_VIDEO == avctx->codec_type)
+        KLOGD("Video decoder reset.\n");
+    else if (AVMEDIA_TYPE_AUDIO == avctx->codec_type)
+        KLOGD("Audio decoder reset.\n");
+    return 0;
+}
+
+int Decoder::stage (AVFormatContext *avfctx, int st_idx)
+{
+    AVStream *st;
+    int       ret;
+
+    if (!pool || next_avctx)
+        return KERROR(KEUNINITED);
+    st = avfctx->streams[st_idx];
+    if (st->codecpar->codec_type != avctx->codec_type)
+        return KERROR(KEINVAL);
+
+    /* open the decoder of the next file, it is used after the splice packet */
+    ret = open_codec(st, &next_avctx, &next_codec);
+    if (ret < 0)
+        return ret;
+    next_avfctx = avfctx;
+    next_st = st;
+    next_st_idx = st_idx;
+
+    return 0;
+}
+
+void Decoder::unstage ()
+{
+    if (next_avctx)
+        avcodec_free_context(&next_avctx);
+    next_avfctx = NULL;
+    next_codec = NULL;
+    next_st = NULL;
+    next_st_idx = -1;
+}
+
+void Decoder::splice ()
+{
+    /* nothing staged, restart the drained codec */
+    if (!next_avctx) {
+        avcodec_flush_buffers(avctx);
+        return;
+    }
+
+    avcodec_free_context(&avctx);
+    avctx = next_avctx;
+    codec = next_codec;
+    avfctx = next_avfctx;
+    st = next_st;
+    st_idx = next_st_idx;
+    frame_rate = av_guess_frame_rate(avfctx, st, NULL);
+    next_avctx = NULL;
+    unstage();
+    splice_req = false;
+    serial++;
+
+    if (AVMEDIA_TYPE_VIDEO == avctx->codec_type)
+        KLOGD("Video decoder spliced.\n");
+    else if (AVMEDIA_TYPE_AUDIO == avctx->codec_type)
+        KLOGD("Audio decoder spliced.\n");
+}
+
+int Decoder::get_serial () const
+{
+    return serial;
 }
 
 void Decoder::start ()
 {
-    if (!dec_thr)
+    if (!pool)
         return;
 
-    pause_req = false;
-    SDL_LockMutex(pause_mutex);
-    SDL_CondSignal(pause_cond);
-    SDL_UnlockMutex(pause_mutex);
-    while (paused);
+    mutex_lock(pause_mutex);
+    SDL_AtomicSet(&pause_req, 0);
+    resume_gen++;
+    mutex_unlock(pause_mutex);
+    dec_task.wake();
+    state.wait_not(WORKER_PAUSED, STATE_WAIT_FOREVER); // stopped if failed
 
     if (AVMEDIA_TYPE_VIDEO == avctx->codec_type)
-        logger.debug("Video decoder started.\n");
-    else if (AVMEDIA_TYPE_VIDEO == avctx->codec_type)
-        logger.debug("Audio decoder started.\n");
+        KLOGD("Video decoder started.\n");
+    else if (AVMEDIA_TYPE_AUDIO == avctx->codec_type)
+        KLOGD("Audio decoder started.\n");
 }
 
 void Decoder::pause ()
 {
-    if (!dec_thr)
+    if (!pool)
         return;
 
-    pause_req = true;
+    SDL_AtomicSet(&pause_req, 1);
     pktq->abort();
-    while (!paused);
+    fq->abort();
+    dec_task.wake();
+    state.wait_not(WORKER_RUNNING, STATE_WAIT_FOREVER); // stopped if failed
 
     if (AVMEDIA_TYPE_VIDEO == avctx->codec_type)
-        logger.debug("Video decoder paused.\n");
-    else if (AVMEDIA_TYPE_VIDEO == avctx->codec_type)
-        logger.debug("Audio decoder paused.\n");
+        KLOGD("Video decoder paused.\n");
+    else if (AVMEDIA_TYPE_AUDIO == avctx->codec_type)
+        KLOGD("Audio decoder paused.\n");
 }
 
-void Decoder::seek (double pos)
+void Decoder::seek (double pos, bool exact)
 {
-    if (!dec_thr)
+    if (!pool)
         return;
 
-    if (!seeking) {
-        if (AVMEDIA_TYPE_VIDEO == avctx->codec_type)
-            logger.debug("Video decoder seek to %lf.\n", pos);
-        else if (AVMEDIA_TYPE_VIDEO == avctx->codec_type)
-            logger.debug("Audio decoder seek to %lf.\n", pos);
-
-        clk.set(pos);
-        seek_req = true;
-        seek_pos = pos;
-        seeking = true;
-    }
+    /* a newer target replaces the unfinished one */
+    if (AVMEDIA_TYPE_VIDEO == avctx->codec_type)
+        KLOGD("Video decoder %s seek to %lf.\n", exact ? "exact" : "fast", pos);
+    else if (AVMEDIA_TYPE_AUDIO == avctx->codec_type)
+        KLOGD("Audio decoder %s seek to %lf.\n", exact ? "exact" : "fast", pos);
+
+    clk.set(pos);
+    seek_req = true;
+    seek_pos = pos;
+    exact_seek = exact;
+    SDL_AtomicSet(&seeking, 1);
+
+    /* skip the non-reference frames until the target is near */
+    if (AVMEDIA_TYPE_VIDEO == avctx->codec_type)
+        set_discard(exact);
+}
+
+void Decoder::set_discard (bool skip)
+{
+    /* 
+    * the loop filter is skipped for non-reference frames only, 
+    * skipping it on reference frames would drift into the target picture 
+    */
+    avctx->skip_frame = skip ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+    avctx->skip_loop_filter = skip ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
 }
 
 void Decoder::flush ()
 {
-    if (!dec_thr)
+    if (!pool)
         return;
 
-    if (paused) {
+    if (WORKER_PAUSED == state.get()) {
         pktq->clear();
         fq->clear();
         avcodec_flush_buffers(avctx);
 
         if (AVMEDIA_TYPE_VIDEO == avctx->codec_type)
-            logger.debug("Video decoder flushed.\n");
+            KLOGD("Video decoder flushed.\n");
         else if (AVMEDIA_TYPE_AUDIO == avctx->codec_type)
-            logger.debug("Audio decoder flushed.\n");
+            KLOGD("Audio decoder flushed.\n");
     }
 }
 
-bool Decoder::is_seeking () const
+bool Decoder::is_seeking ()
+{
+    return SDL_AtomicGet(&seeking);
+}
+
+double Decoder::get_landed_pts () const
+{
+    return landed_pts;
+}
+
+void Decoder::set_master (Decoder *master)
+{
+    if (this->master)
+        this->master->slave = NULL;
+    this->master = master;
+    if (master)
+        master->slave = this;
+}
+
+void Decoder::land ()
+{
+    SDL_AtomicSet(&seeking, 0);
+    if (slave)
+        slave->dec_task.wake();
+}
+
+StageStats *Decoder::get_stats ()
 {
-    return seeking;
+    return &stats;
 }
 
 Decoder::Decoder (AVFormatContext* avfctx, int st_idx, 
-                  PacketQueue* pktq, FrameQueue* fq, 
-                  SDL_mutex* wait_mutex, SDL_cond* empty_queue_cond)
+                  PacketQueue* pktq, FrameQueue* fq)
 {
     this->avfctx = avfctx;
     this->st_idx = st_idx;
     this->st = avfctx->streams[st_idx];
     this->pktq = pktq;
     this->fq = fq;
-    this->wait_mutex = wait_mutex;
-    this->empty_queue_cond = empty_queue_cond;
-    dec_thr = NULL;
+    this->mem = pktq->get_mem();
+    pool = NULL;
+    f = NULL;
+    master = NULL;
+    slave = NULL;
+    next_avctx = NULL;
+    unstage();
+    serial = 0;
+    splice_req = false;
+    stage_stats_reset(&stats);
 }
 
 Decoder::~Decoder ()
 {
-    if (dec_thr)
+    if (pool)
         close();
+    set_master(NULL);
+    if (slave)
+        slave->master = NULL;
 }
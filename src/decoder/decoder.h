@@ -6,6 +6,9 @@
 #include "queue/frame_queue.h"
 #include "error/error.h"
 #include "clock/clock.h"
+#include "state/state.h"
+#include "pool/pool.h"
+#include "stats/stats.h"
 
 extern "C"
 {
@@ -14,18 +17,25 @@ extern "C"
 #include "SDL2/SDL.h"
 }
 
+/* decode every frame when the exact seek is closer than this to the target (unit: second) */
+#define SEEK_NEAR_THRESHOLD 1.0
+
+/* frames decoded in a run of the decoder task */
+#define DECODER_TASK_SLICE  4
+
 class Decoder : public QObject {
     Q_OBJECT
 
 private:
-    /* thread */
-    SDL_Thread *     dec_thr;
+    /* task */
+    Task             dec_task;
+    TaskPool *       pool;        // NULL if not inited
+    AVFrame *        f;           // frame being decoded, kept between the runs
+    bool             got_frame;   // f is decoded but not queued yet
+    bool             retry;       // f is waiting for the space of the frame queue
 
-    /* mutex and condition variable */
-    SDL_mutex *      wait_mutex;
-    SDL_cond *       empty_queue_cond;
+    /* mutex */
     SDL_mutex *      pause_mutex;
-    SDL_cond *       pause_cond;
 
     /* context */
     AVFormatContext *avfctx;
@@ -35,46 +45,78 @@ private:
     /* queues */
     PacketQueue *    pktq;
     FrameQueue *     fq;
+    MemStats *       mem;         // of the queues
 
     /* stream */
     AVStream *       st;
     int              st_idx;
+    AVRational       frame_rate;
     
     /* decoder state */
-    bool             abort_req;
-    bool             pause_req;
+    SDL_atomic_t     abort_req;
+    SDL_atomic_t     pause_req;
     bool             paused;
+    int              resume_gen;  // increased by start() under pause_mutex
+    int              pause_gen;   // resume_gen when paused
+    State            state;       // acknowledged by the decoder task
     Clock            clk;
 
     /* seek */
     bool             seek_req;
-    bool             seeking;
+    SDL_atomic_t     seeking;
+    bool             exact_seek;
     double           seek_pos;
+    double           landed_pts; // pts of the first frame after seeking, set before seeking is cleared
     double           incr;
+    Decoder *        master;     // the audio decoder holds until the master lands
+    Decoder *        slave;      // holding for this decoder, woken when it lands
+
+    /* splice */
+    AVFormatContext *next_avfctx; // staged file, the decoder switches to it at the splice packet
+    AVCodecContext * next_avctx;
+    AVCodec *        next_codec;
+    AVStream *       next_st;
+    int              next_st_idx;
+    bool             splice_req;  // the old codec is being drained
+    int              serial;      // increased on every splice
+
+    /* statistics */
+    StageStats       stats;       // frames decoded, bytes of the packets sent
  
 signals:
     void               err_occured    (int);
 
 private:
-    static int SDLCALL vdec_thread    (void *args);
-    static int SDLCALL adec_thread    (void *args);
+    static int         dec_proc       (void *args);
 
 private:
+    int                decode_frame   ();
+    void               enter_pause    ();
     int                decode_packets (AVFrame *f);
+    void               set_discard    (bool skip);
+    void               land           (); // clears seeking and wakes the slave
+    int                open_codec     (AVStream *st, AVCodecContext **avctx, AVCodec **codec);
 
 public:
-    int                init           (Clock clk);
+    int                init           (Clock clk, TaskPool *pool, int session);
     void               close          ();
+    int                reset          (AVFormatContext *avfctx, int st_idx, Clock clk);
+    int                stage          (AVFormatContext *avfctx, int st_idx);
+    void               unstage        ();
+    void               splice         ();
+    int                get_serial     () const;
     void               start          ();
     void               pause          ();
-    void               seek           (double pos);
+    void               seek           (double pos, bool exact);
     void               flush          ();
-    bool               is_seeking     () const;
+    bool               is_seeking     ();
+    double             get_landed_pts () const;
+    void               set_master     (Decoder *master);
+    StageStats *       get_stats      ();
 
 public:
     Decoder   (AVFormatContext *avfctx, int st_idx, 
-               PacketQueue *pktq, FrameQueue *fq, 
-               SDL_mutex *wait_mutex, SDL_cond *empty_queue_cond);
+               PacketQueue *pktq, FrameQueue *fq);
     ~Decoder  ();
 };
 
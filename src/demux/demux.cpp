@@ -1,7 +1,11 @@
 #include "demux.h"
 #include "decoder/decoder.h"
+#include "pool/pool.h"
 #include "error/error.h"
 #include "log/log.h"
+#include "trace/trace.h"
+#include "lock/lock.h"
+#include "mem/mem.h"
 
 extern "C"
 {
@@ -10,165 +14,333 @@ extern "C"
 
 #define FILENAME "demux.cpp"
 
-int SDLCALL Demux::demux_thread (void* args)
+int Demux::demux_proc (void* args)
 {
-    Demux *    d = (Demux *)args;
-    AVPacket * pkt = NULL;
-    int        ret;
-
-    logger.debug("Demux thread started.\n");
-
-    while (!d->abort_req) {
-        /* read eof or get a pause requestion */
-        if (d->read_eof || d->pause_req)
-            goto wait;
-
-        /* if packet queues is full, no need to read more */
-        if ((d->vst ? d->vpktq->get_size() : 0) +
-            (d->ast ? d->apktq->get_size() : 0) > (d->infinite_buf ? MAX_PKTQ_SIZE : d->max_pktq_size))
-            {
-            /* wait 10ms */
-            SDL_LockMutex(d->wait_mutex);
-            //logger.debug("Packet queue is full.\n");
-            SDL_CondWait(d->continue_read_cond, d->wait_mutex);
-            SDL_UnlockMutex(d->wait_mutex);
-            continue;
-        }
+    Demux *d = (Demux *)args;
+    int    ret;
 
-        /* read a frame */
-        pkt = av_packet_alloc();
-        if (!pkt) {
-            ret = KERROR(KENOMEM);
-fail:
-            if (d->vpktq)
-                d->vpktq->abort();
-            if (d->apktq)
-                d->apktq->abort();
-            av_packet_free(&pkt);
-            emit d->err_occured(ret);
+    /* read a few packets, then give way to the other tasks */
+    for (int i = 0; i < DEMUX_TASK_SLICE; i++) {
+        ret = d->read_packet();
+        if (TASK_AGAIN != ret)
             return ret;
-        }
-        ret = av_read_frame(d->avfctx, pkt);
-        if (ret < 0) {
-            av_packet_free(&pkt);
-            if (ret == AVERROR_EOF || avio_feof(d->avfctx->pb)) {
-                d->read_eof = true;
-                if (d->vpktq)
-                    d->vpktq->set_read_eof(true);
-                if (d->apktq)
-                    d->apktq->set_read_eof(true);
-                logger.debug("Read eof.\n");
-            } else {
-                if (d->avfctx->pb && d->avfctx->pb->error)
-                    logger.error("%s.\n", av_err2str(d->avfctx->pb->error));
-                logger.error("%s: %s.\n", kerr2str(KEREAD_PACKET_FAIL), av_err2str(ret));
-                ret = KERROR(KEREAD_PACKET_FAIL);
-                goto fail;
-            }
-wait:
-            SDL_LockMutex(d->wait_mutex);
-            d->paused = true;
-            logger.debug("Demux thread paused.\n");
-            SDL_CondWait(d->continue_read_cond, d->wait_mutex);
-            logger.debug("Demux thread resumed.\n");
-            d->paused = false;
-            SDL_UnlockMutex(d->wait_mutex);
-            continue;
-        }
+    }
+
+    return TASK_AGAIN;
+}
+
+int Demux::read_packet ()
+{
+    AVPacket * pkt = NULL;
+    int64_t    span;
+    int64_t    begin;
+    int        ret = 0;
+
+    if (SDL_AtomicGet(&abort_req)) {
+        state.set(WORKER_STOPPED);
+        KLOGD("Demux task stopped.\n");
+        return TASK_DONE;
+    }
 
-        /* put packet to queue */
-        if (d->vst && d->vst_idx == pkt->stream_index) {
-            ret = d->vpktq->put(pkt);
-            //logger.verbose("+vpktq:%d\n", d->vpktq->get_len());
-        } else if (d->ast && d->ast_idx == pkt->stream_index) {
-            ret = d->apktq->put(pkt);
-            //logger.verbose("+apktq:%d\n", d->vpktq->get_len());
+    /* read eof or get a pause requestion, sleep until woken by start(), stage() or seek */
+    if (SDL_AtomicGet(&read_eof) || SDL_AtomicGet(&pause_req)) {
+        if (WORKER_PAUSED != state.get())
+            KLOGD("Demux task paused.\n");
+        state.set(WORKER_PAUSED);
+        return TASK_WAIT;
+    }
+    if (WORKER_RUNNING != state.get())
+        KLOGD("Demux task resumed.\n");
+    state.set(WORKER_RUNNING);
+
+    /* if packet queues is full, no need to read more, woken when a queue runs low */
+    if ((vst ? vpktq->get_size() : 0) +
+        (ast ? apktq->get_size() : 0) > (infinite_buf ? MAX_PKTQ_SIZE : max_pktq_size))
+        return TASK_WAIT;
+
+    /* over the memory budget, hold until a packet queue runs low, so the decoders never starve */
+    if (budget && !infinite_buf && mem_get_total(mem) > budget_get_share(budget)
+        && (!vst || vpktq->get_len() > PKTQ_LOW_LEN) && (!ast || apktq->get_len() > PKTQ_LOW_LEN))
+        return TASK_WAIT;
+
+    /* read a frame */
+    pkt = mem_packet_alloc(mem);
+    if (!pkt)
+        GOTO_FAIL(KENOMEM);
+    span = trace_begin();
+    begin = av_gettime_relative();
+    ret = av_read_frame(avfctx, pkt);
+    stage_stats_add(&stats, ret < 0 ? 0 : 1, ret < 0 ? 0 : pkt->size, av_gettime_relative() - begin);
+    trace_end("av_read_frame", span);
+    if (ret < 0) {
+        mem_packet_free(mem, &pkt);
+        if (AVERROR_EXIT == ret) { // interrupted by the player, stopping
+            state.set(WORKER_STOPPED);
+            KLOGD("Demux task interrupted.\n");
+            return TASK_DONE;
+        } else if (ret == AVERROR_EOF || avio_feof(avfctx->pb)) {
+            /* go on with the staged file, or mark eof */
+            mutex_lock(wait_mutex);
+            ret = splice();
+            if (!ret) {
+                SDL_AtomicSet(&read_eof, 1);
+                if (vpktq)
+                    vpktq->set_read_eof(true);
+                if (apktq)
+                    apktq->set_read_eof(true);
+                KLOGD("Read eof.\n");
+            }
+            mutex_unlock(wait_mutex);
+            if (ret < 0)
+                goto fail;
+            return TASK_AGAIN;
         } else {
-            av_packet_free(&pkt);
+            if (avfctx->pb && avfctx->pb->error)
+                logger.error("%s.\n", av_err2str(avfctx->pb->error));
+            logger.error("%s: %s.\n", kerr2str(KEREAD_PACKET_FAIL), av_err2str(ret));
+            GOTO_FAIL(KEREAD_PACKET_FAIL);
         }
-        if (ret < 0)
-            goto fail;
-        pkt = NULL;
     }
 
-    logger.debug("Demux thread stopped.\n");
-    return KERROR(KEABORTED);
+    mem_packet_fill(mem, pkt);
+
+    /* put packet to queue */
+    if (vst && vst_idx == pkt->stream_index) {
+        ret = vpktq->put(pkt);
+        //logger.verbose("+vpktq:%d\n", vpktq->get_len());
+    } else if (ast && ast_idx == pkt->stream_index) {
+        ret = apktq->put(pkt);
+        //logger.verbose("+apktq:%d\n", vpktq->get_len());
+    } else {
+        mem_packet_free(mem, &pkt);
+    }
+    if (ret < 0)
+        goto fail;
+
+    return TASK_AGAIN;
+fail:
+    if (vpktq)
+        vpktq->abort();
+    if (apktq)
+        apktq->abort();
+    mem_packet_free(mem, &pkt);
+    state.set(WORKER_STOPPED);
+    emit err_occured(ret);
+
+    KLOGD("Demux task stopped.\n");
+    return TASK_DONE;
 }
 
-int Demux::init ()
+int Demux::splice ()
+{
+    AVPacket *pkt;
+
+    /* called with wait_mutex locked */
+    if (!next_avfctx)
+        return 0;
+
+    /* mark the end of the old file, the decoders drain and switch codecs there */
+    if (vst) {
+        pkt = mem_packet_alloc(mem);
+        if (!pkt)
+            return KERROR(KENOMEM);
+        pkt->stream_index = SPLICE_PKT_STREAM_INDEX;
+        vpktq->put(pkt);
+    }
+    if (ast) {
+        pkt = mem_packet_alloc(mem);
+        if (!pkt)
+            return KERROR(KENOMEM);
+        pkt->stream_index = SPLICE_PKT_STREAM_INDEX;
+        apktq->put(pkt);
+    }
+
+    /* switch to the next file */
+    avfctx = next_avfctx;
+    vst_idx = next_vst_idx;
+    ast_idx = next_ast_idx;
+    vst = vst_idx >= 0 ? avfctx->streams[vst_idx] : NULL;
+    ast = ast_idx >= 0 ? avfctx->streams[ast_idx] : NULL;
+    next_avfctx = NULL;
+    serial++;
+    if (SDL_AtomicGet(&read_eof)) {
+        if (vpktq)
+            vpktq->set_read_eof(false);
+        if (apktq)
+            apktq->set_read_eof(false);
+        SDL_AtomicSet(&read_eof, 0);
+    }
+
+    KLOGD("Demux spliced.\n");
+
+    return 1;
+}
+
+int Demux::init (TaskPool *pool, int session)
 {
     int ret;
 
-    if (demux_thr)
+    if (this->pool)
         return KERROR(KEREINIT);
 
-    abort_req = false;
-    pause_req = false;
-    paused = false;
-    read_eof = false;
+    SDL_AtomicSet(&abort_req, 0);
+    SDL_AtomicSet(&pause_req, 0);
+    SDL_AtomicSet(&read_eof, 0);
+    next_avfctx = NULL;
+    serial = 0;
 
-    /* create demux thread */
-    demux_thr = SDL_CreateThread(demux_thread, "demux_thread", this);
-    if (!demux_thr) {
-        logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_THREAD_FAIL), SDL_GetError());
-        return KERROR(KECREATE_THREAD_FAIL);
+    /* init state */
+    ret = state.init(WORKER_RUNNING);
+    if (ret < 0)
+        return ret;
+
+    /* submit demux task, woken by the packet queues */
+    demux_task.init(demux_proc, this, "demux_task");
+    if (vpktq)
+        vpktq->set_producer(&demux_task);
+    if (apktq)
+        apktq->set_producer(&demux_task);
+    ret = pool->submit(&demux_task, session);
+    if (ret < 0) {
+        if (vpktq)
+            vpktq->set_producer(NULL);
+        if (apktq)
+            apktq->set_producer(NULL);
+        logger.FATALN("[%s: %d]%s.\n", kerr2str(-ret));
+        return ret;
     }
-    logger.debug("Demux has been inited.\n");
+    this->pool = pool;
+    KLOGD("Demux has been inited.\n");
 
-    return 0;;
+    return 0;
 }
 
 void Demux::close ()
 {
-    int ret;
-
-    if (!demux_thr)
+    if (!pool)
         return;
 
-    /* stop demux thread */
-    abort_req = true;
-    SDL_LockMutex(wait_mutex);
-    SDL_CondSignal(continue_read_cond);
-    SDL_UnlockMutex(wait_mutex);
-    SDL_WaitThread(demux_thr, NULL);
-    demux_thr = NULL;
+    /* stop demux task, no task is woken by the queues after it finished */
+    SDL_AtomicSet(&abort_req, 1);
+    demux_task.wake();
+    pool->join(&demux_task);
+    if (vpktq)
+        vpktq->set_producer(NULL);
+    if (apktq)
+        apktq->set_producer(NULL);
+    pool = NULL;
+    state.close();
+
+    KLOGD("Demux closed.\n");
+}
+
+int Demux::reset (AVFormatContext *avfctx, int vst_idx, int ast_idx)
+{
+    /* the format context is swapped while the task is paused */
+    if (!pool || WORKER_PAUSED != state.get())
+        return KERROR(KEUNINITED);
+
+    this->avfctx = avfctx;
+    this->vst_idx = vst_idx;
+    this->ast_idx = ast_idx;
+    vst = vst_idx >= 0 ? avfctx->streams[vst_idx] : NULL;
+    ast = ast_idx >= 0 ? avfctx->streams[ast_idx] : NULL;
+    next_avfctx = NULL;
+
+    /* reset read eof flag */
+    if (vpktq)
+        vpktq->set_read_eof(false);
+    if (apktq)
+        apktq->set_read_eof(false);
+    SDL_AtomicSet(&read_eof, 0);
+
+    KLOGD("Demux reset.\n");
+
+    return 0;
+}
+
+int Demux::stage (AVFormatContext *avfctx, int vst_idx, int ast_idx)
+{
+    int ret = 0;
+
+    if (!pool)
+        return KERROR(KEUNINITED);
+
+    mutex_lock(wait_mutex);
+    next_avfctx = avfctx;
+    next_vst_idx = vst_idx;
+    next_ast_idx = ast_idx;
+
+    /* eof has been read, the task is idle, splice here */
+    if (SDL_AtomicGet(&read_eof)) {
+        ret = splice();
+        if (ret < 0)
+            next_avfctx = NULL;
+    }
+    mutex_unlock(wait_mutex);
+    demux_task.wake();
 
-    logger.debug("Demux closed.\n");
+    return ret < 0 ? ret : 0;
+}
+
+bool Demux::unstage ()
+{
+    bool ret;
+
+    mutex_lock(wait_mutex);
+    ret = (NULL != next_avfctx);
+    next_avfctx = NULL;
+    mutex_unlock(wait_mutex);
+
+    return ret;
+}
+
+bool Demux::is_staged ()
+{
+    bool ret;
+
+    mutex_lock(wait_mutex);
+    ret = (NULL != next_avfctx);
+    mutex_unlock(wait_mutex);
+
+    return ret;
+}
+
+int Demux::get_serial () const
+{
+    return serial;
 }
 
 void Demux::start ()
 {
-    if (!demux_thr)
+    if (!pool)
         return;
 
-    pause_req = false;
-    SDL_LockMutex(wait_mutex);
-    SDL_CondSignal(continue_read_cond);
-    SDL_UnlockMutex(wait_mutex);
-    while (paused);
+    SDL_AtomicSet(&pause_req, 0);
+    demux_task.wake();
+    if (!SDL_AtomicGet(&read_eof))
+        state.wait_not(WORKER_PAUSED, STATE_WAIT_FOREVER);
 
-    logger.debug("Demux started.\n");
+    KLOGD("Demux started.\n");
 }
 
 void Demux::pause ()
 {
-    if (!demux_thr)
+    if (!pool)
         return;
 
-    pause_req = true;
-    SDL_LockMutex(wait_mutex);
-    SDL_CondSignal(continue_read_cond);
-    SDL_UnlockMutex(wait_mutex);
-    while (!paused);
+    SDL_AtomicSet(&pause_req, 1);
+    demux_task.wake();
+    state.wait_not(WORKER_RUNNING, STATE_WAIT_FOREVER);
 
-    logger.debug("Demux paused.\n"); 
+    KLOGD("Demux paused.\n"); 
 }
 
 int Demux::seek (double pos)
 {
     int ret;
 
-    if (!demux_thr)
+    if (!pool)
         return KERROR(KEUNINITED);
 
     /* seek */
@@ -177,30 +349,51 @@ int Demux::seek (double pos)
                         AVSEEK_FLAG_BACKWARD);
     if (ret < 0) { // ffmpeg unsolved: av_seek_frame() return -1 when the media format is h264 or h265
         logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KESEEK_FAIL), av_err2str(ret));
-        return KERROR(KESEEK_FAIL);     }
+        return KERROR(KESEEK_FAIL);
+    }
 
     /* reset read eof flag */
     if (vpktq)
         vpktq->set_read_eof(false);
     if (apktq)
         apktq->set_read_eof(false);
-    read_eof = false;
+    SDL_AtomicSet(&read_eof, 0);
 
-    logger.debug("Demux seek to %lf.\n", pos);
+    KLOGD("Demux seek to %lf.\n", pos);
 
     return ret;
 }
 
+bool Demux::is_eof ()
+{
+    return SDL_AtomicGet(&read_eof);
+}
+
+void Demux::wake ()
+{
+    demux_task.wake();
+}
+
+StageStats *Demux::get_stats ()
+{
+    return &stats;
+}
+
+void Demux::set_budget (Budget *budget)
+{
+    this->budget = budget;
+}
+
 Demux::Demux (AVFormatContext* avfctx, PacketQueue* vpktq, PacketQueue* apktq, 
-              SDL_mutex* wait_mutex, SDL_cond* continue_read_cond, 
+              SDL_mutex* wait_mutex,
               int vst_idx, int ast_idx, 
               bool infinite_buf, int max_pktq_size)
 {
     this->avfctx = avfctx;
     this->vpktq = vpktq;
     this->apktq = apktq;
+    this->mem = vpktq ? vpktq->get_mem() : (apktq ? apktq->get_mem() : NULL);
     this->wait_mutex = wait_mutex;
-    this->continue_read_cond = continue_read_cond;
     this->infinite_buf = infinite_buf;
     this->max_pktq_size = max_pktq_size;
     this->vst_idx = vst_idx;
@@ -213,11 +406,15 @@ Demux::Demux (AVFormatContext* avfctx, PacketQueue* vpktq, PacketQueue* apktq,
         ast = avfctx->streams[ast_idx];
     else 
         ast = NULL;
-    demux_thr = NULL;
+    next_avfctx = NULL;
+    serial = 0;
+    pool = NULL;
+    budget = NULL;
+    stage_stats_reset(&stats);
 }
 
 Demux::~Demux ()
 {
-    if (demux_thr)
+    if (pool)
         close();
 }
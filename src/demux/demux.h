@@ -3,6 +3,10 @@
 
 #include <QObject>
 #include "queue/packet_queue.h"
+#include "state/state.h"
+#include "pool/pool.h"
+#include "stats/stats.h"
+#include "budget/budget.h"
 
 extern "C"
 {
@@ -10,31 +14,36 @@ extern "C"
 #include "SDL2/SDL.h"
 }
 
+/* packets read in a run of the demux task */
+#define DEMUX_TASK_SLICE    16
+
 class Demux : public QObject {
     Q_OBJECT
 
 private:
-    /* threads */
-    SDL_Thread *     demux_thr;
+    /* task */
+    Task             demux_task;
+    TaskPool *       pool;      // NULL if not inited
 
     /* format context */
     AVFormatContext *avfctx;
 
     /* state */
-    bool             read_eof;
-    bool             paused;
-    bool             abort_req;
-    bool             pause_req;
+    SDL_atomic_t     read_eof;
+    State            state;     // acknowledged by the demux task
+    SDL_atomic_t     abort_req;
+    SDL_atomic_t     pause_req;
     bool             infinite_buf;
     int              max_pktq_size;
+    Budget *         budget;      // the memory of the session is held under its share
 
-    /* mutex and condition variable */
-    SDL_mutex *      wait_mutex;
-    SDL_cond *       continue_read_cond;
+    /* mutex */
+    SDL_mutex *      wait_mutex; // protects the staged file
 
     /* queues */     
     PacketQueue *    vpktq;
     PacketQueue *    apktq;
+    MemStats *       mem;         // of the queues
 
     /* stream index */
     int              vst_idx;
@@ -42,23 +51,45 @@ private:
     AVStream *       vst;
     AVStream *       ast;
 
+    /* splice */
+    AVFormatContext *next_avfctx; // staged file, read after eof without a gap
+    int              next_vst_idx;
+    int              next_ast_idx;
+    int              serial;      // increased on every splice
+
+    /* statistics */
+    StageStats       stats;       // packets read by av_read_frame()
+
 signals:
     void               err_occured  (int);
 
 private:
-    static int SDLCALL demux_thread (void *args);
+    static int         demux_proc   (void *args);
+
+private:
+    int                read_packet  ();
+    int                splice       ();
 
 public:
-    int                init         ();
+    int                init         (TaskPool *pool, int session);
     void               close        ();
+    int                reset        (AVFormatContext *avfctx, int vst_idx, int ast_idx);
+    int                stage        (AVFormatContext *avfctx, int vst_idx, int ast_idx);
+    bool               unstage      ();
+    bool               is_staged    ();
+    int                get_serial   () const;
     void               start        ();
     void               pause        ();
     int                seek         (double pos);
+    bool               is_eof       ();
+    void               wake         ();
+    StageStats *       get_stats    ();
+    void               set_budget   (Budget *budget);
 
 public:
     Demux                           (AVFormatContext *avfctx, 
                                      PacketQueue *vpktq, PacketQueue *apktq,
-                                     SDL_mutex *wait_mutex, SDL_cond *continue_read_cond,
+                                     SDL_mutex *wait_mutex,
                                      int vst_idx, int ast_idx,
                                      bool infinite_buf, int max_pktq_size);
     ~Demux                          ();
@@ -0,0 +1,839 @@
+#include <cstring>
+#include <cmath>
+#include <new>
+#include <QObject>
+#include "engine.h"
+#include "error/error.h"
+#include "log/log.h"
+#include "utils/utils.h"
+#include "trace/trace.h"
+#include "lock/lock.h"
+#include "mem/mem.h"
+
+extern "C"
+{
+#include "libavformat/avformat.h"
+#include "libavutil/time.h"
+#include "SDL2/SDL.h"
+}
+
+#define FILENAME "engine.cpp"
+
+/* components shared by the players and the engines of the process */
+static SDL_SpinLock global_lock = 0;
+static int          global_refs = 0; // players and engines inited
+static TaskPool     global_pool;     // runs demux, decoder and video refresh tasks of all players
+
+int engine_global_init (Uint32 sdl_flags, TaskPool **pool)
+{
+    int ret = 0;
+
+    SDL_AtomicLock(&global_lock);
+
+    /* init SDL, the subsystems are counted by SDL */
+    ret = SDL_InitSubSystem(sdl_flags);
+    if (ret < 0) {
+        logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KESDL_INIT_FAIL), SDL_GetError());
+        ret = KERROR(KESDL_INIT_FAIL);
+    } else if (!global_refs) {
+        /* init FFmpeg components */
+        av_register_all();
+        avformat_network_init();
+
+        /* init task pool, a thread for a core */
+        if (global_pool.init(0) < 0) {
+            logger.FATALN("[%s: %d]%s.\n", kerr2str(KEPOOL_INIT_FAIL));
+            avformat_network_deinit();
+            SDL_Quit();
+            ret = KERROR(KEPOOL_INIT_FAIL);
+        }
+    }
+    if (!ret) {
+        global_refs++;
+        if (pool)
+            *pool = &global_pool;
+    }
+    SDL_AtomicUnlock(&global_lock);
+
+    return ret;
+}
+
+void engine_global_deinit (Uint32 sdl_flags)
+{
+    SDL_AtomicLock(&global_lock);
+    if (global_refs) {
+        SDL_QuitSubSystem(sdl_flags);
+        if (!--global_refs) {
+            /* the last player or engine closed */
+            global_pool.close();
+            if (lock_is_profiled())
+                lock_report(NULL);
+            SDL_Quit();
+            avformat_network_deinit();
+        }
+    }
+    SDL_AtomicUnlock(&global_lock);
+}
+
+int Engine::interrupt_cb (void *args)
+{
+    Engine *e = (Engine *)args;
+
+    return SDL_AtomicGet(&e->abort_req);
+}
+
+int Engine::init (EngineParams *params)
+{
+    int ret;
+
+    if (inited)
+        return KERROR(KEREINIT);
+    if (params)
+        this->params = *params;
+    if (this->params.width <= 0 || this->params.height <= 0) {
+        this->params.width = ENGINE_DEF_WIDTH;
+        this->params.height = ENGINE_DEF_HEIGHT;
+    }
+
+    /* the sinks need no SDL device */
+    ret = engine_global_init(0, &pool);
+    if (ret < 0) {
+        pool = NULL;
+        return ret;
+    }
+
+    /* open a session, served in turn with the players */
+    session = pool->open_session();
+    if (session < 0) {
+        logger.FATALN("[%s: %d]%s.\n", kerr2str(-session));
+        ret = session;
+        goto fail;
+    }
+
+    /* create offscreen video sink */
+    if (ENGINE_VSINK_OFFSCREEN == this->params.vsink) {
+        surface = SDL_CreateRGBSurfaceWithFormat(0, this->params.width, this->params.height,
+                                                 32, SDL_PIXELFORMAT_ARGB8888);
+        if (!surface) {
+            logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_SURFACE_FAIL), SDL_GetError());
+            GOTO_FAIL(KECREATE_SDL_SURFACE_FAIL);
+        }
+        sdl_renderer = SDL_CreateSoftwareRenderer(surface);
+        if (!sdl_renderer) {
+            logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_RENDERER_FAIL), SDL_GetError());
+            GOTO_FAIL(KECREATE_SDL_RENDERER_FAIL);
+        }
+    }
+
+    inited = true;
+    KLOGD("Engine has been inited.\n");
+
+    return 0;
+fail:
+    close();
+    return ret;
+}
+
+void Engine::close ()
+{
+    if (!pool)
+        return;
+
+    close_media();
+
+    /* destroy sinks */
+    if (sdl_renderer)
+        SDL_DestroyRenderer(sdl_renderer);
+    if (surface)
+        SDL_FreeSurface(surface);
+    sdl_renderer = NULL;
+    surface = NULL;
+
+    /* close the session, FFmpeg and SDL are deinited with the last reference */
+    if (session >= 0)
+        pool->close_session(session);
+    engine_global_deinit(0);
+    pool = NULL;
+    session = -1;
+    inited = false;
+
+    KLOGD("Engine closed.\n");
+}
+
+int Engine::open (const char *url)
+{
+    int ret;
+
+    if (!inited)
+        return KERROR(KEUNINITED);
+    if (!url)
+        return KERROR(KEINVAL);
+    if (avfctx)
+        return KERROR(KEREINIT);
+
+    SDL_AtomicSet(&abort_req, 0);
+    SDL_AtomicSet(&err_code, 0);
+
+    /* open input file */
+    avfctx = avformat_alloc_context();
+    if (!avfctx)
+        return KERROR(KENOMEM);
+    avfctx->interrupt_callback.callback = interrupt_cb;
+    avfctx->interrupt_callback.opaque = this;
+    ret = avformat_open_input(&avfctx, url, NULL, NULL);
+    if (ret < 0) {
+        logger.error("%s %s: %s.\n", kerr2str(KEOPEN_INPUT_FAIL), url, av_err2str(ret));
+        GOTO_FAIL(KEOPEN_INPUT_FAIL);
+    }
+
+    /* find stream info */
+    ret = avformat_find_stream_info(avfctx, NULL);
+    if (ret < 0) {
+        logger.error("%s: %s.\n", kerr2str(KEFIND_STREAM_INFO_FAIL), av_err2str(ret));
+        GOTO_FAIL(KEFIND_STREAM_INFO_FAIL);
+    }
+
+    /* find streams */
+    vst_idx = params.no_video ? -1 : av_find_best_stream(avfctx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    ast_idx = params.no_audio ? -1 : av_find_best_stream(avfctx, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0);
+    if (vst_idx < 0 && ast_idx < 0) {
+        logger.error("%s.\n", kerr2str(KENOAVST));
+        GOTO_FAIL(KENOAVST);
+    }
+    vst = vst_idx >= 0 ? avfctx->streams[vst_idx] : NULL;
+    ast = ast_idx >= 0 ? avfctx->streams[ast_idx] : NULL;
+    start_time = AV_NOPTS_VALUE == avfctx->start_time ? 0.0 : avfctx->start_time / (double)AV_TIME_BASE;
+    max_frame_duration = (avfctx->iformat->flags & AVFMT_TS_DISCONT) ? 10.0 : 3600.0;
+
+    /* build pipeline, demux and decoders start at once */
+    ret = init_pipeline();
+    if (ret < 0)
+        goto fail;
+
+    logger.info("File %s is open.\n", url);
+    return 0;
+fail:
+    if (SDL_AtomicGet(&abort_req))
+        ret = KERROR(KEABORTED);
+    close_media();
+    return ret;
+}
+
+int Engine::init_pipeline ()
+{
+    AudioParams   ap_src;
+    AudioParams   ap_tgt;
+    BudgetStreams streams;
+    BudgetPlan    plan;
+    int           ret;
+
+    /* create mutex */
+    wait_mutex = mutex_create("engine wait_mutex");
+    if (!wait_mutex) {
+        logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_MUTEX_FAIL), SDL_GetError());
+        return KERROR(KECREATE_SDL_MUTEX_FAIL);
+    }
+
+    /* size the queues from the share of the memory budget */
+    budget_join(&budget, params.mem_budget);
+    budget_fill_streams(&streams, avfctx, vst, ast);
+    budget_plan(budget_get_share(&budget), &streams, &plan);
+
+    /* init queues */
+    if (vst) {
+        vpktq = _New PacketQueue();
+        vfq = _New FrameQueue();
+        if (!vpktq || !vfq)
+            return KERROR(KENOMEM);
+        if (vpktq->init(&mem) < 0 || vfq->init(vpktq, plan.pictq_len) < 0)
+            return KERROR(KEQUEUE_INIT_FAIL);
+    }
+    if (ast) {
+        apktq = _New PacketQueue();
+        afq = _New FrameQueue();
+        if (!apktq || !afq)
+            return KERROR(KENOMEM);
+        if (apktq->init(&mem) < 0 || afq->init(apktq, plan.sampleq_len) < 0)
+            return KERROR(KEQUEUE_INIT_FAIL);
+    }
+
+    /* init demux, the failures of the tasks are picked up by run() */
+    demux = _New Demux(avfctx, vpktq, apktq, wait_mutex,
+                       vst_idx, ast_idx, false, (int)plan.pktq_size);
+    if (!demux)
+        return KERROR(KENOMEM);
+    demux->set_budget(&budget);
+    QObject::connect(demux, &Demux::err_occured, [this] (int err) { SDL_AtomicCAS(&err_code, 0, err); });
+    ret = demux->init(pool, session);
+    if (ret < 0) {
+        logger.FATALN("[%s: %d]%s.\n", kerr2str(KEDEMUX_INIT_FAIL));
+        return KERROR(KEDEMUX_INIT_FAIL);
+    }
+
+    /* init decoders */
+    ret = 0;
+    if (vst) {
+        vdec = _New Decoder(avfctx, vst_idx, vpktq, vfq);
+        if (!vdec)
+            return KERROR(KENOMEM);
+        QObject::connect(vdec, &Decoder::err_occured, [this] (int err) { SDL_AtomicCAS(&err_code, 0, err); });
+        vclk.set(start_time);
+        ret = vdec->init(vclk, pool, session);
+    }
+    if (!ret && ast) {
+        adec = _New Decoder(avfctx, ast_idx, apktq, afq);
+        if (!adec)
+            return KERROR(KENOMEM);
+        QObject::connect(adec, &Decoder::err_occured, [this] (int err) { SDL_AtomicCAS(&err_code, 0, err); });
+        ret = adec->init(vclk, pool, session);
+    }
+    if (ret < 0) {
+        logger.FATALN("[%s: %d]%s.\n", kerr2str(KEDECODER_INIT_FAIL));
+        return KERROR(KEDECODER_INIT_FAIL);
+    }
+
+    /* init render, no sws is needed by the null video sink */
+    render = _New Render(sdl_renderer, vfq, afq, NULL, NULL);
+    if (!render)
+        return KERROR(KENOMEM);
+    if (vst)
+        render->init_vrender();
+    if (ast) {
+        /* the null audio sink takes S16 samples of the source layout and rate */
+        ret = get_audio_params(&ap_src);
+        if (ret < 0)
+            return ret;
+        ap_tgt = ap_src;
+        ap_tgt.channel_layout = av_get_default_channel_layout(ap_src.channels);
+        ap_tgt.sample_fmt = AV_SAMPLE_FMT_S16;
+        ret = render->init_arender(ap_src, ap_tgt);
+        if (ret < 0) {
+            logger.FATALN("[%s: %d]%s.\n", kerr2str(KERENDER_INIT_FAIL));
+            return KERROR(KERENDER_INIT_FAIL);
+        }
+        /* resample() takes up to twice nb_samples for a frame */
+        sample_buf_size = av_samples_get_buffer_size(NULL,
+                                                     ap_tgt.channels,
+                                                     ap_tgt.nb_samples * 2,
+                                                     ap_tgt.sample_fmt,
+                                                     1);
+        sample_buf.buf = (Uint8 *)av_mallocz((size_t)sample_buf_size);
+        if (!sample_buf.buf)
+            return KERROR(KENOMEM);
+        mem_add(&mem, MEM_SAMPLES, 1, sample_buf_size);
+        sample_buf.pos = NULL;
+        sample_buf.size = 0;
+        sample_rate = ap_tgt.sample_rate;
+    }
+
+    return 0;
+}
+
+int Engine::get_audio_params (AudioParams *ap_src)
+{
+    Frame *af = NULL;
+
+    /* wait for the first audio frame to be decoded, cancellable */
+    while (!af && !SDL_AtomicGet(&abort_req) && !SDL_AtomicGet(&err_code)) {
+        af = afq->peek_timeout(ENGINE_POLL_INTERVAL);
+        if (!af && afq->is_eof())
+            break;
+    }
+    if (!af)
+        return SDL_AtomicGet(&abort_req) ? KERROR(KEABORTED) : KERROR(KENO_FIRST_FRAME);
+
+    ap_src->channels = af->frame->channels;
+    ap_src->channel_layout = af->frame->channel_layout <= 0 ?
+                             av_get_default_channel_layout(ap_src->channels) :
+                             af->frame->channel_layout;
+    ap_src->nb_samples = af->frame->nb_samples;
+    ap_src->sample_fmt = (AVSampleFormat)af->frame->format;
+    ap_src->sample_rate = af->frame->sample_rate;
+
+    return 0;
+}
+
+void Engine::close_pipeline ()
+{
+    /* pause decoders, the tasks blocked on the queues return */
+    if (vdec)
+        vdec->pause();
+    if (adec)
+        adec->pause();
+
+    /* close render */
+    if (render) {
+        render->close_vrender();
+        render->close_arender();
+        delete render;
+        render = NULL;
+    }
+    if (sample_buf.buf)
+        mem_add(&mem, MEM_SAMPLES, -1, -sample_buf_size);
+    av_freep(&sample_buf.buf);
+    sample_buf.pos = NULL;
+    sample_buf.size = 0;
+
+    /* close decoders */
+    if (vdec) {
+        vdec->close();
+        delete vdec;
+        vdec = NULL;
+    }
+    if (adec) {
+        adec->close();
+        delete adec;
+        adec = NULL;
+    }
+
+    /* close demux */
+    if (demux)
+        demux->close();
+    delete demux;
+    demux = NULL;
+
+    /* clear queues */
+    delete vfq;
+    delete afq;
+    delete vpktq;
+    delete apktq;
+    vfq = afq = NULL;
+    vpktq = apktq = NULL;
+
+    /* destroy mutex */
+    if (wait_mutex)
+        mutex_destroy(wait_mutex);
+    wait_mutex = NULL;
+    budget_leave(&budget);
+}
+
+void Engine::close_media ()
+{
+    if (!avfctx)
+        return;
+
+    close_pipeline();
+#ifdef _DEBUG
+    mem_check_leaks(&mem, MEM_ALL_KINDS, "Engine closed the media");
+#endif /* _DEBUG */
+    avformat_close_input(&avfctx);
+    vst_idx = ast_idx = -1;
+    vst = ast = NULL;
+}
+
+double Engine::get_master_clock (int64_t now)
+{
+    /* the audio sink leads, the samples consumed ahead are not played yet */
+    if (astarted) {
+        if (ENGINE_MODE_FAST == params.mode)
+            return aend_pts;
+
+        double buffered = awritten - (now - abase_time) / (double)AV_TIME_BASE;
+        if (buffered < 0.0 && !aeof) // the sink ran dry, the clock holds
+            buffered = 0.0;
+        return aend_pts - buffered;
+    }
+
+    /* no audio, the wall clock leads */
+    if (vstarted && ENGINE_MODE_FAST != params.mode)
+        return (now - vbase_time) / (double)AV_TIME_BASE;
+
+    return vclk.get();
+}
+
+int Engine::audio_refresh (int64_t now, int64_t *wake)
+{
+    Frame *af;
+    Frame *vf;
+    double played = 0.0;
+    double apos;
+    int    ret;
+    TRACE_SCOPE("audio_refresh");
+
+    if (ENGINE_MODE_FAST != params.mode) {
+        /* the sink keeps no more than ENGINE_AUDIO_LATENCY ahead of the device */
+        if (astarted) {
+            played = (now - abase_time) / (double)AV_TIME_BASE;
+            if (awritten - played >= ENGINE_AUDIO_LATENCY) {
+                *wake = FFMIN(*wake, abase_time + (int64_t)((awritten - ENGINE_AUDIO_LATENCY) * AV_TIME_BASE));
+                return 0;
+            }
+        }
+    }
+
+    /* get an audio frame, unblocked */
+    af = afq->peek_timeout(0);
+    if (!af) {
+        if (afq->is_eof())
+            aeof = true;
+        return 0;
+    }
+
+    /* as fast as possible, the frames of both streams are taken in pts order */
+    if (ENGINE_MODE_FAST == params.mode && vst && !veof) {
+        vf = vfq->peek_timeout(0);
+        if (vf && vf->pts < af->pts)
+            return 0;
+    }
+
+    if (ENGINE_MODE_FAST != params.mode) {
+        if (!astarted) {
+            abase_time = now;
+        } else if (awritten < played) { // the device played silence in the gap
+            abase_time = now - (int64_t)(awritten * AV_TIME_BASE);
+            stats.underruns++;
+        }
+    }
+    astarted = true;
+
+    /* resample */
+    af = afq->get();
+    ret = render->resample(af->frame, &sample_buf);
+    if (ret < 0) {
+        logger.FATALN("[%s: %d]%s.\n", kerr2str(KERESAMPLE_FAIL));
+        mem_frame_free(&mem, &af->frame);
+        delete af;
+        return KERROR(KERESAMPLE_FAIL);
+    }
+
+    /* the samples are output after the ones written before */
+    apos = awritten;
+    if (probe)
+        probe->add_audio((const int16_t *)sample_buf.buf, ret, render->get_ap_tgt().channels, sample_rate,
+                         af->pts, ENGINE_MODE_FAST == params.mode ? now : abase_time + (int64_t)(apos * AV_TIME_BASE));
+
+    /* the samples are consumed by the sink at once */
+    awritten += ret / (double)sample_rate;
+    aend_pts = af->pts + ret / (double)sample_rate;
+    sample_buf.pos = NULL;
+    sample_buf.size = 0;
+    stats.aframes++;
+    stats.samples += ret;
+    stats.media_time = FFMAX(stats.media_time, aend_pts - start_time);
+    mem_frame_free(&mem, &af->frame);
+    delete af;
+
+    return 1;
+}
+
+int Engine::video_refresh (int64_t now, int64_t *wake)
+{
+    Frame *vf;
+    Frame *af;
+    double clock;
+    double diff;
+    double duration;
+    int    ret;
+
+    /* get a video frame, unblocked */
+    vf = vfq->peek_timeout(0);
+    if (!vf) {
+        if (vfq->is_eof())
+            veof = true;
+        return 0;
+    }
+
+    if (ENGINE_MODE_FAST == params.mode) {
+        /* as fast as possible, the frames of both streams are taken in pts order */
+        if (ast && !aeof) {
+            af = afq->peek_timeout(0);
+            if (af && af->pts < vf->pts)
+                return 0;
+        }
+        clock = get_master_clock(now);
+    } else if (ENGINE_MODE_PLAYER == params.mode) {
+        /* the last frame is kept for its delay */
+        if (now < vrefresh_time) {
+            *wake = FFMIN(*wake, vrefresh_time);
+            return 0;
+        }
+        if (!astarted && !vstarted) {
+            vbase_time = now - (int64_t)(vf->pts * AV_TIME_BASE);
+            vstarted = true;
+        }
+
+        /* the duration of the last frame corrected by the clocks, as the player does */
+        diff = vf->pts - last_vpts;
+        duration = std::isnan(last_vpts) ? 0.0
+                   : (std::isnan(diff) || diff <= 0.0 || diff > max_frame_duration) ? last_vduration : diff;
+        clock = get_master_clock(now);
+        diff = compute_sync_delay(duration, vclk.get(), clock, max_frame_duration, params.frame_drop);
+        if (diff < 0.0) {
+            vf = vfq->get();
+            vclk.set(vf->pts);
+            last_vpts = vf->pts;
+            last_vduration = vf->duration;
+            stats.vframes++;
+            stats.dropped++;
+            mem_frame_free(&mem, &vf->frame);
+            delete vf;
+            KLOGV("frame drop.\n");
+            return 1;
+        }
+        vrefresh_time = now + (int64_t)(diff * AV_TIME_BASE);
+    } else {
+        /* the clock is unknown until the audio starts */
+        if (ast && !astarted && !aeof)
+            return 0;
+        if (!astarted && !vstarted) {
+            vbase_time = now - (int64_t)(vf->pts * AV_TIME_BASE);
+            vstarted = true;
+        }
+
+        /* not the time to present it */
+        clock = get_master_clock(now);
+        diff = vf->pts - clock;
+        if (diff > 0.0) {
+            *wake = FFMIN(*wake, now + (int64_t)(diff * AV_TIME_BASE));
+            return 0;
+        }
+
+        /* too late, drop it if the next one is decoded */
+        if (params.frame_drop && -diff > AV_SYNC_FRAMEDROP_THRESHOLD && vfq->get_len() > 1) {
+            vf = vfq->get();
+            vclk.set(vf->pts);
+            stats.vframes++;
+            stats.dropped++;
+            mem_frame_free(&mem, &vf->frame);
+            delete vf;
+            KLOGV("frame drop.\n");
+            return 1;
+        }
+    }
+
+    /* present */
+    vf = vfq->get();
+    ret = present(vf);
+    if (ret < 0) {
+        mem_frame_free(&mem, &vf->frame);
+        delete vf;
+        return ret;
+    }
+
+    if (probe)
+        probe->add_video(vf->frame, vf->pts, now);
+
+    /* A-V drift, the audio clock is known only while the audio is playing */
+    if (astarted && !aeof) {
+        diff = fabs(clock - vf->pts);
+        stats.drift_avg += diff;
+        stats.drift_max = FFMAX(stats.drift_max, diff);
+        stats.drift_count++;
+    }
+    vclk.set(vf->pts);
+    last_vpts = vf->pts;
+    last_vduration = vf->duration;
+    stats.vframes++;
+    stats.media_time = FFMAX(stats.media_time, vf->pts - start_time);
+    mem_frame_free(&mem, &vf->frame);
+    delete vf;
+
+    return 1;
+}
+
+int Engine::present (Frame *vf)
+{
+    SDL_Texture *texture = NULL;
+    SDL_Rect     rect;
+    double       aspect_ratio;
+    int          ret;
+
+    if (ENGINE_VSINK_OFFSCREEN == params.vsink && vf->frame->width && vf->frame->height) {
+        /* render a frame */
+        ret = render->render_video_frame(vf, &texture);
+        if (ret < 0) {
+            logger.FATALN("[%s: %d]%s.\n", kerr2str(KERENDER_FRAME_FAIL));
+            return KERROR(KERENDER_FRAME_FAIL);
+        }
+
+        /* fit the surface, keeping the aspect ratio */
+        aspect_ratio = vf->frame->sample_aspect_ratio.num ? av_q2d(vf->frame->sample_aspect_ratio) : 1.0;
+        aspect_ratio *= (double)vf->frame->width / (double)vf->frame->height;
+        rect.h = params.height;
+        rect.w = (int)lrint(rect.h * aspect_ratio) & ~1;
+        if (rect.w > params.width) {
+            rect.w = params.width;
+            rect.h = (int)lrint(rect.w / aspect_ratio) & ~1;
+        }
+        rect.x = (params.width - rect.w) / 2;
+        rect.y = (params.height - rect.h) / 2;
+        rect.w = FFMAX(rect.w, 1);
+        rect.h = FFMAX(rect.h, 1);
+
+        /* draw into the surface */
+        SDL_SetRenderDrawColor(sdl_renderer, 0, 0, 0, 255);
+        SDL_RenderClear(sdl_renderer);
+        if (texture && SDL_RenderCopy(sdl_renderer, texture, NULL, &rect) < 0) {
+            logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KEUPLOAD_TEXTURE_FAIL), SDL_GetError());
+            return KERROR(KEUPLOAD_TEXTURE_FAIL);
+        }
+        SDL_RenderPresent(sdl_renderer);
+    }
+    stats.rendered++;
+
+    return 0;
+}
+
+void Engine::wait (int64_t now, int64_t wake)
+{
+    int64_t remain = FFMIN(wake - now, (int64_t)ENGINE_POLL_INTERVAL * 1000);
+
+    if (remain <= 0)
+        return;
+
+    /* woken early by a frame put to the empty queue */
+    if (remain >= 1000 && vst && !veof && !vfq->get_len())
+        vfq->peek_timeout((int)(remain / 1000));
+    else if (remain >= 1000 && ast && !aeof && !afq->get_len())
+        afq->peek_timeout((int)(remain / 1000));
+    else
+        av_usleep((unsigned)remain);
+}
+
+int Engine::run ()
+{
+    int64_t  start;
+    int64_t  now;
+    int64_t  wake;
+    double   cpu_start;
+    int      progressed;
+    MemUsage usage;
+    int      ret = 0;
+
+    if (!avfctx)
+        return KERROR(KEUNINITED);
+
+    /* reset clocks and statistics */
+    memset(&stats, 0, sizeof(EngineStats));
+    veof = !vst;
+    aeof = !ast;
+    astarted = vstarted = false;
+    awritten = 0.0;
+    aend_pts = start_time;
+    vclk.set(start_time);
+    vrefresh_time = 0;
+    last_vpts = NAN;
+    last_vduration = 0.0;
+    cpu_start = get_cpu_time();
+    start = av_gettime();
+
+    KLOGD("Engine running.\n");
+    while (!SDL_AtomicGet(&abort_req) && (!veof || !aeof)) {
+        /* a task failed */
+        ret = SDL_AtomicGet(&err_code);
+        if (ret < 0)
+            break;
+
+        /* the media time limit is reached */
+        if (params.max_time > 0.0 && stats.media_time >= params.max_time)
+            break;
+
+        now = av_gettime();
+        wake = now + (int64_t)ENGINE_POLL_INTERVAL * 1000;
+        progressed = 0;
+        if (!aeof) {
+            ret = audio_refresh(now, &wake);
+            if (ret < 0)
+                break;
+            progressed += ret;
+        }
+        if (!veof) {
+            ret = video_refresh(now, &wake);
+            if (ret < 0)
+                break;
+            progressed += ret;
+        }
+        ret = 0;
+
+        /* sleep until a frame is due, decoded or the sink runs low */
+        if (!progressed)
+            wait(now, wake);
+    }
+    if (!ret && SDL_AtomicGet(&abort_req))
+        ret = KERROR(KEABORTED);
+
+    /* summarize */
+    stats.elapsed = (av_gettime() - start) / (double)AV_TIME_BASE;
+    stats.cpu_time = get_cpu_time() - cpu_start;
+    stats.peak_rss = get_peak_rss();
+    mem_get_usage(&mem, &usage);
+    stats.peak_mem = usage.peak;
+    if (stats.drift_count)
+        stats.drift_avg /= stats.drift_count;
+    KLOGD("Engine stopped: %s.\n", ret < 0 ? kerr2str(-ret) : "play over");
+
+    return ret;
+}
+
+void Engine::abort ()
+{
+    SDL_AtomicSet(&abort_req, 1);
+}
+
+void Engine::get_stats (EngineStats *stats) const
+{
+    if (stats)
+        *stats = this->stats;
+}
+
+double Engine::get_duration () const
+{
+    if (!avfctx || avfctx->duration <= 0)
+        return 0.0;
+
+    return avfctx->duration / (double)AV_TIME_BASE;
+}
+
+void Engine::set_sync_probe (SyncProbe *probe)
+{
+    this->probe = probe;
+}
+
+Engine::Engine ()
+{
+    memset(&params, 0, sizeof(EngineParams));
+    params.vsink = ENGINE_VSINK_NULL;
+    params.asink = ENGINE_ASINK_NULL;
+    params.mode = ENGINE_MODE_FAST;
+    params.width = ENGINE_DEF_WIDTH;
+    params.height = ENGINE_DEF_HEIGHT;
+    inited = false;
+    pool = NULL;
+    session = -1;
+    avfctx = NULL;
+    vst_idx = ast_idx = -1;
+    vst = ast = NULL;
+    start_time = 0.0;
+    vpktq = apktq = NULL;
+    vfq = afq = NULL;
+    demux = NULL;
+    vdec = adec = NULL;
+    render = NULL;
+    wait_mutex = NULL;
+    surface = NULL;
+    sdl_renderer = NULL;
+    sample_buf.buf = sample_buf.pos = NULL;
+    sample_buf.size = 0;
+    sample_buf_size = 0;
+    sample_rate = 0;
+    mem_stats_reset(&mem);
+    memset(&budget, 0, sizeof(Budget));
+    astarted = vstarted = false;
+    abase_time = vbase_time = 0;
+    vrefresh_time = 0;
+    last_vpts = NAN;
+    last_vduration = 0.0;
+    max_frame_duration = 3600.0;
+    probe = NULL;
+    awritten = aend_pts = 0.0;
+    veof = aeof = true;
+    SDL_AtomicSet(&abort_req, 0);
+    SDL_AtomicSet(&err_code, 0);
+    memset(&stats, 0, sizeof(EngineStats));
+}
+
+Engine::~Engine ()
+{
+    if (pool)
+        close();
+}
@@ -0,0 +1,181 @@
+#ifndef _AVPLAYERWIDGET_ENGINE_H_
+#define _AVPLAYERWIDGET_ENGINE_H_
+
+#include "avplayerwidget_global.h"
+#include "decoder/decoder.h"
+#include "demux/demux.h"
+#include "render/render.h"
+#include "queue/packet_queue.h"
+#include "queue/frame_queue.h"
+#include "clock/clock.h"
+#include "pool/pool.h"
+#include "syncprobe/syncprobe.h"
+#include "mem/mem.h"
+#include "budget/budget.h"
+
+extern "C"
+{
+#include "libavformat/avformat.h"
+#include "SDL2/SDL.h"
+}
+
+/* video sinks */
+#define ENGINE_VSINK_NULL       0 // frames are synced and counted, never drawn
+#define ENGINE_VSINK_OFFSCREEN  1 // frames are drawn by a software renderer into a surface
+
+/* audio sinks */
+#define ENGINE_ASINK_NULL       0 // samples are resampled and consumed at the rate of a device
+
+/* clock modes */
+#define ENGINE_MODE_REALTIME    0 // frames are presented on time, late ones may be dropped
+#define ENGINE_MODE_FAST        1 // frames are presented as soon as decoded
+#define ENGINE_MODE_PLAYER      2 // frames are scheduled by the delay of the player, see compute_sync_delay()
+
+/* default size of the offscreen surface */
+#define ENGINE_DEF_WIDTH        640
+#define ENGINE_DEF_HEIGHT       360
+
+/* samples buffered by the null audio sink (unit: second) */
+#define ENGINE_AUDIO_LATENCY    0.04
+
+/* max time to sleep in a loop of run() (unit: millisecond) */
+#define ENGINE_POLL_INTERVAL    10
+
+/* engine params */
+typedef struct EngineParams {
+    int              vsink;      // ENGINE_VSINK_*
+    int              asink;      // ENGINE_ASINK_*
+    int              mode;       // ENGINE_MODE_*
+    bool             frame_drop; // drop the late video frames in realtime mode
+    bool             no_video;   // ignore the video stream
+    bool             no_audio;   // ignore the audio stream
+    int              width;      // size of the offscreen surface
+    int              height;
+    double           max_time;   // stop after so much media time, 0 for the whole file (unit: second)
+    int64_t          mem_budget; // the queues are sized to it, 0 for the default (unit: byte)
+}EngineParams;
+
+/* playback statistics */
+typedef struct EngineStats {
+    int64_t          vframes;    // video frames taken from the frame queue
+    int64_t          rendered;   // video frames presented by the sink
+    int64_t          dropped;    // video frames dropped for being late
+    int64_t          aframes;    // audio frames taken from the frame queue
+    int64_t          samples;    // samples consumed by the sink
+    int64_t          underruns;  // times the audio sink ran dry
+    double           elapsed;    // wall time of run() (unit: second)
+    double           media_time; // media time played (unit: second)
+    double           drift_avg;  // average |A-V| of the presented frames (unit: second)
+    double           drift_max;  // max |A-V| of the presented frames (unit: second)
+    int64_t          drift_count;
+    double           cpu_time;   // user and system time of the process in run() (unit: second)
+    int64_t          peak_rss;   // peak resident set size of the process (unit: byte)
+    int64_t          peak_mem;   // peak of the packets, frames and buffers of the session (unit: byte)
+}EngineStats;
+
+/*
+* FFmpeg, SDL and the task pool are shared by the players and the engines of the process,
+* the SDL subsystems in sdl_flags are inited and quit with every reference
+*/
+int        engine_global_init   (Uint32 sdl_flags, TaskPool **pool);
+void       engine_global_deinit (Uint32 sdl_flags);
+
+/*
+* the pipeline of the player without Qt widgets,
+* demux and decoders run on the shared task pool, run() presents the frames to the sinks
+*/
+class AVPLAYERWIDGET_EXPORT Engine {
+private:
+    /* params */
+    EngineParams     params;
+    bool             inited;
+
+    /* task pool */
+    TaskPool *       pool;
+    int              session;
+
+    /* context */
+    AVFormatContext *avfctx;
+    int              vst_idx;
+    int              ast_idx;
+    AVStream *       vst;
+    AVStream *       ast;
+    double           start_time;
+
+    /* queues */
+    PacketQueue *    vpktq;
+    PacketQueue *    apktq;
+    FrameQueue *     vfq;
+    FrameQueue *     afq;
+
+    /* pipeline */
+    Demux *          demux;
+    Decoder *        vdec;
+    Decoder *        adec;
+    Render *         render;
+    SDL_mutex *      wait_mutex; // protects the staged file of demux
+
+    /* offscreen video sink */
+    SDL_Surface *    surface;
+    SDL_Renderer *   sdl_renderer;
+
+    /* null audio sink */
+    SampleBuf        sample_buf;
+    int              sample_buf_size;
+    int              sample_rate;
+    bool             astarted;
+    int64_t          abase_time; // wall time the sink started at, moved on underruns (unit: microsecond)
+    double           awritten;   // duration of the consumed samples (unit: second)
+    double           aend_pts;   // pts of the end of the consumed samples (unit: second)
+
+    /* video */
+    bool             vstarted;
+    int64_t          vbase_time; // wall time of pts 0 without audio (unit: microsecond)
+    Clock            vclk;
+    int64_t          vrefresh_time;      // the last frame is kept until then in player mode (unit: microsecond)
+    double           last_vpts;          // pts of the last video frame, NAN if none
+    double           last_vduration;
+    double           max_frame_duration; // a pts gap above is a discontinuity (unit: second)
+
+    /* A-V sync measurement */
+    SyncProbe *      probe;
+
+    /* state */
+    bool             veof;       // all video frames are taken
+    bool             aeof;       // all audio frames are taken
+    SDL_atomic_t     abort_req;  // set by abort() from any thread or a signal handler
+    SDL_atomic_t     err_code;   // set by the tasks on failure
+    EngineStats      stats;
+    MemStats         mem;        // checked for leaks when the media is closed in the debug builds
+    Budget           budget;     // joined while the pipeline exists
+
+private:
+    static int       interrupt_cb   (void *args);
+
+private:
+    int              init_pipeline  ();
+    void             close_pipeline ();
+    int              get_audio_params (AudioParams *ap_src);
+    double           get_master_clock (int64_t now);
+    int              audio_refresh  (int64_t now, int64_t *wake);
+    int              video_refresh  (int64_t now, int64_t *wake);
+    int              present        (Frame *vf);
+    void             wait           (int64_t now, int64_t wake);
+
+public:
+    int              init           (EngineParams *params); // default params if NULL
+    void             close          ();
+    int              open           (const char *url);
+    void             close_media    ();
+    int              run            ();
+    void             abort          (); // lock-free, safe in a signal handler
+    void             get_stats      (EngineStats *stats) const;
+    double           get_duration   () const;
+    void             set_sync_probe (SyncProbe *probe); // fed by run(), NULL to detach
+
+public:
+    Engine                          ();
+    ~Engine                         ();
+};
+
+#endif /* _AVPLAYERWIDGET_ENGINE_H_ */
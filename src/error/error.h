@@ -27,7 +27,7 @@
 #define KEEOF                           0x06
 #define KEABORTED                       0x07
 #define KEPLAY_OVER                     0x08
-#define KEUNDEF6                        0x09
+#define KETIMEDOUT                      0x09
 #define KEUNDEF5                        0x0A
 #define KEUNDEF4                        0x0B
 #define KEUNDEF3                        0x0C
@@ -87,15 +87,15 @@
 #define KERENDER_MSG_FAIL               0x42
 #define KENO_FIRST_FRAME                0x43
 #define KELOG_FILE_OPEN_FAIL            0x44
-#define KEUNDEF17                       0x45
-#define KEUNDEF16                       0x46
-#define KEUNDEF15                       0x47
-#define KEUNDEF14                       0x48
-#define KEUNDEF13                       0x49
-#define KEUNDEF12                       0x4A
-#define KEUNDEF11                       0x4B
-#define KEUNDEF10                       0x4C
-#define KEUNDEF9                        0x4D
+#define KEPOOL_INIT_FAIL                0x45
+#define KEPOOL_SESSION_FULL             0x46
+#define KEAVCODEC_FIND_ENCODER_FAIL     0x47
+#define KEOPEN_ENCODER_FAIL             0x48
+#define KEWRITE_MEDIA_FILE_FAIL         0x49
+#define KENO_SYNC_MARK                  0x4A
+#define KETRACE_FILE_WRITE_FAIL         0x4B
+#define KEPLAYLIST_OPEN_FAIL            0x4C
+#define KEPLAYLIST_WRITE_FAIL           0x4D
 #define KEUNDEF8                        0x4E
 #define KEUNDEF7                        0x4F
 
@@ -113,11 +113,11 @@ static const char *err_string_map[] = {
     "try again",                            // KEAGAIN                         
     "invalid arguments",                    // KEINVAL                         
     "the component is uninited",            // KEUNINITED                      
-    "the component have been inited"        // KEREINIT
+    "the component have been inited",       // KEREINIT
     "end of file",                          // KEEOF
     "aborteded",                            // KEABORTED
     "play over",                            // KEPLAY_OVER
-    "undefined error code",                 // KEUNDEF6                        
+    "timed out",                            // KETIMEDOUT
     "undefined error code",                 // KEUNDEF5                        
     "undefined error code",                 // KEUNDEF4                        
     "undefined error code",                 // KEUNDEF3                        
@@ -177,15 +177,15 @@ static const char *err_string_map[] = {
     "render msg failed",                    // KERENDER_MSG_FAIL
     "no first frame",                       // KENO_FIRST_FRAME
     "log file open failed",                 // KELOG_FILE_OPEN_FAIL
-    "undefined error code",                 // KEUNDEF17
-    "undefined error code",                 // KEUNDEF16
-    "undefined error code",                 // KEUNDEF15
-    "undefined error code",                 // KEUNDEF14
-    "undefined error code",                 // KEUNDEF13
-    "undefined error code",                 // KEUNDEF12
-    "undefined error code",                 // KEUNDEF11
-    "undefined error code",                 // KEUNDEF10
-    "undefined error code",                 // KEUNDEF9 
+    "task pool init failed",                // KEPOOL_INIT_FAIL
+    "too many sessions of the task pool",   // KEPOOL_SESSION_FULL
+    "unable to find encoder",               // KEAVCODEC_FIND_ENCODER_FAIL
+    "to open encoder failed",               // KEOPEN_ENCODER_FAIL
+    "write media file failed",              // KEWRITE_MEDIA_FILE_FAIL
+    "no sync mark matched",                 // KENO_SYNC_MARK
+    "write trace file failed",              // KETRACE_FILE_WRITE_FAIL
+    "open playlist file failed",            // KEPLAYLIST_OPEN_FAIL
+    "write playlist file failed",           // KEPLAYLIST_WRITE_FAIL
     "undefined error code",                 // KEUNDEF8 
     "undefined error code",                 // KEUNDEF7 
     "GUI window init failed",               // KEGUI_WINDOW_INIT_FAIL
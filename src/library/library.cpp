@@ -0,0 +1,623 @@
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include "library.h"
+#include "error/error.h"
+#include "log/log.h"
+#include "lock/lock.h"
+
+extern "C"
+{
+#include "libavutil/time.h"
+}
+
+#define FILENAME "library.cpp"
+
+/* argument of ProbeService::info_interrupt_cb() */
+typedef struct ProbeDeadline {
+    ProbeService *p;
+    int64_t       deadline; // of av_gettime_relative()
+}ProbeDeadline;
+
+int LibraryScanner::walk_proc (void *args)
+{
+    LibraryScanner *s = (LibraryScanner *)args;
+    QString         dir;
+
+    /* list a few directories, then give way to the probes */
+    for (int i = 0; i < LIBRARY_DIRS_PER_RUN; i++) {
+        mutex_lock(s->mutex);
+        if (SDL_AtomicGet(&s->abort_req) || s->dirs.isEmpty()) {
+            s->walk_done = true;
+            mutex_unlock(s->mutex);
+            for (int j = 0; j < s->nb_probe_tasks; j++)
+                s->probe_tasks[j].wake();
+            KLOGD("Library walk finished.\n");
+            return TASK_DONE;
+        }
+        dir = s->dirs.takeFirst();
+        mutex_unlock(s->mutex);
+
+        s->list_dir(dir);
+    }
+
+    return TASK_AGAIN;
+}
+
+int LibraryScanner::probe_proc (void *args)
+{
+    LibraryScanner *s = (LibraryScanner *)args;
+    AVIOInterruptCB int_cb = { interrupt_cb, s };
+    LibraryFile     file;
+    LibraryItem     item;
+    int             ret;
+
+    mutex_lock(s->mutex);
+    if (SDL_AtomicGet(&s->abort_req) || (s->files.empty() && s->walk_done)) {
+        mutex_unlock(s->mutex);
+        if (SDL_AtomicDecRef(&s->running)) // the last probe reports the scan
+            s->finish();
+        return TASK_DONE;
+    }
+
+    /* woken by the walker */
+    if (s->files.empty()) {
+        mutex_unlock(s->mutex);
+        return TASK_WAIT;
+    }
+    file = s->files.front();
+    s->files.pop_front();
+    mutex_unlock(s->mutex);
+
+    if (!s->cache->find(file.url, file.size, file.mtime, &item)) {
+        ret = library_probe(file, &int_cb, &item);
+        if (ret < 0) { // not cached, it may be readable later
+            s->add_result(NULL);
+            return TASK_AGAIN;
+        }
+        s->cache->put(item);
+    }
+    s->add_result(item.vcodec.empty() && item.acodec.empty() ? NULL : &item);
+
+    return TASK_AGAIN;
+}
+
+int LibraryScanner::interrupt_cb (void *args)
+{
+    return SDL_AtomicGet(&((LibraryScanner *)args)->abort_req);
+}
+
+void LibraryScanner::list_dir (const QString &dir)
+{
+    QFileInfoList           entries;
+    QStringList             subdirs;
+    std::deque<LibraryFile> found;
+    LibraryFile             file;
+
+    entries = QDir(dir).entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot | QDir::Readable,
+                                      QDir::Name);
+    for (int i = 0; i < entries.size(); i++) {
+        const QFileInfo &info = entries[i];
+
+        if (info.isSymLink()) // links may loop
+            continue;
+        if (info.isDir()) {
+            subdirs.append(info.absoluteFilePath());
+            continue;
+        }
+        if (!library_match_ext(info.fileName().toUtf8().constData()))
+            continue;
+        file.url = info.absoluteFilePath().toUtf8().constData();
+        file.size = info.size();
+        file.mtime = info.lastModified().toMSecsSinceEpoch() / 1000;
+        found.push_back(file);
+    }
+
+    mutex_lock(mutex);
+    dirs.append(subdirs);
+    files.insert(files.end(), found.begin(), found.end());
+    mutex_unlock(mutex);
+
+    if (!found.empty()) {
+        for (int i = 0; i < nb_probe_tasks; i++)
+            probe_tasks[i].wake();
+    }
+}
+
+int library_probe (const LibraryFile &file, const AVIOInterruptCB *int_cb, LibraryItem *item)
+{
+    const MediaStreamInfo *vsi;
+    const MediaStreamInfo *asi;
+    AVIOContext *          pb = NULL;
+    MediaInfo              info;
+    uint8_t                magic[LIBRARY_MAGIC_SIZE];
+    int                    ret;
+
+    item->url = file.url;
+    item->size = file.size;
+    item->mtime = file.mtime;
+    item->duration = 0;
+    item->width = item->height = 0;
+    item->vcodec.clear();
+    item->acodec.clear();
+
+    /* check the magic bytes before opening a demuxer */
+    ret = avio_open2(&pb, file.url.c_str(), AVIO_FLAG_READ, int_cb, NULL);
+    if (ret < 0) {
+        logger.warning("%s %s: %s.\n", kerr2str(KEOPEN_INPUT_FAIL), file.url.c_str(), av_err2str(ret));
+        return KERROR(KEOPEN_INPUT_FAIL);
+    }
+    ret = avio_read(pb, magic, sizeof(magic));
+    avio_closep(&pb);
+    if (ret <= 0 || !library_match_magic(magic, ret))
+        return 0;
+
+    /* find the streams in a short probe */
+    ret = media_probe(file.url.c_str(), int_cb, LIBRARY_PROBE_SIZE, LIBRARY_ANALYZE_DURATION, &info);
+    if (ret < 0) // interrupted, or not media
+        return int_cb->callback(int_cb->opaque) ? ret : 0;
+
+    /* the first video stream which is not a cover, and the first audio stream */
+    vsi = info.get_video();
+    asi = info.get_audio();
+    if (vsi) {
+        item->vcodec = vsi->codec;
+        item->width = vsi->width;
+        item->height = vsi->height;
+    }
+    if (asi)
+        item->acodec = asi->codec;
+    item->duration = (int64_t)(info.duration * AV_TIME_BASE);
+
+    return 1;
+}
+
+void LibraryScanner::add_result (const LibraryItem *item)
+{
+    QVector<LibraryItem> batch;
+
+    mutex_lock(mutex);
+    nb_probed++;
+    if (item) {
+        results.append(*item);
+        nb_found++;
+    }
+    if (results.size() >= LIBRARY_BATCH || (files.empty() && !results.isEmpty()))
+        batch.swap(results);
+    mutex_unlock(mutex);
+
+    /* queued to the thread of the owner */
+    if (!batch.isEmpty())
+        emit scanned(batch);
+}
+
+void LibraryScanner::finish ()
+{
+    QVector<LibraryItem> batch;
+    int                  n;
+
+    mutex_lock(mutex);
+    batch.swap(results);
+    n = nb_found;
+    scanning = false;
+    mutex_unlock(mutex);
+    cache->flush();
+
+    if (!batch.isEmpty())
+        emit scanned(batch);
+    emit finished(n);
+    logger.info("Library scanned %d files, %d media files found.\n", nb_probed, n);
+}
+
+int LibraryScanner::init (LibraryCache *cache, int nb_threads)
+{
+    int ret;
+
+    if (session >= 0)
+        return KERROR(KEREINIT);
+    if (!cache)
+        return KERROR(KEINVAL);
+    this->cache = cache;
+
+    qRegisterMetaType<QVector<LibraryItem>>("QVector<LibraryItem>");
+
+    /* one probe for a worker */
+    nb_threads = nb_threads <= 0 ? SDL_GetCPUCount() : nb_threads;
+    nb_threads = nb_threads > LIBRARY_MAX_THREADS ? LIBRARY_MAX_THREADS : nb_threads;
+    ret = pool.init(nb_threads);
+    if (ret < 0)
+        return ret;
+    nb_probe_tasks = pool.get_nb_threads();
+    nb_probe_tasks = nb_probe_tasks > LIBRARY_MAX_THREADS ? LIBRARY_MAX_THREADS : nb_probe_tasks;
+    ret = pool.open_session();
+    if (ret < 0)
+        GOTO_FAIL(ret);
+    session = ret;
+
+    mutex = mutex_create("library");
+    if (!mutex) {
+        logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_MUTEX_FAIL), SDL_GetError());
+        GOTO_FAIL(KECREATE_SDL_MUTEX_FAIL);
+    }
+
+    walk_task.init(walk_proc, this, "library_walk");
+    for (int i = 0; i < nb_probe_tasks; i++)
+        probe_tasks[i].init(probe_proc, this, "library_probe");
+    KLOGD("Library scanner has been inited, %d probes.\n", nb_probe_tasks);
+
+    return 0;
+fail:
+    close();
+
+    return ret;
+}
+
+void LibraryScanner::close ()
+{
+    if (session < 0 && !mutex)
+        return;
+
+    if (mutex)
+        cancel();
+    if (session >= 0)
+        pool.close_session(session);
+    pool.close();
+    session = -1;
+    if (mutex) {
+        mutex_destroy(mutex);
+        mutex = NULL;
+    }
+
+    KLOGD("Library scanner closed.\n");
+}
+
+int LibraryScanner::scan (const QStringList &dirs)
+{
+    int ret;
+
+    if (session < 0 || !mutex)
+        return KERROR(KEUNINITED);
+
+    /* add to the walk in progress */
+    mutex_lock(mutex);
+    if (scanning) {
+        ret = (walk_done || SDL_AtomicGet(&abort_req)) ? KERROR(KEAGAIN) : 0;
+        if (!ret)
+            this->dirs.append(dirs);
+        mutex_unlock(mutex);
+        walk_task.wake();
+        return ret;
+    }
+    mutex_unlock(mutex);
+
+    /* the tasks of the last scan may be returning */
+    pool.join(&walk_task);
+    for (int i = 0; i < nb_probe_tasks; i++)
+        pool.join(&probe_tasks[i]);
+
+    mutex_lock(mutex);
+    this->dirs = dirs;
+    files.clear();
+    results.clear();
+    walk_done = false;
+    SDL_AtomicSet(&abort_req, 0);
+    nb_found = 0;
+    nb_probed = 0;
+    scanning = true;
+    SDL_AtomicSet(&running, nb_probe_tasks);
+    mutex_unlock(mutex);
+
+    ret = pool.submit(&walk_task, session);
+    for (int i = 0; !ret && i < nb_probe_tasks; i++)
+        ret = pool.submit(&probe_tasks[i], session);
+    if (ret < 0) { // not reached after the pool is inited, the tasks submitted stop themselves
+        logger.FATALN("[%s: %d]%s.\n", kerr2str(-ret));
+        cancel();
+        return ret;
+    }
+
+    return 0;
+}
+
+void LibraryScanner::cancel ()
+{
+    if (!mutex)
+        return;
+
+    /* the probes in progress are interrupted */
+    mutex_lock(mutex);
+    SDL_AtomicSet(&abort_req, 1);
+    dirs.clear();
+    files.clear();
+    mutex_unlock(mutex);
+    walk_task.wake();
+    for (int i = 0; i < nb_probe_tasks; i++)
+        probe_tasks[i].wake();
+    pool.join(&walk_task);
+    for (int i = 0; i < nb_probe_tasks; i++)
+        pool.join(&probe_tasks[i]);
+}
+
+bool LibraryScanner::is_scanning ()
+{
+    bool ret;
+
+    if (!mutex)
+        return false;
+    mutex_lock(mutex);
+    ret = scanning;
+    mutex_unlock(mutex);
+
+    return ret;
+}
+
+LibraryScanner::LibraryScanner (QObject *parent)
+    : QObject(parent)
+{
+    session = -1;
+    nb_probe_tasks = 0;
+    mutex = NULL;
+    cache = NULL;
+    walk_done = true;
+    scanning = false;
+    SDL_AtomicSet(&abort_req, 0);
+    nb_found = 0;
+    nb_probed = 0;
+    SDL_AtomicSet(&running, 0);
+}
+
+LibraryScanner::~LibraryScanner ()
+{
+    close();
+}
+
+int ProbeService::probe_proc (void *args)
+{
+    ProbeService *  p = (ProbeService *)args;
+    AVIOInterruptCB int_cb = { interrupt_cb, p };
+    LibraryFile     file;
+    LibraryItem     item;
+    QFileInfo       info;
+    int             ret = 0;
+
+    /* woken by request() */
+    mutex_lock(p->mutex);
+    if (SDL_AtomicGet(&p->abort_req)) {
+        mutex_unlock(p->mutex);
+        return TASK_DONE;
+    }
+    if (!p->info_urls.empty()) { // asked by the user, goes first
+        file.url = p->info_urls.front();
+        p->info_urls.pop_front();
+        mutex_unlock(p->mutex);
+        p->probe_info(file.url);
+        return TASK_AGAIN;
+    }
+    if (p->urls.empty()) {
+        mutex_unlock(p->mutex);
+        return TASK_WAIT;
+    }
+    file.url = p->urls.front();
+    p->urls.pop_front();
+    mutex_unlock(p->mutex);
+
+    /* the network streams would block a worker until they time out */
+    info.setFile(QString::fromStdString(file.url));
+    if (std::string::npos != file.url.find("://") || !info.isFile()) {
+        p->add_result(NULL);
+        return TASK_AGAIN;
+    }
+    file.size = info.size();
+    file.mtime = info.lastModified().toMSecsSinceEpoch() / 1000;
+
+    if (!p->cache->find(file.url, file.size, file.mtime, &item)) {
+        ret = library_probe(file, &int_cb, &item);
+        if (ret >= 0)
+            p->cache->put(item);
+    }
+    p->add_result(ret < 0 || (item.vcodec.empty() && item.acodec.empty()) ? NULL : &item);
+
+    return TASK_AGAIN;
+}
+
+int ProbeService::interrupt_cb (void *args)
+{
+    return SDL_AtomicGet(&((ProbeService *)args)->abort_req);
+}
+
+int ProbeService::info_interrupt_cb (void *args)
+{
+    ProbeDeadline *d = (ProbeDeadline *)args;
+
+    return SDL_AtomicGet(&d->p->abort_req) || av_gettime_relative() > d->deadline;
+}
+
+void ProbeService::probe_info (const std::string &url)
+{
+    ProbeDeadline          d = { this, av_gettime_relative() + PROBE_INFO_TIMEOUT * 1000LL };
+    AVIOInterruptCB        int_cb = { info_interrupt_cb, &d };
+    const MediaStreamInfo *vsi;
+    const MediaStreamInfo *asi;
+    MediaInfo              info;
+    LibraryItem            item;
+    QFileInfo              fi;
+    int                    ret;
+
+    ret = media_probe(url.c_str(), &int_cb, 0, 0, &info);
+    if (ret < 0) {
+        logger.error("Failed to get the info of %s: %s.\n", url.c_str(), kerr2str(-ret));
+        emit info_probed(QString::fromStdString(url), ret, QString(), 0);
+        return;
+    }
+
+    /* a local file is cached, so the playlist and the next request do not probe it again */
+    fi.setFile(QString::fromStdString(url));
+    if (std::string::npos == url.find("://") && fi.isFile()) {
+        item.url = url;
+        item.size = fi.size();
+        item.mtime = fi.lastModified().toMSecsSinceEpoch() / 1000;
+        item.width = item.height = 0;
+        vsi = info.get_video();
+        asi = info.get_audio();
+        if (vsi) {
+            item.vcodec = vsi->codec;
+            item.width = vsi->width;
+            item.height = vsi->height;
+        }
+        if (asi)
+            item.acodec = asi->codec;
+        item.duration = (int64_t)(info.duration * AV_TIME_BASE);
+        cache->put(item);
+        cache->flush();
+    }
+
+    /* queued to the thread of the owner */
+    emit info_probed(QString::fromStdString(url), 0, QString::fromStdString(info.to_text()),
+                     (qint64)(info.duration * AV_TIME_BASE));
+}
+
+void ProbeService::add_result (const LibraryItem *item)
+{
+    QVector<LibraryItem> batch;
+
+    mutex_lock(mutex);
+    if (item)
+        results.append(*item);
+    if (results.size() >= LIBRARY_BATCH || (urls.empty() && !results.isEmpty()))
+        batch.swap(results);
+    mutex_unlock(mutex);
+
+    /* queued to the thread of the owner */
+    if (!batch.isEmpty()) {
+        cache->flush();
+        emit probed(batch);
+    }
+}
+
+int ProbeService::init (LibraryCache *cache, int nb_threads)
+{
+    int ret;
+
+    if (session >= 0)
+        return KERROR(KEREINIT);
+    if (!cache)
+        return KERROR(KEINVAL);
+    this->cache = cache;
+
+    qRegisterMetaType<QVector<LibraryItem>>("QVector<LibraryItem>");
+
+    nb_threads = nb_threads <= 0 ? PROBE_DEF_THREADS : nb_threads;
+    nb_threads = nb_threads > PROBE_MAX_THREADS ? PROBE_MAX_THREADS : nb_threads;
+    ret = pool.init(nb_threads);
+    if (ret < 0)
+        return ret;
+    nb_tasks = pool.get_nb_threads();
+    nb_tasks = nb_tasks > PROBE_MAX_THREADS ? PROBE_MAX_THREADS : nb_tasks;
+    ret = pool.open_session();
+    if (ret < 0)
+        GOTO_FAIL(ret);
+    session = ret;
+
+    mutex = mutex_create("probe service");
+    if (!mutex) {
+        logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_MUTEX_FAIL), SDL_GetError());
+        GOTO_FAIL(KECREATE_SDL_MUTEX_FAIL);
+    }
+
+    /* the tasks sleep until urls are requested */
+    SDL_AtomicSet(&abort_req, 0);
+    for (int i = 0; i < nb_tasks; i++) {
+        tasks[i].init(probe_proc, this, "probe_service");
+        ret = pool.submit(&tasks[i], session);
+        if (ret < 0) {
+            logger.FATALN("[%s: %d]%s.\n", kerr2str(-ret));
+            goto fail;
+        }
+    }
+    KLOGD("Probe service has been inited, %d probes.\n", nb_tasks);
+
+    return 0;
+fail:
+    close();
+
+    return ret;
+}
+
+void ProbeService::close ()
+{
+    if (session < 0 && !mutex)
+        return;
+
+    /* the probes in progress are interrupted */
+    if (mutex) {
+        mutex_lock(mutex);
+        SDL_AtomicSet(&abort_req, 1);
+        urls.clear();
+        info_urls.clear();
+        mutex_unlock(mutex);
+        for (int i = 0; i < nb_tasks; i++) {
+            tasks[i].wake();
+            pool.join(&tasks[i]);
+        }
+    }
+    if (session >= 0)
+        pool.close_session(session);
+    pool.close();
+    session = -1;
+    if (mutex) {
+        mutex_destroy(mutex);
+        mutex = NULL;
+    }
+
+    KLOGD("Probe service closed.\n");
+}
+
+void ProbeService::request (const QStringList &urls)
+{
+    if (!mutex || urls.isEmpty())
+        return;
+
+    mutex_lock(mutex);
+    for (int i = 0; i < urls.size(); i++)
+        this->urls.push_back(urls[i].toStdString());
+    mutex_unlock(mutex);
+    for (int i = 0; i < nb_tasks; i++)
+        tasks[i].wake();
+}
+
+void ProbeService::request_info (const QString &url)
+{
+    if (!mutex || url.isEmpty())
+        return;
+
+    mutex_lock(mutex);
+    info_urls.push_back(url.toStdString());
+    mutex_unlock(mutex);
+    for (int i = 0; i < nb_tasks; i++)
+        tasks[i].wake();
+}
+
+void ProbeService::cancel ()
+{
+    if (!mutex)
+        return;
+
+    mutex_lock(mutex);
+    urls.clear();
+    mutex_unlock(mutex);
+}
+
+ProbeService::ProbeService (QObject *parent)
+    : QObject(parent)
+{
+    session = -1;
+    nb_tasks = 0;
+    mutex = NULL;
+    SDL_AtomicSet(&abort_req, 0);
+    cache = NULL;
+}
+
+ProbeService::~ProbeService ()
+{
+    close();
+}
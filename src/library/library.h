@@ -0,0 +1,154 @@
+#ifndef _AVPLAYERWIDGET_LIBRARY_H_
+#define _AVPLAYERWIDGET_LIBRARY_H_
+
+#include <QObject>
+#include <QVector>
+#include <QStringList>
+#include <deque>
+#include "avplayerwidget_global.h"
+#include "pool/pool.h"
+#include "library_cache.h"
+#include "mediainfo/mediainfo.h"
+
+extern "C"
+{
+#include "libavformat/avformat.h"
+#include "SDL2/SDL.h"
+}
+
+/*
+* media library import and the probe service of the playlist,
+* a walker task lists the directories and a probe task per worker thread probes the files,
+* the files are filtered by extension and magic bytes before they are opened,
+* the results are cached by a LibraryCache shared by both and emitted in batches to the thread of the owner
+*/
+
+/* probe limits */
+#define LIBRARY_PROBE_SIZE       (512 * 1024)  // bytes read to find the streams
+#define LIBRARY_ANALYZE_DURATION 500000        // (unit: microsecond)
+
+/* scanner */
+#define LIBRARY_MAX_THREADS      8
+#define LIBRARY_BATCH            64            // results emitted at once, or when no file is waiting
+#define LIBRARY_DIRS_PER_RUN     4             // directories listed in a run of the walker
+
+/* probe service, a few threads, the playback comes first */
+#define PROBE_MAX_THREADS        4
+#define PROBE_DEF_THREADS        2
+#define PROBE_INFO_TIMEOUT       5000          // upper bound of probing the info of a file (unit: millisecond)
+
+Q_DECLARE_METATYPE(LibraryItem)
+
+/* a file waiting for the probe */
+typedef struct LibraryFile {
+    std::string url;
+    int64_t     size;
+    int64_t     mtime;
+}LibraryFile;
+
+/* probes a local file, 1 if it is media, 0 if not, < 0 if it can not be read */
+int library_probe (const LibraryFile &file, const AVIOInterruptCB *int_cb, LibraryItem *item);
+
+class AVPLAYERWIDGET_EXPORT LibraryScanner : public QObject {
+    Q_OBJECT
+
+private:
+    /* tasks */
+    TaskPool                pool;        // own workers, the probes block on I/O
+    int                     session;     // -1 if not inited
+    Task                    walk_task;
+    Task                    probe_tasks[LIBRARY_MAX_THREADS];
+    int                     nb_probe_tasks;
+    SDL_atomic_t            running;     // probe tasks not finished
+
+    /* state, protected by mutex */
+    SDL_mutex *             mutex;
+    QStringList             dirs;        // to be listed
+    std::deque<LibraryFile> files;       // to be probed
+    QVector<LibraryItem>    results;     // not emitted yet
+    bool                    walk_done;
+    bool                    scanning;
+    int                     nb_found;
+    int                     nb_probed;
+    SDL_atomic_t            abort_req;   // interrupt_cb() reads it without the mutex
+
+    /* probe results, shared */
+    LibraryCache *          cache;
+
+signals:
+    void scanned         (const QVector<LibraryItem> &items);
+    void finished        (int nb_items);
+
+private:
+    static int walk_proc         (void *args);
+    static int probe_proc        (void *args);
+    static int interrupt_cb      (void *args);
+
+private:
+    void       list_dir          (const QString &dir);
+    void       add_result        (const LibraryItem *item); // NULL if the file is not media
+    void       finish            ();
+
+public:
+    int        init              (LibraryCache *cache, int nb_threads); // 0 threads for the number of cores
+    void       close             ();
+    int        scan              (const QStringList &dirs); // the results are emitted by scanned()
+    void       cancel            ();
+    bool       is_scanning       ();
+
+public:
+    LibraryScanner               (QObject *parent = nullptr);
+    ~LibraryScanner              ();
+};
+
+/*
+* probes the items of the playlist for their durations without opening them in a player,
+* the urls requested are probed in order, the network streams are skipped,
+* the info of a file requested by request_info() is probed first with the full probe
+*/
+class AVPLAYERWIDGET_EXPORT ProbeService : public QObject {
+    Q_OBJECT
+
+private:
+    /* tasks */
+    TaskPool                pool;        // own workers, the probes block on I/O
+    int                     session;     // -1 if not inited
+    Task                    tasks[PROBE_MAX_THREADS];
+    int                     nb_tasks;
+
+    /* state, protected by mutex */
+    SDL_mutex *             mutex;
+    std::deque<std::string> urls;        // to be probed, UTF-8
+    std::deque<std::string> info_urls;   // the info requested, UTF-8
+    QVector<LibraryItem>    results;     // not emitted yet
+    SDL_atomic_t            abort_req;   // as the one of the scanner
+
+    /* probe results, shared */
+    LibraryCache *          cache;
+
+signals:
+    void probed          (const QVector<LibraryItem> &items); // the media files only
+    void info_probed     (const QString &url, int ret, const QString &text, qint64 duration); // ret < 0 if failed
+
+private:
+    static int probe_proc        (void *args);
+    static int interrupt_cb      (void *args);
+    static int info_interrupt_cb (void *args);
+
+private:
+    void       add_result        (const LibraryItem *item); // NULL if the url is not probed
+    void       probe_info        (const std::string &url);
+
+public:
+    int        init              (LibraryCache *cache, int nb_threads); // 0 threads for the default
+    void       close             ();
+    void       request           (const QStringList &urls);
+    void       request_info      (const QString &url); // the result is emitted by info_probed()
+    void       cancel            (); // the urls queued are dropped
+
+public:
+    ProbeService                 (QObject *parent = nullptr);
+    ~ProbeService                ();
+};
+
+#endif /* _AVPLAYERWIDGET_LIBRARY_H_ */
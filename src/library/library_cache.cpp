@@ -0,0 +1,371 @@
+#include <cstring>
+#include <vector>
+#include "library_cache.h"
+#include "error/error.h"
+#include "log/log.h"
+#include "utils/utils.h"
+#include "lock/lock.h"
+
+extern "C"
+{
+#include "libavutil/crc.h"
+#include "libavutil/intreadwrite.h"
+}
+
+#define FILENAME "library_cache.cpp"
+
+/* extensions of the media files, as the open dialog of the player */
+static const char *media_exts[] = {
+    "mp4", "avi", "mkv", "mpeg", "mpg", "h264", "h265", "mov", "wmv", "flv", "webm", "ts", "m2ts",
+    "mp3", "mp2", "aac", "ape", "flac", "ogg", "aiff", "m4a", "wav", "wma"
+};
+
+bool library_match_ext (const char *path)
+{
+    const char *ext = strrchr(path, '.');
+    char        lower[8];
+    size_t      i;
+
+    if (!ext || strchr(ext, '/') || strchr(ext, '\\') || strlen(++ext) >= sizeof(lower))
+        return false;
+    for (i = 0; ext[i]; i++)
+        lower[i] = (ext[i] >= 'A' && ext[i] <= 'Z') ? ext[i] - 'A' + 'a' : ext[i];
+    lower[i] = 0;
+    for (i = 0; i < ARRAY_ELEMS(media_exts); i++) {
+        if (!strcmp(lower, media_exts[i]))
+            return true;
+    }
+
+    return false;
+}
+
+bool library_match_magic (const uint8_t *buf, int size)
+{
+    if (size < 4)
+        return false;
+
+    /* containers */
+    if (size >= 8 && !memcmp(buf + 4, "ftyp", 4))       // mp4, mov, m4a
+        return true;
+    if (!memcmp(buf, "RIFF", 4)                          // avi, wav
+        || !memcmp(buf, "\x1A\x45\xDF\xA3", 4)           // mkv, webm
+        || !memcmp(buf, "\x30\x26\xB2\x75", 4)           // asf, wmv, wma
+        || !memcmp(buf, "FLV", 3)
+        || !memcmp(buf, "OggS", 4)
+        || !memcmp(buf, "fLaC", 4)
+        || !memcmp(buf, "MAC ", 4)                       // ape
+        || !memcmp(buf, "FORM", 4)                       // aiff
+        || !memcmp(buf, "ID3", 3))                       // mp3 with a tag
+        return true;
+    if (!memcmp(buf, "\x00\x00\x01", 3) || !memcmp(buf, "\x00\x00\x00\x01", 4)) // mpeg-ps, h264, h265
+        return true;
+    if (0x47 == buf[0])                                  // mpeg-ts sync byte
+        return true;
+
+    /* mpeg audio and adts frames */
+    if (0xFF == buf[0] && 0xE0 == (buf[1] & 0xE0))
+        return true;
+
+    return false;
+}
+
+static void put_str (std::vector<uint8_t> &buf, const std::string &s)
+{
+    uint8_t size[4];
+
+    AV_WL32(size, (uint32_t)s.size());
+    buf.insert(buf.end(), size, size + 4);
+    buf.insert(buf.end(), s.begin(), s.end());
+}
+
+static void put_i64 (std::vector<uint8_t> &buf, int64_t v)
+{
+    uint8_t b[8];
+
+    AV_WL64(b, (uint64_t)v);
+    buf.insert(buf.end(), b, b + 8);
+}
+
+static void put_i32 (std::vector<uint8_t> &buf, int v)
+{
+    uint8_t b[4];
+
+    AV_WL32(b, (uint32_t)v);
+    buf.insert(buf.end(), b, b + 4);
+}
+
+/* readers return false if the payload ends */
+static bool get_str (const uint8_t **p, const uint8_t *end, std::string &s)
+{
+    uint32_t size;
+
+    if (end - *p < 4)
+        return false;
+    size = AV_RL32(*p);
+    if ((uint32_t)(end - *p - 4) < size)
+        return false;
+    s.assign((const char *)*p + 4, size);
+    *p += 4 + size;
+
+    return true;
+}
+
+static bool get_i64 (const uint8_t **p, const uint8_t *end, int64_t *v)
+{
+    if (end - *p < 8)
+        return false;
+    *v = (int64_t)AV_RL64(*p);
+    *p += 8;
+
+    return true;
+}
+
+static bool get_i32 (const uint8_t **p, const uint8_t *end, int *v)
+{
+    if (end - *p < 4)
+        return false;
+    *v = (int)AV_RL32(*p);
+    *p += 4;
+
+    return true;
+}
+
+static bool parse_item (const uint8_t *p, const uint8_t *end, LibraryItem *item)
+{
+    return get_str(&p, end, item->url) && get_i64(&p, end, &item->size) && get_i64(&p, end, &item->mtime)
+           && get_i64(&p, end, &item->duration) && get_i32(&p, end, &item->width)
+           && get_i32(&p, end, &item->height) && get_str(&p, end, item->vcodec)
+           && get_str(&p, end, item->acodec) && p == end;
+}
+
+int LibraryCache::load (const std::string &path)
+{
+    const AVCRC *        table = av_crc_get_table(AV_CRC_32_IEEE_LE);
+    std::vector<uint8_t> data;
+    const uint8_t *      p;
+    const uint8_t *      end;
+    LibraryItem          item;
+    uint32_t             size;
+    long                 file_size;
+    FILE *               in;
+
+    if (mutex)
+        return KERROR(KEREINIT);
+    mutex = mutex_create("library cache");
+    if (!mutex) {
+        logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_MUTEX_FAIL), SDL_GetError());
+        return KERROR(KECREATE_SDL_MUTEX_FAIL);
+    }
+
+    /* not shared until loaded */
+    this->path = path;
+    items.clear();
+    records = 0;
+
+    /* a new cache */
+    in = fopen(path.c_str(), "rb");
+    if (!in)
+        return compact();
+    fseek(in, 0, SEEK_END);
+    file_size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    data.resize(file_size > 0 ? file_size : 0);
+    if (file_size > 0 && 1 != fread(&data[0], file_size, 1, in)) {
+        fclose(in);
+        logger.error("Failed to read library cache %s.\n", path.c_str());
+        return KERROR(KEPLAYLIST_OPEN_FAIL);
+    }
+    fclose(in);
+    if (data.size() < LIBRARY_CACHE_HEADER
+        || LIBRARY_CACHE_MAGIC != AV_RL32(&data[0]) || LIBRARY_CACHE_VERSION != AV_RL32(&data[4]))
+        return compact(); // a cache is thrown if it is not of this version
+
+    /* the records up to the first torn one */
+    p = &data[0] + LIBRARY_CACHE_HEADER;
+    end = &data[0] + data.size();
+    while (end - p >= LIBRARY_CACHE_RECORD) {
+        size = AV_RL32(p);
+        if (size > LIBRARY_MAX_RECORD || (uint32_t)(end - p - LIBRARY_CACHE_RECORD) < size)
+            break;
+        if (AV_RL32(p + 4) != av_crc(table, 0, p + LIBRARY_CACHE_RECORD, size))
+            break;
+        if (!parse_item(p + LIBRARY_CACHE_RECORD, p + LIBRARY_CACHE_RECORD + size, &item))
+            break;
+        items[item.url] = item;
+        records++;
+        p += LIBRARY_CACHE_RECORD + size;
+    }
+
+    /* torn, or most of the records are stale */
+    if (p != end || (records >= LIBRARY_CACHE_COMPACT && records > 2 * (int64_t)items.size()))
+        return compact();
+
+    fp = fopen(path.c_str(), "ab");
+    if (!fp) {
+        logger.error("Failed to open library cache %s.\n", path.c_str());
+        return KERROR(KEPLAYLIST_OPEN_FAIL);
+    }
+
+    return 0;
+}
+
+void LibraryCache::close ()
+{
+    /* the users have stopped */
+    if (fp) {
+        fclose(fp);
+        fp = NULL;
+    }
+    items.clear();
+    records = 0;
+    if (mutex) {
+        mutex_destroy(mutex);
+        mutex = NULL;
+    }
+}
+
+bool LibraryCache::find (const std::string &url, int64_t size, int64_t mtime, LibraryItem *item)
+{
+    std::unordered_map<std::string, LibraryItem>::const_iterator it;
+    bool                                                         ret = false;
+
+    if (!mutex)
+        return false;
+    mutex_lock(mutex);
+    it = items.find(url);
+    if (it != items.end() && it->second.size == size && it->second.mtime == mtime) {
+        *item = it->second;
+        ret = true;
+    }
+    mutex_unlock(mutex);
+
+    return ret;
+}
+
+int LibraryCache::put (const LibraryItem &item)
+{
+    int ret;
+
+    if (!mutex)
+        return KERROR(KEUNINITED);
+    mutex_lock(mutex);
+    items[item.url] = item;
+    ret = fp ? write_record(fp, item) : KERROR(KEUNINITED);
+    mutex_unlock(mutex);
+
+    return ret;
+}
+
+int LibraryCache::flush ()
+{
+    int ret = 0;
+
+    if (!mutex)
+        return KERROR(KEUNINITED);
+    mutex_lock(mutex);
+    if (!fp) {
+        ret = KERROR(KEUNINITED);
+    } else if (fflush(fp)) {
+        logger.error("Failed to write library cache %s.\n", path.c_str());
+        ret = KERROR(KEPLAYLIST_WRITE_FAIL);
+    }
+    mutex_unlock(mutex);
+
+    return ret;
+}
+
+int LibraryCache::get_len ()
+{
+    int ret;
+
+    if (!mutex)
+        return 0;
+    mutex_lock(mutex);
+    ret = (int)items.size();
+    mutex_unlock(mutex);
+
+    return ret;
+}
+
+int LibraryCache::write_record (FILE *fp, const LibraryItem &item)
+{
+    std::vector<uint8_t> buf(LIBRARY_CACHE_RECORD);
+
+    put_str(buf, item.url);
+    put_i64(buf, item.size);
+    put_i64(buf, item.mtime);
+    put_i64(buf, item.duration);
+    put_i32(buf, item.width);
+    put_i32(buf, item.height);
+    put_str(buf, item.vcodec);
+    put_str(buf, item.acodec);
+    if (buf.size() - LIBRARY_CACHE_RECORD > LIBRARY_MAX_RECORD)
+        return KERROR(KEINVAL);
+    AV_WL32(&buf[0], (uint32_t)(buf.size() - LIBRARY_CACHE_RECORD));
+    AV_WL32(&buf[4], av_crc(av_crc_get_table(AV_CRC_32_IEEE_LE), 0,
+                            &buf[LIBRARY_CACHE_RECORD], buf.size() - LIBRARY_CACHE_RECORD));
+    if (1 != fwrite(&buf[0], buf.size(), 1, fp)) {
+        logger.error("Failed to write library cache %s.\n", path.c_str());
+        return KERROR(KEPLAYLIST_WRITE_FAIL);
+    }
+    records++;
+
+    return 0;
+}
+
+int LibraryCache::compact ()
+{
+    std::string tmp_path = path + ".tmp";
+    uint8_t     head[LIBRARY_CACHE_HEADER];
+    FILE *      out;
+    int         ret = 0;
+
+    /* write the live items beside, then replace the old file */
+    out = fopen(tmp_path.c_str(), "wb");
+    if (!out) {
+        logger.error("Failed to create library cache %s.\n", tmp_path.c_str());
+        return KERROR(KEPLAYLIST_WRITE_FAIL);
+    }
+    AV_WL32(head, LIBRARY_CACHE_MAGIC);
+    AV_WL32(head + 4, LIBRARY_CACHE_VERSION);
+    if (1 != fwrite(head, sizeof(head), 1, out))
+        ret = KERROR(KEPLAYLIST_WRITE_FAIL);
+    records = 0;
+    for (std::unordered_map<std::string, LibraryItem>::iterator it = items.begin();
+         !ret && it != items.end(); ++it)
+        ret = write_record(out, it->second);
+    if (!ret && file_sync(out))
+        ret = KERROR(KEPLAYLIST_WRITE_FAIL);
+    fclose(out);
+    if (fp) {
+        fclose(fp);
+        fp = NULL;
+    }
+    if (!ret && file_replace(tmp_path.c_str(), path.c_str()))
+        ret = KERROR(KEPLAYLIST_WRITE_FAIL);
+    if (ret < 0) {
+        remove(tmp_path.c_str());
+        logger.error("Failed to write library cache %s.\n", path.c_str());
+        return ret;
+    }
+
+    fp = fopen(path.c_str(), "ab");
+    if (!fp) {
+        logger.error("Failed to open library cache %s.\n", path.c_str());
+        return KERROR(KEPLAYLIST_OPEN_FAIL);
+    }
+
+    return 0;
+}
+
+LibraryCache::LibraryCache ()
+{
+    fp = NULL;
+    records = 0;
+    mutex = NULL;
+}
+
+LibraryCache::~LibraryCache ()
+{
+    close();
+}
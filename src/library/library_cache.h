@@ -0,0 +1,78 @@
+#ifndef _AVPLAYERWIDGET_LIBRARY_CACHE_H_
+#define _AVPLAYERWIDGET_LIBRARY_CACHE_H_
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include "avplayerwidget_global.h"
+
+extern "C"
+{
+#include "SDL2/SDL.h"
+}
+
+/*
+* probe results of the media library,
+* a result is used while the size and the modification time of the file are unchanged,
+* new results are appended to the cache file as checksummed records, the last one of a url wins,
+* the file is rewritten when it is torn or most of it is stale,
+* a cache is shared by the scanner and the probe service, the methods are thread-safe after load()
+*
+* header:  magic (4) version (4)
+* record:  size of payload (4) crc32 of payload (4) payload
+* payload: url, size, mtime, duration, width, height, vcodec, acodec,
+*          strings are a size (4) and the bytes, integers are little-endian
+*/
+
+#define LIBRARY_MAGIC_SIZE       16            // bytes read to check the type of a file
+
+#define LIBRARY_CACHE_MAGIC      0x434C414B    // "KALC"
+#define LIBRARY_CACHE_VERSION    1
+#define LIBRARY_CACHE_HEADER     8
+#define LIBRARY_CACHE_RECORD     8             // without the payload
+#define LIBRARY_MAX_RECORD       65536
+#define LIBRARY_CACHE_COMPACT    1024          // records before a stale cache is rewritten
+
+/* a probed file */
+typedef struct LibraryItem {
+    std::string url;       // UTF-8
+    int64_t     size;      // of the file
+    int64_t     mtime;     // (unit: second)
+    int64_t     duration;  // 0 if unknown (unit: microsecond)
+    int         width;     // 0 without video
+    int         height;
+    std::string vcodec;    // empty without video
+    std::string acodec;    // empty without audio
+}LibraryItem;
+
+/* filters */
+bool library_match_ext   (const char *path);
+bool library_match_magic (const uint8_t *buf, int size);
+
+class AVPLAYERWIDGET_EXPORT LibraryCache {
+private:
+    std::unordered_map<std::string, LibraryItem> items;
+    std::string                                  path;
+    FILE *                                       fp;      // opened for appending
+    int64_t                                      records; // in the file
+    SDL_mutex *                                  mutex;   // protects all, NULL if not loaded
+
+public:
+    int                load    (const std::string &path);
+    void               close   ();
+    bool               find    (const std::string &url, int64_t size, int64_t mtime, LibraryItem *item);
+    int                put     (const LibraryItem &item);
+    int                flush   ();
+    int                get_len ();
+
+public:
+    LibraryCache       ();
+    ~LibraryCache      ();
+
+private:
+    int                write_record (FILE *fp, const LibraryItem &item);
+    int                compact      ();
+};
+
+#endif /* _AVPLAYERWIDGET_LIBRARY_CACHE_H_ */
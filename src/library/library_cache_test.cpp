@@ -0,0 +1,102 @@
+#include <cstdio>
+#include <gtest/gtest.h>
+#include "library_cache.h"
+#include "testutil/testutil.h"
+
+static LibraryItem make_item (const char *url, int64_t size, int64_t mtime)
+{
+    LibraryItem item;
+
+    item.url = url;
+    item.size = size;
+    item.mtime = mtime;
+    item.duration = 61000000;
+    item.width = 1920;
+    item.height = 1080;
+    item.vcodec = "h264";
+    item.acodec = "aac";
+
+    return item;
+}
+
+TEST(library_cache_test, filters)
+{
+    const uint8_t mp4[]  = { 0, 0, 0, 0x20, 'f', 't', 'y', 'p', 'i', 's', 'o', 'm' };
+    const uint8_t mkv[]  = { 0x1A, 0x45, 0xDF, 0xA3, 0x01, 0x00, 0x00, 0x00 };
+    const uint8_t mp3[]  = { 0xFF, 0xFB, 0x90, 0x64 };
+    const uint8_t text[] = { 'h', 'e', 'l', 'l', 'o', ' ', 'w', 'o' };
+
+    EXPECT_TRUE(library_match_ext("/music/a.MP3"));
+    EXPECT_TRUE(library_match_ext("C:\\video\\b.mkv"));
+    EXPECT_FALSE(library_match_ext("/doc/a.txt"));
+    EXPECT_FALSE(library_match_ext("/dir.mp4/readme"));
+    EXPECT_FALSE(library_match_ext("/noext"));
+
+    EXPECT_TRUE(library_match_magic(mp4, sizeof(mp4)));
+    EXPECT_TRUE(library_match_magic(mkv, sizeof(mkv)));
+    EXPECT_TRUE(library_match_magic(mp3, sizeof(mp3)));
+    EXPECT_FALSE(library_match_magic(text, sizeof(text)));
+    EXPECT_FALSE(library_match_magic(mkv, 2));
+}
+
+TEST(library_cache_test, reload)
+{
+    std::string  path = test_path("library_cache_test_reload.cache");
+    LibraryCache cache;
+    LibraryItem  item;
+
+    remove(path.c_str());
+    ASSERT_EQ(0, cache.load(path));
+    EXPECT_EQ(0, cache.put(make_item("/a.mkv", 100, 1)));
+    EXPECT_EQ(0, cache.put(make_item("/b.mp3", 200, 2)));
+    EXPECT_EQ(0, cache.put(make_item("/a.mkv", 150, 3)));
+    EXPECT_EQ(0, cache.flush());
+    cache.close();
+
+    /* the last result of a url wins */
+    ASSERT_EQ(0, cache.load(path));
+    EXPECT_EQ(2, cache.get_len());
+    EXPECT_FALSE(cache.find("/a.mkv", 100, 1, &item));
+    ASSERT_TRUE(cache.find("/a.mkv", 150, 3, &item));
+    EXPECT_EQ(61000000, item.duration);
+    EXPECT_EQ(1920, item.width);
+    EXPECT_EQ("h264", item.vcodec);
+    EXPECT_EQ("aac", item.acodec);
+
+    /* a changed file is probed again */
+    EXPECT_FALSE(cache.find("/b.mp3", 200, 5, &item));
+    EXPECT_FALSE(cache.find("/c.mp4", 0, 0, &item));
+    cache.close();
+    remove(path.c_str());
+}
+
+TEST(library_cache_test, torn_tail)
+{
+    std::string  path = test_path("library_cache_test_torn.cache");
+    LibraryCache cache;
+    LibraryItem  item;
+    FILE *       fp;
+
+    remove(path.c_str());
+    ASSERT_EQ(0, cache.load(path));
+    EXPECT_EQ(0, cache.put(make_item("/a.mkv", 100, 1)));
+    EXPECT_EQ(0, cache.flush());
+    cache.close();
+
+    /* a record cut by a crash */
+    fp = fopen(path.c_str(), "ab");
+    ASSERT_TRUE(fp != NULL);
+    fwrite("\x40\x00\x00\x00\x12\x34", 6, 1, fp);
+    fclose(fp);
+
+    ASSERT_EQ(0, cache.load(path));
+    EXPECT_EQ(1, cache.get_len());
+    EXPECT_TRUE(cache.find("/a.mkv", 100, 1, &item));
+    EXPECT_EQ(0, cache.put(make_item("/b.mkv", 100, 1)));
+    cache.close();
+
+    ASSERT_EQ(0, cache.load(path));
+    EXPECT_EQ(2, cache.get_len());
+    cache.close();
+    remove(path.c_str());
+}
@@ -0,0 +1,327 @@
+#include <cstring>
+#include <new>
+#include "lock.h"
+#include "error/error.h"
+#include "log/log.h"
+
+#define FILENAME "lock.cpp"
+
+#ifdef LOCK_PROFILE
+
+/* mutexes alive, a power of 2, the mutexes created when it is full are not profiled */
+#define LOCK_TABLE_SIZE     4096
+#define LOCK_REMOVED        ((void *)1)
+
+/* names in a report */
+#define LOCK_MAX_NAMES      128
+
+/* profile of a mutex, updated by the holder of the mutex only */
+typedef struct LockProfile {
+    const char *     name;
+    int              depth;       // SDL mutexes are recursive
+    Uint64           hold_begin;
+    int64_t          acquires;
+    int64_t          contended;
+    int64_t          cond_waits;
+    int64_t          wait_time;   // unit: microsecond
+    int64_t          wait_max;
+    int64_t          hold_time;
+    int64_t          hold_max;
+    int64_t          wait_hist[LOCK_HIST_BUCKETS];
+    LockProfile *    next;
+}LockProfile;
+
+/* mutex -> profile, lock-free lookup, the profiles are never freed */
+static SDL_SpinLock  table_lock = 0;
+static void *        keys[LOCK_TABLE_SIZE];
+static LockProfile * profiles[LOCK_TABLE_SIZE];
+static LockProfile * all_profiles = NULL;
+
+static unsigned slot_of (const void *mutex)
+{
+    uintptr_t h = (uintptr_t)mutex;
+
+    h ^= h >> 17;
+    h *= 0x9E3779B1u;
+    return (unsigned)(h ^ (h >> 15)) & (LOCK_TABLE_SIZE - 1);
+}
+
+static LockProfile *lookup (SDL_mutex *mutex)
+{
+    unsigned i = slot_of(mutex);
+    void *   key;
+
+    for (int n = 0; n < LOCK_TABLE_SIZE; n++, i = (i + 1) & (LOCK_TABLE_SIZE - 1)) {
+        key = SDL_AtomicGetPtr(&keys[i]);
+        if (!key)
+            return NULL;
+        if (key == mutex)
+            return profiles[i];
+    }
+
+    return NULL;
+}
+
+static Uint64 now_us ()
+{
+    static Uint64 freq = 0;
+
+    if (!freq)
+        freq = SDL_GetPerformanceFrequency();
+    return SDL_GetPerformanceCounter() * 1000000 / freq;
+}
+
+static void add_wait (LockProfile *p, int64_t wait)
+{
+    int b = 0;
+
+    p->contended++;
+    p->wait_time += wait;
+    if (wait > p->wait_max)
+        p->wait_max = wait;
+    while (b < LOCK_HIST_BUCKETS - 1 && wait >= ((int64_t)1 << b))
+        b++;
+    p->wait_hist[b]++;
+}
+
+static void end_hold (LockProfile *p)
+{
+    int64_t hold = (int64_t)(now_us() - p->hold_begin);
+
+    p->hold_time += hold;
+    if (hold > p->hold_max)
+        p->hold_max = hold;
+}
+
+SDL_mutex *mutex_create (const char *name)
+{
+    SDL_mutex *  mutex = SDL_CreateMutex();
+    LockProfile *p;
+    unsigned     i;
+
+    if (!mutex)
+        return NULL;
+    p = _New LockProfile;
+    if (!p)
+        return mutex;
+    memset(p, 0, sizeof(LockProfile));
+    p->name = name ? name : "unnamed";
+
+    /* the profile is published before the key */
+    SDL_AtomicLock(&table_lock);
+    i = slot_of(mutex);
+    for (int n = 0; n < LOCK_TABLE_SIZE; n++, i = (i + 1) & (LOCK_TABLE_SIZE - 1)) {
+        void *key = SDL_AtomicGetPtr(&keys[i]);
+        if (!key || LOCK_REMOVED == key) {
+            profiles[i] = p;
+            SDL_MemoryBarrierRelease();
+            SDL_AtomicSetPtr(&keys[i], mutex);
+            break;
+        }
+    }
+    p->next = all_profiles;
+    all_profiles = p;
+    SDL_AtomicUnlock(&table_lock);
+
+    return mutex;
+}
+
+void mutex_destroy (SDL_mutex *mutex)
+{
+    unsigned i;
+
+    if (!mutex)
+        return;
+
+    /* the profile is kept for the report */
+    SDL_AtomicLock(&table_lock);
+    i = slot_of(mutex);
+    for (int n = 0; n < LOCK_TABLE_SIZE; n++, i = (i + 1) & (LOCK_TABLE_SIZE - 1)) {
+        void *key = SDL_AtomicGetPtr(&keys[i]);
+        if (!key)
+            break;
+        if (key == mutex) {
+            SDL_AtomicSetPtr(&keys[i], LOCK_REMOVED);
+            break;
+        }
+    }
+    SDL_AtomicUnlock(&table_lock);
+    SDL_DestroyMutex(mutex);
+}
+
+int mutex_lock (SDL_mutex *mutex)
+{
+    LockProfile *p = mutex ? lookup(mutex) : NULL;
+    Uint64       begin;
+    int          ret;
+
+    if (!p)
+        return SDL_LockMutex(mutex);
+
+    /* the wait is only timed when the mutex is held by another thread */
+    ret = SDL_TryLockMutex(mutex);
+    if (SDL_MUTEX_TIMEDOUT == ret) {
+        begin = now_us();
+        ret = SDL_LockMutex(mutex);
+        if (ret < 0)
+            return ret;
+        add_wait(p, (int64_t)(now_us() - begin));
+    } else if (ret < 0) {
+        return ret;
+    }
+    p->acquires++;
+    if (!p->depth++)
+        p->hold_begin = now_us();
+
+    return 0;
+}
+
+int mutex_unlock (SDL_mutex *mutex)
+{
+    LockProfile *p = mutex ? lookup(mutex) : NULL;
+
+    if (p && p->depth > 0 && !--p->depth)
+        end_hold(p);
+
+    return SDL_UnlockMutex(mutex);
+}
+
+int cond_wait (SDL_cond *cond, SDL_mutex *mutex)
+{
+    return cond_wait_timeout(cond, mutex, SDL_MUTEX_MAXWAIT);
+}
+
+int cond_wait_timeout (SDL_cond *cond, SDL_mutex *mutex, Uint32 ms)
+{
+    LockProfile *p = mutex ? lookup(mutex) : NULL;
+    int          depth = 0;
+    int          ret;
+
+    /* the mutex is released while waiting, it is not held */
+    if (p) {
+        depth = p->depth;
+        p->depth = 0;
+        if (depth)
+            end_hold(p);
+    }
+    if (SDL_MUTEX_MAXWAIT == ms)
+        ret = SDL_CondWait(cond, mutex);
+    else
+        ret = SDL_CondWaitTimeout(cond, mutex, ms);
+    if (p) {
+        p->cond_waits++;
+        p->depth = depth;
+        if (depth)
+            p->hold_begin = now_us();
+    }
+
+    return ret;
+}
+
+#endif /* LOCK_PROFILE */
+
+static void print_line (FILE *fp, const char *line)
+{
+    if (fp)
+        fputs(line, fp);
+    else
+        logger.info("%s", line);
+}
+
+void lock_report (FILE *fp)
+{
+#ifdef LOCK_PROFILE
+    LockProfile  sums[LOCK_MAX_NAMES];
+    LockProfile *profs;
+    char         line[512];
+    int          nb_names = 0;
+    int          len;
+
+    SDL_AtomicLock(&table_lock);
+    profs = all_profiles;
+    SDL_AtomicUnlock(&table_lock);
+
+    /* sum the mutexes of a name, the counters of the locks held are approximate */
+    memset(sums, 0, sizeof(sums));
+    for (LockProfile *p = profs; p; p = p->next) {
+        int i;
+        for (i = 0; i < nb_names && strcmp(sums[i].name, p->name); i++)
+            ;
+        if (i == LOCK_MAX_NAMES)
+            continue;
+        if (i == nb_names)
+            sums[nb_names++].name = p->name;
+        sums[i].acquires += p->acquires;
+        sums[i].contended += p->contended;
+        sums[i].cond_waits += p->cond_waits;
+        sums[i].wait_time += p->wait_time;
+        sums[i].wait_max = FFMAX(sums[i].wait_max, p->wait_max);
+        sums[i].hold_time += p->hold_time;
+        sums[i].hold_max = FFMAX(sums[i].hold_max, p->hold_max);
+        for (int b = 0; b < LOCK_HIST_BUCKETS; b++)
+            sums[i].wait_hist[b] += p->wait_hist[b];
+    }
+
+    /* the most waited first */
+    for (int i = 1; i < nb_names; i++) {
+        for (int j = i; j > 0 && sums[j].wait_time > sums[j - 1].wait_time; j--) {
+            LockProfile t = sums[j];
+            sums[j] = sums[j - 1];
+            sums[j - 1] = t;
+        }
+    }
+
+    print_line(fp, "Lock profile (unit: microsecond):\n");
+    snprintf(line, sizeof(line), "%-28s %10s %10s %8s %12s %10s %12s %10s\n",
+             "lock", "acquires", "contended", "waits", "wait total", "wait max", "hold total", "hold max");
+    print_line(fp, line);
+    for (int i = 0; i < nb_names; i++) {
+        LockProfile *s = &sums[i];
+        snprintf(line, sizeof(line), "%-28s %10lld %10lld %8lld %12lld %10lld %12lld %10lld\n",
+                 s->name, (long long)s->acquires, (long long)s->contended, (long long)s->cond_waits,
+                 (long long)s->wait_time, (long long)s->wait_max, (long long)s->hold_time, (long long)s->hold_max);
+        print_line(fp, line);
+        if (!s->contended)
+            continue;
+
+        /* histogram of the contended waits */
+        len = snprintf(line, sizeof(line), "%-28s", "  wait histogram");
+        for (int b = 0; b < LOCK_HIST_BUCKETS && len < (int)sizeof(line) - 32; b++) {
+            if (!s->wait_hist[b])
+                continue;
+            if (b < LOCK_HIST_BUCKETS - 1)
+                len += snprintf(line + len, sizeof(line) - len, " <%lld:%lld",
+                                (long long)1 << b, (long long)s->wait_hist[b]);
+            else
+                len += snprintf(line + len, sizeof(line) - len, " >=%lld:%lld",
+                                (long long)1 << (b - 1), (long long)s->wait_hist[b]);
+        }
+        snprintf(line + len, sizeof(line) - len, "\n");
+        print_line(fp, line);
+    }
+#else /* LOCK_PROFILE */
+    print_line(fp, "Lock profiling is not built in, define LOCK_PROFILE.\n");
+#endif /* LOCK_PROFILE */
+}
+
+void lock_reset ()
+{
+#ifdef LOCK_PROFILE
+    SDL_AtomicLock(&table_lock);
+    for (LockProfile *p = all_profiles; p; p = p->next) {
+        p->acquires = p->contended = p->cond_waits = 0;
+        p->wait_time = p->wait_max = p->hold_time = p->hold_max = 0;
+        memset(p->wait_hist, 0, sizeof(p->wait_hist));
+    }
+    SDL_AtomicUnlock(&table_lock);
+#endif /* LOCK_PROFILE */
+}
+
+bool lock_is_profiled ()
+{
+#ifdef LOCK_PROFILE
+    return true;
+#else /* LOCK_PROFILE */
+    return false;
+#endif /* LOCK_PROFILE */
+}
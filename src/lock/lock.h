@@ -0,0 +1,72 @@
+#ifndef _AVPLAYERWIDGET_LOCK_H_
+#define _AVPLAYERWIDGET_LOCK_H_
+
+#include <cstdio>
+#include "avplayerwidget_global.h"
+
+extern "C"
+{
+#include "SDL2/SDL.h"
+}
+
+/*
+* mutexes of the player,
+* they are SDL mutexes with a name, the calls go straight to SDL,
+* in the builds with LOCK_PROFILE defined every lock records
+* acquires, contended acquires, a histogram of the wait time and the hold time,
+* lock_report() prints them by name
+*/
+
+/* wait time histogram, bucket n counts the waits under 2^n microseconds, the last counts the rest */
+#define LOCK_HIST_BUCKETS   24
+
+#ifdef LOCK_PROFILE
+
+SDL_mutex *mutex_create       (const char *name);
+void       mutex_destroy      (SDL_mutex *mutex);
+int        mutex_lock         (SDL_mutex *mutex);
+int        mutex_unlock       (SDL_mutex *mutex);
+int        cond_wait          (SDL_cond *cond, SDL_mutex *mutex);
+int        cond_wait_timeout  (SDL_cond *cond, SDL_mutex *mutex, Uint32 ms);
+
+#else /* LOCK_PROFILE */
+
+static inline SDL_mutex *mutex_create (const char *name)
+{
+    (void)name;
+    return SDL_CreateMutex();
+}
+
+static inline void mutex_destroy (SDL_mutex *mutex)
+{
+    SDL_DestroyMutex(mutex);
+}
+
+static inline int mutex_lock (SDL_mutex *mutex)
+{
+    return SDL_LockMutex(mutex);
+}
+
+static inline int mutex_unlock (SDL_mutex *mutex)
+{
+    return SDL_UnlockMutex(mutex);
+}
+
+static inline int cond_wait (SDL_cond *cond, SDL_mutex *mutex)
+{
+    return SDL_CondWait(cond, mutex);
+}
+
+static inline int cond_wait_timeout (SDL_cond *cond, SDL_mutex *mutex, Uint32 ms)
+{
+    return SDL_CondWaitTimeout(cond, mutex, ms);
+}
+
+#endif /* LOCK_PROFILE */
+
+/* prints the profile of the locks to fp, or to the log if fp is NULL */
+AVPLAYERWIDGET_EXPORT void lock_report      (FILE *fp);
+void                       lock_reset       ();
+AVPLAYERWIDGET_EXPORT bool lock_is_profiled ();
+
+#endif /* _AVPLAYERWIDGET_LOCK_H_ */
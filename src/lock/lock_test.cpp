@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include "lock.h"
+
+/* the counters are only kept in the builds with LOCK_PROFILE */
+
+static void read_report (char *buf, int size)
+{
+    FILE *fp = tmpfile();
+    int   len;
+
+    ASSERT_TRUE(fp != NULL);
+    lock_report(fp);
+    rewind(fp);
+    len = (int)fread(buf, 1, size - 1, fp);
+    buf[len] = '\0';
+    fclose(fp);
+}
+
+static bool report_line (const char *report, const char *name, long long v[7])
+{
+    const char *p = strstr(report, name);
+
+    if (!p)
+        return false;
+    return 7 == sscanf(p + strlen(name), "%lld %lld %lld %lld %lld %lld %lld",
+                       &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6]);
+}
+
+static int hold_proc (void *args)
+{
+    SDL_mutex *m = (SDL_mutex *)args;
+
+    mutex_lock(m);
+    SDL_Delay(200);
+    mutex_unlock(m);
+    return 0;
+}
+
+TEST(lock_test, contention)
+{
+    SDL_mutex * m;
+    SDL_Thread *t;
+    char        report[4096];
+    long long   v[7];
+
+    if (!lock_is_profiled())
+        return;
+    lock_reset();
+    m = mutex_create("lock_test contention");
+    ASSERT_TRUE(m != NULL);
+
+    /* uncontended, recursive */
+    mutex_lock(m);
+    mutex_lock(m);
+    mutex_unlock(m);
+    mutex_unlock(m);
+
+    /* held by another thread for 200ms */
+    t = SDL_CreateThread(hold_proc, "hold", m);
+    SDL_Delay(50);
+    mutex_lock(m);
+    mutex_unlock(m);
+    SDL_WaitThread(t, NULL);
+    mutex_destroy(m);
+
+    read_report(report, sizeof(report));
+    ASSERT_TRUE(report_line(report, "lock_test contention", v)) << report;
+    EXPECT_EQ(4, v[0]);             // acquires
+    EXPECT_EQ(1, v[1]);             // contended
+    EXPECT_GT(v[3], 100000);        // wait total
+    EXPECT_EQ(v[3], v[4]);          // wait max
+    EXPECT_GT(v[5], 150000);        // hold total
+    EXPECT_TRUE(strstr(report, "wait histogram") != NULL);
+}
+
+TEST(lock_test, cond_wait)
+{
+    SDL_mutex *m;
+    SDL_cond * c;
+    char       report[4096];
+    long long  v[7];
+
+    if (!lock_is_profiled())
+        return;
+    lock_reset();
+    m = mutex_create("lock_test cond");
+    c = SDL_CreateCond();
+    ASSERT_TRUE(m && c);
+
+    /* the time in the wait is not held */
+    mutex_lock(m);
+    EXPECT_EQ(SDL_MUTEX_TIMEDOUT, cond_wait_timeout(c, m, 100));
+    mutex_unlock(m);
+    SDL_DestroyCond(c);
+    mutex_destroy(m);
+
+    read_report(report, sizeof(report));
+    ASSERT_TRUE(report_line(report, "lock_test cond", v)) << report;
+    EXPECT_EQ(1, v[0]);
+    EXPECT_EQ(0, v[1]);
+    EXPECT_EQ(1, v[2]);             // cond waits
+    EXPECT_LT(v[5], 50000);
+
+    /* reset clears the counters */
+    lock_reset();
+    read_report(report, sizeof(report));
+    ASSERT_TRUE(report_line(report, "lock_test cond", v));
+    EXPECT_EQ(0, v[0]);
+    EXPECT_EQ(0, v[2]);
+}
@@ -2,44 +2,214 @@
 #include "error/error.h"
 #include <cstdio>
 #include <cstdarg>
+#include <cstring>
+#include <new>
 
 Logger logger;
 
-int Logger::write_log(int level, const char * fmt, va_list *vl) 
+int Logger::write_log(int level, const char * fmt, va_list *vl)
 {
-    char    err_str[4096]; ///////////////////////////////////////
+    LogRecord *rec;
+    unsigned   pos;
+    int        label;
+    int        len;
 
-    if (!fplog)
+    if (!SDL_AtomicGet(&running))
         return KERROR(KEUNINITED);
+    if (level > SDL_AtomicGet(&this->level))
+        return 0;
+
+    /* claim a free record, lock-free, the record is dropped if the ring is full */
+    pos = (unsigned)SDL_AtomicGet(&enqueue_pos);
+    while (true) {
+        rec = &ring[pos & (LOG_RING_SIZE - 1)];
+        int diff = (int)((unsigned)SDL_AtomicGet(&rec->seq) - pos);
+        if (!diff) {
+            if (SDL_AtomicCAS(&enqueue_pos, (int)pos, (int)(pos + 1)))
+                break;
+            pos = (unsigned)SDL_AtomicGet(&enqueue_pos);
+        } else if (diff < 0) {
+            SDL_AtomicIncRef(&dropped);
+            return KERROR(KEAGAIN);
+        } else {
+            pos = (unsigned)SDL_AtomicGet(&enqueue_pos);
+        }
+    }
+
+    /* format in place, truncated to the record */
+    label = 0;
+    if (!dis_level_label) {
+        memcpy(rec->text, log_level_map[level].str, 4);
+        label = 4;
+    }
+    len = vsnprintf(rec->text + label, LOG_MAX_RECORD - label, fmt, *vl);
+    if (len < 0)
+        len = 0;
+    rec->len = label + (len < LOG_MAX_RECORD - label ? len : LOG_MAX_RECORD - label - 1);
+
+    /* publish it to the flusher */
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&rec->seq, (int)(pos + 1));
+
+    return 0;
+}
+
+int Logger::write_batch ()
+{
+    LogRecord *rec;
+    int64_t    rotate_size;
+    int        rotate_files;
+    int        n = 0;
+    int        lost;
+
+    /* write the records in order until one is not filled yet */
+    while (true) {
+        rec = &ring[dequeue_pos & (LOG_RING_SIZE - 1)];
+        if ((int)((unsigned)SDL_AtomicGet(&rec->seq) - (dequeue_pos + 1)) < 0)
+            break;
+        SDL_MemoryBarrierAcquire();
+        if (fplog) {
+            fwrite(rec->text, 1, (size_t)rec->len, fplog);
+            file_size += rec->len;
+        }
+#ifdef _DEBUG
+        fwrite(rec->text, 1, (size_t)rec->len, stderr);
+#endif /* _DEBUG */
 
-    if (dis_level_label) {
-        vsprintf(err_str, fmt, *vl);
-    } else {
-        sprintf(err_str, "%s", log_level_map[level].str);
-        vsprintf(err_str + 4, fmt, *vl);
+        /* free it for the producers of the next lap */
+        SDL_AtomicSet(&rec->seq, (int)(dequeue_pos + LOG_RING_SIZE));
+        dequeue_pos++;
+        n++;
     }
+    lost = SDL_AtomicSet(&dropped, 0);
+    if (lost && fplog)
+        file_size += fprintf(fplog, "%s%d log records dropped.\n", log_level_map[LOG_WARNING].str, lost);
+    if (n || lost) {
+        if (fplog)
+            fflush(fplog);
 #ifdef _DEBUG
-    fputs(err_str, stderr);
-    fflush(stderr);
+        fflush(stderr);
 #endif /* _DEBUG */
-    fputs(err_str, fplog);
-    fflush(fplog);
+    }
+    SDL_AtomicSet(&flushed_pos, (int)dequeue_pos);
+    SDL_LockMutex(flushed_mutex);
+    SDL_CondBroadcast(flushed_cond);
+    SDL_UnlockMutex(flushed_mutex);
+
+    /* rotate between the batches */
+    SDL_AtomicLock(&rotation_lock);
+    rotate_size = max_size;
+    rotate_files = max_files;
+    SDL_AtomicUnlock(&rotation_lock);
+    if (rotate_size > 0 && file_size >= rotate_size)
+        rotate(rotate_files);
+
+    return n;
+}
+
+void Logger::rotate (int max_files)
+{
+    char from[LOG_MAX_PATH + 16];
+    char to[LOG_MAX_PATH + 16];
+
+    if (fplog)
+        fclose(fplog);
+
+    /* file.N-1 -> file.N, ..., file -> file.1, the oldest is removed */
+    snprintf(to, sizeof(to), "%s.%d", file_name, max_files);
+    remove(to);
+    for (int i = max_files - 1; i >= 1; i--) {
+        snprintf(from, sizeof(from), "%s.%d", file_name, i);
+        snprintf(to, sizeof(to), "%s.%d", file_name, i + 1);
+        rename(from, to);
+    }
+    snprintf(to, sizeof(to), "%s.1", file_name);
+    if (max_files > 0)
+        rename(file_name, to);
+    else
+        remove(file_name);
+
+    /* the records are dropped until the file is open again */
+    fplog = fopen(file_name, "a");
+    file_size = 0;
+}
+
+int Logger::flush_proc (void *args)
+{
+    Logger *l = (Logger *)args;
+
+    /* the records of the callers racing with close() are written by the last batch */
+    while (SDL_AtomicGet(&l->running)) {
+        SDL_SemWaitTimeout(l->wake_sem, LOG_FLUSH_INTERVAL);
+        l->write_batch();
+    }
+    l->write_batch();
 
     return 0;
 }
 
 int Logger::init (const char *file_name)
 {
-    if (!file_name)
+    int ret;
+
+    if (!file_name || strlen(file_name) >= LOG_MAX_PATH)
         return KERROR(KEINVAL);
+    if (SDL_AtomicGet(&running))
+        return KERROR(KEREINIT);
 
     fplog = fopen(file_name, "a");
     if (!fplog)
         return KERROR(KELOG_FILE_OPEN_FAIL);
+    strcpy(this->file_name, file_name);
+    fseek(fplog, 0, SEEK_END);
+    file_size = ftell(fplog);
+
+    /* the ring outlives close(), a late caller never touches freed memory */
+    if (!ring) {
+        ring = _New LogRecord[LOG_RING_SIZE];
+        if (!ring)
+            GOTO_FAIL(KENOMEM);
+    }
+    for (unsigned i = 0; i < LOG_RING_SIZE; i++)
+        SDL_AtomicSet(&ring[i].seq, (int)i);
+    SDL_AtomicSet(&enqueue_pos, 0);
+    dequeue_pos = 0;
+    SDL_AtomicSet(&flushed_pos, 0);
+    SDL_AtomicSet(&dropped, 0);
+
+    /* outlive close() like the ring, a flush() racing with it never touches a destroyed one */
+    if (!flushed_mutex) {
+        flushed_mutex = SDL_CreateMutex();
+        if (!flushed_mutex)
+            GOTO_FAIL(KECREATE_SDL_MUTEX_FAIL);
+    }
+    if (!flushed_cond) {
+        flushed_cond = SDL_CreateCond();
+        if (!flushed_cond)
+            GOTO_FAIL(KECREATE_SDL_COND_FAIL);
+    }
+
+    /* start the flusher */
+    wake_sem = SDL_CreateSemaphore(0);
+    if (!wake_sem)
+        GOTO_FAIL(KECREATE_SDL_COND_FAIL);
+    SDL_AtomicSet(&running, 1);
+    flusher = SDL_CreateThread(flush_proc, "log_flusher", this);
+    if (!flusher) {
+        SDL_AtomicSet(&running, 0);
+        GOTO_FAIL(KECREATE_THREAD_FAIL);
+    }
 
     logger.debug("Logger has been inited.\n");
 
     return 0;
+fail:
+    if (wake_sem)
+        SDL_DestroySemaphore(wake_sem);
+    wake_sem = NULL;
+    fclose(fplog);
+    fplog = NULL;
+    return ret;
 }
 
 int Logger::fatal (const char * fmt, ...)
@@ -119,10 +289,91 @@ int Logger::verbose (const char * fmt, ...)
 #endif /* _DEBUG */
 }
 
+int Logger::log (int level, const char * fmt, ...)
+{
+    if (level < LOG_FATAL || level > LOG_VERBOSE)
+        return KERROR(KEINVAL);
+
+    va_list vl;
+    va_start(vl, fmt);
+    int ret = write_log(level, fmt, &vl);
+    va_end(vl);
+
+    return ret;
+}
+
+bool Logger::is_enabled (int level)
+{
+    if (!SDL_AtomicGet(&running) || level > SDL_AtomicGet(&this->level))
+        return false;
+
+    switch (level) {
+    case LOG_INFO:
+        return !dis_info_log;
+    case LOG_DEBUG:
+        return !dis_debug_log;
+    case LOG_VERBOSE:
+        return !dis_verbose_log;
+    default:
+        return true;
+    }
+}
+
+void Logger::flush ()
+{
+    int target = SDL_AtomicGet(&enqueue_pos);
+
+    if (!SDL_AtomicGet(&running))
+        return;
+
+    /* the records claimed but not filled yet are waited for too */
+    SDL_LockMutex(flushed_mutex);
+    while (SDL_AtomicGet(&running) && (int)((unsigned)SDL_AtomicGet(&flushed_pos) - (unsigned)target) < 0) {
+        SDL_SemPost(wake_sem);
+        SDL_CondWait(flushed_cond, flushed_mutex);
+    }
+    SDL_UnlockMutex(flushed_mutex);
+}
+
 void Logger::close ()
 {
-    fclose(fplog);
+    if (!SDL_AtomicGet(&running))
+        return;
+
     logger.debug("Logger closed.\n");
+
+    /* the flusher writes the last batch and quits */
+    SDL_AtomicSet(&running, 0);
+    SDL_SemPost(wake_sem);
+    SDL_WaitThread(flusher, NULL);
+    flusher = NULL;
+    SDL_LockMutex(flushed_mutex);
+    SDL_CondBroadcast(flushed_cond);
+    SDL_UnlockMutex(flushed_mutex);
+    SDL_DestroySemaphore(wake_sem);
+    wake_sem = NULL;
+    if (fplog)
+        fclose(fplog);
+    fplog = NULL;
+}
+
+void Logger::set_level (int level)
+{
+    SDL_AtomicSet(&this->level, level);
+}
+
+int Logger::get_level ()
+{
+    return SDL_AtomicGet(&level);
+}
+
+void Logger::set_rotation (int64_t max_size, int max_files)
+{
+    /* taken by the flusher at the next batch */
+    SDL_AtomicLock(&rotation_lock);
+    this->max_size = max_size > 0 ? max_size : 0;
+    this->max_files = max_files > 0 ? max_files : 0;
+    SDL_AtomicUnlock(&rotation_lock);
 }
 
 void Logger::dis_info ()
@@ -172,4 +423,31 @@ Logger::Logger ()
     dis_debug_log = false;
     dis_verbose_log = false;
     dis_level_label = false;
+    ring = NULL;
+    SDL_AtomicSet(&enqueue_pos, 0);
+    dequeue_pos = 0;
+    SDL_AtomicSet(&dropped, 0);
+    SDL_AtomicSet(&level, LOG_VERBOSE);
+    SDL_AtomicSet(&running, 0);
+    flusher = NULL;
+    wake_sem = NULL;
+    SDL_AtomicSet(&flushed_pos, 0);
+    flushed_mutex = NULL;
+    flushed_cond = NULL;
+    file_name[0] = '\0';
+    file_size = 0;
+    rotation_lock = 0;
+    max_size = LOG_DEF_MAX_SIZE;
+    max_files = LOG_DEF_MAX_FILES;
+}
+
+Logger::~Logger ()
+{
+    /* the records left are written at exit */
+    close();
+    delete[] ring;
+    if (flushed_cond)
+        SDL_DestroyCond(flushed_cond);
+    if (flushed_mutex)
+        SDL_DestroyMutex(flushed_mutex);
 }
@@ -3,15 +3,17 @@
 
 #include <cstdio>
 #include <cstdarg>
+#include <cstdint>
 
 extern "C"
 {
 #define __STDC_CONSTANT_MACROS
 #include "libavutil/log.h"
+#include "SDL2/SDL.h"
 }
 
 enum LogLevel {
-    LOG_FATAL   = 0, 
+    LOG_FATAL   = 0,
     LOG_ERROR   = 1,
     LOG_WARNING = 2,
     LOG_INFO    = 3,
@@ -25,6 +27,52 @@ enum LogLevel {
 
 #define ARRAY_ELEMS(a) (sizeof(a) / sizeof((a)[0]))
 
+/*
+* compile-time floor, the records above it are compiled away with their arguments,
+* the runtime level of the logger applies below it,
+* it can be set by the build, e.g. -DLOG_COMPILED_LEVEL=3
+*/
+#ifndef LOG_COMPILED_LEVEL
+#ifdef _DEBUG
+#define LOG_COMPILED_LEVEL  LOG_VERBOSE
+#else
+#define LOG_COMPILED_LEVEL  LOG_INFO
+#endif /* _DEBUG */
+#endif /* LOG_COMPILED_LEVEL */
+
+template <int level>
+struct LogCompiled {
+    static const bool value = level <= LOG_COMPILED_LEVEL;
+};
+
+/*
+* the arguments are evaluated only when the record is written,
+* usage: KLOGV("%d\n", pktq->get_size());
+*/
+#define KLOG(level, ...)                                                \
+    do {                                                                \
+        if (LogCompiled<level>::value && logger.is_enabled(level))     \
+            logger.log(level, __VA_ARGS__);                             \
+    } while (0)
+#define KLOGF(...) KLOG(LOG_FATAL, __VA_ARGS__)
+#define KLOGE(...) KLOG(LOG_ERROR, __VA_ARGS__)
+#define KLOGW(...) KLOG(LOG_WARNING, __VA_ARGS__)
+#define KLOGI(...) KLOG(LOG_INFO, __VA_ARGS__)
+#define KLOGD(...) KLOG(LOG_DEBUG, __VA_ARGS__)
+#define KLOGV(...) KLOG(LOG_VERBOSE, __VA_ARGS__)
+
+/* ring of records, a power of 2 */
+#define LOG_RING_SIZE       1024
+#define LOG_MAX_RECORD      512  // longer records are truncated, label included
+
+/* the flusher writes the records every so often (unit: millisecond) */
+#define LOG_FLUSH_INTERVAL  20
+
+/* rotation, file.1 is the newest old file */
+#define LOG_DEF_MAX_SIZE    (10 * 1024 * 1024)
+#define LOG_DEF_MAX_FILES   3
+#define LOG_MAX_PATH        1024
+
 static const struct {
     int         level;
     const char *str;
@@ -36,20 +84,65 @@ static const struct {
                      {LOG_VERBOSE, "[V] "}
 };
 
+/* a formatted record in the ring */
+typedef struct LogRecord {
+    SDL_atomic_t seq;  // the position it is free for, or the position + 1 when it is filled
+    int          len;
+    char         text[LOG_MAX_RECORD];
+}LogRecord;
+
+/*
+* asynchronous logger,
+* the callers format the records into a lock-free ring and return,
+* a background thread writes them to the file in batches and rotates it,
+* the format is done by the caller as the arguments may not outlive the call,
+* it is bounded by LOG_MAX_RECORD
+*
+* a call never blocks: it takes no lock, allocates nothing and makes no system call,
+* when the ring is full the record is dropped and counted,
+* so it is safe from the audio callback
+*/
 #ifdef _WIN32
 class _declspec(dllimport) Logger {
 #else
 class Logger {
 #endif
 private:
-    FILE *fplog;
-    bool  dis_info_log;
-    bool  dis_debug_log;
-    bool  dis_verbose_log;
-    bool  dis_level_label;
+    FILE *       fplog;
+    bool         dis_info_log;
+    bool         dis_debug_log;
+    bool         dis_verbose_log;
+    bool         dis_level_label;
+
+    /* ring, multiple producers and the flusher */
+    LogRecord *  ring;
+    SDL_atomic_t enqueue_pos;
+    unsigned     dequeue_pos;     // only touched by the flusher
+    SDL_atomic_t dropped;         // records dropped for the ring being full
+    SDL_atomic_t level;           // records above are skipped
+    SDL_atomic_t running;
+
+    /* flusher */
+    SDL_Thread * flusher;
+    SDL_sem *    wake_sem;        // posted by close() and flush(), never by the callers
+    SDL_atomic_t flushed_pos;     // records before are written
+    SDL_mutex *  flushed_mutex;
+    SDL_cond *   flushed_cond;    // broadcast by the flusher after every batch, waited by flush()
+
+    /* rotation */
+    char         file_name[LOG_MAX_PATH];
+    int64_t      file_size;       // only touched by the flusher
+    SDL_SpinLock rotation_lock;   // set_rotation() races with the flusher
+    int64_t      max_size;        // 0 for no rotation
+    int          max_files;
 
 private:
-    int  write_log   (int level, const char * fmt, va_list *vl); 
+    static int   flush_proc  (void *args);
+
+private:
+    int  write_log   (int level, const char * fmt, va_list *vl);
+    int  write_batch ();
+    void rotate      (int max_files);
 
 public:
     int  init        (const char *file_name);
@@ -59,7 +152,13 @@ public:
     int  info        (const char *fmt, ...);
     int  debug       (const char *fmt, ...);
     int  verbose     (const char *fmt, ...);
+    int  log         (int level, const char *fmt, ...);
+    bool is_enabled  (int level); // checked by KLOG() before the arguments are evaluated
+    void flush       (); // waits until the records logged before are written
     void close       ();
+    void set_level   (int level);
+    int  get_level   ();
+    void set_rotation (int64_t max_size, int max_files);
     void dis_info    ();
     void dis_debug   ();
     void dis_verbose ();
@@ -68,9 +167,10 @@ public:
     void en_debug    ();
     void en_verbose  ();
     void en_label    ();
-    
+
 public:
     Logger           ();
+    ~Logger          ();
 };
 
 #ifdef _WIN32
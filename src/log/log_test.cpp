@@ -0,0 +1,205 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#define LOG_COMPILED_LEVEL LOG_INFO
+#include "log.h"
+#include "error/error.h"
+#include "testutil/testutil.h"
+
+#define TEST_LOG "log_test.log"
+
+static int count_records (const std::string &s, const char *prefix)
+{
+    int    n = 0;
+    size_t pos = 0;
+
+    while ((pos = s.find(prefix, pos)) != std::string::npos) {
+        n++;
+        pos++;
+    }
+
+    return n;
+}
+
+typedef struct WriterArgs {
+    Logger *l;
+    int     id;
+    int     n;
+}WriterArgs;
+
+static int writer_proc (void *args)
+{
+    WriterArgs *a = (WriterArgs *)args;
+
+    for (int i = 0; i < a->n; i++) {
+        while (a->l->info("writer %d record %d\n", a->id, i) == KERROR(KEAGAIN))
+            SDL_Delay(1);
+    }
+
+    return 0;
+}
+
+TEST(log_test, uninited)
+{
+    Logger l;
+
+    EXPECT_EQ(KERROR(KEUNINITED), l.info("lost\n"));
+    l.flush();
+    l.close();
+}
+
+TEST(log_test, multi_thread)
+{
+    Logger      l;
+    WriterArgs  args[4];
+    SDL_Thread *threads[4];
+    std::string s;
+
+    remove(TEST_LOG);
+    ASSERT_EQ(0, l.init(TEST_LOG));
+    for (int i = 0; i < 4; i++) {
+        args[i].l = &l;
+        args[i].id = i;
+        args[i].n = 5000;
+        threads[i] = SDL_CreateThread(writer_proc, "writer", &args[i]);
+    }
+    for (int i = 0; i < 4; i++)
+        SDL_WaitThread(threads[i], NULL);
+    l.flush();
+
+    /* every record is written whole, in the order of its writer, the ones dropped are retried */
+    s = read_file(TEST_LOG);
+    EXPECT_EQ(4 * 5000, count_records(s, "[I] writer"));
+    for (int i = 0; i < 4; i++) {
+        char   rec[64];
+        size_t last = 0;
+        for (int j = 0; j < 5000; j += 499) {
+            snprintf(rec, sizeof(rec), "[I] writer %d record %d\n", i, j);
+            size_t pos = s.find(rec);
+            ASSERT_NE(std::string::npos, pos);
+            EXPECT_LE(last, pos);
+            last = pos;
+        }
+    }
+    l.close();
+    remove(TEST_LOG);
+}
+
+TEST(log_test, full_ring)
+{
+    Logger      l;
+    std::string s;
+    const int   n = LOG_RING_SIZE * 16;
+    int         dropped = 0;
+    int         lost = 0;
+    uint64_t    start;
+    size_t      pos = 0;
+
+    remove(TEST_LOG);
+    ASSERT_EQ(0, l.init(TEST_LOG));
+
+    /* many more records than the ring holds in less than a flush interval, the caller never waits */
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < n; i++) {
+        if (l.info("record %d of the full ring test\n", i) == KERROR(KEAGAIN))
+            dropped++;
+    }
+    EXPECT_LT((double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency(), 1.0);
+    EXPECT_GT(dropped, 0);
+    l.flush();
+
+    /* the records written and the ones counted as dropped are all of them */
+    s = read_file(TEST_LOG);
+    while ((pos = s.find("[W] ", pos)) != std::string::npos) {
+        lost += atoi(s.c_str() + pos + 4);
+        pos++;
+    }
+    EXPECT_EQ(dropped, lost);
+    EXPECT_EQ(n - dropped, count_records(s, "[I] record"));
+    l.close();
+    remove(TEST_LOG);
+}
+
+TEST(log_test, truncate_and_level)
+{
+    Logger      l;
+    std::string s;
+    std::string big(LOG_MAX_RECORD * 2, 'x');
+
+    remove(TEST_LOG);
+    ASSERT_EQ(0, l.init(TEST_LOG));
+    l.set_level(LOG_WARNING);
+    EXPECT_EQ(LOG_WARNING, l.get_level());
+    l.info("skipped\n");
+    l.warning("%s\n", big.c_str());
+    l.close();
+
+    /* the record is cut to the ring record, label included */
+    s = read_file(TEST_LOG);
+    EXPECT_EQ(std::string::npos, s.find("skipped"));
+    EXPECT_EQ((size_t)LOG_MAX_RECORD - 1, s.size());
+    EXPECT_EQ(0, s.compare(0, 4, "[W] "));
+    remove(TEST_LOG);
+}
+
+TEST(log_test, rotation)
+{
+    Logger      l;
+    std::string s;
+
+    remove(TEST_LOG);
+    remove(TEST_LOG ".1");
+    remove(TEST_LOG ".2");
+    remove(TEST_LOG ".3");
+    l.set_rotation(1000, 2);
+    ASSERT_EQ(0, l.init(TEST_LOG));
+    for (int i = 0; i < 100; i++) {
+        l.info("record %03d of the rotation test\n", i);
+        l.flush();
+    }
+    l.close();
+
+    /* the newest records are in the file, the older ones in file.1 and file.2 */
+    EXPECT_NE(std::string::npos, read_file(TEST_LOG).find("record 099"));
+    EXPECT_FALSE(read_file(TEST_LOG ".1").empty());
+    EXPECT_FALSE(read_file(TEST_LOG ".2").empty());
+    EXPECT_TRUE(read_file(TEST_LOG ".3").empty());
+    EXPECT_GE(1000u + LOG_MAX_RECORD, read_file(TEST_LOG ".1").size());
+    remove(TEST_LOG);
+    remove(TEST_LOG ".1");
+    remove(TEST_LOG ".2");
+}
+
+static int evaluated (int *n)
+{
+    return ++*n;
+}
+
+TEST(log_test, compiled_level)
+{
+    int         n = 0;
+    std::string s;
+
+    remove(TEST_LOG);
+    ASSERT_EQ(0, logger.init(TEST_LOG));
+
+    /* above the floor, compiled away */
+    KLOGD("debug %d\n", evaluated(&n));
+    KLOGV("verbose %d\n", evaluated(&n));
+    EXPECT_EQ(0, n);
+
+    /* below the floor, filtered at runtime before the arguments */
+    logger.set_level(LOG_WARNING);
+    KLOGI("info %d\n", evaluated(&n));
+    EXPECT_EQ(0, n);
+    KLOGW("warning %d\n", evaluated(&n));
+    EXPECT_EQ(1, n);
+    logger.set_level(LOG_VERBOSE);
+    logger.close();
+
+    s = read_file(TEST_LOG);
+    EXPECT_EQ("[W] warning 1\n", s);
+    remove(TEST_LOG);
+}
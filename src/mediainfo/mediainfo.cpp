@@ -0,0 +1,238 @@
+#include <cstdio>
+#include "mediainfo.h"
+#include "error/error.h"
+#include "log/log.h"
+
+extern "C"
+{
+#include "libavutil/pixdesc.h"
+#include "libavutil/samplefmt.h"
+}
+
+#define FILENAME "mediainfo.cpp"
+
+static std::string get_tag (AVDictionary *dict, const char *key)
+{
+    AVDictionaryEntry *tag = av_dict_get(dict, key, NULL, 0);
+
+    return tag && tag->value ? tag->value : "";
+}
+
+static std::string format_time (double t)
+{
+    char buf[32];
+    int  s = (int)t;
+
+    snprintf(buf, sizeof(buf), "%02d:%02d:%02d.%02d", s / 3600, s / 60 % 60, s % 60, (int)((t - s) * 100));
+
+    return buf;
+}
+
+int MediaInfo::read (const AVFormatContext *avfctx)
+{
+    AVDictionaryEntry *tag = NULL;
+    MediaStreamInfo    si;
+    MediaChapter       ch;
+    AVStream *         st;
+    AVRational         rate;
+    const char *       name;
+    int64_t            size;
+
+    if (!avfctx || !avfctx->iformat)
+        return KERROR(KEINVAL);
+    clear();
+
+    /* container */
+    url = avfctx->url ? avfctx->url : "";
+    format = avfctx->iformat->name ? avfctx->iformat->name : "";
+    format_name = avfctx->iformat->long_name ? avfctx->iformat->long_name : format;
+    size = avfctx->pb && !(avfctx->iformat->flags & AVFMT_NOFILE) ? avio_size(avfctx->pb) : 0;
+    this->size = size > 0 ? size : 0;
+    duration = avfctx->duration > 0 ? avfctx->duration / (double)AV_TIME_BASE : 0.0;
+    start_time = AV_NOPTS_VALUE != avfctx->start_time ? avfctx->start_time / (double)AV_TIME_BASE : 0.0;
+    bitrate = avfctx->bit_rate > 0 ? avfctx->bit_rate : 0;
+    while ((tag = av_dict_get(avfctx->metadata, "", tag, AV_DICT_IGNORE_SUFFIX)))
+        tags.push_back(std::make_pair(std::string(tag->key), std::string(tag->value)));
+
+    /* streams */
+    streams.reserve(avfctx->nb_streams);
+    for (unsigned int i = 0; i < avfctx->nb_streams; i++) {
+        st = avfctx->streams[i];
+        si = MediaStreamInfo();
+        si.index = i;
+        si.type = st->codecpar->codec_type;
+        si.codec = avcodec_get_name(st->codecpar->codec_id);
+        name = avcodec_profile_name(st->codecpar->codec_id, st->codecpar->profile);
+        si.profile = name ? name : "";
+        si.language = get_tag(st->metadata, "language");
+        si.bitrate = st->codecpar->bit_rate > 0 ? st->codecpar->bit_rate : 0;
+        si.cover = !!(st->disposition & AV_DISPOSITION_ATTACHED_PIC);
+        if (AVMEDIA_TYPE_VIDEO == si.type) {
+            si.width = st->codecpar->width;
+            si.height = st->codecpar->height;
+            rate = st->avg_frame_rate.num && st->avg_frame_rate.den ? st->avg_frame_rate : st->r_frame_rate;
+            si.fps = rate.num && rate.den ? av_q2d(rate) : 0.0;
+            name = av_get_pix_fmt_name((enum AVPixelFormat)st->codecpar->format);
+            si.pix_fmt = name ? name : "";
+        } else if (AVMEDIA_TYPE_AUDIO == si.type) {
+            si.sample_rate = st->codecpar->sample_rate;
+            si.channels = st->codecpar->channels;
+            name = av_get_sample_fmt_name((enum AVSampleFormat)st->codecpar->format);
+            si.sample_fmt = name ? name : "";
+        }
+        streams.push_back(si);
+    }
+
+    /* chapters */
+    chapters.reserve(avfctx->nb_chapters);
+    for (unsigned int i = 0; i < avfctx->nb_chapters; i++) {
+        ch.start = avfctx->chapters[i]->start * av_q2d(avfctx->chapters[i]->time_base);
+        ch.end = avfctx->chapters[i]->end * av_q2d(avfctx->chapters[i]->time_base);
+        ch.title = get_tag(avfctx->chapters[i]->metadata, "title");
+        chapters.push_back(ch);
+    }
+
+    return 0;
+}
+
+void MediaInfo::clear ()
+{
+    url.clear();
+    format.clear();
+    format_name.clear();
+    size = 0;
+    duration = 0.0;
+    start_time = 0.0;
+    bitrate = 0;
+    streams.clear();
+    chapters.clear();
+    tags.clear();
+}
+
+const MediaStreamInfo *MediaInfo::get_video () const
+{
+    for (size_t i = 0; i < streams.size(); i++) {
+        if (AVMEDIA_TYPE_VIDEO == streams[i].type && !streams[i].cover)
+            return &streams[i];
+    }
+
+    return NULL;
+}
+
+const MediaStreamInfo *MediaInfo::get_audio () const
+{
+    for (size_t i = 0; i < streams.size(); i++) {
+        if (AVMEDIA_TYPE_AUDIO == streams[i].type)
+            return &streams[i];
+    }
+
+    return NULL;
+}
+
+std::string MediaInfo::to_text () const
+{
+    std::string text;
+    const char *type;
+    char        buf[256];
+
+    text += "File: " + url + "\n";
+    text += "Format: " + format_name + " (" + format + ")\n";
+    if (size) {
+        snprintf(buf, sizeof(buf), "Size: %.2f MB\n", size / (1024.0 * 1024.0));
+        text += buf;
+    }
+    text += "Duration: " + (duration > 0.0 ? format_time(duration) : std::string("unknown")) + "\n";
+    if (bitrate) {
+        snprintf(buf, sizeof(buf), "Bitrate: %lld kb/s\n", (long long)(bitrate / 1000));
+        text += buf;
+    }
+
+    for (size_t i = 0; i < streams.size(); i++) {
+        const MediaStreamInfo &si = streams[i];
+
+        type = av_get_media_type_string((enum AVMediaType)si.type);
+        snprintf(buf, sizeof(buf), "Stream #%d: %s %s", si.index, type ? type : "unknown", si.codec.c_str());
+        text += buf;
+        if (!si.profile.empty())
+            text += " (" + si.profile + ")";
+        if (AVMEDIA_TYPE_VIDEO == si.type) {
+            snprintf(buf, sizeof(buf), ", %dx%d", si.width, si.height);
+            text += buf;
+            if (si.fps > 0.0) {
+                snprintf(buf, sizeof(buf), ", %.3g fps", si.fps);
+                text += buf;
+            }
+            if (!si.pix_fmt.empty())
+                text += ", " + si.pix_fmt;
+            if (si.cover)
+                text += ", cover";
+        } else if (AVMEDIA_TYPE_AUDIO == si.type) {
+            snprintf(buf, sizeof(buf), ", %d Hz, %d channels", si.sample_rate, si.channels);
+            text += buf;
+            if (!si.sample_fmt.empty())
+                text += ", " + si.sample_fmt;
+        }
+        if (si.bitrate) {
+            snprintf(buf, sizeof(buf), ", %lld kb/s", (long long)(si.bitrate / 1000));
+            text += buf;
+        }
+        if (!si.language.empty())
+            text += " [" + si.language + "]";
+        text += "\n";
+    }
+
+    for (size_t i = 0; i < chapters.size(); i++) {
+        snprintf(buf, sizeof(buf), "Chapter #%d: %s - %s ", (int)i,
+                 format_time(chapters[i].start).c_str(), format_time(chapters[i].end).c_str());
+        text += buf + chapters[i].title + "\n";
+    }
+
+    for (size_t i = 0; i < tags.size(); i++)
+        text += tags[i].first + ": " + tags[i].second + "\n";
+
+    return text;
+}
+
+MediaInfo::MediaInfo ()
+{
+    clear();
+}
+
+MediaInfo::~MediaInfo ()
+{
+}
+
+int media_probe (const char *url, const AVIOInterruptCB *int_cb,
+                 int64_t probesize, int64_t analyze_duration, MediaInfo *info)
+{
+    AVFormatContext *avfctx;
+    int              ret;
+
+    avfctx = avformat_alloc_context();
+    if (!avfctx)
+        return KERROR(KENOMEM);
+    if (int_cb)
+        avfctx->interrupt_callback = *int_cb;
+    if (probesize > 0)
+        avfctx->probesize = probesize;
+    if (analyze_duration > 0)
+        avfctx->max_analyze_duration = analyze_duration;
+
+    /* freed by avformat_open_input() if failed */
+    ret = avformat_open_input(&avfctx, url, NULL, NULL);
+    if (ret < 0) {
+        KLOGD("%s %s: %s.\n", kerr2str(KEOPEN_INPUT_FAIL), url, av_err2str(ret));
+        return KERROR(KEOPEN_INPUT_FAIL);
+    }
+    ret = avformat_find_stream_info(avfctx, NULL);
+    if (ret < 0) {
+        avformat_close_input(&avfctx);
+        KLOGD("%s %s: %s.\n", kerr2str(KEFIND_STREAM_INFO_FAIL), url, av_err2str(ret));
+        return KERROR(KEFIND_STREAM_INFO_FAIL);
+    }
+    ret = info->read(avfctx);
+    info->url = url;
+    avformat_close_input(&avfctx);
+
+    return ret;
+}
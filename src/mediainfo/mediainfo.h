@@ -0,0 +1,76 @@
+#ifndef _AVPLAYERWIDGET_MEDIAINFO_H_
+#define _AVPLAYERWIDGET_MEDIAINFO_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+#include "avplayerwidget_global.h"
+
+extern "C"
+{
+#include "libavformat/avformat.h"
+}
+
+/* a stream of the media */
+typedef struct MediaStreamInfo {
+    int                index;
+    int                type;         // AVMEDIA_TYPE_*
+    std::string        codec;        // short name, "none" if unknown
+    std::string        profile;      // empty if none
+    std::string        language;     // of the tags, empty if none
+    int64_t            bitrate;      // 0 if unknown (unit: bit/s)
+    bool               cover;        // an attached picture
+
+    /* video */
+    int                width;
+    int                height;
+    double             fps;          // 0 if unknown
+    std::string        pix_fmt;
+
+    /* audio */
+    int                sample_rate;
+    int                channels;
+    std::string        sample_fmt;
+}MediaStreamInfo;
+
+/* a chapter of the media (unit: second) */
+typedef struct MediaChapter {
+    double             start;
+    double             end;
+    std::string        title;        // empty if none
+}MediaChapter;
+
+typedef std::vector<std::pair<std::string, std::string> > MediaTags;
+
+/* media info */
+class AVPLAYERWIDGET_EXPORT MediaInfo {
+public:
+    std::string                  url;
+    std::string                  format;      // short names of the demuxer, "mov,mp4,m4a,3gp,3g2,mj2"
+    std::string                  format_name; // long name of the demuxer
+    int64_t                      size;        // of the file, 0 if unknown (unit: byte)
+    double                       duration;    // 0 if unknown (unit: second)
+    double                       start_time;  // (unit: second)
+    int64_t                      bitrate;     // total, 0 if unknown (unit: bit/s)
+    std::vector<MediaStreamInfo> streams;
+    std::vector<MediaChapter>    chapters;
+    MediaTags                    tags;        // of the container
+
+public:
+    int                    read      (const AVFormatContext *avfctx); // from a context with the stream info found
+    void                   clear     ();
+    const MediaStreamInfo *get_video () const; // the first video stream which is not a cover, NULL if none
+    const MediaStreamInfo *get_audio () const; // the first audio stream, NULL if none
+    std::string            to_text   () const; // report of a line for a field
+
+public:
+    MediaInfo ();
+    ~MediaInfo ();
+};
+
+/* opens url and reads its info, 0 for the default probesize or analyze duration of FFmpeg */
+AVPLAYERWIDGET_EXPORT int media_probe (const char *url, const AVIOInterruptCB *int_cb,
+                                       int64_t probesize, int64_t analyze_duration, MediaInfo *info);
+
+#endif /* _AVPLAYERWIDGET_MEDIAINFO_H_ */
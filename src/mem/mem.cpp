@@ -0,0 +1,194 @@
+#include <cstring>
+#include "mem.h"
+#include "error/error.h"
+#include "log/log.h"
+
+#define FILENAME "mem.cpp"
+
+static const char *kind_names[MEM_KINDS] = {
+    "packets", "frames", "textures", "sample buffers"
+};
+
+void mem_stats_reset (MemStats *mem)
+{
+    /* before the stats are shared, the lock is initialized here too */
+    mem->lock = 0;
+    for (int i = 0; i < MEM_KINDS; i++) {
+        SDL_AtomicSet(&mem->count[i], 0);
+        mem->bytes[i] = 0;
+    }
+    mem->peak = 0;
+}
+
+void mem_add (MemStats *mem, int kind, int count, int bytes)
+{
+    int64_t total = 0;
+
+    if (!mem || kind < 0 || kind >= MEM_KINDS)
+        return;
+    if (count)
+        SDL_AtomicAdd(&mem->count[kind], count);
+    if (!bytes)
+        return;
+    SDL_AtomicLock(&mem->lock);
+    mem->bytes[kind] += bytes;
+
+    /* the peak is raised by the growing side only */
+    if (bytes > 0) {
+        for (int i = 0; i < MEM_KINDS; i++)
+            total += mem->bytes[i];
+        if (total > mem->peak)
+            mem->peak = total;
+    }
+    SDL_AtomicUnlock(&mem->lock);
+}
+
+void mem_get_usage (MemStats *mem, MemUsage *usage)
+{
+    memset(usage, 0, sizeof(MemUsage));
+    if (!mem)
+        return;
+    for (int i = 0; i < MEM_KINDS; i++)
+        usage->count[i] = SDL_AtomicGet(&mem->count[i]);
+    SDL_AtomicLock(&mem->lock);
+    for (int i = 0; i < MEM_KINDS; i++) {
+        usage->bytes[i] = mem->bytes[i];
+        usage->total += usage->bytes[i];
+    }
+    usage->peak = mem->peak;
+    SDL_AtomicUnlock(&mem->lock);
+}
+
+int64_t mem_get_total (MemStats *mem)
+{
+    int64_t total = 0;
+
+    if (!mem)
+        return 0;
+    SDL_AtomicLock(&mem->lock);
+    for (int i = 0; i < MEM_KINDS; i++)
+        total += mem->bytes[i];
+    SDL_AtomicUnlock(&mem->lock);
+
+    return total;
+}
+
+const char *mem_kind_name (int kind)
+{
+    return kind >= 0 && kind < MEM_KINDS ? kind_names[kind] : "unknown";
+}
+
+int mem_check_leaks (MemStats *mem, unsigned mask, const char *owner)
+{
+    MemUsage usage;
+    int      leaks = 0;
+
+    mem_get_usage(mem, &usage);
+    for (int i = 0; i < MEM_KINDS; i++) {
+        if (!(mask & (1u << i)) || (!usage.count[i] && !usage.bytes[i]))
+            continue;
+        logger.warning("%s: %d %s (%lld bytes) still alive.\n",
+                       owner, usage.count[i], kind_names[i], (long long)usage.bytes[i]);
+        leaks += usage.count[i] ? usage.count[i] : 1;
+    }
+
+    return leaks;
+}
+
+int mem_packet_size (const AVPacket *pkt)
+{
+    if (!pkt)
+        return 0;
+
+    /* the padding is part of the buffer */
+    return pkt->buf ? pkt->buf->size : pkt->size;
+}
+
+int mem_frame_size (const AVFrame *f)
+{
+    int size = 0;
+
+    if (!f)
+        return 0;
+    for (int i = 0; i < AV_NUM_DATA_POINTERS && f->buf[i]; i++)
+        size += f->buf[i]->size;
+    for (int i = 0; i < f->nb_extended_buf; i++)
+        size += f->extended_buf[i]->size;
+
+    return size;
+}
+
+int mem_texture_size (SDL_Texture *texture)
+{
+    Uint32 fmt;
+    int    w;
+    int    h;
+
+    if (!texture || SDL_QueryTexture(texture, &fmt, NULL, &w, &h) < 0)
+        return 0;
+
+    /* the planar YUV formats take 12 bits a pixel */
+    switch (fmt) {
+    case SDL_PIXELFORMAT_YV12:
+    case SDL_PIXELFORMAT_IYUV:
+    case SDL_PIXELFORMAT_NV12:
+    case SDL_PIXELFORMAT_NV21:
+        return w * h * 3 / 2;
+    default:
+        return w * h * SDL_BYTESPERPIXEL(fmt);
+    }
+}
+
+AVPacket *mem_packet_alloc (MemStats *mem)
+{
+    AVPacket *pkt = av_packet_alloc();
+
+    if (pkt)
+        mem_add(mem, MEM_PACKET, 1, 0);
+
+    return pkt;
+}
+
+void mem_packet_fill (MemStats *mem, const AVPacket *pkt)
+{
+    mem_add(mem, MEM_PACKET, 0, mem_packet_size(pkt));
+}
+
+void mem_packet_free (MemStats *mem, AVPacket **pkt)
+{
+    if (!pkt || !*pkt)
+        return;
+    mem_add(mem, MEM_PACKET, -1, -mem_packet_size(*pkt));
+    av_packet_free(pkt);
+}
+
+AVFrame *mem_frame_alloc (MemStats *mem)
+{
+    AVFrame *f = av_frame_alloc();
+
+    if (f)
+        mem_add(mem, MEM_FRAME, 1, 0);
+
+    return f;
+}
+
+void mem_frame_fill (MemStats *mem, const AVFrame *f)
+{
+    mem_add(mem, MEM_FRAME, 0, mem_frame_size(f));
+}
+
+void mem_frame_unref (MemStats *mem, AVFrame *f)
+{
+    if (!f)
+        return;
+    mem_add(mem, MEM_FRAME, 0, -mem_frame_size(f));
+    av_frame_unref(f);
+}
+
+void mem_frame_free (MemStats *mem, AVFrame **f)
+{
+    if (!f || !*f)
+        return;
+    mem_add(mem, MEM_FRAME, -1, -mem_frame_size(*f));
+    av_frame_free(f);
+}
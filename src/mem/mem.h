@@ -0,0 +1,66 @@
+#ifndef _AVPLAYERWIDGET_MEM_H_
+#define _AVPLAYERWIDGET_MEM_H_
+
+extern "C"
+{
+#include "libavcodec/avcodec.h"
+#include "SDL2/SDL.h"
+}
+
+/*
+* memory accounting of a player session,
+* the objects allocated and freed through these functions are counted
+* with the bytes of the buffers they reference,
+* the refcounted buffers shared by several frames are counted for each frame
+*/
+
+/* kinds of objects */
+enum {
+    MEM_PACKET = 0, // AVPacket and its buffer
+    MEM_FRAME,      // AVFrame and its buffers
+    MEM_TEXTURE,    // SDL texture
+    MEM_SAMPLES,    // resampled audio buffer
+    MEM_KINDS
+};
+#define MEM_ALL_KINDS       ((1u << MEM_KINDS) - 1)
+
+/* live objects and bytes, written by any thread */
+typedef struct MemStats {
+    SDL_atomic_t count[MEM_KINDS];
+    SDL_SpinLock lock;             // protects bytes and peak, 64 bits do not fit an SDL_atomic_t
+    int64_t      bytes[MEM_KINDS];
+    int64_t      peak;             // peak of the total bytes
+}MemStats;
+
+/* a snapshot */
+typedef struct MemUsage {
+    int     count[MEM_KINDS];
+    int64_t bytes[MEM_KINDS];
+    int64_t total;
+    int64_t peak;
+}MemUsage;
+
+void       mem_stats_reset  (MemStats *mem); // not thread-safe, before the stats are shared
+void       mem_add          (MemStats *mem, int kind, int count, int bytes);
+void       mem_get_usage    (MemStats *mem, MemUsage *usage);
+int64_t    mem_get_total    (MemStats *mem);
+const char*mem_kind_name    (int kind);
+
+/* logs the objects of the kinds in mask still alive, returns the number of them */
+int        mem_check_leaks  (MemStats *mem, unsigned mask, const char *owner);
+
+/* sizes of the buffers */
+int        mem_packet_size  (const AVPacket *pkt);
+int        mem_frame_size   (const AVFrame *f);
+int        mem_texture_size (SDL_Texture *texture);
+
+/* counted allocations, mem can be NULL */
+AVPacket * mem_packet_alloc (MemStats *mem);
+void       mem_packet_fill  (MemStats *mem, const AVPacket *pkt);
+void       mem_packet_free  (MemStats *mem, AVPacket **pkt);
+AVFrame *  mem_frame_alloc  (MemStats *mem);
+void       mem_frame_fill   (MemStats *mem, const AVFrame *f);
+void       mem_frame_unref  (MemStats *mem, AVFrame *f);
+void       mem_frame_free   (MemStats *mem, AVFrame **f);
+
+#endif /* _AVPLAYERWIDGET_MEM_H_ */
@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+#include "mem.h"
+
+TEST(mem_test, usage)
+{
+    MemStats mem;
+    MemUsage usage;
+
+    mem_stats_reset(&mem);
+
+    /* 2 packets of 1000 bytes and a frame of 5000 bytes */
+    mem_add(&mem, MEM_PACKET, 1, 1000);
+    mem_add(&mem, MEM_PACKET, 1, 1000);
+    mem_add(&mem, MEM_FRAME, 1, 0);
+    mem_add(&mem, MEM_FRAME, 0, 5000);
+    mem_get_usage(&mem, &usage);
+    EXPECT_EQ(2, usage.count[MEM_PACKET]);
+    EXPECT_EQ(2000, usage.bytes[MEM_PACKET]);
+    EXPECT_EQ(1, usage.count[MEM_FRAME]);
+    EXPECT_EQ(7000, usage.total);
+    EXPECT_EQ(7000, usage.peak);
+
+    /* the peak is kept */
+    mem_add(&mem, MEM_FRAME, -1, -5000);
+    mem_add(&mem, MEM_TEXTURE, 1, 100);
+    mem_get_usage(&mem, &usage);
+    EXPECT_EQ(2100, usage.total);
+    EXPECT_EQ(7000, usage.peak);
+
+    /* NULL is ignored */
+    mem_add(NULL, MEM_PACKET, 1, 1);
+    mem_get_usage(NULL, &usage);
+    EXPECT_EQ(0, usage.total);
+}
+
+TEST(mem_test, leaks)
+{
+    MemStats mem;
+
+    mem_stats_reset(&mem);
+    EXPECT_EQ(0, mem_check_leaks(&mem, MEM_ALL_KINDS, "mem_test"));
+
+    /* the kinds out of the mask are not checked */
+    mem_add(&mem, MEM_TEXTURE, 1, 4096);
+    EXPECT_EQ(0, mem_check_leaks(&mem, MEM_ALL_KINDS & ~(1u << MEM_TEXTURE), "mem_test"));
+    EXPECT_EQ(1, mem_check_leaks(&mem, MEM_ALL_KINDS, "mem_test"));
+
+    /* bytes left without an object are a leak too */
+    mem_add(&mem, MEM_TEXTURE, -1, -4096);
+    mem_add(&mem, MEM_FRAME, 0, 10);
+    EXPECT_EQ(1, mem_check_leaks(&mem, MEM_ALL_KINDS, "mem_test"));
+}
+
+TEST(mem_test, large)
+{
+    MemStats mem;
+    MemUsage usage;
+
+    mem_stats_reset(&mem);
+
+    /* 3 GiB of frames, past the range of an int */
+    for (int i = 0; i < 3; i++)
+        mem_add(&mem, MEM_FRAME, 1, 1 << 30);
+    mem_get_usage(&mem, &usage);
+    EXPECT_EQ(3LL << 30, usage.bytes[MEM_FRAME]);
+    EXPECT_EQ(3LL << 30, usage.total);
+    EXPECT_EQ(3LL << 30, usage.peak);
+    EXPECT_EQ(3LL << 30, mem_get_total(&mem));
+
+    mem_add(&mem, MEM_FRAME, -3, -(1 << 30));
+    mem_add(&mem, MEM_FRAME, 0, -(1 << 30));
+    mem_add(&mem, MEM_FRAME, 0, -(1 << 30));
+    EXPECT_EQ(0, mem_check_leaks(&mem, MEM_ALL_KINDS, "mem_test"));
+    mem_get_usage(&mem, &usage);
+    EXPECT_EQ(3LL << 30, usage.peak);
+}
@@ -2,6 +2,7 @@
 #include "msger.h"
 #include "error/error.h"
 #include "log/log.h"
+#include <cstring>
 
 extern "C" {
 #include "SDL2/SDL.h"
@@ -10,6 +11,11 @@ extern "C" {
 
 #define FILENAME "msger.h"
 
+/* text of render_text() */
+#define MSGER_MAX_LINES  32
+#define MSGER_MAX_LINE   256
+#define MSGER_PADDING    6
+
 int Msger::init (const char * font_file, SDL_Renderer *renderer)
 {
 #if defined(__MACOSX__) || defined(__LINUX__)
@@ -38,7 +44,7 @@ int Msger::init (const char * font_file, SDL_Renderer *renderer)
         GOTO_FAIL(KEOPEN_FONT_FAIL);
     }
 
-    logger.debug("Mesger has been inited.\n");
+    KLOGD("Mesger has been inited.\n");
 
 fail:
     if (ret < 0)
@@ -79,6 +85,86 @@ int Msger::render_msg (const char *msg, SDL_Rect *rect)
     return 0;
 }
 
+int Msger::render_text (const char *text, SDL_Color color, SDL_Color bg, SDL_Rect *rect)
+{
+#if defined(__MACOSX__) || defined(__LINUX__)
+    return 0;
+#endif
+
+    SDL_Surface *lines[MSGER_MAX_LINES];
+    SDL_Surface *surf = NULL;
+    SDL_Rect     dst;
+    char         line[MSGER_MAX_LINE];
+    int          nb_lines = 0;
+    int          w = 0;
+    int          skip;
+    int          ret = 0;
+
+    if (!sdl_renderer)
+        return KERROR(KEUNINITED);
+
+    if (!text || !rect)
+        return KERROR(KEINVAL);
+
+    /* render the lines, TTF renders no line break */
+    skip = TTF_FontLineSkip(font);
+    for (const char *p = text; *p && nb_lines < MSGER_MAX_LINES; ) {
+        const char *end = strchr(p, '\n');
+        size_t      len = end ? (size_t)(end - p) : strlen(p);
+
+        if (len >= MSGER_MAX_LINE)
+            len = MSGER_MAX_LINE - 1;
+        memcpy(line, p, len);
+        line[len] = '\0';
+        lines[nb_lines] = len ? TTF_RenderUTF8_Blended(font, line, color) : NULL;
+        if (lines[nb_lines] && lines[nb_lines]->w > w)
+            w = lines[nb_lines]->w;
+        nb_lines++;
+        if (!end)
+            break;
+        p = end + 1;
+    }
+
+    /* draw them on the background */
+    rect->w = w + MSGER_PADDING * 2;
+    rect->h = nb_lines * skip + MSGER_PADDING * 2;
+    surf = SDL_CreateRGBSurfaceWithFormat(0, rect->w, rect->h, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (!surf) {
+        logger.FATALN("[%s: %d]%s: %s", kerr2str(KECREATE_SDL_SURFACE_FAIL), SDL_GetError());
+        GOTO_FAIL(KECREATE_SDL_SURFACE_FAIL);
+    }
+    SDL_FillRect(surf, NULL, SDL_MapRGBA(surf->format, bg.r, bg.g, bg.b, bg.a));
+    for (int i = 0; i < nb_lines; i++) {
+        if (!lines[i])
+            continue;
+        dst.x = MSGER_PADDING;
+        dst.y = MSGER_PADDING + i * skip;
+        dst.w = lines[i]->w;
+        dst.h = lines[i]->h;
+        SDL_SetSurfaceBlendMode(lines[i], SDL_BLENDMODE_BLEND);
+        SDL_BlitSurface(lines[i], NULL, surf, &dst);
+    }
+
+    if (texture)
+        SDL_DestroyTexture(texture);
+    texture = SDL_CreateTextureFromSurface(sdl_renderer, surf);
+    if (!texture) {
+        logger.FATALN("[%s: %d]%s: %s", kerr2str(KECREATE_TEXTURE_FAIL), SDL_GetError());
+        GOTO_FAIL(KECREATE_TEXTURE_FAIL);
+    }
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+fail:
+    for (int i = 0; i < nb_lines; i++) {
+        if (lines[i])
+            SDL_FreeSurface(lines[i]);
+    }
+    if (surf)
+        SDL_FreeSurface(surf);
+
+    return ret;
+}
+
 SDL_Texture * Msger::get_texture () const
 {
     return texture;
@@ -108,7 +194,7 @@ void Msger::close ()
 
     sdl_renderer = NULL;
 
-    logger.debug("Mesger closed.\n");
+    KLOGD("Mesger closed.\n");
 }
 
 Msger::Msger ()
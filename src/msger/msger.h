@@ -19,6 +19,7 @@ private:
 public:
     int          init        (const char *font_file, SDL_Renderer *renderer);
     int          render_msg  (const char *msg, SDL_Rect *rect);
+    int          render_text (const char *text, SDL_Color color, SDL_Color bg, SDL_Rect *rect); // lines on a background
     SDL_Texture *get_texture () const;
     void         close       ();
  
@@ -0,0 +1,229 @@
+#include <cstring>
+#include <cctype>
+#include "plimport.h"
+#include "error/error.h"
+#include "log/log.h"
+
+#define FILENAME "plimport.cpp"
+
+static bool has_prefix (const StrRef &s, const char *prefix) // ignoring case
+{
+    int len = (int)strlen(prefix);
+
+    if (s.size < len)
+        return false;
+    for (int i = 0; i < len; i++) {
+        if (tolower((unsigned char)s.data[i]) != tolower((unsigned char)prefix[i]))
+            return false;
+    }
+
+    return true;
+}
+
+static StrRef trim (const char *begin, const char *end)
+{
+    StrRef s;
+
+    while (begin < end && isspace((unsigned char)*begin))
+        begin++;
+    while (end > begin && isspace((unsigned char)end[-1]))
+        end--;
+    s.data = begin;
+    s.size = (int)(end - begin);
+
+    return s;
+}
+
+static int parse_int (const char *p, const char *end) // -1 if not a number
+{
+    int v = 0;
+
+    if (p >= end || !isdigit((unsigned char)*p))
+        return -1;
+    for (; p < end && isdigit((unsigned char)*p) && v < 100000000; p++)
+        v = v * 10 + (*p - '0');
+
+    return v;
+}
+
+bool PlaylistImport::is_playlist (const char *path)
+{
+    const char *ext = strrchr(path, '.');
+    StrRef      s;
+
+    if (!ext || strchr(ext, '/') || strchr(ext, '\\'))
+        return false;
+    s.data = ext;
+    s.size = (int)strlen(ext);
+
+    return (5 == s.size && has_prefix(s, ".m3u8")) || (4 == s.size && (has_prefix(s, ".m3u") || has_prefix(s, ".pls")));
+}
+
+int PlaylistImport::open (const std::string &path)
+{
+    StrRef      first;
+    StrRef      ext;
+    const char *p;
+
+    if (opened)
+        return KERROR(KEREINIT);
+
+    if (file_map(path.c_str(), &m) < 0) {
+        logger.error("Failed to map playlist %s.\n", path.c_str());
+        return KERROR(KEPLAYLIST_OPEN_FAIL);
+    }
+    pos = (const char *)m.data;
+    end = pos + (m.data ? m.size : 0);
+    if (end - pos >= 3 && !memcmp(pos, "\xEF\xBB\xBF", 3)) // utf-8 bom
+        pos += 3;
+
+    /* by the extension or the section of pls, the servers may name a pls as m3u */
+    p = pos;
+    while (p < end && isspace((unsigned char)*p))
+        p++;
+    first.data = p;
+    first.size = (int)min(end - p, 16);
+    ext.data = path.c_str() + (path.size() > 4 ? path.size() - 4 : 0);
+    ext.size = (int)strlen(ext.data);
+    format = ((4 == ext.size && has_prefix(ext, ".pls")) || has_prefix(first, "[playlist]"))
+             ? PLIMPORT_PLS : PLIMPORT_M3U;
+
+    title.data = NULL;
+    title.size = 0;
+    duration = -1;
+    opened = true;
+    KLOGD("Playlist %s opened, %lld bytes.\n", path.c_str(), (long long)m.size);
+
+    return 0;
+}
+
+void PlaylistImport::close ()
+{
+    if (!opened)
+        return;
+
+    file_unmap(&m);
+    pos = end = NULL;
+    opened = false;
+}
+
+bool PlaylistImport::next_line (StrRef *line)
+{
+    const char *nl;
+
+    if (pos >= end)
+        return false;
+    nl = (const char *)memchr(pos, '\n', end - pos);
+    *line = trim(pos, nl ? nl : end);
+    pos = nl ? nl + 1 : end;
+
+    return true;
+}
+
+bool PlaylistImport::parse_m3u (const StrRef &line, ImportEntry *entry)
+{
+    const char *p;
+    const char *e = line.data + line.size;
+    const char *comma;
+
+    if (!line.size)
+        return false;
+
+    /* #EXTINF:duration[ attributes],title, the info of the next url */
+    if ('#' == line.data[0]) {
+        if (has_prefix(line, "#EXTINF:")) {
+            p = line.data + 8;
+            duration = parse_int(p, e); // -1 in the live playlists
+            comma = (const char *)memchr(p, ',', e - p);
+            title = comma ? trim(comma + 1, e) : trim(e, e);
+        }
+        return false;
+    }
+
+    entry->url = line;
+    entry->title = title;
+    entry->duration = duration;
+    title.data = NULL;
+    title.size = 0;
+    duration = -1;
+
+    return true;
+}
+
+bool PlaylistImport::parse_pls (const StrRef &line, ImportEntry *entry)
+{
+    const char *e = line.data + line.size;
+    const char *eq;
+    const char *p;
+
+    /* FileN=url, the titles and lengths are keyed by N and not kept */
+    if (!has_prefix(line, "File"))
+        return false;
+    eq = (const char *)memchr(line.data, '=', line.size);
+    if (!eq)
+        return false;
+    for (p = line.data + 4; p < eq && isdigit((unsigned char)*p); p++)
+        ;
+    if (p == line.data + 4 || trim(p, eq).size)
+        return false;
+
+    entry->url = trim(eq + 1, e);
+    entry->title.data = NULL;
+    entry->title.size = 0;
+    entry->duration = -1;
+
+    return entry->url.size > 0;
+}
+
+int PlaylistImport::read (std::vector<ImportEntry> &entries, int max)
+{
+    ImportEntry entry;
+    StrRef      line;
+    int         n = 0;
+
+    if (!opened)
+        return KERROR(KEUNINITED);
+
+    while (n < max && next_line(&line)) {
+        if (PLIMPORT_PLS == format ? parse_pls(line, &entry) : parse_m3u(line, &entry)) {
+            entries.push_back(entry);
+            n++;
+        }
+    }
+
+    return n;
+}
+
+bool PlaylistImport::is_open () const
+{
+    return opened;
+}
+
+int PlaylistImport::get_format () const
+{
+    return format;
+}
+
+int PlaylistImport::get_progress () const
+{
+    if (!opened || !m.data)
+        return 100;
+
+    return (int)((pos - (const char *)m.data) * 100 / m.size);
+}
+
+PlaylistImport::PlaylistImport ()
+{
+    memset(&m, 0, sizeof(m));
+    pos = end = NULL;
+    format = PLIMPORT_M3U;
+    title.data = NULL;
+    title.size = 0;
+    duration = -1;
+    opened = false;
+}
+
+PlaylistImport::~PlaylistImport ()
+{
+    close();
+}
@@ -0,0 +1,68 @@
+#ifndef _AVPLAYERWIDGET_PLIMPORT_H_
+#define _AVPLAYERWIDGET_PLIMPORT_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "utils/utils.h"
+
+/*
+* streaming import of M3U, M3U8 and PLS playlists,
+* the file is mapped and read a chunk of entries at a time,
+* the strings of the entries point into the mapping and are valid until close(),
+* the urls are kept as written, the relative ones are resolved by the owner
+*/
+
+#define PLIMPORT_BATCH      4096  // entries read in a chunk by the player
+
+/* formats */
+enum {
+    PLIMPORT_M3U = 0,             // m3u and m3u8, with or without the extended info
+    PLIMPORT_PLS
+};
+
+/* a string in the mapped file, not terminated */
+typedef struct StrRef {
+    const char *data;
+    int         size;
+}StrRef;
+
+/* an entry of the playlist */
+typedef struct ImportEntry {
+    StrRef      url;              // as written in the playlist
+    StrRef      title;            // empty if none
+    int         duration;         // -1 if unknown (unit: second)
+}ImportEntry;
+
+class PlaylistImport {
+private:
+    MappedFile  m;
+    const char *pos;              // of the next line
+    const char *end;
+    int         format;
+    StrRef      title;            // of the #EXTINF before the next url
+    int         duration;
+    bool        opened;
+
+public:
+    int         open        (const std::string &path);
+    void        close       ();
+    int         read        (std::vector<ImportEntry> &entries, int max); // appends up to max entries, 0 at the end
+    bool        is_open     () const;
+    int         get_format  () const;
+    int         get_progress() const; // of the file read (unit: percent)
+
+public:
+    static bool is_playlist (const char *path); // by extension
+
+public:
+    PlaylistImport ();
+    ~PlaylistImport ();
+
+private:
+    bool        next_line   (StrRef *line);
+    bool        parse_m3u   (const StrRef &line, ImportEntry *entry);
+    bool        parse_pls   (const StrRef &line, ImportEntry *entry);
+};
+
+#endif /* _AVPLAYERWIDGET_PLIMPORT_H_ */
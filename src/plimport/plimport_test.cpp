@@ -0,0 +1,93 @@
+#include <cstdio>
+#include <gtest/gtest.h>
+#include "plimport.h"
+#include "testutil/testutil.h"
+
+static void write_file (const std::string &path, const char *data)
+{
+    FILE *fp = fopen(path.c_str(), "wb");
+
+    ASSERT_TRUE(fp != NULL);
+    fwrite(data, strlen(data), 1, fp);
+    fclose(fp);
+}
+
+static std::string str (const StrRef &s)
+{
+    return std::string(s.data ? s.data : "", s.size);
+}
+
+TEST(plimport_test, m3u)
+{
+    std::string              path = test_path("plimport_test.m3u8");
+    std::vector<ImportEntry> entries;
+    PlaylistImport           pl;
+
+    write_file(path, "\xEF\xBB\xBF#EXTM3U\r\n"
+                     "#EXTINF:123,Artist - Title\r\n"
+                     "music/a.mp3\r\n"
+                     "\r\n"
+                     "# a comment\r\n"
+                     "/abs/b.mkv\r\n"
+                     "#EXTINF:-1 tvg-id=\"x\",Live\n"
+                     "http://host/live.m3u8\n"
+                     "C:\\video\\c.mp4");
+    ASSERT_EQ(0, pl.open(path));
+    EXPECT_EQ(PLIMPORT_M3U, pl.get_format());
+
+    /* read in chunks */
+    EXPECT_EQ(1, pl.read(entries, 1));
+    EXPECT_EQ(3, pl.read(entries, 10));
+    EXPECT_EQ(0, pl.read(entries, 10));
+    EXPECT_EQ(100, pl.get_progress());
+    ASSERT_EQ(4u, entries.size());
+
+    EXPECT_EQ("music/a.mp3", str(entries[0].url));
+    EXPECT_EQ("Artist - Title", str(entries[0].title));
+    EXPECT_EQ(123, entries[0].duration);
+    EXPECT_EQ("", str(entries[1].title));
+    EXPECT_EQ(-1, entries[1].duration);
+    EXPECT_EQ("Live", str(entries[2].title));
+    EXPECT_EQ(-1, entries[2].duration);
+
+    EXPECT_EQ("/abs/b.mkv", str(entries[1].url));
+    EXPECT_EQ("http://host/live.m3u8", str(entries[2].url));
+    EXPECT_EQ("C:\\video\\c.mp4", str(entries[3].url));
+
+    pl.close();
+    EXPECT_FALSE(pl.is_open());
+    remove(path.c_str());
+}
+
+TEST(plimport_test, pls)
+{
+    std::string              path = test_path("plimport_test.pls");
+    std::vector<ImportEntry> entries;
+    PlaylistImport           pl;
+
+    write_file(path, "[playlist]\n"
+                     "File1=a.ogg\n"
+                     "Title1=A\n"
+                     "Length1=10\n"
+                     "file2 = http://host/stream\n"
+                     "FileX=bad\n"
+                     "NumberOfEntries=2\n"
+                     "Version=2\n");
+    ASSERT_EQ(0, pl.open(path));
+    EXPECT_EQ(PLIMPORT_PLS, pl.get_format());
+    EXPECT_EQ(2, pl.read(entries, PLIMPORT_BATCH));
+    ASSERT_EQ(2u, entries.size());
+    EXPECT_EQ("a.ogg", str(entries[0].url));
+    EXPECT_EQ("http://host/stream", str(entries[1].url));
+    pl.close();
+    remove(path.c_str());
+}
+
+TEST(plimport_test, is_playlist)
+{
+    EXPECT_TRUE(PlaylistImport::is_playlist("/a/b.M3U"));
+    EXPECT_TRUE(PlaylistImport::is_playlist("/a/b.m3u8"));
+    EXPECT_TRUE(PlaylistImport::is_playlist("C:\\a\\b.pls"));
+    EXPECT_FALSE(PlaylistImport::is_playlist("/a/b.mkv"));
+    EXPECT_FALSE(PlaylistImport::is_playlist("/a.m3u/b"));
+}
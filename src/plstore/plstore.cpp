@@ -0,0 +1,495 @@
+#include <cstring>
+#include "plstore.h"
+#include "inifile/inifile.h"
+#include "error/error.h"
+#include "log/log.h"
+#include "utils/utils.h"
+
+extern "C"
+{
+#include "libavutil/crc.h"
+#include "libavutil/intreadwrite.h"
+}
+
+#define FILENAME "plstore.cpp"
+
+static uint32_t record_crc (int type, const char *url, int size)
+{
+    const AVCRC *table = av_crc_get_table(AV_CRC_32_IEEE_LE);
+    uint8_t      t = (uint8_t)type;
+
+    return av_crc(table, av_crc(table, 0, &t, 1), (const uint8_t *)url, size);
+}
+
+/* the size of the record at p, 0 if it is not a whole valid record */
+static int64_t check_record (const uint8_t *p, const uint8_t *end)
+{
+    uint32_t url_size;
+    int      type;
+
+    if (end - p < PLSTORE_RECORD_SIZE)
+        return 0;
+    url_size = AV_RL32(p);
+    type = p[4];
+    if (url_size > PLSTORE_MAX_URL || end - p - PLSTORE_RECORD_SIZE < (int64_t)url_size)
+        return 0;
+    if (type < PLSTORE_REC_ADD || type > PLSTORE_REC_HISTORY)
+        return 0;
+    if (AV_RL32(p + 5) != record_crc(type, (const char *)p + PLSTORE_RECORD_SIZE, url_size))
+        return 0;
+
+    return PLSTORE_RECORD_SIZE + url_size;
+}
+
+/* the record is built in one buffer and written by one write, returns its size */
+static int write_record (FILE *fp, int type, const std::string &url)
+{
+    std::vector<uint8_t> buf(PLSTORE_RECORD_SIZE + url.size());
+
+    AV_WL32(&buf[0], (uint32_t)url.size());
+    buf[4] = (uint8_t)type;
+    AV_WL32(&buf[5], record_crc(type, url.data(), (int)url.size()));
+    if (!url.empty())
+        memcpy(&buf[PLSTORE_RECORD_SIZE], url.data(), url.size());
+    if (1 != fwrite(&buf[0], buf.size(), 1, fp))
+        return KERROR(KEPLAYLIST_WRITE_FAIL);
+
+    return (int)buf.size();
+}
+
+/* unbuffered, nothing of a failed record is left in the stream to be written later */
+static FILE *open_append (const std::string &path)
+{
+    FILE *fp = fopen(path.c_str(), "ab");
+
+    if (fp)
+        setvbuf(fp, NULL, _IONBF, 0);
+
+    return fp;
+}
+
+int PlaylistStore::open (const std::string &path)
+{
+    MappedFile m;
+    FILE *     test;
+    int64_t    file_size;
+    int64_t    valid = 0;
+    int64_t    skipped = 0;
+    int        ret;
+
+    if (fp)
+        return KERROR(KEREINIT);
+
+    this->path = path;
+    entries.clear();
+    index.clear();
+    history.clear();
+    len = 0;
+    records = 0;
+    size = 0;
+
+    /* a new file */
+    test = fopen(path.c_str(), "rb");
+    if (!test)
+        return compact();
+    fclose(test);
+
+    /* scan the records */
+    if (file_map(path.c_str(), &m) < 0) {
+        logger.error("Failed to map playlist file %s.\n", path.c_str());
+        return KERROR(KEPLAYLIST_OPEN_FAIL);
+    }
+    if (m.size < PLSTORE_HEADER_SIZE) { // torn while the file was created
+        file_unmap(&m);
+        return compact();
+    }
+    if (PLSTORE_MAGIC != AV_RL32(m.data) || AV_RL32(m.data + 4) > PLSTORE_VERSION) {
+        file_unmap(&m);
+        logger.error("%s is not a playlist file of this version.\n", path.c_str());
+        return KERROR(KEPLAYLIST_OPEN_FAIL);
+    }
+    file_size = m.size;
+    ret = load(m.data, m.size, &valid, &skipped);
+    file_unmap(&m);
+    if (ret < 0)
+        return ret;
+
+    /* corrupt records in the middle, the valid ones after them are loaded, the file is rewritten */
+    if (skipped > 0) {
+        logger.warning("Playlist file %s has corrupt records, %lld bytes skipped.\n",
+                       path.c_str(), (long long)skipped);
+        return compact();
+    }
+
+    fp = open_append(path);
+    if (!fp) {
+        logger.error("Failed to open playlist file %s.\n", path.c_str());
+        return KERROR(KEPLAYLIST_OPEN_FAIL);
+    }
+    size = valid;
+
+    /* cut off the record torn by a crash */
+    if (valid < file_size) {
+        logger.warning("Playlist file %s is torn at %lld, %lld bytes dropped.\n",
+                       path.c_str(), (long long)valid, (long long)(file_size - valid));
+        if (file_truncate(fp, valid)) {
+            fclose(fp);
+            fp = NULL;
+            return compact();
+        }
+    }
+
+    return 0;
+}
+
+void PlaylistStore::close ()
+{
+    int64_t live = len + (history.empty() ? 0 : 1);
+    int64_t dead = records - live;
+
+    if (!fp)
+        return;
+
+    /* most of the file is the history of the changes */
+    if (dead >= PLSTORE_MIN_COMPACT && dead > live)
+        compact();
+    if (fp) {
+        if (fclose(fp))
+            logger.error("Failed to write playlist file %s.\n", path.c_str());
+        fp = NULL;
+    }
+    entries.clear();
+    index.clear();
+    history.clear();
+    len = 0;
+    records = 0;
+    size = 0;
+}
+
+int PlaylistStore::load (const uint8_t *data, int64_t size, int64_t *valid, int64_t *skipped)
+{
+    const uint8_t *p = data + PLSTORE_HEADER_SIZE;
+    const uint8_t *end = data + size;
+    const uint8_t *good = p; // the end of the last valid record
+    int64_t        n;
+
+    *skipped = 0;
+    while (end - p >= PLSTORE_RECORD_SIZE) {
+        n = check_record(p, end);
+        if (!n) { // resync on the next byte that starts a valid record
+            p++;
+            continue;
+        }
+        *skipped += p - good;
+        apply(p[4], std::string((const char *)p + PLSTORE_RECORD_SIZE, (size_t)(n - PLSTORE_RECORD_SIZE)));
+        records++;
+        p += n;
+        good = p;
+    }
+    *valid = good - data;
+
+    return 0;
+}
+
+void PlaylistStore::apply (int type, const std::string &url)
+{
+    std::unordered_map<std::string, int>::iterator it;
+
+    switch (type) {
+    case PLSTORE_REC_ADD:
+        if (index.count(url))
+            break;
+        index[url] = (int)entries.size();
+        entries.push_back(Entry{url, false});
+        len++;
+        break;
+    case PLSTORE_REC_REMOVE:
+        it = index.find(url);
+        if (it == index.end())
+            break;
+        entries[it->second].removed = true;
+        index.erase(it);
+        len--;
+        break;
+    case PLSTORE_REC_CLEAR:
+        entries.clear();
+        index.clear();
+        len = 0;
+        break;
+    case PLSTORE_REC_HISTORY:
+        history = url;
+        break;
+    }
+}
+
+int PlaylistStore::append (int type, const std::string &url)
+{
+    int ret;
+
+    if (!fp)
+        return KERROR(KEUNINITED);
+    if (url.size() > PLSTORE_MAX_URL)
+        return KERROR(KEINVAL);
+
+    ret = write_record(fp, type, url);
+    if (ret < 0) {
+        /* a part of the record would hide the ones appended after it */
+        clearerr(fp);
+        if (file_truncate(fp, size))
+            logger.error("Failed to truncate playlist file %s.\n", path.c_str());
+        logger.error("Failed to write playlist file %s.\n", path.c_str());
+        return ret;
+    }
+    size += ret;
+    records++;
+
+    return 0;
+}
+
+int PlaylistStore::add (const std::string &url)
+{
+    int ret;
+
+    if (index.count(url))
+        return 0;
+    ret = append(PLSTORE_REC_ADD, url);
+    if (ret < 0)
+        return ret;
+    apply(PLSTORE_REC_ADD, url);
+
+    return 1;
+}
+
+int PlaylistStore::remove (const std::string &url)
+{
+    int ret;
+
+    if (!index.count(url))
+        return 0;
+    ret = append(PLSTORE_REC_REMOVE, url);
+    if (ret < 0)
+        return ret;
+    apply(PLSTORE_REC_REMOVE, url);
+
+    return 1;
+}
+
+int PlaylistStore::clear ()
+{
+    int ret;
+
+    ret = append(PLSTORE_REC_CLEAR, "");
+    if (ret < 0)
+        return ret;
+    apply(PLSTORE_REC_CLEAR, "");
+
+    return 0;
+}
+
+int PlaylistStore::set_history (const std::string &url)
+{
+    int ret;
+
+    if (url == history)
+        return 0;
+    ret = append(PLSTORE_REC_HISTORY, url);
+    if (ret < 0)
+        return ret;
+    apply(PLSTORE_REC_HISTORY, url);
+
+    return 0;
+}
+
+int PlaylistStore::flush ()
+{
+    if (!fp)
+        return KERROR(KEUNINITED);
+    if (fflush(fp)) {
+        logger.error("Failed to write playlist file %s.\n", path.c_str());
+        return KERROR(KEPLAYLIST_WRITE_FAIL);
+    }
+
+    return 0;
+}
+
+int PlaylistStore::write_file (const std::string &path, int64_t *written)
+{
+    FILE *  out;
+    uint8_t head[PLSTORE_HEADER_SIZE];
+    int64_t n = PLSTORE_HEADER_SIZE;
+    int     ret = 0;
+
+    out = fopen(path.c_str(), "wb");
+    if (!out) {
+        logger.error("Failed to create playlist file %s.\n", path.c_str());
+        return KERROR(KEPLAYLIST_WRITE_FAIL);
+    }
+
+    /* the live items and the history */
+    AV_WL32(head, PLSTORE_MAGIC);
+    AV_WL32(head + 4, PLSTORE_VERSION);
+    if (1 != fwrite(head, sizeof(head), 1, out))
+        GOTO_FAIL(KEPLAYLIST_WRITE_FAIL);
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries[i].removed)
+            continue;
+        ret = write_record(out, PLSTORE_REC_ADD, entries[i].url);
+        if (ret < 0)
+            goto fail;
+        n += ret;
+    }
+    if (!history.empty()) {
+        ret = write_record(out, PLSTORE_REC_HISTORY, history);
+        if (ret < 0)
+            goto fail;
+        n += ret;
+    }
+    if (file_sync(out))
+        GOTO_FAIL(KEPLAYLIST_WRITE_FAIL);
+    if (fclose(out)) {
+        out = NULL;
+        GOTO_FAIL(KEPLAYLIST_WRITE_FAIL);
+    }
+    *written = n;
+
+    return 0;
+fail:
+    if (out)
+        fclose(out);
+    ::remove(path.c_str());
+    logger.error("Failed to write playlist file %s.\n", path.c_str());
+
+    return ret;
+}
+
+int PlaylistStore::compact ()
+{
+    std::string tmp_path = path + ".tmp";
+    std::string bak_path = path + ".bak";
+    FILE *      test;
+    int64_t     written = 0;
+    int         n = 0;
+    int         ret;
+
+    /* write a new file beside, then replace the old one, a crash leaves one of them whole */
+    ret = write_file(tmp_path, &written);
+    if (ret < 0)
+        return ret;
+    if (fp) {
+        fclose(fp);
+        fp = NULL;
+    }
+
+    /* the old file is kept until the next compaction, the records dropped can be recovered from it */
+    test = fopen(path.c_str(), "rb");
+    if (test) {
+        fclose(test);
+        if (file_copy(path.c_str(), bak_path.c_str()))
+            logger.warning("Failed to back up playlist file %s.\n", path.c_str());
+    }
+
+    if (file_replace(tmp_path.c_str(), path.c_str())) {
+        ::remove(tmp_path.c_str());
+        logger.error("Failed to replace playlist file %s.\n", path.c_str());
+        fp = open_append(path);
+        return KERROR(KEPLAYLIST_WRITE_FAIL);
+    }
+    records = len + (history.empty() ? 0 : 1);
+    size = written;
+
+    /* drop the removed items */
+    index.clear();
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries[i].removed)
+            continue;
+        if ((size_t)n != i)
+            entries[n] = entries[i];
+        index[entries[n].url] = n;
+        n++;
+    }
+    entries.resize(n);
+
+    fp = open_append(path);
+    if (!fp) {
+        logger.error("Failed to open playlist file %s.\n", path.c_str());
+        return KERROR(KEPLAYLIST_OPEN_FAIL);
+    }
+
+    return 0;
+}
+
+bool PlaylistStore::contains (const std::string &url) const
+{
+    return index.count(url) != 0;
+}
+
+int PlaylistStore::get_len () const
+{
+    return len;
+}
+
+const std::string &PlaylistStore::get_history () const
+{
+    return history;
+}
+
+void PlaylistStore::get_urls (std::vector<std::string> &urls) const
+{
+    urls.clear();
+    urls.reserve(len);
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (!entries[i].removed)
+            urls.push_back(entries[i].url);
+    }
+}
+
+int PlaylistStore::import_ini (const std::string &ini_path)
+{
+    inifile::IniFile loader;
+    std::string      url;
+    int              n = 0;
+    int              ret;
+
+    if (inifile::RET_OK != loader.load(ini_path))
+        return KERROR(KEPLAYLIST_OPEN_FAIL);
+
+    /* the items in the order of the file, URL0..URLn */
+    for (inifile::IniFile::iterator it = loader.begin(); it != loader.end(); ++it) {
+        if ("PLAY_LIST" != it->first)
+            continue;
+        for (inifile::IniSection::iterator item = it->second->begin(); item != it->second->end(); ++item) {
+            if (item->key.compare(0, 3, "URL") || item->value.empty())
+                continue;
+            ret = add(item->value);
+            if (ret < 0)
+                return ret;
+            n += ret;
+        }
+    }
+
+    url = loader.getStringValue("PLAY_HISTORY", "URL", ret);
+    if (!ret && !url.empty()) {
+        ret = set_history(url);
+        if (ret < 0)
+            return ret;
+    }
+    ret = flush();
+    if (ret < 0)
+        return ret;
+    logger.info("%d items imported from %s.\n", n, ini_path.c_str());
+
+    return n;
+}
+
+PlaylistStore::PlaylistStore ()
+{
+    fp = NULL;
+    len = 0;
+    records = 0;
+    size = 0;
+}
+
+PlaylistStore::~PlaylistStore ()
+{
+    close();
+}
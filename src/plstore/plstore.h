@@ -0,0 +1,89 @@
+#ifndef _AVPLAYERWIDGET_PLSTORE_H_
+#define _AVPLAYERWIDGET_PLSTORE_H_
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+/*
+* binary playlist file, a header and a log of length-prefixed records,
+* every change is appended as a record, so saving is incremental,
+* every record is written by one unbuffered write, a failed one is cut off the file,
+* a record torn by a crash fails its checksum and is cut off the end of the file,
+* a corrupt record in the middle is skipped, the file is rewritten and the old one kept as .bak,
+* the file is mapped and scanned once on open, the urls are indexed by a hash table
+*
+* header:  magic (4) version (4)
+* record:  size of url (4) type (1) crc32 of type and url (4) url (size)
+* integers are little-endian
+*/
+
+#define PLSTORE_MAGIC          0x4C50414B // "KAPL"
+#define PLSTORE_VERSION        1
+#define PLSTORE_HEADER_SIZE    8
+#define PLSTORE_RECORD_SIZE    9          // without the url
+#define PLSTORE_MAX_URL        65536
+#define PLSTORE_MIN_COMPACT    1024       // dead records before the file is compacted on close
+
+/* record types */
+enum {
+    PLSTORE_REC_ADD = 1,
+    PLSTORE_REC_REMOVE,
+    PLSTORE_REC_CLEAR,
+    PLSTORE_REC_HISTORY
+};
+
+/* playlist store */
+class PlaylistStore {
+private:
+    /* an item, the removed ones are kept until the file is compacted */
+    typedef struct Entry {
+        std::string url;
+        bool        removed;
+    }Entry;
+
+private:
+    std::string                          path;
+    FILE *                               fp;       // the file opened for appending
+    std::vector<Entry>                   entries;  // in the order of the playlist
+    std::unordered_map<std::string, int> index;    // url to index of entries
+    std::string                          history;  // the url played last
+    int                                  len;      // items not removed
+    int64_t                              records;  // records in the file
+    int64_t                              size;     // of the valid records in the file (unit: byte)
+
+public:
+    int                open        (const std::string &path);
+    void               close       ();
+
+    /* changes, appended to the file and applied once written, the list is left as it was on failure */
+    int                add         (const std::string &url); // 1 if added, 0 if the url is in the list
+    int                remove      (const std::string &url); // 1 if removed, 0 if the url is not in the list
+    int                clear       ();
+    int                set_history (const std::string &url);
+    int                flush       ();
+
+    /* rewrites the file with the live items only, the old file is kept as .bak */
+    int                compact     ();
+
+    bool               contains    (const std::string &url) const;
+    int                get_len     () const;
+    const std::string &get_history () const;
+    void               get_urls    (std::vector<std::string> &urls) const;
+
+    /* one-time import of the INI playlist saved by the old versions */
+    int                import_ini  (const std::string &ini_path);
+
+    PlaylistStore ();
+    ~PlaylistStore ();
+
+private:
+    int                load        (const uint8_t *data, int64_t size, int64_t *valid, int64_t *skipped);
+    void               apply       (int type, const std::string &url);
+    int                append      (int type, const std::string &url);
+    int                write_file  (const std::string &path, int64_t *written);
+};
+
+#endif /* _AVPLAYERWIDGET_PLSTORE_H_ */
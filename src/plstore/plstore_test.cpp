@@ -0,0 +1,246 @@
+#include <cstdio>
+#include <gtest/gtest.h>
+#ifndef _WIN32
+#include <csignal>
+#include <sys/resource.h>
+#endif
+#include "plstore.h"
+#include "testutil/testutil.h"
+
+static int64_t file_size (const std::string &path)
+{
+    FILE *  fp = fopen(path.c_str(), "rb");
+    int64_t size;
+
+    if (!fp)
+        return -1;
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fclose(fp);
+
+    return size;
+}
+
+TEST(plstore_test, reopen)
+{
+    std::string              path = test_path("plstore_test_reopen.kpl");
+    std::vector<std::string> urls;
+    PlaylistStore            store;
+
+    remove(path.c_str());
+    ASSERT_EQ(0, store.open(path));
+    EXPECT_EQ(1, store.add("/a.mkv"));
+    EXPECT_EQ(1, store.add("/b.mkv"));
+    EXPECT_EQ(0, store.add("/a.mkv"));
+    EXPECT_EQ(1, store.add("http://host/c.m3u8"));
+    EXPECT_EQ(1, store.remove("/b.mkv"));
+    EXPECT_EQ(0, store.remove("/b.mkv"));
+    EXPECT_EQ(1, store.add("/b.mkv"));
+    EXPECT_EQ(0, store.set_history("/b.mkv"));
+    EXPECT_EQ(0, store.flush());
+    store.close();
+
+    /* the order of the changes is kept */
+    ASSERT_EQ(0, store.open(path));
+    EXPECT_EQ(3, store.get_len());
+    store.get_urls(urls);
+    ASSERT_EQ(3u, urls.size());
+    EXPECT_EQ("/a.mkv", urls[0]);
+    EXPECT_EQ("http://host/c.m3u8", urls[1]);
+    EXPECT_EQ("/b.mkv", urls[2]);
+    EXPECT_EQ("/b.mkv", store.get_history());
+    EXPECT_TRUE(store.contains("/b.mkv"));
+
+    /* clear */
+    EXPECT_EQ(0, store.clear());
+    EXPECT_EQ(1, store.add("/d.mkv"));
+    store.close();
+    ASSERT_EQ(0, store.open(path));
+    store.get_urls(urls);
+    ASSERT_EQ(1u, urls.size());
+    EXPECT_EQ("/d.mkv", urls[0]);
+    store.close();
+    remove(path.c_str());
+}
+
+TEST(plstore_test, torn)
+{
+    std::string              path = test_path("plstore_test_torn.kpl");
+    std::vector<std::string> urls;
+    PlaylistStore            store;
+    int64_t                  size;
+    FILE *                   fp;
+
+    remove(path.c_str());
+    remove((path + ".bak").c_str());
+    ASSERT_EQ(0, store.open(path));
+    store.add("/a.mkv");
+    store.add("/b.mkv");
+    store.close();
+
+    /* a record cut by a crash, and garbage after it */
+    size = file_size(path);
+    fp = fopen(path.c_str(), "ab");
+    ASSERT_TRUE(fp != NULL);
+    fwrite("\x06\x00\x00\x00\x01\x12\x34\x56\x78/c.m", 1, 13, fp);
+    fclose(fp);
+    ASSERT_EQ(0, store.open(path));
+    EXPECT_EQ(2, store.get_len());
+    EXPECT_EQ(size, file_size(path));
+    EXPECT_EQ(-1, file_size(path + ".bak")); // cut off, not rewritten
+
+    /* the file is whole again, the changes go on */
+    store.add("/c.mkv");
+    store.close();
+    ASSERT_EQ(0, store.open(path));
+    store.get_urls(urls);
+    ASSERT_EQ(3u, urls.size());
+    EXPECT_EQ("/c.mkv", urls[2]);
+    store.close();
+
+    /* not a playlist file */
+    fp = fopen(path.c_str(), "wb");
+    fputs("[PLAY_LIST]\n", fp);
+    fclose(fp);
+    EXPECT_GT(0, store.open(path));
+    remove(path.c_str());
+}
+
+TEST(plstore_test, corrupt)
+{
+    std::string              path = test_path("plstore_test_corrupt.kpl");
+    std::string              bak_path = path + ".bak";
+    std::vector<std::string> urls;
+    PlaylistStore            store;
+    int64_t                  size;
+    FILE *                   fp;
+
+    remove(path.c_str());
+    remove(bak_path.c_str());
+    ASSERT_EQ(0, store.open(path));
+    store.add("/a.mkv");
+    store.add("/b.mkv");
+    store.add("/c.mkv");
+    store.set_history("/c.mkv");
+    store.close();
+    size = file_size(path);
+
+    /* a bit flipped in the url of the second record */
+    fp = fopen(path.c_str(), "r+b");
+    ASSERT_TRUE(fp != NULL);
+    fseek(fp, PLSTORE_HEADER_SIZE + (PLSTORE_RECORD_SIZE + 6) + PLSTORE_RECORD_SIZE + 1, SEEK_SET);
+    fputc('B', fp);
+    fclose(fp);
+
+    /* the records after it are kept, the old file is backed up */
+    ASSERT_EQ(0, store.open(path));
+    store.get_urls(urls);
+    ASSERT_EQ(2u, urls.size());
+    EXPECT_EQ("/a.mkv", urls[0]);
+    EXPECT_EQ("/c.mkv", urls[1]);
+    EXPECT_EQ("/c.mkv", store.get_history());
+    EXPECT_EQ(size, file_size(bak_path));
+    EXPECT_EQ(size - PLSTORE_RECORD_SIZE - 6, file_size(path));
+    store.close();
+    remove(path.c_str());
+    remove(bak_path.c_str());
+}
+
+#ifndef _WIN32
+TEST(plstore_test, write_fail)
+{
+    std::string              path = test_path("plstore_test_write_fail.kpl");
+    std::vector<std::string> urls;
+    PlaylistStore            store;
+    struct rlimit            old_limit;
+    struct rlimit            limit;
+    int64_t                  size;
+
+    remove(path.c_str());
+    ASSERT_EQ(0, store.open(path));
+    store.add("/a.mkv");
+    size = file_size(path);
+
+    /* the disk is full in the middle of a record */
+    signal(SIGXFSZ, SIG_IGN);
+    getrlimit(RLIMIT_FSIZE, &old_limit);
+    limit = old_limit;
+    limit.rlim_cur = size + 4;
+    ASSERT_EQ(0, setrlimit(RLIMIT_FSIZE, &limit));
+    EXPECT_GT(0, store.add("/b.mkv"));
+    EXPECT_GT(0, store.set_history("/a.mkv"));
+    setrlimit(RLIMIT_FSIZE, &old_limit);
+    signal(SIGXFSZ, SIG_DFL);
+
+    /* the list and the file are as they were */
+    EXPECT_FALSE(store.contains("/b.mkv"));
+    EXPECT_EQ(1, store.get_len());
+    EXPECT_EQ("", store.get_history());
+    EXPECT_EQ(size, file_size(path));
+
+    /* the changes go on */
+    EXPECT_EQ(1, store.add("/c.mkv"));
+    store.close();
+    ASSERT_EQ(0, store.open(path));
+    store.get_urls(urls);
+    ASSERT_EQ(2u, urls.size());
+    EXPECT_EQ("/a.mkv", urls[0]);
+    EXPECT_EQ("/c.mkv", urls[1]);
+    store.close();
+    remove(path.c_str());
+}
+#endif
+
+TEST(plstore_test, compact)
+{
+    std::string   path = test_path("plstore_test_compact.kpl");
+    PlaylistStore store;
+    int64_t       size;
+
+    remove(path.c_str());
+    ASSERT_EQ(0, store.open(path));
+    for (int i = 0; i < PLSTORE_MIN_COMPACT; i++) {
+        store.add("/" + std::to_string(i) + ".mkv");
+        store.remove("/" + std::to_string(i) + ".mkv");
+    }
+    store.add("/a.mkv");
+    store.close();
+
+    /* only the live item is left */
+    size = file_size(path);
+    EXPECT_EQ(PLSTORE_HEADER_SIZE + PLSTORE_RECORD_SIZE + 6, size);
+    ASSERT_EQ(0, store.open(path));
+    EXPECT_EQ(1, store.get_len());
+    store.close();
+    remove(path.c_str());
+}
+
+TEST(plstore_test, import_ini)
+{
+    std::string              ini_path = test_path("plstore_test.pl");
+    std::string              path = test_path("plstore_test_import.kpl");
+    std::vector<std::string> urls;
+    PlaylistStore            store;
+    FILE *                   fp;
+
+    fp = fopen(ini_path.c_str(), "w");
+    ASSERT_TRUE(fp != NULL);
+    fprintf(fp, "[PLAYLIST_VERSION]\nVER_ID=1.0\n[PLAY_HISTORY]\nURL=/b.mkv\n");
+    fprintf(fp, "[PLAY_LIST]\nLIST_LEN=4\nURL0=/a.mkv\nURL1=/b.mkv\nURL2=/a.mkv\nURL3=/c.mkv\n");
+    fclose(fp);
+
+    remove(path.c_str());
+    ASSERT_EQ(0, store.open(path));
+    EXPECT_EQ(3, store.import_ini(ini_path));
+    store.close();
+    ASSERT_EQ(0, store.open(path));
+    store.get_urls(urls);
+    ASSERT_EQ(3u, urls.size());
+    EXPECT_EQ("/a.mkv", urls[0]);
+    EXPECT_EQ("/b.mkv", urls[1]);
+    EXPECT_EQ("/c.mkv", urls[2]);
+    EXPECT_EQ("/b.mkv", store.get_history());
+    store.close();
+    remove(path.c_str());
+    remove(ini_path.c_str());
+}
@@ -0,0 +1,536 @@
+#include "pool.h"
+#include "error/error.h"
+#include "log/log.h"
+#include "trace/trace.h"
+#include "lock/lock.h"
+#include <new>
+
+extern "C"
+{
+#include "SDL2/SDL.h"
+}
+
+#define FILENAME "pool.cpp"
+
+Task::Task ()
+{
+    proc = NULL;
+    args = NULL;
+    name = NULL;
+    pool = NULL;
+    session = -1;
+    timeout = 0;
+    firing = 0;
+    SDL_AtomicSet(&state, TASK_IDLE);
+}
+
+void Task::init (TaskProc proc, void *args, const char *name)
+{
+    this->proc = proc;
+    this->args = args;
+    this->name = name;
+}
+
+void Task::wake ()
+{
+    int state;
+
+    if (!pool)
+        return;
+
+    while (true) {
+        state = SDL_AtomicGet(&this->state);
+        if (TASK_IDLE == state) { // sleeping, queue it
+            if (SDL_AtomicCAS(&this->state, TASK_IDLE, TASK_QUEUED)) {
+                pool->push(this);
+                return;
+            }
+        } else if (TASK_RUNNING == state) { // queued again after the run
+            if (SDL_AtomicCAS(&this->state, TASK_RUNNING, TASK_NOTIFIED))
+                return;
+        } else { // queued, notified or finished
+            return;
+        }
+    }
+}
+
+void Task::set_timeout (int timeout)
+{
+    this->timeout = timeout < 1 ? 1 : timeout;
+}
+
+int Task::get_state ()
+{
+    return SDL_AtomicGet(&state);
+}
+
+int SDLCALL TaskPool::worker_thread (void *args)
+{
+    Worker *  w = (Worker *)args;
+    TaskPool *p = w->pool;
+    Task *    task;
+
+    SDL_TLSSet(p->tls, w, NULL);
+    trace_set_thread_name("pool worker");
+    while ((task = p->get_task(w)))
+        p->run_task(w, task);
+
+    return 0;
+}
+
+Task *TaskPool::get_task (Worker *w)
+{
+    Task * task;
+    Uint32 now;
+    Sint32 timeout;
+
+    while (!abort_req) {
+        fire_timers();
+
+        /* take a task of the sessions regularly, so no session is starved by the local tasks */
+        task = NULL;
+        if (!(++w->ticks % POOL_FAIR_INTERVAL))
+            task = pop_session();
+        if (!task)
+            task = pop_local(w);
+        if (!task)
+            task = pop_session();
+        if (!task)
+            task = steal(w);
+        if (task)
+            return task;
+
+        /* sleep until a task is queued or the next timer expires */
+        mutex_lock(mutex);
+        if (!abort_req && !SDL_AtomicGet(&nb_tasks)) {
+            timeout = -1;
+            now = SDL_GetTicks();
+            for (size_t i = 0; i < timers.size(); i++) {
+                Sint32 remain = (Sint32)(timers[i].time - now);
+                if (timeout < 0 || remain < timeout)
+                    timeout = remain < 0 ? 0 : remain;
+            }
+            nb_idle++;
+            if (timeout < 0)
+                cond_wait(cond, mutex);
+            else if (timeout > 0)
+                cond_wait_timeout(cond, mutex, (Uint32)timeout);
+            nb_idle--;
+        }
+        mutex_unlock(mutex);
+    }
+
+    return NULL;
+}
+
+Task *TaskPool::pop_local (Worker *w)
+{
+    Task *task = NULL;
+
+    mutex_lock(w->mutex);
+    if (!w->tasks.empty()) {
+        task = w->tasks.back();
+        w->tasks.pop_back();
+        SDL_AtomicAdd(&nb_tasks, -1);
+    }
+    mutex_unlock(w->mutex);
+
+    return task;
+}
+
+Task *TaskPool::pop_session ()
+{
+    Task *task = NULL;
+    int   i;
+
+    mutex_lock(mutex);
+    for (i = 0; i < POOL_MAX_SESSIONS; i++) {
+        int session = (next_session + i) % POOL_MAX_SESSIONS;
+        if (!sessions[session].empty()) {
+            task = sessions[session].front();
+            sessions[session].pop_front();
+            next_session = (session + 1) % POOL_MAX_SESSIONS;
+            SDL_AtomicAdd(&nb_tasks, -1);
+            break;
+        }
+    }
+    mutex_unlock(mutex);
+
+    return task;
+}
+
+Task *TaskPool::steal (Worker *w)
+{
+    Task * task = NULL;
+    size_t start = 0;
+    size_t i;
+
+    /* start from the next worker, the oldest task is taken */
+    for (i = 0; i < workers.size(); i++) {
+        if (workers[i] == w) {
+            start = i + 1;
+            break;
+        }
+    }
+    for (i = 0; i < workers.size() && !task; i++) {
+        Worker *victim = workers[(start + i) % workers.size()];
+        if (victim == w)
+            continue;
+        mutex_lock(victim->mutex);
+        if (!victim->tasks.empty()) {
+            task = victim->tasks.front();
+            victim->tasks.pop_front();
+            SDL_AtomicAdd(&nb_tasks, -1);
+        }
+        mutex_unlock(victim->mutex);
+    }
+
+    return task;
+}
+
+void TaskPool::run_task (Worker *w, Task *task)
+{
+    int ret;
+
+    SDL_AtomicSet(&task->state, TASK_RUNNING);
+    task->timeout = 0;
+    int64_t span = trace_begin();
+    ret = task->proc(task->args);
+    trace_end(task->name ? task->name : "task", span);
+
+    switch (ret) {
+    case TASK_AGAIN: // behind the tasks of the other sessions
+        SDL_AtomicSet(&task->state, TASK_QUEUED);
+        push_session(task);
+        break;
+    case TASK_WAIT:
+        if (task->timeout > 0)
+            add_timer(task);
+        if (!SDL_AtomicCAS(&task->state, TASK_RUNNING, TASK_IDLE)) { // woken while running
+            SDL_AtomicSet(&task->state, TASK_QUEUED);
+            push_local(w, task);
+        }
+        break;
+    default:
+        mutex_lock(mutex);
+        remove_timer(task);
+        SDL_AtomicSet(&task->state, TASK_FINISHED);
+        SDL_CondBroadcast(done_cond);
+        mutex_unlock(mutex);
+        break;
+    }
+}
+
+void TaskPool::push (Task *task)
+{
+    Worker *w = (Worker *)SDL_TLSGet(tls);
+
+    /* woken by a worker, likely to use the data just produced by it */
+    if (w && w->pool == this)
+        push_local(w, task);
+    else
+        push_session(task);
+}
+
+void TaskPool::push_local (Worker *w, Task *task)
+{
+    mutex_lock(w->mutex);
+    w->tasks.push_back(task);
+    SDL_AtomicAdd(&nb_tasks, 1);
+    mutex_unlock(w->mutex);
+    notify();
+}
+
+void TaskPool::push_session (Task *task)
+{
+    mutex_lock(mutex);
+    sessions[task->session].push_back(task);
+    SDL_AtomicAdd(&nb_tasks, 1);
+    mutex_unlock(mutex);
+    notify();
+}
+
+void TaskPool::notify ()
+{
+    mutex_lock(mutex);
+    if (nb_idle)
+        SDL_CondSignal(cond);
+    mutex_unlock(mutex);
+}
+
+void TaskPool::add_timer (Task *task)
+{
+    Uint32 time = SDL_GetTicks() + (Uint32)task->timeout;
+    size_t i;
+
+    mutex_lock(mutex);
+
+    /* one timer for a task, the earlier one is replaced */
+    for (i = 0; i < timers.size(); i++) {
+        if (timers[i].task == task) {
+            timers[i].time = time;
+            break;
+        }
+    }
+    if (i == timers.size()) {
+        Timer timer = {task, time};
+        timers.push_back(timer);
+    }
+
+    /* the sleeping workers compute the timeout again */
+    if (nb_idle)
+        SDL_CondSignal(cond);
+
+    mutex_unlock(mutex);
+}
+
+void TaskPool::remove_timer (Task *task)
+{
+    /* called with mutex locked */
+    for (size_t i = 0; i < timers.size(); i++) {
+        if (timers[i].task == task) {
+            timers.erase(timers.begin() + i);
+            break;
+        }
+    }
+}
+
+int TaskPool::fire_timers ()
+{
+    Task * fired[POOL_MAX_FIRED];
+    Uint32 now;
+    int    nb_fired = 0;
+    int    n;
+    size_t i;
+
+    /*
+    * the expired tasks are collected with mutex locked and woken after it is unlocked,
+    * join() waits for the tasks being woken, so a task is never woken after it is joined
+    */
+    do {
+        n = 0;
+        i = 0;
+        mutex_lock(mutex);
+        now = SDL_GetTicks();
+        while (i < timers.size() && n < POOL_MAX_FIRED) {
+            if ((Sint32)(timers[i].time - now) <= 0) {
+                fired[n] = timers[i].task;
+                fired[n]->firing++;
+                timers.erase(timers.begin() + i);
+                n++;
+            } else {
+                i++;
+            }
+        }
+        mutex_unlock(mutex);
+        if (!n)
+            break;
+
+        for (int j = 0; j < n; j++)
+            fired[j]->wake();
+
+        mutex_lock(mutex);
+        for (int j = 0; j < n; j++)
+            fired[j]->firing--;
+        SDL_CondBroadcast(done_cond);
+        mutex_unlock(mutex);
+        nb_fired += n;
+    } while (POOL_MAX_FIRED == n);
+
+    return nb_fired;
+}
+
+int TaskPool::init (int nb_threads)
+{
+    int ret;
+
+    if (mutex)
+        return KERROR(KEREINIT);
+
+    /* one thread for a core, a pool of one thread is asked for explicitly */
+    if (nb_threads <= 0) {
+        nb_threads = SDL_GetCPUCount();
+        nb_threads = nb_threads < POOL_MIN_THREADS ? POOL_MIN_THREADS : nb_threads;
+    }
+    nb_threads = nb_threads > POOL_MAX_THREADS ? POOL_MAX_THREADS : nb_threads;
+
+    abort_req = false;
+    nb_idle = 0;
+    next_session = 0;
+    SDL_AtomicSet(&nb_tasks, 0);
+    for (int i = 0; i < POOL_MAX_SESSIONS; i++)
+        session_used[i] = false;
+
+    /* create mutex and cond */
+    mutex = mutex_create("pool");
+    if (!mutex) {
+        logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_MUTEX_FAIL), SDL_GetError());
+        GOTO_FAIL(KECREATE_SDL_MUTEX_FAIL);
+    }
+    cond = SDL_CreateCond();
+    done_cond = SDL_CreateCond();
+    if (!cond || !done_cond) {
+        logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_COND_FAIL), SDL_GetError());
+        GOTO_FAIL(KECREATE_SDL_COND_FAIL);
+    }
+    if (!tls) // kept after closed, SDL never frees a TLS id
+        tls = SDL_TLSCreate();
+
+    /* create workers */
+    for (int i = 0; i < nb_threads; i++) {
+        Worker *w = _New Worker;
+        if (!w)
+            GOTO_FAIL(KENOMEM);
+        w->pool = this;
+        w->ticks = 0;
+        w->thr = NULL;
+        w->mutex = mutex_create("pool worker");
+        workers.push_back(w);
+        if (!w->mutex) {
+            logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_MUTEX_FAIL), SDL_GetError());
+            GOTO_FAIL(KECREATE_SDL_MUTEX_FAIL);
+        }
+    }
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i]->thr = SDL_CreateThread(worker_thread, "pool_worker_thread", workers[i]);
+        if (!workers[i]->thr) {
+            logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_THREAD_FAIL), SDL_GetError());
+            GOTO_FAIL(KECREATE_THREAD_FAIL);
+        }
+    }
+
+    KLOGD("Task pool has been inited with %d threads.\n", nb_threads);
+    ret = 0;
+fail:
+    if (ret < 0)
+        close();
+    return ret;
+}
+
+void TaskPool::close ()
+{
+    if (!mutex)
+        return;
+
+    /* stop workers, the tasks have been joined by their owners */
+    mutex_lock(mutex);
+    abort_req = true;
+    SDL_CondBroadcast(cond);
+    mutex_unlock(mutex);
+    for (size_t i = 0; i < workers.size(); i++) {
+        if (workers[i]->thr)
+            SDL_WaitThread(workers[i]->thr, NULL);
+        if (workers[i]->mutex)
+            mutex_destroy(workers[i]->mutex);
+        delete workers[i];
+    }
+    workers.clear();
+
+    /* clear all */
+    for (int i = 0; i < POOL_MAX_SESSIONS; i++) {
+        sessions[i].clear();
+        session_used[i] = false;
+    }
+    timers.clear();
+    SDL_AtomicSet(&nb_tasks, 0);
+    if (done_cond)
+        SDL_DestroyCond(done_cond);
+    if (cond)
+        SDL_DestroyCond(cond);
+    mutex_destroy(mutex);
+    done_cond = NULL;
+    cond = NULL;
+    mutex = NULL;
+
+    KLOGD("Task pool closed.\n");
+}
+
+int TaskPool::open_session ()
+{
+    int ret = KERROR(KEPOOL_SESSION_FULL);
+
+    if (!mutex)
+        return KERROR(KEUNINITED);
+
+    mutex_lock(mutex);
+    for (int i = 0; i < POOL_MAX_SESSIONS; i++) {
+        if (!session_used[i]) {
+            session_used[i] = true;
+            ret = i;
+            break;
+        }
+    }
+    mutex_unlock(mutex);
+
+    return ret;
+}
+
+void TaskPool::close_session (int session)
+{
+    if (!mutex || session < 0 || session >= POOL_MAX_SESSIONS)
+        return;
+
+    /* the tasks of the session have been joined */
+    mutex_lock(mutex);
+    SDL_AtomicAdd(&nb_tasks, -(int)sessions[session].size());
+    sessions[session].clear();
+    session_used[session] = false;
+    mutex_unlock(mutex);
+}
+
+int TaskPool::submit (Task *task, int session)
+{
+    int state;
+
+    if (!mutex)
+        return KERROR(KEUNINITED);
+    if (!task || !task->proc || session < 0 || session >= POOL_MAX_SESSIONS || !session_used[session])
+        return KERROR(KEINVAL);
+    state = SDL_AtomicGet(&task->state);
+    if (task->pool && TASK_FINISHED != state)
+        return KERROR(KEREINIT);
+
+    task->pool = this;
+    task->session = session;
+    task->timeout = 0;
+    SDL_AtomicSet(&task->state, TASK_QUEUED);
+    push_session(task);
+
+    return 0;
+}
+
+void TaskPool::join (Task *task)
+{
+    /* must not be called by a task, the worker would wait for itself */
+    if (!task || task->pool != this)
+        return;
+
+    mutex_lock(mutex);
+    while (TASK_FINISHED != SDL_AtomicGet(&task->state) || task->firing)
+        cond_wait(done_cond, mutex);
+    mutex_unlock(mutex);
+}
+
+int TaskPool::get_nb_threads () const
+{
+    return (int)workers.size();
+}
+
+TaskPool::TaskPool ()
+{
+    nb_idle = 0;
+    next_session = 0;
+    abort_req = false;
+    tls = 0;
+    mutex = NULL;
+    cond = NULL;
+    done_cond = NULL;
+    SDL_AtomicSet(&nb_tasks, 0);
+    for (int i = 0; i < POOL_MAX_SESSIONS; i++)
+        session_used[i] = false;
+}
+
+TaskPool::~TaskPool ()
+{
+    close();
+}
@@ -0,0 +1,136 @@
+#ifndef _AVPLAYERWIDGET_POOL_H_
+#define _AVPLAYERWIDGET_POOL_H_
+
+#include <deque>
+#include <vector>
+
+extern "C"
+{
+#include "SDL2/SDL.h"
+}
+
+/* results of a task run */
+#define TASK_AGAIN          0 // not finished, queued behind the tasks of the other sessions
+#define TASK_WAIT           1 // sleep until woken by wake() or the timeout set by set_timeout()
+#define TASK_DONE           2 // finished, never run again
+
+/* task states */
+#define TASK_IDLE           0
+#define TASK_QUEUED         1
+#define TASK_RUNNING        2
+#define TASK_NOTIFIED       3 // woken while running, queued again after the run
+#define TASK_FINISHED       4
+
+/* pool limits */
+#define POOL_MAX_THREADS    32
+#define POOL_MIN_THREADS    2  // of the default size
+#define POOL_MAX_SESSIONS   64
+
+/* a worker takes a task of the session queues after so many local tasks */
+#define POOL_FAIR_INTERVAL  8
+
+/* expired timers collected by a worker at a time, woken with the mutex unlocked */
+#define POOL_MAX_FIRED      16
+
+typedef int (*TaskProc) (void *args);
+
+class TaskPool;
+
+/*
+* a unit of work run by the pool,
+* it is never run by two workers at the same time,
+* a run must not block on the other tasks
+*/
+class Task {
+private:
+    friend class TaskPool;
+
+private:
+    TaskProc         proc;
+    void *           args;
+    const char *     name;
+    TaskPool *       pool;
+    int              session;
+    SDL_atomic_t     state;
+    int              timeout;   // timeout of the next TASK_WAIT (unit: millisecond), 0 means none
+    int              firing;    // timers expired and not woken yet, join() waits for them, under the pool mutex
+
+public:
+    void init        (TaskProc proc, void *args, const char *name);
+    void wake        ();
+    void set_timeout (int timeout);
+    int  get_state   ();
+
+public:
+    Task             ();
+};
+
+/*
+* work-stealing pool shared by the sessions,
+* woken tasks are pushed to the local queue of the waking worker,
+* requeued and submitted tasks are served round robin between the sessions
+*/
+class TaskPool {
+private:
+    friend class Task;
+
+private:
+    typedef struct Worker {
+        TaskPool *         pool;
+        SDL_Thread *       thr;
+        SDL_mutex *        mutex;  // protects tasks
+        std::deque<Task *> tasks;  // the owner pops the back, the thieves take the front
+        int                ticks;  // tasks run
+    }Worker;
+
+    typedef struct Timer {
+        Task *             task;
+        Uint32             time;   // ticks to wake the task (unit: millisecond)
+    }Timer;
+
+private:
+    std::vector<Worker *> workers;
+    std::deque<Task *>    sessions[POOL_MAX_SESSIONS]; // queued tasks of every session
+    bool                  session_used[POOL_MAX_SESSIONS];
+    int                   next_session; // round robin cursor
+    std::vector<Timer>    timers;
+    SDL_atomic_t          nb_tasks;     // tasks queued, local or in the sessions
+    int                   nb_idle;      // workers sleeping on cond
+    bool                  abort_req;
+    SDL_TLSID             tls;          // worker of the current thread
+    SDL_mutex *           mutex;        // protects sessions, timers and nb_idle
+    SDL_cond *            cond;         // signaled when a task is queued
+    SDL_cond *            done_cond;    // broadcast when a task is finished or its timer is woken
+
+private:
+    static int SDLCALL worker_thread (void *args);
+
+private:
+    Task *             get_task      (Worker *w);
+    Task *             pop_local     (Worker *w);
+    Task *             pop_session   ();
+    Task *             steal         (Worker *w);
+    void               run_task      (Worker *w, Task *task);
+    void               push          (Task *task);
+    void               push_local    (Worker *w, Task *task);
+    void               push_session  (Task *task);
+    void               notify        ();
+    void               add_timer     (Task *task);
+    void               remove_timer  (Task *task);
+    int                fire_timers   ();
+
+public:
+    int                init          (int nb_threads);
+    void               close         ();
+    int                open_session  ();
+    void               close_session (int session);
+    int                submit        (Task *task, int session);
+    void               join          (Task *task);
+    int                get_nb_threads() const;
+
+public:
+    TaskPool           ();
+    ~TaskPool          ();
+};
+
+#endif /* _AVPLAYERWIDGET_POOL_H_ */
@@ -0,0 +1,286 @@
+#include <gtest/gtest.h>
+#include "pool.h"
+#include "error/error.h"
+
+extern "C"
+{
+#include "SDL2/SDL.h"
+}
+
+/* a task counting its runs */
+typedef struct Counter {
+    Task         task;
+    SDL_atomic_t runs;
+    int          limit;   // finished after so many runs
+    int          result;  // returned before the limit
+    int          timeout; // timeout of the first run
+    int          sleep;   // busy time of a run (unit: millisecond)
+    bool         done;
+    Uint32       start;
+    Uint32       last;
+}Counter;
+
+static int counter_proc (void *args)
+{
+    Counter *c = (Counter *)args;
+    int      runs = SDL_AtomicAdd(&c->runs, 1) + 1;
+
+    c->last = SDL_GetTicks();
+    if (c->sleep)
+        SDL_Delay(c->sleep);
+    if (c->done || (c->limit && runs >= c->limit))
+        return TASK_DONE;
+    if (1 == runs && c->timeout)
+        c->task.set_timeout(c->timeout);
+
+    return c->result;
+}
+
+static void counter_init (Counter *c, int limit, int result)
+{
+    SDL_AtomicSet(&c->runs, 0);
+    c->limit = limit;
+    c->result = result;
+    c->timeout = 0;
+    c->sleep = 0;
+    c->done = false;
+    c->start = SDL_GetTicks();
+    c->last = 0;
+    c->task.init(counter_proc, c, "counter_task");
+}
+
+static bool wait_runs (Counter *c, int runs, int timeout)
+{
+    Uint32 start = SDL_GetTicks();
+
+    while (SDL_AtomicGet(&c->runs) < runs) {
+        if (SDL_GetTicks() - start > (Uint32)timeout)
+            return false;
+        SDL_Delay(1);
+    }
+    return true;
+}
+
+TEST(TaskPool, init_and_close)
+{
+    TaskPool pool;
+
+    ASSERT_EQ(pool.init(3), 0);
+    EXPECT_EQ(pool.get_nb_threads(), 3);
+    EXPECT_EQ(pool.init(3), KERROR(KEREINIT));
+    pool.close();
+    EXPECT_EQ(pool.get_nb_threads(), 0);
+
+    /* one thread for a core */
+    ASSERT_EQ(pool.init(0), 0);
+    EXPECT_GE(pool.get_nb_threads(), POOL_MIN_THREADS);
+    EXPECT_LE(pool.get_nb_threads(), POOL_MAX_THREADS);
+    pool.close();
+
+    /* a thread of its own, for the tasks bound to a thread */
+    ASSERT_EQ(pool.init(1), 0);
+    EXPECT_EQ(pool.get_nb_threads(), 1);
+    pool.close();
+}
+
+TEST(TaskPool, single_thread)
+{
+    TaskPool pool;
+    Counter  c;
+    int      session;
+
+    /* woken from another thread and by the timer, one worker serves both */
+    ASSERT_EQ(pool.init(1), 0);
+    session = pool.open_session();
+    counter_init(&c, 0, TASK_WAIT);
+    c.timeout = 5;
+    ASSERT_EQ(pool.submit(&c.task, session), 0);
+    EXPECT_TRUE(wait_runs(&c, 2, 1000));
+    c.task.wake();
+    EXPECT_TRUE(wait_runs(&c, 3, 1000));
+    c.done = true;
+    c.task.wake();
+    pool.join(&c.task);
+    EXPECT_EQ(c.task.get_state(), TASK_FINISHED);
+    pool.close();
+}
+
+TEST(TaskPool, many_timers)
+{
+    const int n = POOL_MAX_FIRED * 3;
+    TaskPool  pool;
+    Counter   c[n];
+    int       session;
+
+    /* more timers expire at once than a worker collects, every task is woken and joined */
+    ASSERT_EQ(pool.init(2), 0);
+    session = pool.open_session();
+    for (int i = 0; i < n; i++) {
+        counter_init(&c[i], 2, TASK_WAIT);
+        c[i].timeout = 1;
+        ASSERT_EQ(pool.submit(&c[i].task, session), 0);
+    }
+    for (int i = 0; i < n; i++) {
+        pool.join(&c[i].task);
+        EXPECT_EQ(SDL_AtomicGet(&c[i].runs), 2);
+    }
+    pool.close();
+}
+
+TEST(TaskPool, sessions)
+{
+    TaskPool pool;
+    Counter  c;
+    int      session;
+
+    EXPECT_EQ(pool.open_session(), KERROR(KEUNINITED));
+    ASSERT_EQ(pool.init(2), 0);
+    for (int i = 0; i < POOL_MAX_SESSIONS; i++)
+        EXPECT_EQ(pool.open_session(), i);
+    EXPECT_EQ(pool.open_session(), KERROR(KEPOOL_SESSION_FULL));
+    pool.close_session(5);
+    EXPECT_EQ(pool.open_session(), 5);
+
+    /* a closed session takes no task */
+    pool.close_session(7);
+    counter_init(&c, 1, TASK_AGAIN);
+    EXPECT_EQ(pool.submit(&c.task, 7), KERROR(KEINVAL));
+    session = pool.open_session();
+    ASSERT_EQ(session, 7);
+    EXPECT_EQ(pool.submit(&c.task, session), 0);
+    pool.join(&c.task);
+    EXPECT_EQ(SDL_AtomicGet(&c.runs), 1);
+    pool.close();
+}
+
+TEST(TaskPool, run_to_done)
+{
+    TaskPool pool;
+    Counter  c;
+    int      session;
+
+    ASSERT_EQ(pool.init(2), 0);
+    session = pool.open_session();
+    ASSERT_GE(session, 0);
+
+    counter_init(&c, 1000, TASK_AGAIN);
+    pool.join(&c.task); // never submitted
+    ASSERT_EQ(pool.submit(&c.task, session), 0);
+    EXPECT_EQ(pool.submit(&c.task, session), KERROR(KEREINIT));
+    pool.join(&c.task);
+    EXPECT_EQ(SDL_AtomicGet(&c.runs), 1000);
+    EXPECT_EQ(c.task.get_state(), TASK_FINISHED);
+
+    /* submitted again after finished */
+    counter_init(&c, 10, TASK_AGAIN);
+    ASSERT_EQ(pool.submit(&c.task, session), 0);
+    pool.join(&c.task);
+    EXPECT_EQ(SDL_AtomicGet(&c.runs), 10);
+
+    pool.close_session(session);
+    pool.close();
+}
+
+TEST(TaskPool, wake_and_wait)
+{
+    TaskPool pool;
+    Counter  c;
+    int      session;
+
+    ASSERT_EQ(pool.init(4), 0);
+    session = pool.open_session();
+    counter_init(&c, 0, TASK_WAIT);
+    ASSERT_EQ(pool.submit(&c.task, session), 0);
+    ASSERT_TRUE(wait_runs(&c, 1, 1000));
+
+    /* a sleeping task runs once for a wake */
+    for (int i = 2; i < 100; i++) {
+        c.task.wake();
+        ASSERT_TRUE(wait_runs(&c, i, 1000));
+        SDL_Delay(i % 3);
+        EXPECT_EQ(SDL_AtomicGet(&c.runs), i);
+    }
+
+    c.done = true;
+    c.task.wake();
+    pool.join(&c.task);
+    pool.close();
+}
+
+TEST(TaskPool, wake_while_running)
+{
+    TaskPool pool;
+    Counter  c;
+    int      session;
+
+    ASSERT_EQ(pool.init(2), 0);
+    session = pool.open_session();
+    counter_init(&c, 0, TASK_WAIT);
+    c.sleep = 50;
+    ASSERT_EQ(pool.submit(&c.task, session), 0);
+
+    /* woken in the run, the task runs again */
+    ASSERT_TRUE(wait_runs(&c, 1, 1000));
+    c.task.wake();
+    ASSERT_TRUE(wait_runs(&c, 2, 1000));
+    c.sleep = 0;
+    SDL_Delay(100);
+    EXPECT_EQ(SDL_AtomicGet(&c.runs), 2);
+
+    c.done = true;
+    c.task.wake();
+    pool.join(&c.task);
+    pool.close();
+}
+
+TEST(TaskPool, timeout)
+{
+    TaskPool pool;
+    Counter  c;
+    int      session;
+
+    ASSERT_EQ(pool.init(2), 0);
+    session = pool.open_session();
+    counter_init(&c, 2, TASK_WAIT);
+    c.timeout = 50;
+    ASSERT_EQ(pool.submit(&c.task, session), 0);
+    pool.join(&c.task);
+    EXPECT_EQ(SDL_AtomicGet(&c.runs), 2);
+    EXPECT_GE(c.last - c.start, (Uint32)45);
+    pool.close();
+}
+
+TEST(TaskPool, fairness)
+{
+    TaskPool pool;
+    Counter  busy[8];
+    Counter  light;
+    int      busy_session;
+    int      light_session;
+    int      busy_runs = 0;
+
+    ASSERT_EQ(pool.init(2), 0);
+    busy_session = pool.open_session();
+    light_session = pool.open_session();
+
+    /* a session floods the pool */
+    for (int i = 0; i < 8; i++) {
+        counter_init(&busy[i], 200, TASK_AGAIN);
+        busy[i].sleep = 1;
+        ASSERT_EQ(pool.submit(&busy[i].task, busy_session), 0);
+    }
+    SDL_Delay(20);
+
+    /* the other session is served in turn, not behind the flood */
+    counter_init(&light, 20, TASK_AGAIN);
+    light.sleep = 1;
+    ASSERT_EQ(pool.submit(&light.task, light_session), 0);
+    pool.join(&light.task);
+    for (int i = 0; i < 8; i++)
+        busy_runs += SDL_AtomicGet(&busy[i].runs);
+    EXPECT_LT(busy_runs, 8 * 200 / 2);
+
+    for (int i = 0; i < 8; i++)
+        pool.join(&busy[i].task);
+    pool.close();
+}
@@ -1,7 +1,11 @@
 #include "frame_queue.h"
 #include "packet_queue.h"
+#include "pool/pool.h"
 #include "error/error.h"
 #include "log/log.h"
+#include "trace/trace.h"
+#include "lock/lock.h"
+#include "mem/mem.h"
 #include <new>
 
 extern "C"
@@ -31,13 +35,13 @@ FrameQueue::~FrameQueue ()
     if (this->cond)
         SDL_DestroyCond(this->cond);
     if (this->mutex)
-        SDL_DestroyMutex(this->mutex);
+        mutex_destroy(this->mutex);
 }
 
 int FrameQueue::init (PacketQueue *pktq, int max_len)
 {
     /* create condition variables and mutex */
-    this->mutex = SDL_CreateMutex();
+    this->mutex = mutex_create("frame queue");
     if (!this->mutex) {
         logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_MUTEX_FAIL), SDL_GetError());
         return KERROR(KECREATE_SDL_MUTEX_FAIL);
@@ -45,7 +49,7 @@ int FrameQueue::init (PacketQueue *pktq, int max_len)
     this->cond = SDL_CreateCond();
     if (!this->cond) {
         logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_COND_FAIL), SDL_GetError());
-        SDL_DestroyMutex(this->mutex);
+        mutex_destroy(this->mutex);
         return KERROR(KECREATE_SDL_COND_FAIL);
     }
 
@@ -64,7 +68,7 @@ int FrameQueue::init (PacketQueue *pktq, int max_len)
 }
 
 int FrameQueue::put (AVFrame *f, int64_t pos,
-                     double pts, double duration)
+                     double pts, double duration, int serial)
 {
     Frame *temp = NULL;
     int    ret = 0;
@@ -73,11 +77,13 @@ int FrameQueue::put (AVFrame *f, int64_t pos,
         return KERROR(KEINVAL);
 
     /* enter the critical aera */
-    SDL_LockMutex(this->mutex);
+    mutex_lock(this->mutex);
 
-    /* get an abort requestion */
-    if (this->pktq->abort_req)
+    /* get an abort requestion, the frame is dropped */
+    if (this->pktq->abort_req) {
+        mem_frame_free(this->pktq->mem, &f);
         goto fail; // (ret == 0)
+    }
 
     /* create a new node and put it to tail of frame queue */
     if (this->len < this->max_len) {
@@ -88,10 +94,15 @@ int FrameQueue::put (AVFrame *f, int64_t pos,
         temp->frame = f; // don't copy
         temp->pts = pts;
         temp->duration = duration;
+        temp->serial = serial;
         this->fq[this->windex] = temp;
         if (++this->windex == this->max_len)
             this->windex = 0;
         this->len++;
+        this->duration += duration;
+        this->size += mem_frame_size(f);
+        if (1 == this->len && this->consumer)
+            this->consumer->wake();
     } else {
         GOTO_FAIL(KEAGAIN);
     }
@@ -99,7 +110,7 @@ int FrameQueue::put (AVFrame *f, int64_t pos,
 fail:
     /* leave the critical aera */
     SDL_CondSignal(this->cond);
-    SDL_UnlockMutex(this->mutex);
+    mutex_unlock(this->mutex);
 
     return ret;
 }
@@ -109,7 +120,7 @@ Frame *FrameQueue::get ()
     Frame *ret = NULL;
 
     /* enter the critical aera */
-    SDL_LockMutex(this->mutex);
+    mutex_lock(this->mutex);
 
     /* get the queue head node from queue head, blocked */
     while (!this->pktq->abort_req) {
@@ -118,7 +129,10 @@ Frame *FrameQueue::get ()
             this->fq[this->rindex] = NULL;
             if (++this->rindex == this->max_len)
                 this->rindex = 0;
-            this->len--;
+            this->duration -= ret->duration;
+            this->size -= mem_frame_size(ret->frame);
+            if (this->len-- == this->max_len && this->producer)
+                this->producer->wake();
             break;
         } else { // (len == 0)
             /* return NULL when the play is over */
@@ -126,13 +140,15 @@ Frame *FrameQueue::get ()
                 break;
 
             /* waiting until (len != 0) or aborted */
-            SDL_CondWait(this->cond, this->mutex);
+            int64_t span = trace_begin();
+            cond_wait(this->cond, this->mutex);
+            trace_end("FrameQueue::get wait", span);
         }
     }
 
     /* leave the critical aera */
     SDL_CondSignal(this->cond);
-    SDL_UnlockMutex(this->mutex);
+    mutex_unlock(this->mutex);
 
     return ret;
 }
@@ -142,7 +158,7 @@ Frame * FrameQueue::peek ()
     Frame *ret = NULL;
 
     /* enter the critical aera */
-    SDL_LockMutex(this->mutex);
+    mutex_lock(this->mutex);
 
     /* get the queue head node from queue head, blocked */
     while (!this->pktq->abort_req) {
@@ -155,22 +171,86 @@ Frame * FrameQueue::peek ()
                 break;
 
             /* waiting until (len != 0) or aborted */
-            SDL_CondWait(this->cond, this->mutex);
+            cond_wait(this->cond, this->mutex);
         }
     }
 
     /* leave the critical aera */
     SDL_CondSignal(this->cond);
-    SDL_UnlockMutex(this->mutex);
+    mutex_unlock(this->mutex);
+
+    return ret;
+}
+
+Frame * FrameQueue::peek_timeout (int timeout)
+{
+    Frame *ret = NULL;
+    Uint32 deadline = SDL_GetTicks() + timeout;
+
+    /* enter the critical aera */
+    mutex_lock(this->mutex);
+
+    /* get the queue head node from queue head, blocked no longer than timeout */
+    while (!this->pktq->abort_req) {
+        if (this->len) {
+            ret = this->fq[this->rindex];
+            break;
+        } else { // (len == 0)
+            /* return NULL when the play is over or timed out */
+            if (!this->len && !this->pktq->len && this->pktq->read_eof)
+                break;
+            Sint32 remain = (Sint32)(deadline - SDL_GetTicks());
+            if (remain <= 0)
+                break;
+
+            /* waiting until (len != 0), aborted or timed out */
+            cond_wait_timeout(this->cond, this->mutex, (Uint32)remain);
+        }
+    }
+
+    /* leave the critical aera */
+    mutex_unlock(this->mutex);
 
     return ret;
 }
 
+void FrameQueue::wait_space (int timeout)
+{
+    /* enter the critical aera */
+    mutex_lock(this->mutex);
+
+    /* waiting until a frame is taken or aborted, signaled by get() and abort() */
+    if (this->len >= this->max_len && !this->pktq->abort_req)
+        cond_wait_timeout(this->cond, this->mutex, timeout);
+
+    /* leave the critical aera */
+    mutex_unlock(this->mutex);
+}
+
+void FrameQueue::set_producer (Task *producer)
+{
+    /* the tasks are woken with mutex locked, no task is woken after it is removed */
+    mutex_lock(this->mutex);
+    this->producer = producer;
+    mutex_unlock(this->mutex);
+}
+
+void FrameQueue::set_consumer (Task *consumer)
+{
+    mutex_lock(this->mutex);
+    this->consumer = consumer;
+    mutex_unlock(this->mutex);
+}
+
 void FrameQueue::abort ()
 {
-    SDL_LockMutex(this->mutex);
+    mutex_lock(this->mutex);
+    if (this->producer)
+        this->producer->wake();
+    if (this->consumer)
+        this->consumer->wake();
     SDL_CondSignal(this->cond);
-    SDL_UnlockMutex(this->mutex);
+    mutex_unlock(this->mutex);
 }
 
 void FrameQueue::clear ()
@@ -178,12 +258,12 @@ void FrameQueue::clear ()
     int i = 0; 
 
     /* enter the critical aera */
-    SDL_LockMutex(this->mutex);
+    mutex_lock(this->mutex);
 
     /* clear all nodes */
     while (i < max_len) {
         if (this->fq[i]) // equal to "if (this->fq[i] && this->fq[i]->frame)" in this application
-            av_frame_free(&this->fq[i]->frame);
+            mem_frame_free(this->pktq->mem, &this->fq[i]->frame);
         delete this->fq[i];
         this->fq[i] = NULL;
         i++;
@@ -191,11 +271,15 @@ void FrameQueue::clear ()
 
     /* reset all information */
     this->len = 0;
+    this->duration = 0.0;
+    this->size = 0;
     this->windex = 0;
     this->rindex = 0;
+    if (this->producer)
+        this->producer->wake();
 
     /* leave the critical aera */
-    SDL_UnlockMutex(this->mutex);
+    mutex_unlock(this->mutex);
 }
 
 int FrameQueue::get_len ()
@@ -203,7 +287,27 @@ int FrameQueue::get_len ()
     return this->len;
 }
 
+int FrameQueue::get_max_len ()
+{
+    return this->max_len;
+}
+
+double FrameQueue::get_duration ()
+{
+    return this->len ? this->duration : 0.0;
+}
+
+int64_t FrameQueue::get_size ()
+{
+    return this->size;
+}
+
 bool FrameQueue::is_eof()
 {
     return (!this->len && !this->pktq->len && this->pktq->read_eof);
 }
+
+MemStats *FrameQueue::get_mem ()
+{
+    return this->pktq->mem;
+}
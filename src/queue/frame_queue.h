@@ -11,7 +11,9 @@ extern "C"
 
 /* queue length */
 #define DEF_SAMPLEQ_LEN        10
+#define MIN_SAMPLEQ_LEN        3
 #define DEF_PICTQ_LEN          10
+#define MIN_PICTQ_LEN          3
 #define DEF_SUBPICTQ_LEN       10
 #define MAX_SAMPLEQ_LEN        100
 #define MAX_PICTQ_LEN          100
@@ -22,6 +24,7 @@ typedef struct Frame {
     AVFrame *           frame;   // pointer of frame
     double              pts;      // pts of frame (unit: second)
     double              duration; // duration of frame (unit: second)
+    int                 serial;   // increased by the decoder on every splice
 }Frame;
 
 /* frame queue */
@@ -32,19 +35,31 @@ private:
     int                 rindex;   // read index
     int                 windex;   // write index
     int                 max_len;  // max length of queue
+    double              duration; // duration of the frames queued (unit: second)
+    int64_t             size;     // bytes of the frame buffers queued
     SDL_mutex *         mutex;   // mutex
     SDL_cond *          cond;    // cond
     PacketQueue *       pktq;    // pointer of associated packet queue 
+    Task *              producer; // woken when a frame is taken from the full queue
+    Task *              consumer; // woken when a frame is put
 
 public:
     int    init    (PacketQueue *pktq, int max_len);
-    int    put     (AVFrame *f, int64_t pos, double pts, double duration);
+    int    put     (AVFrame *f, int64_t pos, double pts, double duration, int serial);
     Frame *get     ();
     Frame *peek    ();
+    Frame *peek_timeout (int timeout);
+    void   wait_space (int timeout);
+    void   set_producer (Task *producer);
+    void   set_consumer (Task *consumer);
     void   abort   ();
     void   clear   ();
     int    get_len ();
+    int    get_max_len ();
+    double get_duration ();
+    int64_t get_size ();
     bool   is_eof  ();
+    MemStats *get_mem ();
 
 public:
     FrameQueue     ();
@@ -1,6 +1,10 @@
 #include "packet_queue.h"
+#include "pool/pool.h"
 #include "error/error.h"
 #include "log/log.h"
+#include "trace/trace.h"
+#include "lock/lock.h"
+#include "mem/mem.h"
 #include <new>
 
 extern "C"
@@ -27,13 +31,13 @@ PacketQueue::~PacketQueue ()
     if (cond)
         SDL_DestroyCond(cond);
     if (mutex)
-        SDL_DestroyMutex(mutex);
+        mutex_destroy(mutex);
 }
 
-int PacketQueue::init ()
+int PacketQueue::init (MemStats *mem)
 {
     /* create condition variables and mutex */
-    mutex = SDL_CreateMutex();
+    mutex = mutex_create("packet queue");
     if (!mutex) {
         logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_MUTEX_FAIL), SDL_GetError());
         return KERROR(KECREATE_SDL_MUTEX_FAIL);
@@ -41,9 +45,10 @@ int PacketQueue::init ()
     cond = SDL_CreateCond();
     if (!cond) {
         logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_COND_FAIL), SDL_GetError());
-        SDL_DestroyMutex(mutex);
+        mutex_destroy(mutex);
         return KERROR(KECREATE_SDL_COND_FAIL);
     }
+    this->mem = mem;
 
 	return 0;
 }
@@ -57,11 +62,13 @@ int PacketQueue::put (AVPacket *pkt)
         return KERROR(KEINVAL);
 
     /* enter the critical area */
-    SDL_LockMutex(mutex);
+    mutex_lock(mutex);
 
-    /* get an abort requestion */
-    if (abort_req)
+    /* get an abort requestion, the packet is dropped */
+    if (abort_req) {
+        mem_packet_free(mem, &pkt);
         goto fail; // (ret == 0)
+    }
     
     /* create a new node and put it to tail of packet queue */
     temp = _New Packet();
@@ -78,11 +85,13 @@ int PacketQueue::put (AVPacket *pkt)
     len++;
     size += pkt->size;
     duration += pkt->duration;
+    if (1 == len && consumer)
+        consumer->wake();
 
 fail:
     /* leave the critical area */
     SDL_CondSignal(cond);
-    SDL_UnlockMutex(mutex);
+    mutex_unlock(mutex);
 
     return ret;
 }
@@ -93,7 +102,7 @@ AVPacket *PacketQueue::get ()
     Packet   *temp = tail;
 
     /* enter the critical area */
-    SDL_LockMutex(mutex);
+    mutex_lock(mutex);
 
     /* get the queue head node from queue head, blocked */
     while (!abort_req) {
@@ -113,7 +122,9 @@ AVPacket *PacketQueue::get ()
                 break;
             
             /* waiting until (len != 0) or aborted */
-            SDL_CondWait(cond, mutex);
+            int64_t span = trace_begin();
+            cond_wait(cond, mutex);
+            trace_end("PacketQueue::get wait", span);
 /*
 *           blocking until seeked or aborted when (len == 0 && read_eof == 1)
 *           if (!len && read_eof)
@@ -124,33 +135,85 @@ AVPacket *PacketQueue::get ()
 
     /* leave the critical area */
     SDL_CondSignal(cond);
-    SDL_UnlockMutex(mutex);
+    mutex_unlock(mutex);
 
     return ret;
 }
 
+AVPacket *PacketQueue::try_get ()
+{
+    AVPacket *ret = NULL;
+    Packet   *temp;
+
+    /* enter the critical area */
+    mutex_lock(mutex);
+
+    /* get the queue head node from queue head, unblocked */
+    temp = head;
+    if (!abort_req && temp) {
+        head = head->next;
+        if (!head)
+            tail = NULL;
+        ret = temp->pkt;
+        delete temp;
+        len--;
+        size -= ret->size;
+        duration -= ret->duration;
+
+        /* running low, continue reading */
+        if (len <= PKTQ_LOW_LEN && producer)
+            producer->wake();
+    }
+
+    /* leave the critical area */
+    mutex_unlock(mutex);
+
+    return ret;
+}
+
+void PacketQueue::set_producer (Task *producer)
+{
+    /* the tasks are woken with mutex locked, no task is woken after it is removed */
+    mutex_lock(mutex);
+    this->producer = producer;
+    mutex_unlock(mutex);
+}
+
+void PacketQueue::set_consumer (Task *consumer)
+{
+    mutex_lock(mutex);
+    this->consumer = consumer;
+    mutex_unlock(mutex);
+}
+
 void PacketQueue::set_read_eof (bool is_read_eof)
 {
-    SDL_LockMutex(mutex);
+    mutex_lock(mutex);
     read_eof = is_read_eof;
+    if (consumer)
+        consumer->wake();
     SDL_CondSignal(cond);
-    SDL_UnlockMutex(mutex);
+    mutex_unlock(mutex);
 }
 
 void PacketQueue::restore ()
 {
-    SDL_LockMutex(mutex);
+    mutex_lock(mutex);
     abort_req = false;
+    if (consumer)
+        consumer->wake();
     SDL_CondSignal(cond);
-    SDL_UnlockMutex(mutex);
+    mutex_unlock(mutex);
 }
 
 void PacketQueue::abort ()
 {
-    SDL_LockMutex(mutex);
+    mutex_lock(mutex);
     abort_req = true;
+    if (consumer)
+        consumer->wake();
     SDL_CondSignal(cond);
-    SDL_UnlockMutex(mutex);
+    mutex_unlock(mutex);
 }
 
 void PacketQueue::clear ()
@@ -158,12 +221,12 @@ void PacketQueue::clear ()
     Packet *temp = head;
 
     /* enter the critical area */
-    SDL_LockMutex(mutex);
+    mutex_lock(mutex);
 
     /* clear all nodes */
     while (head) {
         head = head->next;
-        av_packet_free(&temp->pkt);
+        mem_packet_free(mem, &temp->pkt);
         delete temp;
         temp = head;
     }
@@ -177,7 +240,7 @@ void PacketQueue::clear ()
     read_eof = false;
 
     /* leave the critical area */
-    SDL_UnlockMutex(mutex);
+    mutex_unlock(mutex);
 }
 
 int PacketQueue::get_len ()
@@ -200,3 +263,8 @@ bool PacketQueue::is_eof()
     return (!len && read_eof);
 }
 
+MemStats *PacketQueue::get_mem ()
+{
+    return mem;
+}
+
@@ -11,8 +11,14 @@ extern "C"
 #define DEF_PKTQ_SIZE       (40 * 1024 * 1024)   // 50MB
 #define MAX_PKTQ_SIZE       (1024 * 1024 * 1024) // 1GB
 #define MIN_PKTQ_SIZE       (10 * 1024 * 1024)   // 10MB
+#define PKTQ_LOW_LEN        2                    // the producer is woken when the queue gets so short
+
+/* stream index of the packet marking the end of a spliced file */
+#define SPLICE_PKT_STREAM_INDEX -1
 
 class FrameQueue;
+class Task;
+struct MemStats;
 
 /* packet node */
 typedef struct Packet {
@@ -35,13 +41,19 @@ private:
     bool                read_eof;  // whether read eof
     SDL_mutex *         mutex;    // mutex
     SDL_cond *          cond;     // cond
+    Task *              producer; // woken when the queue runs low
+    Task *              consumer; // woken when a packet is put or the state changes
+    MemStats *          mem;      // memory accounting of the session, shared by the pipeline
 
 public:
     PacketQueue ();
 	~PacketQueue ();
-	int       init         ();
+	int       init         (MemStats *mem);
 	int       put          (AVPacket *pkt);
 	AVPacket *get          ();
+	AVPacket *try_get      ();
+	void      set_producer (Task *producer);
+	void      set_consumer (Task *consumer);
 	void      set_read_eof (bool is_read_eof);
 	void      restore      ();
 	void      abort        ();
@@ -50,6 +62,7 @@ public:
 	int64_t   get_size     ();
 	int64_t   get_duration ();
     bool      is_eof       ();
+    MemStats *get_mem      ();
 };
 
 #endif /* _AVPLAYERWIDGET_PACKET_QUEUE_H_ */
\ No newline at end of file
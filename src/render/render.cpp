@@ -1,7 +1,8 @@
 #include "error/error.h"
 #include "log/log.h"
+#include "trace/trace.h"
+#include "mem/mem.h"
 #include "render.h"
-#include "vdev/vdev.h"
 #include "adev/adev.h"
 #include <cstring>
 #include <new>
@@ -44,8 +45,22 @@ int Render::init_swr ()
     return 0;
 }
 
-int Render::alloc_texture (int fmt, int w, int h, SDL_BlendMode blend_mode)
+int Render::realloc_texture (int fmt, int w, int h, SDL_BlendMode blend_mode)
 {
+    Uint32 cur_fmt;
+    int    cur_w;
+    int    cur_h;
+
+    /* reuse the texture of the last frame, textures are created only when the format or size changes */
+    if (vid_texture) {
+        if (!SDL_QueryTexture(vid_texture, &cur_fmt, NULL, &cur_w, &cur_h)
+            && (Uint32)fmt == cur_fmt && w == cur_w && h == cur_h)
+            return 0;
+        mem_add(mem, MEM_TEXTURE, -1, -mem_texture_size(vid_texture));
+        SDL_DestroyTexture(vid_texture);
+        vid_texture = NULL;
+    }
+
     if (!(vid_texture = SDL_CreateTexture(sdl_renderer,
                                           fmt, 
                                           SDL_TEXTUREACCESS_STREAMING,
@@ -54,6 +69,7 @@ int Render::alloc_texture (int fmt, int w, int h, SDL_BlendMode blend_mode)
         logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_TEXTURE_FAIL), SDL_GetError());
         return KERROR(KECREATE_TEXTURE_FAIL); 
     }
+    mem_add(mem, MEM_TEXTURE, 1, mem_texture_size(vid_texture));
     if (SDL_SetTextureBlendMode(vid_texture, blend_mode) < 0) {
         logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KESET_TEXTURE_BLEND_MODE_FAIL), SDL_GetError());
         return KERROR(KESET_TEXTURE_BLEND_MODE_FAIL);
@@ -73,6 +89,7 @@ int Render::render_video_image (Frame * vf, SDL_Texture ** texture)
     uint8_t **    data = vf->frame->data;
     int *         linesize = vf->frame->linesize;
     int           ret;
+    TRACE_SCOPE("render_video_image");
 
 //    if (!yuv_vf)
 //        return KERROR(KENOMEM);
@@ -128,8 +145,7 @@ int Render::render_video_image (Frame * vf, SDL_Texture ** texture)
     /* update texture */
 
     /* realloc texture */
-//    ret = realloc_texture(texture, sdl_pix_fmt, rect->w, rect->h, sdl_blend_mode);
-    ret = alloc_texture(sdl_pix_fmt, vf->frame->width, vf->frame->height, sdl_blend_mode);
+    ret = realloc_texture(sdl_pix_fmt, vf->frame->width, vf->frame->height, sdl_blend_mode);
     if (ret < 0) {
         logger.FATALN("[%s: %d]%s.\n", kerr2str(KEREALLOC_TEXTURE_FAIL));
         return KERROR(KEREALLOC_TEXTURE_FAIL);
@@ -168,8 +184,8 @@ int Render::render_video_image (Frame * vf, SDL_Texture ** texture)
         return KERROR(KEUPDATE_TEXTURE_FAIL);
     }
 
+    /* the texture is still owned by render */
     *texture = vid_texture;
-    vid_texture = NULL;
     ret = 0;
 fail:
 //    av_frame_free(&yuv_vf);
@@ -212,13 +228,13 @@ void Render::init_vrender ()
 
 void Render::close_vrender ()
 {
-    if (!sws_ctx)
-        return;
-
-    if (vid_texture)
+    if (vid_texture) {
+        mem_add(mem, MEM_TEXTURE, -1, -mem_texture_size(vid_texture));
         SDL_DestroyTexture(vid_texture);
+    }
     vid_texture = NULL;
-    sws_freeContext(sws_ctx);
+    if (sws_ctx)
+        sws_freeContext(sws_ctx);
     sws_ctx = NULL;
 }
 
@@ -246,7 +262,9 @@ int Render::render_video_frame (Frame * vf, SDL_Texture ** texture)
     if (!vf->frame->width || !vf->frame->height) // fix bad frame
         return 0;
 
+    int64_t begin = av_gettime_relative();
     int ret = render_video_image(vf, texture);
+    stage_stats_add(&vstats, 1, 0, av_gettime_relative() - begin);
     if (ret < 0) {
         logger.FATALN("[%s: %d]%s.\n", kerr2str(KEVIDEO_IMAGE_DISPLAY_FAIL));
         return KERROR(KEVIDEO_IMAGE_DISPLAY_FAIL);
@@ -255,6 +273,11 @@ int Render::render_video_frame (Frame * vf, SDL_Texture ** texture)
     return 0;
 }
 
+AudioParams Render::get_ap_src () const
+{
+    return ap_src;
+}
+
 AudioParams Render::get_ap_tgt () const
 {
     return ap_tgt;
@@ -265,21 +288,29 @@ void Render::set_speed (double speed)
     this->speed = speed;
 }
 
+StageStats *Render::get_vstats ()
+{
+    return &vstats;
+}
+
 Render::Render (SDL_Renderer * sdl_renderer, FrameQueue * vfq, FrameQueue * afq, SDL_mutex * wait_mutex, SDL_cond * empty_queue_cond)
 {
     this->sdl_renderer = sdl_renderer;
     this->vfq = vfq;
     this->afq = afq;
+    this->mem = vfq ? vfq->get_mem() : (afq ? afq->get_mem() : NULL);
     this->wait_mutex = wait_mutex;
     this->empty_queue_cond = empty_queue_cond;
     swr_ctx = NULL;
     sws_ctx = NULL;
+    vid_texture = NULL;
     speed = 1.0;
+    stage_stats_reset(&vstats);
 }
 
 Render::~Render ()
 {
-    if (sws_ctx)
+    if (sws_ctx || vid_texture)
         close_vrender();
     if (swr_ctx)
         close_arender();
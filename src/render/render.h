@@ -5,7 +5,7 @@
 #include "clock/clock.h"
 #include "queue/frame_queue.h"
 #include "adev/adev.h"
-#include "vdev/vdev.h"
+#include "stats/stats.h"
 
 extern "C"
 {
@@ -16,12 +16,6 @@ extern "C"
 #include "SDL2/SDL.h"
 }
 
-#define AV_SYNC_THRESHOLD_MIN       0.04 // no AV sync correction is done if below the minimum AV sync threshold
-#define AV_SYNC_THRESHOLD_MAX       0.1  // AV sync correction is done if above the maximum AV sync threshold 
-#define AV_SYNC_FRAMEDUP_THRESHOLD  0.1  // if a frame duration is longer than this, it will not be duplicated to compensate AV sync
-#define AV_SYNC_FRAMEDROP_THRESHOLD 0.5 
-#define AV_SYNC_DELAY_MAX           2.0  // max delay in seconds
-
 /* speed */
 #define MAX_SPEED 4.0
 #define MIN_SPEED 0.1
@@ -66,7 +60,7 @@ private:
     /* sdl renderer */
     SDL_Renderer * sdl_renderer;
 
-    /* sdl texture */
+    /* sdl texture, reused by the next frame of the same format and size */
     SDL_Texture *  vid_texture;
 
     /* swr context */
@@ -78,14 +72,18 @@ private:
     /* frame queues */
     FrameQueue *   vfq;
     FrameQueue *   afq;
+    MemStats *     mem;           // of the queues, counts the texture
 
     /* mutex and cond */
     SDL_mutex *    wait_mutex;
     SDL_cond *     empty_queue_cond;
+
+    /* statistics */
+    StageStats     vstats;        // frames converted and uploaded
     
 private:
     int         init_swr           ();
-    int         alloc_texture      (int fmt, int w, int h, SDL_BlendMode blend_mode);
+    int         realloc_texture    (int fmt, int w, int h, SDL_BlendMode blend_mode);
     int         render_video_image (Frame *vf, SDL_Texture **texture);
 
 public:
@@ -95,8 +93,10 @@ public:
     void        close_arender      ();
     int         resample           (AVFrame *vf, SampleBuf *sample_buf);
     int         render_video_frame (Frame *vf, SDL_Texture **texture);
+    AudioParams get_ap_src         () const;
     AudioParams get_ap_tgt         () const;
     void        set_speed          (double speed);
+    StageStats *get_vstats         ();
 
 public:
     Render                         (SDL_Renderer *sdl_renderer, FrameQueue *vfq, FrameQueue *afq,
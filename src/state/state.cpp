@@ -0,0 +1,159 @@
+#include "state.h"
+#include "error/error.h"
+#include "log/log.h"
+#include "lock/lock.h"
+
+extern "C"
+{
+#include "SDL2/SDL.h"
+}
+
+#define FILENAME "state.cpp"
+
+static const char *player_state_map[] = {
+    "stopped",                              // PLAYER_STATE_STOPPED
+    "opening",                              // PLAYER_STATE_OPENING
+    "playing",                              // PLAYER_STATE_PLAYING
+    "paused",                               // PLAYER_STATE_PAUSED
+    "seeking",                              // PLAYER_STATE_SEEKING
+    "draining"                              // PLAYER_STATE_DRAINING
+};
+
+/* transitions allowed, [from][to] */
+static const bool player_state_table[PLAYER_STATE_MAX + 1][PLAYER_STATE_MAX + 1] = {
+    /*              stopped opening playing paused seeking draining */
+    /* stopped  */ {true,   true,   false,  false, false,  false},
+    /* opening  */ {true,   false,  true,   true,  false,  false},
+    /* playing  */ {true,   false,  false,  true,  true,   true },
+    /* paused   */ {true,   false,  true,   false, true,   true },
+    /* seeking  */ {true,   false,  true,   true,  true,   false},
+    /* draining */ {true,   false,  true,   true,  true,   false}
+};
+
+State::State ()
+{
+    state = 0;
+    mutex = NULL;
+    cond = NULL;
+}
+
+State::~State ()
+{
+    close();
+}
+
+int State::init (int state)
+{
+    if (mutex)
+        return KERROR(KEREINIT);
+
+    /* create mutex and cond */
+    mutex = mutex_create("state");
+    if (!mutex) {
+        logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_MUTEX_FAIL), SDL_GetError());
+        return KERROR(KECREATE_SDL_MUTEX_FAIL);
+    }
+    cond = SDL_CreateCond();
+    if (!cond) {
+        logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_COND_FAIL), SDL_GetError());
+        mutex_destroy(mutex);
+        mutex = NULL;
+        return KERROR(KECREATE_SDL_COND_FAIL);
+    }
+
+    this->state = state;
+    return 0;
+}
+
+void State::close ()
+{
+    if (cond)
+        SDL_DestroyCond(cond);
+    if (mutex)
+        mutex_destroy(mutex);
+    cond = NULL;
+    mutex = NULL;
+}
+
+void State::set (int state)
+{
+    mutex_lock(mutex);
+    if (this->state != state) {
+        this->state = state;
+        SDL_CondBroadcast(cond);
+    }
+    mutex_unlock(mutex);
+}
+
+bool State::compare_set (int from, int to)
+{
+    bool ret;
+
+    mutex_lock(mutex);
+    ret = this->state == from;
+    if (ret && from != to) {
+        this->state = to;
+        SDL_CondBroadcast(cond);
+    }
+    mutex_unlock(mutex);
+
+    return ret;
+}
+
+int State::get ()
+{
+    int ret;
+
+    mutex_lock(mutex);
+    ret = state;
+    mutex_unlock(mutex);
+
+    return ret;
+}
+
+int State::wait_for (int state, bool equal, int timeout)
+{
+    Uint32 deadline = SDL_GetTicks() + (Uint32)(timeout < 0 ? 0 : timeout);
+    int    ret = 0;
+
+    mutex_lock(mutex);
+    while ((this->state == state) != equal) {
+        if (timeout < 0) {
+            cond_wait(cond, mutex);
+        } else {
+            Sint32 remain = (Sint32)(deadline - SDL_GetTicks());
+            if (remain <= 0) {
+                ret = KERROR(KETIMEDOUT);
+                break;
+            }
+            cond_wait_timeout(cond, mutex, (Uint32)remain);
+        }
+    }
+    mutex_unlock(mutex);
+
+    return ret;
+}
+
+int State::wait (int state, int timeout)
+{
+    return wait_for(state, true, timeout);
+}
+
+int State::wait_not (int state, int timeout)
+{
+    return wait_for(state, false, timeout);
+}
+
+const char *player_state_str (int state)
+{
+    if (state < 0 || state > PLAYER_STATE_MAX)
+        return "unknown";
+    return player_state_map[state];
+}
+
+bool player_state_can_set (int from, int to)
+{
+    if (from < 0 || from > PLAYER_STATE_MAX || to < 0 || to > PLAYER_STATE_MAX)
+        return false;
+    return player_state_table[from][to];
+}
@@ -0,0 +1,54 @@
+#ifndef _AVPLAYERWIDGET_STATE_H_
+#define _AVPLAYERWIDGET_STATE_H_
+
+extern "C"
+{
+#include "SDL2/SDL.h"
+}
+
+/* player states */
+#define PLAYER_STATE_STOPPED    0
+#define PLAYER_STATE_OPENING    1
+#define PLAYER_STATE_PLAYING    2
+#define PLAYER_STATE_PAUSED     3
+#define PLAYER_STATE_SEEKING    4
+#define PLAYER_STATE_DRAINING   5
+#define PLAYER_STATE_MAX        PLAYER_STATE_DRAINING
+
+/* worker thread states, acknowledged by the worker itself */
+#define WORKER_RUNNING          0
+#define WORKER_PAUSED           1
+#define WORKER_STOPPED          2
+
+/* wait forever */
+#define STATE_WAIT_FOREVER      -1
+
+/*
+* state shared between threads,
+* the waiters sleep on a condition variable until the state is acknowledged
+*/
+class State {
+private:
+    int        state;  // current state
+    SDL_mutex *mutex;  // mutex
+    SDL_cond * cond;   // broadcast on every change
+
+private:
+    int  wait_for    (int state, bool equal, int timeout);
+
+public:
+    State            ();
+    ~State           ();
+    int  init        (int state);
+    void close       ();
+    void set         (int state);
+    bool compare_set (int from, int to); // false if the state is not from
+    int  get         ();
+    int  wait        (int state, int timeout);
+    int  wait_not    (int state, int timeout);
+};
+
+const char *player_state_str     (int state);
+bool        player_state_can_set (int from, int to);
+
+#endif /* _AVPLAYERWIDGET_STATE_H_ */
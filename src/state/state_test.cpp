@@ -0,0 +1,230 @@
+#include <gtest/gtest.h>
+#include "state.h"
+#include "error/error.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+extern "C"
+{
+#include "SDL2/SDL.h"
+}
+
+/* cpu time of the process (unit: second) */
+static double cpu_time ()
+{
+#ifdef _WIN32
+    FILETIME create, exit, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &create, &exit, &kernel, &user);
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (double)(k.QuadPart + u.QuadPart) / 1e7;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+           + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+#endif
+}
+
+/* a worker acknowledging pause and resume like the decoder threads */
+typedef struct Worker {
+    State        state;
+    SDL_mutex *  mutex;
+    SDL_cond *   cond;
+    SDL_atomic_t pause_req;
+    SDL_atomic_t abort_req;
+    int          resume_gen; // protected by mutex
+    SDL_atomic_t loops;
+}Worker;
+
+static int SDLCALL worker_thread (void *args)
+{
+    Worker *w = (Worker *)args;
+    int     resume_gen;
+
+    while (!SDL_AtomicGet(&w->abort_req)) {
+        if (SDL_AtomicGet(&w->pause_req)) {
+            SDL_LockMutex(w->mutex);
+            SDL_AtomicSet(&w->pause_req, 0);
+            resume_gen = w->resume_gen;
+            w->state.set(WORKER_PAUSED);
+            while (resume_gen == w->resume_gen && !SDL_AtomicGet(&w->abort_req))
+                SDL_CondWait(w->cond, w->mutex);
+            w->state.set(WORKER_RUNNING);
+            SDL_UnlockMutex(w->mutex);
+        }
+        SDL_AtomicIncRef(&w->loops);
+        SDL_Delay(1);
+    }
+    w->state.set(WORKER_STOPPED);
+
+    return 0;
+}
+
+static void worker_resume (Worker *w)
+{
+    SDL_LockMutex(w->mutex);
+    w->resume_gen++;
+    SDL_CondSignal(w->cond);
+    SDL_UnlockMutex(w->mutex);
+}
+
+static int SDLCALL waiter_thread (void *args)
+{
+    State *state = (State *)args;
+
+    return state->wait(WORKER_STOPPED, STATE_WAIT_FOREVER);
+}
+
+static int SDLCALL transition_thread (void *args)
+{
+    return ((State *)args)->compare_set(WORKER_RUNNING, WORKER_PAUSED) ? 1 : 0;
+}
+
+static int worker_start (Worker *w, SDL_Thread **thr)
+{
+    if (w->state.init(WORKER_RUNNING) < 0)
+        return -1;
+    w->mutex = SDL_CreateMutex();
+    w->cond = SDL_CreateCond();
+    SDL_AtomicSet(&w->pause_req, 0);
+    SDL_AtomicSet(&w->abort_req, 0);
+    w->resume_gen = 0;
+    SDL_AtomicSet(&w->loops, 0);
+    *thr = SDL_CreateThread(worker_thread, "worker_thread", w);
+
+    return *thr ? 0 : -1;
+}
+
+static void worker_stop (Worker *w, SDL_Thread *thr)
+{
+    SDL_AtomicSet(&w->abort_req, 1);
+    worker_resume(w);
+    SDL_WaitThread(thr, NULL);
+    SDL_DestroyCond(w->cond);
+    SDL_DestroyMutex(w->mutex);
+}
+
+TEST(State, set_and_get)
+{
+    State state;
+
+    ASSERT_EQ(state.init(WORKER_RUNNING), 0);
+    EXPECT_EQ(state.init(WORKER_RUNNING), KERROR(KEREINIT));
+    EXPECT_EQ(state.get(), WORKER_RUNNING);
+    state.set(WORKER_PAUSED);
+    EXPECT_EQ(state.get(), WORKER_PAUSED);
+    EXPECT_EQ(state.wait(WORKER_PAUSED, 0), 0);
+    EXPECT_EQ(state.wait_not(WORKER_RUNNING, 0), 0);
+
+    /* replaced only from the state expected */
+    EXPECT_FALSE(state.compare_set(WORKER_RUNNING, WORKER_STOPPED));
+    EXPECT_EQ(state.get(), WORKER_PAUSED);
+    EXPECT_TRUE(state.compare_set(WORKER_PAUSED, WORKER_STOPPED));
+    EXPECT_EQ(state.get(), WORKER_STOPPED);
+}
+
+TEST(State, wait_timeout)
+{
+    State  state;
+    Uint32 start;
+
+    ASSERT_EQ(state.init(WORKER_RUNNING), 0);
+    start = SDL_GetTicks();
+    EXPECT_EQ(state.wait(WORKER_PAUSED, 50), KERROR(KETIMEDOUT));
+    EXPECT_GE(SDL_GetTicks() - start, (Uint32)45);
+    EXPECT_EQ(state.wait_not(WORKER_RUNNING, 10), KERROR(KETIMEDOUT));
+}
+
+TEST(State, transition)
+{
+    EXPECT_TRUE(player_state_can_set(PLAYER_STATE_STOPPED, PLAYER_STATE_OPENING));
+    EXPECT_TRUE(player_state_can_set(PLAYER_STATE_PLAYING, PLAYER_STATE_SEEKING));
+    EXPECT_TRUE(player_state_can_set(PLAYER_STATE_DRAINING, PLAYER_STATE_STOPPED));
+    EXPECT_FALSE(player_state_can_set(PLAYER_STATE_STOPPED, PLAYER_STATE_PLAYING));
+    EXPECT_FALSE(player_state_can_set(PLAYER_STATE_OPENING, PLAYER_STATE_SEEKING));
+    EXPECT_FALSE(player_state_can_set(-1, PLAYER_STATE_STOPPED));
+    EXPECT_STREQ(player_state_str(PLAYER_STATE_SEEKING), "seeking");
+}
+
+TEST(State, pause_and_resume)
+{
+    Worker      w;
+    SDL_Thread *thr;
+
+    ASSERT_EQ(worker_start(&w, &thr), 0);
+    for (int i = 0; i < 100; i++) {
+        SDL_AtomicSet(&w.pause_req, 1);
+        ASSERT_EQ(w.state.wait(WORKER_PAUSED, 1000), 0);
+        int loops = SDL_AtomicGet(&w.loops);
+        SDL_Delay(2);
+        EXPECT_EQ(SDL_AtomicGet(&w.loops), loops);
+        worker_resume(&w);
+        ASSERT_EQ(w.state.wait(WORKER_RUNNING, 1000), 0);
+    }
+    worker_stop(&w, thr);
+    EXPECT_EQ(w.state.get(), WORKER_STOPPED);
+}
+
+TEST(State, concurrent_transitions)
+{
+    State        state;
+    SDL_Thread * thr[4];
+    SDL_atomic_t won;
+
+    /* of the threads moving the state from the same value, one wins */
+    ASSERT_EQ(state.init(WORKER_RUNNING), 0);
+    for (int round = 0; round < 100; round++) {
+        SDL_AtomicSet(&won, 0);
+        state.set(WORKER_RUNNING);
+        for (int i = 0; i < 4; i++) {
+            thr[i] = SDL_CreateThread(transition_thread, "transition_thread", &state);
+            ASSERT_TRUE(thr[i] != NULL);
+        }
+        for (int i = 0; i < 4; i++) {
+            int ret;
+            SDL_WaitThread(thr[i], &ret);
+            SDL_AtomicAdd(&won, ret);
+        }
+        EXPECT_EQ(SDL_AtomicGet(&won), 1);
+    }
+}
+
+TEST(State, idle_cpu_usage)
+{
+    Worker       w;
+    SDL_Thread * worker;
+    SDL_Thread * thr[4];
+    double       start;
+    int          ret;
+
+    /*
+    * a paused worker and the threads waiting for it to stop, as the control thread waits for
+    * the decoders of a paused player, this covers the pause handshake, not a whole player
+    */
+    ASSERT_EQ(worker_start(&w, &worker), 0);
+    SDL_AtomicSet(&w.pause_req, 1);
+    ASSERT_EQ(w.state.wait(WORKER_PAUSED, 1000), 0);
+    for (int i = 0; i < 4; i++) {
+        thr[i] = SDL_CreateThread(waiter_thread, "waiter_thread", &w.state);
+        ASSERT_TRUE(thr[i] != NULL);
+    }
+
+    /* nothing polls, cpu usage should be near zero */
+    SDL_Delay(50);
+    start = cpu_time();
+    SDL_Delay(500);
+    EXPECT_LT(cpu_time() - start, 0.05);
+
+    worker_stop(&w, worker);
+    for (int i = 0; i < 4; i++) {
+        SDL_WaitThread(thr[i], &ret);
+        EXPECT_EQ(ret, 0);
+    }
+}
@@ -0,0 +1,72 @@
+#include <cstring>
+#include "stats.h"
+
+#define FILENAME "stats.cpp"
+
+void stage_stats_reset (StageStats *s)
+{
+    SDL_AtomicSet(&s->count, 0);
+    SDL_AtomicSet(&s->bytes, 0);
+    SDL_AtomicSet(&s->time, 0);
+}
+
+void stage_stats_add (StageStats *s, int count, int bytes, int64_t time)
+{
+    if (count)
+        SDL_AtomicAdd(&s->count, count);
+    if (bytes)
+        SDL_AtomicAdd(&s->bytes, bytes);
+    if (time > 0)
+        SDL_AtomicAdd(&s->time, (int)time);
+}
+
+const StageRate &StageMeter::sample (StageStats *s, int64_t now, int64_t interval)
+{
+    uint32_t count = (uint32_t)SDL_AtomicGet(&s->count);
+    uint32_t bytes = (uint32_t)SDL_AtomicGet(&s->bytes);
+    uint32_t time = (uint32_t)SDL_AtomicGet(&s->time);
+    double   elapsed;
+
+    /* the first sample is the base */
+    if (sample_time < 0) {
+        this->count = count;
+        this->bytes = bytes;
+        this->time = time;
+        sample_time = now;
+        return rate;
+    }
+    if (now - sample_time < interval)
+        return rate;
+
+    /* the differences are right across a wrap around */
+    elapsed = (now - sample_time) / 1000000.0;
+    rate.count = (uint32_t)(count - this->count) / elapsed;
+    rate.bytes = (uint32_t)(bytes - this->bytes) / elapsed;
+    rate.avg_time = count != this->count ? (uint32_t)(time - this->time) / 1000.0 / (uint32_t)(count - this->count) : 0.0;
+    rate.load = (uint32_t)(time - this->time) / 1000000.0 / elapsed;
+    this->count = count;
+    this->bytes = bytes;
+    this->time = time;
+    sample_time = now;
+
+    return rate;
+}
+
+const StageRate &StageMeter::get_rate () const
+{
+    return rate;
+}
+
+void StageMeter::reset ()
+{
+    count = 0;
+    bytes = 0;
+    time = 0;
+    sample_time = -1;
+    memset(&rate, 0, sizeof(StageRate));
+}
+
+StageMeter::StageMeter ()
+{
+    reset();
+}
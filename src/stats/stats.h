@@ -0,0 +1,51 @@
+#ifndef _AVPLAYERWIDGET_STATS_H_
+#define _AVPLAYERWIDGET_STATS_H_
+
+#include <cstdint>
+
+extern "C"
+{
+#include "SDL2/SDL.h"
+}
+
+/*
+* counters of a pipeline stage,
+* added lock-free by the thread running the stage, read by the stats HUD,
+* they wrap around, so only the differences are meaningful
+*/
+typedef struct StageStats {
+    SDL_atomic_t     count;    // packets or frames
+    SDL_atomic_t     bytes;
+    SDL_atomic_t     time;     // time spent (unit: microsecond)
+}StageStats;
+
+void stage_stats_reset (StageStats *s);
+void stage_stats_add   (StageStats *s, int count, int bytes, int64_t time);
+
+/* rates of a stage over the last interval */
+typedef struct StageRate {
+    double           count;    // per second
+    double           bytes;    // per second
+    double           avg_time; // per count (unit: millisecond)
+    double           load;     // time spent / interval
+}StageRate;
+
+/* samples a stage, the rates are kept for an interval at least */
+class StageMeter {
+private:
+    uint32_t         count;
+    uint32_t         bytes;
+    uint32_t         time;
+    int64_t          sample_time; // unit: microsecond
+    StageRate        rate;
+
+public:
+    const StageRate &sample     (StageStats *s, int64_t now, int64_t interval);
+    const StageRate &get_rate   () const;
+    void             reset      ();
+
+public:
+    StageMeter                  ();
+};
+
+#endif /* _AVPLAYERWIDGET_STATS_H_ */
@@ -0,0 +1,44 @@
+#include <gtest/gtest.h>
+#include "stats.h"
+
+TEST(stats_test, rates)
+{
+    StageStats s;
+    StageMeter m;
+
+    stage_stats_reset(&s);
+
+    /* the first sample is the base */
+    stage_stats_add(&s, 10, 1000, 5000);
+    EXPECT_EQ(0.0, m.sample(&s, 1000000, 500000).count);
+
+    /* 50 frames, 100KB and 250ms of work in 500ms */
+    stage_stats_add(&s, 50, 100 * 1024, 250000);
+    const StageRate &r = m.sample(&s, 1500000, 500000);
+    EXPECT_DOUBLE_EQ(100.0, r.count);
+    EXPECT_DOUBLE_EQ(200.0 * 1024, r.bytes);
+    EXPECT_DOUBLE_EQ(5.0, r.avg_time);
+    EXPECT_DOUBLE_EQ(0.5, r.load);
+
+    /* kept until an interval passed */
+    stage_stats_add(&s, 1, 0, 0);
+    EXPECT_DOUBLE_EQ(100.0, m.sample(&s, 1600000, 500000).count);
+
+    /* nothing done */
+    m.sample(&s, 2000000, 500000);
+    EXPECT_DOUBLE_EQ(0.0, m.sample(&s, 3000000, 500000).avg_time);
+    EXPECT_DOUBLE_EQ(0.0, m.get_rate().count);
+}
+
+TEST(stats_test, wrap_around)
+{
+    StageStats s;
+    StageMeter m;
+
+    /* the counters wrap, the differences are still right */
+    stage_stats_reset(&s);
+    SDL_AtomicSet(&s.bytes, 0x7fffff00);
+    m.sample(&s, 0, 1000000);
+    stage_stats_add(&s, 1, 0x200, 0);
+    EXPECT_DOUBLE_EQ(512.0, m.sample(&s, 1000000, 1000000).bytes);
+}
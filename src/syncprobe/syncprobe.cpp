@@ -0,0 +1,121 @@
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include "syncprobe.h"
+#include "synth/synth.h"
+#include "error/error.h"
+
+#define FILENAME "syncprobe.cpp"
+
+void SyncProbe::reset ()
+{
+    marks.clear();
+    beeps.clear();
+    pairs.clear();
+    samples = 0;
+    last_loud = INT64_MIN / 2;
+}
+
+void SyncProbe::add_video (const AVFrame *f, double pts, int64_t time)
+{
+    if (synth_read_mark(f))
+        add_mark(pts, time);
+}
+
+void SyncProbe::add_mark (double pts, int64_t time)
+{
+    SyncEvent e = {pts, time};
+
+    marks.push_back(e);
+}
+
+void SyncProbe::add_audio (const int16_t *samples, int nb_samples, int channels,
+                           int sample_rate, double pts, int64_t time)
+{
+    int64_t gap;
+
+    if (!samples || channels <= 0 || sample_rate <= 0)
+        return;
+
+    /* a loud sample after a silence longer than a beep starts a beep */
+    gap = (int64_t)(SYNTH_BEEP_DURATION * 2 * sample_rate);
+    for (int i = 0; i < nb_samples; i++) {
+        if (synth_find_beep(samples + i * channels, 1, channels) < 0)
+            continue;
+        if (this->samples + i - last_loud > gap) {
+            SyncEvent e = {pts + i / (double)sample_rate,
+                           time + (int64_t)llrint(i * 1000000.0 / sample_rate)};
+            beeps.push_back(e);
+        }
+        last_loud = this->samples + i;
+    }
+    this->samples += nb_samples;
+}
+
+int SyncProbe::get_report (SyncReport *report)
+{
+    std::vector<double> abs_offsets;
+    size_t              b = 0;
+    double              sum_t = 0.0;
+    double              sum_o = 0.0;
+    double              sum_tt = 0.0;
+    double              sum_to = 0.0;
+    double              n;
+
+    if (!report)
+        return KERROR(KEINVAL);
+    memset(report, 0, sizeof(SyncReport));
+    report->marks = (int)marks.size();
+    report->beeps = (int)beeps.size();
+
+    /* match the marks with the nearest beeps, both are in pts order */
+    pairs.clear();
+    for (size_t m = 0; m < marks.size(); m++) {
+        while (b + 1 < beeps.size()
+               && fabs(beeps[b + 1].pts - marks[m].pts) <= fabs(beeps[b].pts - marks[m].pts))
+            b++;
+        if (b >= beeps.size() || fabs(beeps[b].pts - marks[m].pts) > SYNC_MATCH_WINDOW)
+            continue;
+        SyncPair p = {marks[m].pts, (marks[m].time - beeps[b].time) / 1e6};
+        pairs.push_back(p);
+    }
+    if (pairs.empty())
+        return KERROR(KENO_SYNC_MARK);
+
+    /* statistics */
+    for (size_t i = 0; i < pairs.size(); i++) {
+        double o = pairs[i].offset;
+        report->mean += o;
+        report->mean_abs += fabs(o);
+        report->max = fmax(report->max, fabs(o));
+        abs_offsets.push_back(fabs(o));
+        sum_t += pairs[i].pts;
+        sum_o += o;
+        sum_tt += pairs[i].pts * pairs[i].pts;
+        sum_to += pairs[i].pts * o;
+    }
+    n = (double)pairs.size();
+    report->pairs = (int)pairs.size();
+    report->mean /= n;
+    report->mean_abs /= n;
+
+    /* nearest rank */
+    std::sort(abs_offsets.begin(), abs_offsets.end());
+    report->p95 = abs_offsets[(size_t)ceil(0.95 * n) - 1];
+
+    /* the offset growing with the media time */
+    if (pairs.size() > 1 && n * sum_tt - sum_t * sum_t > 0.0)
+        report->drift = (n * sum_to - sum_t * sum_o) / (n * sum_tt - sum_t * sum_t);
+
+    return 0;
+}
+
+const std::vector<SyncPair> &SyncProbe::get_pairs () const
+{
+    return pairs;
+}
+
+SyncProbe::SyncProbe ()
+{
+    reset();
+}
@@ -0,0 +1,65 @@
+#ifndef _AVPLAYERWIDGET_SYNCPROBE_H_
+#define _AVPLAYERWIDGET_SYNCPROBE_H_
+
+#include <cstdint>
+#include <vector>
+
+extern "C"
+{
+#include "libavutil/frame.h"
+}
+
+/* a video mark or an audio beep matches the nearest one of the other stream within so much pts (unit: second) */
+#define SYNC_MATCH_WINDOW       0.2
+
+/* a sync event of a stream */
+typedef struct SyncEvent {
+    double           pts;      // media time (unit: second)
+    int64_t          time;     // wall time it is presented or output (unit: microsecond)
+}SyncEvent;
+
+/* a video mark and its beep */
+typedef struct SyncPair {
+    double           pts;      // pts of the video mark (unit: second)
+    double           offset;   // video time - audio time, positive if the video is late (unit: second)
+}SyncPair;
+
+/* A-V offset of a run */
+typedef struct SyncReport {
+    int              marks;    // video marks presented
+    int              beeps;    // audio beeps output
+    int              pairs;    // marks matched with a beep
+    double           mean;     // mean offset (unit: second)
+    double           mean_abs; // mean |offset| (unit: second)
+    double           p95;      // 95th percentile of |offset| (unit: second)
+    double           max;      // max |offset| (unit: second)
+    double           drift;    // slope of the offset over the media time, by least squares (unit: second per second)
+}SyncReport;
+
+/*
+* measures the A-V offset of the synthetic clips,
+* the frames showing the sync mark are matched with the beeps by pts,
+* the offset of a pair is the time the frame is presented minus the time the beep is output
+*/
+class SyncProbe {
+private:
+    std::vector<SyncEvent> marks;
+    std::vector<SyncEvent> beeps;
+    std::vector<SyncPair>  pairs;
+    int64_t          samples;   // samples seen
+    int64_t          last_loud; // sample number of the last sample of a beep
+
+public:
+    void             reset      ();
+    void             add_video  (const AVFrame *f, double pts, int64_t time);
+    void             add_mark   (double pts, int64_t time);
+    void             add_audio  (const int16_t *samples, int nb_samples, int channels,
+                                 int sample_rate, double pts, int64_t time); // time of the first sample
+    int              get_report (SyncReport *report);
+    const std::vector<SyncPair> &get_pairs () const; // valid after get_report()
+
+public:
+    SyncProbe                   ();
+};
+
+#endif /* _AVPLAYERWIDGET_SYNCPROBE_H_ */
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "syncprobe.h"
+#include "synth/synth.h"
+#include "error/error.h"
+
+#define RATE     48000
+#define CHANNELS 2
+
+/* feed the probe with a beep every second, in chunks of 1024 samples output on time */
+static void feed_beeps (SyncProbe *probe, int seconds)
+{
+    std::vector<int16_t> chunk(1024 * CHANNELS);
+    int64_t              total = (int64_t)seconds * RATE;
+
+    for (int64_t first = 0; first < total; first += 1024) {
+        int nb_samples = (int)(total - first < 1024 ? total - first : 1024);
+        for (int i = 0; i < nb_samples; i++) {
+            int64_t n = (first + i) % RATE;
+            int16_t val = n < RATE * SYNTH_BEEP_DURATION ? (n % 48 < 24 ? 20000 : -20000) : 0;
+            chunk[i * CHANNELS] = chunk[i * CHANNELS + 1] = val;
+        }
+        probe->add_audio(&chunk[0], nb_samples, CHANNELS, RATE,
+                         first / (double)RATE, first * 1000000 / RATE);
+    }
+}
+
+TEST(syncprobe_test, no_marks)
+{
+    SyncProbe  probe;
+    SyncReport report;
+
+    feed_beeps(&probe, 3);
+    EXPECT_EQ(KERROR(KENO_SYNC_MARK), probe.get_report(&report));
+    EXPECT_EQ(3, report.beeps);
+    EXPECT_EQ(0, report.marks);
+}
+
+TEST(syncprobe_test, constant_offset)
+{
+    SyncProbe  probe;
+    SyncReport report;
+
+    /* the video is 20ms late */
+    feed_beeps(&probe, 10);
+    for (int i = 0; i < 10; i++)
+        probe.add_mark(i, i * 1000000 + 20000);
+    ASSERT_EQ(0, probe.get_report(&report));
+    EXPECT_EQ(10, report.pairs);
+    EXPECT_NEAR(0.02, report.mean, 2e-6);
+    EXPECT_NEAR(0.02, report.p95, 2e-6);
+    EXPECT_NEAR(0.02, report.max, 2e-6);
+    EXPECT_NEAR(0.0, report.drift, 1e-7);
+}
+
+TEST(syncprobe_test, drift)
+{
+    SyncProbe  probe;
+    SyncReport report;
+
+    /* the video falls behind by 1ms every second, the last mark is 9ms late */
+    feed_beeps(&probe, 10);
+    for (int i = 0; i < 10; i++)
+        probe.add_mark(i, i * 1000000 + i * 1000);
+    ASSERT_EQ(0, probe.get_report(&report));
+    EXPECT_NEAR(0.0045, report.mean, 2e-6);
+    EXPECT_NEAR(0.009, report.max, 2e-6);
+    EXPECT_NEAR(0.009, report.p95, 2e-6);
+    EXPECT_NEAR(0.001, report.drift, 2e-6);
+    ASSERT_EQ(10u, probe.get_pairs().size());
+    EXPECT_NEAR(0.005, probe.get_pairs()[5].offset, 2e-6);
+}
+
+TEST(syncprobe_test, unmatched_marks)
+{
+    SyncProbe  probe;
+    SyncReport report;
+
+    /* a mark far from any beep is not matched */
+    feed_beeps(&probe, 3);
+    probe.add_mark(0.0, 0);
+    probe.add_mark(1.5, 1500000);
+    probe.add_mark(2.0, 1990000);
+    ASSERT_EQ(0, probe.get_report(&report));
+    EXPECT_EQ(3, report.marks);
+    EXPECT_EQ(2, report.pairs);
+    EXPECT_NEAR(-0.005, report.mean, 2e-6);
+    EXPECT_NEAR(0.01, report.max, 2e-6);
+
+    /* reset for the next run */
+    probe.reset();
+    EXPECT_EQ(KERROR(KENO_SYNC_MARK), probe.get_report(&report));
+    EXPECT_EQ(0, report.beeps);
+}
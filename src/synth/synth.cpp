@@ -0,0 +1,576 @@
+#include <cstring>
+#include <cmath>
+#include "synth.h"
+#include "error/error.h"
+#include "log/log.h"
+
+extern "C"
+{
+#include "libavformat/avformat.h"
+#include "libavcodec/avcodec.h"
+#include "libavutil/channel_layout.h"
+#include "libavutil/mathematics.h"
+#include "libavutil/pixdesc.h"
+#include "libswscale/swscale.h"
+#include "libswresample/swresample.h"
+}
+
+#define FILENAME "synth.cpp"
+
+/* the benchmark matrix, the clips of mpeg4 and mp2 are written by any FFmpeg build */
+const SynthPreset synth_presets[] = {
+    { "480p24_h264_aac",    "mp4", "h264",  "aac",   854,  480,  24 },
+    { "480p30_mpeg4_mp2",   "ts",  "mpeg4", "mp2",   854,  480,  30 },
+    { "720p30_h264_aac",    "mkv", "h264",  "aac",   1280, 720,  30 },
+    { "720p120_h264_aac",   "ts",  "h264",  "aac",   1280, 720,  120 },
+    { "1080p30_vp9_opus",   "mkv", "vp9",   "opus",  1920, 1080, 30 },
+    { "1080p60_hevc_aac",   "mp4", "hevc",  "aac",   1920, 1080, 60 },
+    { "1080p60_h264_flac",  "mkv", "h264",  "flac",  1920, 1080, 60 },
+    { "2160p24_vp9_opus",   "mkv", "vp9",   "opus",  3840, 2160, 24 },
+    { "2160p30_hevc_aac",   "ts",  "hevc",  "aac",   3840, 2160, 30 },
+};
+const int synth_nb_presets = (int)ARRAY_ELEMS(synth_presets);
+
+/* 3x5 font of the digits, a row of 3 bits for a line */
+static const uint8_t digit_font[10][5] = {
+    {7, 5, 5, 5, 7}, {2, 6, 2, 2, 7}, {7, 1, 7, 4, 7}, {7, 1, 7, 1, 7}, {5, 5, 7, 1, 1},
+    {7, 4, 7, 1, 7}, {7, 4, 7, 5, 7}, {7, 1, 1, 1, 1}, {7, 5, 7, 5, 7}, {7, 5, 7, 1, 7}
+};
+
+/* an output stream and its encoder */
+typedef struct SynthStream {
+    AVStream *       st;
+    AVCodecContext * ctx;
+    AVFrame *        frame;  // frame sent to the encoder
+    AVFrame *        src;    // YUV420P picture when the encoder takes another format
+    SwsContext *     sws;
+    SwrContext *     swr;
+    uint8_t *        samples; // interleaved S16 samples of a frame
+    int64_t          next;   // pts of the next frame, in frames or samples
+    int64_t          total;  // frames or samples of the clip
+}SynthStream;
+
+static uint32_t make_code (int index)
+{
+    uint32_t i = (uint32_t)index & ((1u << SYNTH_INDEX_BITS) - 1);
+    uint32_t sum = ((i ^ (i >> 8) ^ (i >> 16)) & 0xFF) ^ 0x5A;
+
+    return i | (sum << SYNTH_INDEX_BITS);
+}
+
+static void fill_rect (uint8_t *data, int linesize, int x, int y, int w, int h, uint8_t val)
+{
+    for (int j = y; j < y + h; j++)
+        memset(data + j * linesize + x, val, (size_t)w);
+}
+
+static void draw_picture (AVFrame *f, int index, int beep_interval)
+{
+    int      w = f->width;
+    int      h = f->height;
+    int      cw = (w + 1) / 2;
+    int      ch = (h + 1) / 2;
+    int      band = h / SYNTH_CODE_ROWS;
+    int      block = w / SYNTH_CODE_BITS;
+    int      cell = FFMAX(2, h / 60);
+    int      mark = h / 8;
+    uint32_t code = make_code(index);
+    char     digits[16];
+    int      nb_digits;
+
+    /* moving gradient, so the encoders see motion */
+    for (int y = 0; y < h; y++) {
+        uint8_t *line = f->data[0] + y * f->linesize[0];
+        for (int x = 0; x < w; x++)
+            line[x] = (uint8_t)(SYNTH_BLACK + (x + y + index * 4) % (SYNTH_WHITE - SYNTH_BLACK));
+    }
+    for (int y = 0; y < ch; y++) {
+        uint8_t *u = f->data[1] + y * f->linesize[1];
+        uint8_t *v = f->data[2] + y * f->linesize[2];
+        for (int x = 0; x < cw; x++) {
+            u[x] = (uint8_t)(64 + x * 128 / cw);
+            v[x] = (uint8_t)(64 + y * 128 / ch);
+        }
+    }
+
+    /* frame index code on the top */
+    fill_rect(f->data[1], f->linesize[1], 0, 0, cw, (band + 1) / 2, 128);
+    fill_rect(f->data[2], f->linesize[2], 0, 0, cw, (band + 1) / 2, 128);
+    for (int i = 0; i < SYNTH_CODE_BITS; i++) {
+        uint8_t val = (code >> (SYNTH_CODE_BITS - 1 - i)) & 1 ? SYNTH_WHITE : SYNTH_BLACK;
+        fill_rect(f->data[0], f->linesize[0], i * block, 0, block, band, val);
+    }
+
+    /* frame index in digits below the code, for the human eyes */
+    nb_digits = snprintf(digits, sizeof(digits), "%d", index);
+    fill_rect(f->data[0], f->linesize[0], 0, band, (nb_digits * 4 + 1) * cell, 7 * cell, SYNTH_BLACK);
+    for (int i = 0; i < nb_digits; i++) {
+        const uint8_t *glyph = digit_font[digits[i] - '0'];
+        for (int row = 0; row < 5; row++) {
+            for (int col = 0; col < 3; col++) {
+                if (glyph[row] & (4 >> col))
+                    fill_rect(f->data[0], f->linesize[0],
+                              (i * 4 + 1 + col) * cell, band + (row + 1) * cell,
+                              cell, cell, SYNTH_WHITE);
+            }
+        }
+    }
+
+    /* sync mark on the bottom right corner */
+    fill_rect(f->data[0], f->linesize[0], w - mark, h - mark, mark, mark,
+              index % beep_interval ? SYNTH_BLACK : SYNTH_WHITE);
+    fill_rect(f->data[1], f->linesize[1], (w - mark) / 2, (h - mark) / 2, mark / 2, mark / 2, 128);
+    fill_rect(f->data[2], f->linesize[2], (w - mark) / 2, (h - mark) / 2, mark / 2, mark / 2, 128);
+}
+
+static void draw_samples (int16_t *samples, int64_t first, int nb_samples,
+                          int channels, int sample_rate, int fps, int beep_interval)
+{
+    int64_t period = (int64_t)beep_interval * sample_rate; // in 1/fps samples
+    int64_t beep_len = (int64_t)(SYNTH_BEEP_DURATION * sample_rate);
+
+    for (int i = 0; i < nb_samples; i++) {
+        int64_t n = first + i;
+        int64_t start = n * fps / period * period / fps; // first sample of the last beep
+        int16_t val = 0;
+
+        if (n - start < beep_len)
+            val = (int16_t)lrint(SYNTH_BEEP_AMPLITUDE * 32767.0
+                                 * sin(2.0 * M_PI * SYNTH_BEEP_FREQ * (double)(n - start) / sample_rate));
+        for (int c = 0; c < channels; c++)
+            *samples++ = val;
+    }
+}
+
+static const AVCodec *find_encoder (const char *name)
+{
+    const AVCodec *          codec = avcodec_find_encoder_by_name(name);
+    const AVCodecDescriptor *desc;
+
+    if (!codec && (desc = avcodec_descriptor_get_by_name(name)))
+        codec = avcodec_find_encoder(desc->id);
+
+    return codec;
+}
+
+static int open_encoder (AVFormatContext *oc, SynthStream *s, const char *name)
+{
+    const AVCodec *codec = find_encoder(name);
+
+    if (!codec) {
+        logger.error("%s: %s.\n", kerr2str(KEAVCODEC_FIND_ENCODER_FAIL), name);
+        return KERROR(KEAVCODEC_FIND_ENCODER_FAIL);
+    }
+    s->st = avformat_new_stream(oc, NULL);
+    s->ctx = avcodec_alloc_context3(codec);
+    if (!s->st || !s->ctx)
+        return KERROR(KENOMEM);
+    s->ctx->codec_id = codec->id;
+
+    return 0;
+}
+
+static int start_encoder (AVFormatContext *oc, SynthStream *s)
+{
+    int ret;
+
+    /* the same params write the same file */
+    s->ctx->flags |= AV_CODEC_FLAG_BITEXACT;
+    s->ctx->strict_std_compliance = FF_COMPLIANCE_EXPERIMENTAL;
+    if (oc->oformat->flags & AVFMT_GLOBALHEADER)
+        s->ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    ret = avcodec_open2(s->ctx, s->ctx->codec, NULL);
+    if (ret < 0) {
+        logger.error("%s %s: %s.\n", kerr2str(KEOPEN_ENCODER_FAIL), s->ctx->codec->name, av_err2str(ret));
+        return KERROR(KEOPEN_ENCODER_FAIL);
+    }
+    ret = avcodec_parameters_from_context(s->st->codecpar, s->ctx);
+    if (ret < 0)
+        return KERROR(KECOPY_CODEC_PARAMS_FAIL);
+    s->st->time_base = s->ctx->time_base;
+
+    return 0;
+}
+
+static int open_video (AVFormatContext *oc, SynthStream *s, const SynthParams *params)
+{
+    const enum AVPixelFormat *fmt;
+    int                       ret;
+
+    ret = open_encoder(oc, s, params->vcodec);
+    if (ret < 0)
+        return ret;
+
+    /* YUV420P if taken by the encoder, or the first format of it */
+    s->ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+    if (s->ctx->codec->pix_fmts) {
+        for (fmt = s->ctx->codec->pix_fmts; *fmt != AV_PIX_FMT_NONE && *fmt != AV_PIX_FMT_YUV420P; fmt++);
+        if (AV_PIX_FMT_NONE == *fmt)
+            s->ctx->pix_fmt = s->ctx->codec->pix_fmts[0];
+    }
+    s->ctx->width = params->width;
+    s->ctx->height = params->height;
+    s->ctx->time_base = av_make_q(1, params->fps);
+    s->ctx->framerate = av_make_q(params->fps, 1);
+    s->ctx->gop_size = params->fps;
+    s->ctx->bit_rate = params->bit_rate ? params->bit_rate
+                                        : (int64_t)params->width * params->height * params->fps / 10;
+    ret = start_encoder(oc, s);
+    if (ret < 0)
+        return ret;
+
+    /* pictures are drawn in YUV420P */
+    s->frame = av_frame_alloc();
+    if (!s->frame)
+        return KERROR(KENOMEM);
+    s->frame->format = s->ctx->pix_fmt;
+    s->frame->width = params->width;
+    s->frame->height = params->height;
+    if (av_frame_get_buffer(s->frame, 32) < 0)
+        return KERROR(KENOMEM);
+    if (AV_PIX_FMT_YUV420P != s->ctx->pix_fmt) {
+        s->src = av_frame_alloc();
+        if (!s->src)
+            return KERROR(KENOMEM);
+        s->src->format = AV_PIX_FMT_YUV420P;
+        s->src->width = params->width;
+        s->src->height = params->height;
+        if (av_frame_get_buffer(s->src, 32) < 0)
+            return KERROR(KENOMEM);
+        s->sws = sws_getContext(params->width, params->height, AV_PIX_FMT_YUV420P,
+                                params->width, params->height, s->ctx->pix_fmt,
+                                SWS_BICUBIC | SWS_BITEXACT, NULL, NULL, NULL);
+        if (!s->sws)
+            return KERROR(KESWS_ALLOC_FAIL);
+    }
+    s->total = llrint(params->duration * params->fps);
+
+    return 0;
+}
+
+static int open_audio (AVFormatContext *oc, SynthStream *s, const SynthParams *params)
+{
+    const enum AVSampleFormat *fmt;
+    const int *                rate;
+    int64_t                    layout = av_get_default_channel_layout(params->channels);
+    int                        ret;
+
+    ret = open_encoder(oc, s, params->acodec);
+    if (ret < 0)
+        return ret;
+
+    /* S16 if taken by the encoder, or the first format of it */
+    s->ctx->sample_fmt = AV_SAMPLE_FMT_S16;
+    if (s->ctx->codec->sample_fmts) {
+        for (fmt = s->ctx->codec->sample_fmts; *fmt != AV_SAMPLE_FMT_NONE && *fmt != AV_SAMPLE_FMT_S16; fmt++);
+        if (AV_SAMPLE_FMT_NONE == *fmt)
+            s->ctx->sample_fmt = s->ctx->codec->sample_fmts[0];
+    }
+
+    /* the wanted rate, or 48kHz, or the first rate taken by the encoder */
+    s->ctx->sample_rate = params->sample_rate;
+    if (s->ctx->codec->supported_samplerates) {
+        for (rate = s->ctx->codec->supported_samplerates; *rate && *rate != params->sample_rate; rate++);
+        if (!*rate) {
+            for (rate = s->ctx->codec->supported_samplerates; *rate && *rate != 48000; rate++);
+            s->ctx->sample_rate = *rate ? *rate : s->ctx->codec->supported_samplerates[0];
+        }
+    }
+    s->ctx->channels = params->channels;
+    s->ctx->channel_layout = (uint64_t)layout;
+    s->ctx->time_base = av_make_q(1, s->ctx->sample_rate);
+    ret = start_encoder(oc, s);
+    if (ret < 0)
+        return ret;
+
+    /* samples are drawn in S16 and converted to the format of the encoder */
+    s->frame = av_frame_alloc();
+    if (!s->frame)
+        return KERROR(KENOMEM);
+    s->frame->format = s->ctx->sample_fmt;
+    s->frame->channel_layout = s->ctx->channel_layout;
+    s->frame->sample_rate = s->ctx->sample_rate;
+    s->frame->nb_samples = (s->ctx->codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE)
+                           || !s->ctx->frame_size ? 1024 : s->ctx->frame_size;
+    if (av_frame_get_buffer(s->frame, 0) < 0)
+        return KERROR(KENOMEM);
+    s->samples = (uint8_t *)av_malloc((size_t)s->frame->nb_samples * params->channels * sizeof(int16_t));
+    if (!s->samples)
+        return KERROR(KENOMEM);
+    s->swr = swr_alloc_set_opts(NULL,
+                                layout, s->ctx->sample_fmt, s->ctx->sample_rate,
+                                layout, AV_SAMPLE_FMT_S16, s->ctx->sample_rate,
+                                0, NULL);
+    if (!s->swr || swr_init(s->swr) < 0) {
+        logger.error("%s.\n", kerr2str(KESWR_INIT_FAIL));
+        return KERROR(KESWR_INIT_FAIL);
+    }
+    s->total = llrint(params->duration * s->ctx->sample_rate);
+
+    return 0;
+}
+
+static void close_stream (SynthStream *s)
+{
+    avcodec_free_context(&s->ctx);
+    av_frame_free(&s->frame);
+    av_frame_free(&s->src);
+    sws_freeContext(s->sws);
+    swr_free(&s->swr);
+    av_freep(&s->samples);
+    s->sws = NULL;
+}
+
+static int encode (AVFormatContext *oc, SynthStream *s, AVFrame *frame, AVPacket *pkt)
+{
+    int ret;
+
+    ret = avcodec_send_frame(s->ctx, frame);
+    while (ret >= 0) {
+        ret = avcodec_receive_packet(s->ctx, pkt);
+        if (AVERROR(EAGAIN) == ret || AVERROR_EOF == ret)
+            return 0;
+        if (ret < 0)
+            break;
+        av_packet_rescale_ts(pkt, s->ctx->time_base, s->st->time_base);
+        pkt->stream_index = s->st->index;
+        ret = av_interleaved_write_frame(oc, pkt);
+    }
+    logger.error("%s: %s.\n", kerr2str(KEWRITE_MEDIA_FILE_FAIL), av_err2str(ret));
+
+    return KERROR(KEWRITE_MEDIA_FILE_FAIL);
+}
+
+static int write_video (AVFormatContext *oc, SynthStream *s, int beep_interval, AVPacket *pkt)
+{
+    if (av_frame_make_writable(s->frame) < 0)
+        return KERROR(KENOMEM);
+    if (s->sws) {
+        draw_picture(s->src, (int)s->next, beep_interval);
+        sws_scale(s->sws, s->src->data, s->src->linesize, 0, s->src->height,
+                  s->frame->data, s->frame->linesize);
+    } else {
+        draw_picture(s->frame, (int)s->next, beep_interval);
+    }
+    s->frame->pts = s->next++;
+
+    return encode(oc, s, s->frame, pkt);
+}
+
+static int write_audio (AVFormatContext *oc, SynthStream *s, const SynthParams *params, AVPacket *pkt)
+{
+    const uint8_t *src;
+    int            nb_samples = (int)FFMIN((int64_t)s->frame->nb_samples, s->total - s->next);
+    int            ret;
+
+    if (av_frame_make_writable(s->frame) < 0)
+        return KERROR(KENOMEM);
+    draw_samples((int16_t *)s->samples, s->next, nb_samples,
+                 params->channels, s->ctx->sample_rate, params->fps, params->beep_interval);
+    src = s->samples;
+    ret = swr_convert(s->swr, s->frame->data, nb_samples, &src, nb_samples);
+    if (ret < 0) {
+        logger.error("%s: %s.\n", kerr2str(KESWR_CONVERT_FAIL), av_err2str(ret));
+        return KERROR(KESWR_CONVERT_FAIL);
+    }
+    s->frame->nb_samples = nb_samples; // the last frame may be short
+    s->frame->pts = s->next;
+    s->next += nb_samples;
+
+    return encode(oc, s, s->frame, pkt);
+}
+
+void synth_default_params (SynthParams *params)
+{
+    memset(params, 0, sizeof(SynthParams));
+    params->vcodec = "mpeg4";
+    params->acodec = "mp2";
+    params->width = 854;
+    params->height = 480;
+    params->fps = 30;
+    params->sample_rate = 48000;
+    params->channels = 2;
+    params->duration = 10.0;
+    params->beep_interval = SYNTH_DEF_BEEP_INTERVAL;
+}
+
+void synth_preset_params (const SynthPreset *preset, SynthParams *params)
+{
+    synth_default_params(params);
+    params->vcodec = preset->vcodec;
+    params->acodec = preset->acodec;
+    params->width = preset->width;
+    params->height = preset->height;
+    params->fps = preset->fps;
+    params->beep_interval = preset->fps; // a beep every second
+}
+
+int synth_generate (const SynthParams *params, const char *path)
+{
+    AVFormatContext *oc = NULL;
+    AVPacket *       pkt = NULL;
+    SynthStream      vs;
+    SynthStream      as;
+    bool             header = false;
+    int              ret;
+
+    memset(&vs, 0, sizeof(SynthStream));
+    memset(&as, 0, sizeof(SynthStream));
+    if (!params || !path || (!params->vcodec && !params->acodec) || params->duration <= 0.0
+        || params->fps <= 0 || params->beep_interval <= 0
+        || (params->vcodec && (params->width < SYNTH_CODE_BITS * 4 || params->height < SYNTH_CODE_ROWS * 4))
+        || (params->acodec && (params->sample_rate <= 0 || params->channels <= 0)))
+        return KERROR(KEINVAL);
+
+    av_register_all();
+
+    /* create output file */
+    ret = avformat_alloc_output_context2(&oc, NULL, params->format, path);
+    if (ret < 0 || !oc) {
+        logger.error("%s %s: %s.\n", kerr2str(KEWRITE_MEDIA_FILE_FAIL), path, av_err2str(ret));
+        return KERROR(KEWRITE_MEDIA_FILE_FAIL);
+    }
+    oc->flags |= AVFMT_FLAG_BITEXACT;
+    if (params->vcodec) {
+        ret = open_video(oc, &vs, params);
+        if (ret < 0)
+            goto fail;
+    }
+    if (params->acodec) {
+        ret = open_audio(oc, &as, params);
+        if (ret < 0)
+            goto fail;
+    }
+    pkt = av_packet_alloc();
+    if (!pkt)
+        GOTO_FAIL(KENOMEM);
+    if (!(oc->oformat->flags & AVFMT_NOFILE)) {
+        ret = avio_open(&oc->pb, path, AVIO_FLAG_WRITE);
+        if (ret < 0) {
+            logger.error("%s %s: %s.\n", kerr2str(KEWRITE_MEDIA_FILE_FAIL), path, av_err2str(ret));
+            GOTO_FAIL(KEWRITE_MEDIA_FILE_FAIL);
+        }
+    }
+    ret = avformat_write_header(oc, NULL);
+    if (ret < 0) {
+        logger.error("%s %s: %s.\n", kerr2str(KEWRITE_MEDIA_FILE_FAIL), path, av_err2str(ret));
+        GOTO_FAIL(KEWRITE_MEDIA_FILE_FAIL);
+    }
+    header = true;
+
+    /* write the frames of both streams in time order */
+    while (vs.next < vs.total || as.next < as.total) {
+        if (vs.next < vs.total
+            && (as.next >= as.total
+                || av_compare_ts(vs.next, vs.ctx->time_base, as.next, as.ctx->time_base) <= 0))
+            ret = write_video(oc, &vs, params->beep_interval, pkt);
+        else
+            ret = write_audio(oc, &as, params, pkt);
+        if (ret < 0)
+            goto fail;
+    }
+
+    /* drain encoders */
+    if (vs.ctx && (ret = encode(oc, &vs, NULL, pkt)) < 0)
+        goto fail;
+    if (as.ctx && (ret = encode(oc, &as, NULL, pkt)) < 0)
+        goto fail;
+    ret = av_write_trailer(oc);
+    header = false;
+    if (ret < 0) {
+        logger.error("%s %s: %s.\n", kerr2str(KEWRITE_MEDIA_FILE_FAIL), path, av_err2str(ret));
+        GOTO_FAIL(KEWRITE_MEDIA_FILE_FAIL);
+    }
+    KLOGD("Clip %s is written.\n", path);
+    ret = 0;
+fail:
+    if (header)
+        av_write_trailer(oc);
+    close_stream(&vs);
+    close_stream(&as);
+    av_packet_free(&pkt);
+    if (!(oc->oformat->flags & AVFMT_NOFILE))
+        avio_closep(&oc->pb);
+    avformat_free_context(oc);
+
+    return ret;
+}
+
+/* average luma of a rect, every 4th pixel is sampled */
+static int luma_level (const AVFrame *f, int x, int y, int w, int h)
+{
+    int64_t sum = 0;
+    int     n = 0;
+
+    for (int j = y; j < y + h; j += 4) {
+        const uint8_t *line = f->data[0] + j * f->linesize[0];
+        for (int i = x; i < x + w; i += 4, n++)
+            sum += line[i];
+    }
+
+    return n ? (int)(sum / n) : 0;
+}
+
+static bool is_readable (const AVFrame *f)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((AVPixelFormat)f->format);
+
+    /* 8 bit luma on the first plane */
+    return (desc && f->data[0] && f->linesize[0] > 0
+            && !(desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PAL))
+            && 0 == desc->comp[0].plane && 8 == desc->comp[0].depth && 1 == desc->comp[0].step
+            && f->width >= SYNTH_CODE_BITS * 4 && f->height >= SYNTH_CODE_ROWS * 4);
+}
+
+int synth_read_index (const AVFrame *f)
+{
+    int      band;
+    int      block;
+    uint32_t code = 0;
+
+    if (!f || !is_readable(f))
+        return -1;
+
+    /* the center of every block */
+    band = f->height / SYNTH_CODE_ROWS;
+    block = f->width / SYNTH_CODE_BITS;
+    for (int i = 0; i < SYNTH_CODE_BITS; i++) {
+        int level = luma_level(f, i * block + block / 4, band / 4, FFMAX(1, block / 2), FFMAX(1, band / 2));
+        code = (code << 1) | (level > (SYNTH_BLACK + SYNTH_WHITE) / 2 ? 1 : 0);
+    }
+
+    /* a damaged code fails the checksum */
+    if (make_code((int)(code & ((1u << SYNTH_INDEX_BITS) - 1))) != code)
+        return -1;
+
+    return (int)(code & ((1u << SYNTH_INDEX_BITS) - 1));
+}
+
+bool synth_read_mark (const AVFrame *f)
+{
+    int mark;
+
+    if (!f || !is_readable(f))
+        return false;
+
+    mark = f->height / 8;
+    return luma_level(f, f->width - mark * 3 / 4, f->height - mark * 3 / 4, mark / 2, mark / 2)
+           > (SYNTH_BLACK + SYNTH_WHITE) / 2;
+}
+
+int synth_find_beep (const int16_t *samples, int nb_samples, int channels)
+{
+    if (!samples || channels <= 0)
+        return -1;
+
+    for (int i = 0; i < nb_samples; i++) {
+        for (int c = 0; c < channels; c++) {
+            int val = samples[i * channels + c];
+            if (val > SYNTH_BEEP_THRESHOLD || val < -SYNTH_BEEP_THRESHOLD)
+                return i;
+        }
+    }
+
+    return -1;
+}
@@ -0,0 +1,79 @@
+#ifndef _AVPLAYERWIDGET_SYNTH_H_
+#define _AVPLAYERWIDGET_SYNTH_H_
+
+#include <cstdint>
+
+extern "C"
+{
+#include "libavutil/frame.h"
+}
+
+/*
+* frame index overlay,
+* a row of SYNTH_CODE_BITS blocks on the top of every frame, white for 1 and black for 0,
+* the low SYNTH_INDEX_BITS are the frame index, the rest is a checksum of the index
+*/
+#define SYNTH_CODE_BITS         32
+#define SYNTH_INDEX_BITS        24
+#define SYNTH_CODE_ROWS         12  // the code takes 1/SYNTH_CODE_ROWS of the height
+
+/*
+* sync marks,
+* a beep of SYNTH_BEEP_FREQ Hz starts every beep_interval frames,
+* the frame at the start of the beep shows a white square on the bottom right corner
+*/
+#define SYNTH_BEEP_FREQ         1000
+#define SYNTH_BEEP_DURATION     0.05 // unit: second
+#define SYNTH_BEEP_AMPLITUDE    0.8
+#define SYNTH_BEEP_THRESHOLD    8192 // S16 level of a beep sample, the rest is silence
+#define SYNTH_DEF_BEEP_INTERVAL 25
+
+/* luma levels of the overlays */
+#define SYNTH_BLACK             16
+#define SYNTH_WHITE             235
+
+/* clip params */
+typedef struct SynthParams {
+    const char *     vcodec;        // encoder or codec name, NULL for no video
+    const char *     acodec;        // encoder or codec name, NULL for no audio
+    const char *     format;        // muxer name, guessed from the file name if NULL
+    int              width;
+    int              height;
+    int              fps;
+    int64_t          bit_rate;      // video bit rate, 0 for a rate of the size and fps (unit: bit/s)
+    int              sample_rate;
+    int              channels;
+    double           duration;      // unit: second
+    int              beep_interval; // frames between the sync marks
+}SynthParams;
+
+/* a clip of the benchmark matrix */
+typedef struct SynthPreset {
+    const char *     name;          // also the file name without the extension
+    const char *     ext;
+    const char *     vcodec;
+    const char *     acodec;
+    int              width;
+    int              height;
+    int              fps;
+}SynthPreset;
+
+extern const SynthPreset synth_presets[];
+extern const int         synth_nb_presets;
+
+void synth_default_params (SynthParams *params);
+void synth_preset_params  (const SynthPreset *preset, SynthParams *params);
+
+/* write a clip, every run with the same params writes the same frames and samples */
+int  synth_generate       (const SynthParams *params, const char *path);
+
+/* the frame index of a decoded planar YUV frame, -1 if the code is unreadable */
+int  synth_read_index     (const AVFrame *f);
+
+/* whether a decoded planar YUV frame shows the sync mark */
+bool synth_read_mark      (const AVFrame *f);
+
+/* index of the first sample of a beep in interleaved S16 samples, -1 if none */
+int  synth_find_beep      (const int16_t *samples, int nb_samples, int channels);
+
+#endif /* _AVPLAYERWIDGET_SYNTH_H_ */
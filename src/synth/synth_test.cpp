@@ -0,0 +1,173 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <vector>
+#include "synth.h"
+#include "error/error.h"
+
+extern "C"
+{
+#include "libavformat/avformat.h"
+#include "libavcodec/avcodec.h"
+#include "libswresample/swresample.h"
+}
+
+#define CLIP_FILE "synth_test.mkv"
+
+/* indices of the video frames and first samples of the beeps in a clip */
+typedef struct ClipInfo {
+    std::vector<int>     indices;
+    std::vector<int>     marks;
+    std::vector<int64_t> beeps;
+}ClipInfo;
+
+static void decode_clip (const char *path, ClipInfo *info)
+{
+    AVFormatContext *avfctx = NULL;
+    AVCodecContext * ctx[2] = {NULL, NULL};
+    AVFrame *        f = av_frame_alloc();
+    AVPacket         pkt;
+    int              idx[2];
+    int64_t          last = INT64_MIN / 2;
+    int64_t          samples = 0;
+
+    ASSERT_EQ(0, avformat_open_input(&avfctx, path, NULL, NULL));
+    ASSERT_GE(avformat_find_stream_info(avfctx, NULL), 0);
+    idx[0] = av_find_best_stream(avfctx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    idx[1] = av_find_best_stream(avfctx, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0);
+    for (int i = 0; i < 2; i++) {
+        AVStream *st = avfctx->streams[idx[i]];
+        ASSERT_GE(idx[i], 0);
+        ctx[i] = avcodec_alloc_context3(avcodec_find_decoder(st->codecpar->codec_id));
+        avcodec_parameters_to_context(ctx[i], st->codecpar);
+        ctx[i]->request_sample_fmt = AV_SAMPLE_FMT_S16;
+        ASSERT_EQ(0, avcodec_open2(ctx[i], NULL, NULL));
+    }
+
+    av_init_packet(&pkt);
+    while (true) {
+        int  ret = av_read_frame(avfctx, &pkt);
+        int  i;
+        bool eof = ret < 0;
+
+        for (i = 0; !eof && i < 2 && pkt.stream_index != idx[i]; i++);
+        if (2 == i) {
+            av_packet_unref(&pkt);
+            continue;
+        }
+        for (int j = 0; j < 2; j++) {
+            if (eof)
+                avcodec_send_packet(ctx[j], NULL);
+            else if (i == j)
+                avcodec_send_packet(ctx[j], &pkt);
+            else
+                continue;
+            while (0 == avcodec_receive_frame(ctx[j], f)) {
+                if (0 == j) {
+                    info->indices.push_back(synth_read_index(f));
+                    if (synth_read_mark(f))
+                        info->marks.push_back(synth_read_index(f));
+                } else {
+                    /* the flac decoder gives S16 for S16 clips */
+                    ASSERT_EQ(AV_SAMPLE_FMT_S16, f->format);
+                    for (int n = 0; n < f->nb_samples; n++) {
+                        const int16_t *s = (const int16_t *)f->data[0] + n * f->channels;
+                        if (synth_find_beep(s, 1, f->channels) < 0)
+                            continue;
+                        /* a loud sample far from the last one starts a beep */
+                        if (samples + n - last > SYNTH_BEEP_DURATION * 2 * f->sample_rate)
+                            info->beeps.push_back(samples + n);
+                        last = samples + n;
+                    }
+                    samples += f->nb_samples;
+                }
+            }
+        }
+        av_packet_unref(&pkt);
+        if (eof)
+            break;
+    }
+
+    av_frame_free(&f);
+    avcodec_free_context(&ctx[0]);
+    avcodec_free_context(&ctx[1]);
+    avformat_close_input(&avfctx);
+}
+
+TEST(synth_test, find_beep)
+{
+    int16_t samples[64 * 2] = {0};
+
+    EXPECT_EQ(-1, synth_find_beep(samples, 64, 2));
+    samples[21 * 2 + 1] = -SYNTH_BEEP_THRESHOLD - 1;
+    samples[40 * 2] = SYNTH_BEEP_THRESHOLD + 1;
+    EXPECT_EQ(21, synth_find_beep(samples, 64, 2));
+    EXPECT_EQ(-1, synth_find_beep(samples, 21, 2));
+    EXPECT_EQ(-1, synth_find_beep(NULL, 64, 2));
+}
+
+TEST(synth_test, unreadable_frame)
+{
+    AVFrame *f = av_frame_alloc();
+
+    /* no picture */
+    EXPECT_EQ(-1, synth_read_index(f));
+    EXPECT_FALSE(synth_read_mark(f));
+
+    /* packed RGB */
+    f->format = AV_PIX_FMT_RGB24;
+    f->width = 320;
+    f->height = 240;
+    ASSERT_EQ(0, av_frame_get_buffer(f, 32));
+    EXPECT_EQ(-1, synth_read_index(f));
+    av_frame_free(&f);
+}
+
+TEST(synth_test, invalid_params)
+{
+    SynthParams params;
+
+    synth_default_params(&params);
+    params.vcodec = NULL;
+    params.acodec = NULL;
+    EXPECT_EQ(KERROR(KEINVAL), synth_generate(&params, CLIP_FILE));
+    synth_default_params(&params);
+    params.width = 16;
+    EXPECT_EQ(KERROR(KEINVAL), synth_generate(&params, CLIP_FILE));
+    synth_default_params(&params);
+    params.vcodec = "no_such_codec";
+    EXPECT_EQ(KERROR(KEAVCODEC_FIND_ENCODER_FAIL), synth_generate(&params, CLIP_FILE));
+}
+
+TEST(synth_test, roundtrip)
+{
+    SynthParams params;
+    ClipInfo    info;
+
+    /* encoders of every FFmpeg build */
+    synth_default_params(&params);
+    params.vcodec = "mpeg4";
+    params.acodec = "flac";
+    params.width = 320;
+    params.height = 240;
+    params.fps = 25;
+    params.bit_rate = 2000000;
+    params.sample_rate = 48000;
+    params.duration = 3.0;
+    params.beep_interval = 25;
+    ASSERT_EQ(0, synth_generate(&params, CLIP_FILE));
+    decode_clip(CLIP_FILE, &info);
+    remove(CLIP_FILE);
+
+    /* every frame in order */
+    ASSERT_EQ(75u, info.indices.size());
+    for (int i = 0; i < 75; i++)
+        EXPECT_EQ(i, info.indices[i]);
+
+    /* a mark and a beep every second */
+    ASSERT_EQ(3u, info.marks.size());
+    ASSERT_EQ(3u, info.beeps.size());
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(i * 25, info.marks[i]);
+        EXPECT_NEAR(i * 48000, info.beeps[i], 48); // the first swing of the sine over the threshold
+    }
+}
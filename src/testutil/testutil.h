@@ -0,0 +1,63 @@
+#ifndef _AVPLAYERWIDGET_TESTUTIL_H_
+#define _AVPLAYERWIDGET_TESTUTIL_H_
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+/*
+* helpers shared by the unit tests,
+* the files of the tests are written to the temporary directory of the system
+*/
+
+#ifdef _WIN32
+#define TEST_DEF_TMP_DIR "."
+#else
+#define TEST_DEF_TMP_DIR "/tmp"
+#endif
+
+/* the temporary directory, TEMP or TMP on Windows, TMPDIR elsewhere */
+static inline std::string test_tmp_dir ()
+{
+    const char *dir;
+
+#ifdef _WIN32
+    dir = getenv("TEMP");
+    if (!dir || !*dir)
+        dir = getenv("TMP");
+#else
+    dir = getenv("TMPDIR");
+#endif
+
+    return (dir && *dir) ? dir : TEST_DEF_TMP_DIR;
+}
+
+/* path of a file of the tests in the temporary directory */
+static inline std::string test_path (const char *name)
+{
+    std::string dir = test_tmp_dir();
+
+    if ('/' != dir[dir.size() - 1] && '\\' != dir[dir.size() - 1])
+        dir += "/";
+
+    return dir + name;
+}
+
+/* the whole file, empty if it can not be read */
+static inline std::string read_file (const std::string &path)
+{
+    std::string s;
+    char        buf[4096];
+    size_t      n;
+    FILE *      fp = fopen(path.c_str(), "rb");
+
+    if (!fp)
+        return s;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        s.append(buf, n);
+    fclose(fp);
+
+    return s;
+}
+
+#endif /* _AVPLAYERWIDGET_TESTUTIL_H_ */
@@ -0,0 +1,479 @@
+#include "thumb.h"
+#include "error/error.h"
+#include "log/log.h"
+#include "lock/lock.h"
+
+#define FILENAME "thumb.cpp"
+
+int ThumbEngine::thumb_proc (void *args)
+{
+    ThumbEngine *t = (ThumbEngine *)args;
+    ThumbRef     thumb;
+    std::string  url;
+    double       pos;
+    int64_t      pts;
+    int          bucket;
+    int          ret;
+
+    /* woken by open() and get() */
+    mutex_lock(t->mutex);
+    if (SDL_AtomicGet(&t->abort_req)) {
+        mutex_unlock(t->mutex);
+        t->close_file();
+        KLOGD("Thumbnail task stopped.\n");
+        return TASK_DONE;
+    }
+
+    /* a new file, the strip of the old one is dropped, its thumbnails stay in the cache */
+    if (SDL_AtomicGet(&t->open_req)) {
+        url = t->next_url;
+        SDL_AtomicSet(&t->open_req, 0);
+        t->url.clear();
+        t->duration = 0.0;
+        t->strip.assign(THUMB_STRIP_LEN, AV_NOPTS_VALUE);
+        t->strip_next = 0;
+        mutex_unlock(t->mutex);
+
+        t->close_file();
+        if (url.empty() || t->open_file(url) < 0)
+            return TASK_AGAIN;
+        mutex_lock(t->mutex);
+        if (!SDL_AtomicGet(&t->open_req)) { // not replaced while opening
+            t->url = url;
+            t->duration = AV_NOPTS_VALUE == t->avfctx->duration ? 0.0 : (double)t->avfctx->duration / AV_TIME_BASE;
+        }
+        mutex_unlock(t->mutex);
+        return TASK_AGAIN;
+    }
+    if (!t->avfctx || t->url.empty()) {
+        mutex_unlock(t->mutex);
+        return TASK_WAIT;
+    }
+
+    /* the hovered position first */
+    if (t->hover_req) {
+        pos = t->hover_pos;
+        t->hover_req = false;
+        mutex_unlock(t->mutex);
+
+        if (t->low_priority) {
+            SDL_SetThreadPriority(SDL_THREAD_PRIORITY_NORMAL);
+            t->low_priority = false;
+        }
+        ret = t->decode_at(pos, &thumb, &pts);
+        if (ret < 0)
+            return TASK_AGAIN;
+        mutex_lock(t->mutex);
+        bucket = t->get_bucket(pos);
+        if (bucket >= 0 && AV_NOPTS_VALUE == t->strip[bucket])
+            t->strip[bucket] = pts;
+        mutex_unlock(t->mutex);
+        emit t->thumb_ready(pos, to_image(thumb));
+        return TASK_AGAIN;
+    }
+
+    /* then a bucket of the strip per run, the hover requests are not delayed by the whole strip */
+    if (t->duration > 0.0 && t->strip_next < THUMB_STRIP_LEN) {
+        bucket = t->strip_next++;
+        pos = (bucket + 0.5) * t->duration / THUMB_STRIP_LEN;
+        if (AV_NOPTS_VALUE != t->strip[bucket]) {
+            mutex_unlock(t->mutex);
+            return TASK_AGAIN;
+        }
+        mutex_unlock(t->mutex);
+
+        if (!t->low_priority) {
+            SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+            t->low_priority = true;
+        }
+        ret = t->decode_at(pos, &thumb, &pts);
+        if (ret >= 0) {
+            mutex_lock(t->mutex);
+            if (!SDL_AtomicGet(&t->open_req))
+                t->strip[bucket] = pts;
+            mutex_unlock(t->mutex);
+        }
+        if (THUMB_STRIP_LEN == bucket + 1)
+            KLOGD("Thumbnail strip finished.\n");
+        return TASK_AGAIN;
+    }
+    mutex_unlock(t->mutex);
+
+    return TASK_WAIT;
+}
+
+int ThumbEngine::interrupt_cb (void *args)
+{
+    ThumbEngine *t = (ThumbEngine *)args;
+
+    /* the file is replaced or the engine closed */
+    return SDL_AtomicGet(&t->abort_req) || SDL_AtomicGet(&t->open_req);
+}
+
+QImage ThumbEngine::to_image (const ThumbRef &thumb)
+{
+    /* deep copy, the thumbnail may be evicted while the image is shown */
+    return QImage(thumb->rgb.data(), thumb->width, thumb->height,
+                  thumb->width * 3, QImage::Format_RGB888).copy();
+}
+
+int ThumbEngine::open_file (const std::string &url)
+{
+    AVCodec *codec = NULL;
+    int      lowres;
+    int      ret;
+
+    /* the network streams would seek over the network for every thumbnail */
+    if (std::string::npos != url.find("://"))
+        return KERROR(KEINVAL);
+
+    /* open input */
+    avfctx = avformat_alloc_context();
+    if (!avfctx)
+        return KERROR(KENOMEM);
+    avfctx->interrupt_callback.callback = interrupt_cb;
+    avfctx->interrupt_callback.opaque = this;
+    ret = avformat_open_input(&avfctx, url.c_str(), NULL, NULL);
+    if (ret < 0) {
+        logger.warning("%s: %s.\n", kerr2str(KEOPEN_INPUT_FAIL), av_err2str(ret));
+        GOTO_FAIL(KEOPEN_INPUT_FAIL);
+    }
+    ret = avformat_find_stream_info(avfctx, NULL);
+    if (ret < 0) {
+        logger.warning("%s: %s.\n", kerr2str(KEFIND_STREAM_INFO_FAIL), av_err2str(ret));
+        GOTO_FAIL(KEFIND_STREAM_INFO_FAIL);
+    }
+
+    /* the cover arts have no timeline */
+    vst_idx = av_find_best_stream(avfctx, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    if (vst_idx < 0 || !codec || (avfctx->streams[vst_idx]->disposition & AV_DISPOSITION_ATTACHED_PIC))
+        GOTO_FAIL(KENOAVST);
+    for (unsigned int i = 0; i < avfctx->nb_streams; i++)
+        if ((int)i != vst_idx)
+            avfctx->streams[i]->discard = AVDISCARD_ALL;
+
+    /* open decoder */
+    dec = avcodec_alloc_context3(codec);
+    if (!dec)
+        GOTO_FAIL(KENOMEM);
+    ret = avcodec_parameters_to_context(dec, avfctx->streams[vst_idx]->codecpar);
+    if (ret < 0) {
+        logger.warning("%s: %s.\n", kerr2str(KECOPY_CODEC_PARAMS_FAIL), av_err2str(ret));
+        GOTO_FAIL(KECOPY_CODEC_PARAMS_FAIL);
+    }
+
+    /* decode the keyframes only, at the smallest size still wider than a thumbnail */
+    for (lowres = 0; lowres < codec->max_lowres && (dec->width >> (lowres + 1)) >= THUMB_WIDTH; lowres++);
+    dec->lowres = lowres;
+    dec->skip_frame = AVDISCARD_NONKEY;
+    dec->skip_loop_filter = AVDISCARD_ALL;
+    dec->flags2 |= AV_CODEC_FLAG2_FAST;
+    dec->thread_count = 1;
+    ret = avcodec_open2(dec, codec, NULL);
+    if (ret < 0) {
+        logger.warning("%s: %s.\n", kerr2str(KEOPEN_DECODER_FAIL), av_err2str(ret));
+        GOTO_FAIL(KEOPEN_DECODER_FAIL);
+    }
+    frame = av_frame_alloc();
+    if (!frame)
+        GOTO_FAIL(KENOMEM);
+    KLOGD("Thumbnail file opened, lowres %d.\n", lowres);
+
+    return 0;
+fail:
+    close_file();
+
+    return ret;
+}
+
+void ThumbEngine::close_file ()
+{
+    av_frame_free(&frame);
+    avcodec_free_context(&dec);
+    avformat_close_input(&avfctx);
+    vst_idx = -1;
+}
+
+int ThumbEngine::decode_at (double pos, ThumbRef *thumb, int64_t *pts)
+{
+    AVPacket pkt;
+    int64_t  key = AV_NOPTS_VALUE;
+    bool     eof = false;
+    bool     got = false;
+    int      ret;
+
+    /* the nearest keyframe before the position */
+    ret = av_seek_frame(avfctx, -1,
+                        pos * AV_TIME_BASE + (AV_NOPTS_VALUE == avfctx->start_time ? 0 : avfctx->start_time),
+                        AVSEEK_FLAG_BACKWARD);
+    if (ret < 0)
+        return KERROR(KESEEK_FAIL);
+    avcodec_flush_buffers(dec);
+
+    av_init_packet(&pkt);
+    pkt.data = NULL;
+    pkt.size = 0;
+    for (int i = 0; i < THUMB_MAX_PACKETS; i++) {
+        ret = av_read_frame(avfctx, &pkt);
+        if (AVERROR_EXIT == ret)
+            return KERROR(KEABORTED);
+        if (ret < 0) {
+            if (AV_NOPTS_VALUE == key)
+                return KERROR(KEEOF);
+            eof = true;
+        } else if (vst_idx != pkt.stream_index) {
+            av_packet_unref(&pkt);
+            continue;
+        }
+
+        /* the keyframe is the key of the cache, a known one is not decoded again */
+        if (!eof && AV_NOPTS_VALUE == key) {
+            if (!(pkt.flags & AV_PKT_FLAG_KEY)) {
+                av_packet_unref(&pkt);
+                continue;
+            }
+            key = AV_NOPTS_VALUE == pkt.pts ? pkt.dts : pkt.pts;
+            mutex_lock(mutex);
+            *thumb = cache.get(url, key);
+            mutex_unlock(mutex);
+            if (*thumb) {
+                av_packet_unref(&pkt);
+                *pts = key;
+                return 0;
+            }
+        }
+
+        /* decode */
+        ret = avcodec_send_packet(dec, eof ? NULL : &pkt);
+        av_packet_unref(&pkt);
+        if (ret < 0 && AVERROR(EAGAIN) != ret && AVERROR_EOF != ret)
+            return KERROR(KESEND_PACKET_FAIL);
+        ret = avcodec_receive_frame(dec, frame);
+        if (!ret) {
+            got = true;
+            break;
+        }
+        if (eof || AVERROR(EAGAIN) != ret)
+            return KERROR(eof || AVERROR_EOF == ret ? KEEOF : KERECEIVE_FRAME_FAIL);
+    }
+    if (!got)
+        return KERROR(KENO_FIRST_FRAME);
+
+    ret = scale(thumb);
+    av_frame_unref(frame);
+    if (ret < 0)
+        return ret;
+    mutex_lock(mutex);
+    cache.put(url, key, *thumb);
+    mutex_unlock(mutex);
+    *pts = key;
+
+    return 0;
+}
+
+int ThumbEngine::scale (ThumbRef *thumb)
+{
+    std::shared_ptr<Thumb> t;
+    AVRational             sar;
+    uint8_t *              dst[4] = { NULL };
+    int                    dst_linesize[4] = { 0 };
+    int                    w;
+    int                    h;
+
+    /* keep the display aspect ratio */
+    sar = av_guess_sample_aspect_ratio(avfctx, avfctx->streams[vst_idx], frame);
+    w = frame->width;
+    if (sar.num > 0 && sar.den > 0)
+        w = (int)av_rescale(w, sar.num, sar.den);
+    if (w <= 0 || frame->height <= 0)
+        return KERROR(KEINVAL);
+    h = (int)av_rescale(THUMB_WIDTH, frame->height, w);
+    h = h > THUMB_MAX_HEIGHT ? THUMB_MAX_HEIGHT : h;
+    h = h < 2 ? 2 : (h & ~1);
+
+    sws = sws_getCachedContext(sws, frame->width, frame->height, (AVPixelFormat)frame->format,
+                               THUMB_WIDTH, h, AV_PIX_FMT_RGB24, SWS_FAST_BILINEAR, NULL, NULL, NULL);
+    if (!sws)
+        return KERROR(KESWS_ALLOC_FAIL);
+
+    t.reset(new(std::nothrow) Thumb);
+    if (!t)
+        return KERROR(KENOMEM);
+    t->width = THUMB_WIDTH;
+    t->height = h;
+    t->rgb.resize(THUMB_WIDTH * 3 * h);
+    dst[0] = t->rgb.data();
+    dst_linesize[0] = THUMB_WIDTH * 3;
+    if (sws_scale(sws, frame->data, frame->linesize, 0, frame->height, dst, dst_linesize) <= 0)
+        return KERROR(KESWS_SCALE_FAIL);
+    *thumb = t;
+
+    return 0;
+}
+
+int ThumbEngine::get_bucket (double pos) const
+{
+    int bucket;
+
+    if (duration <= 0.0)
+        return -1;
+    bucket = (int)(pos / duration * THUMB_STRIP_LEN);
+    bucket = bucket < 0 ? 0 : bucket;
+
+    return bucket >= THUMB_STRIP_LEN ? THUMB_STRIP_LEN - 1 : bucket;
+}
+
+int ThumbEngine::init ()
+{
+    int ret;
+
+    if (session >= 0)
+        return KERROR(KEREINIT);
+
+    /* own worker, its priority is lowered while the strip is filled */
+    ret = pool.init(1);
+    if (ret < 0)
+        return ret;
+    ret = pool.open_session();
+    if (ret < 0)
+        GOTO_FAIL(ret);
+    session = ret;
+
+    mutex = mutex_create("thumb engine");
+    if (!mutex) {
+        logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_MUTEX_FAIL), SDL_GetError());
+        GOTO_FAIL(KECREATE_SDL_MUTEX_FAIL);
+    }
+
+    /* the task sleeps until a file is opened */
+    SDL_AtomicSet(&abort_req, 0);
+    SDL_AtomicSet(&open_req, 0);
+    hover_req = false;
+    task.init(thumb_proc, this, "thumb_task");
+    ret = pool.submit(&task, session);
+    if (ret < 0) {
+        logger.FATALN("[%s: %d]%s.\n", kerr2str(-ret));
+        goto fail;
+    }
+    KLOGD("Thumbnail engine has been inited.\n");
+
+    return 0;
+fail:
+    close();
+
+    return ret;
+}
+
+void ThumbEngine::close ()
+{
+    if (session < 0 && !mutex)
+        return;
+
+    /* the decode in progress is interrupted */
+    if (mutex) {
+        mutex_lock(mutex);
+        SDL_AtomicSet(&abort_req, 1);
+        mutex_unlock(mutex);
+        task.wake();
+        pool.join(&task);
+    }
+    if (session >= 0)
+        pool.close_session(session);
+    pool.close();
+    session = -1;
+    close_file();
+    sws_freeContext(sws);
+    sws = NULL;
+    url.clear();
+    cache.clear();
+    if (mutex) {
+        mutex_destroy(mutex);
+        mutex = NULL;
+    }
+
+    KLOGD("Thumbnail engine closed.\n");
+}
+
+void ThumbEngine::open (const char *url)
+{
+    std::string next = url ? url : "";
+
+    if (!mutex)
+        return;
+
+    /* the same file is kept with its strip */
+    mutex_lock(mutex);
+    if (!SDL_AtomicGet(&open_req) && next == this->url) {
+        mutex_unlock(mutex);
+        return;
+    }
+    next_url = next;
+    SDL_AtomicSet(&open_req, 1);
+    hover_req = false;
+    mutex_unlock(mutex);
+    task.wake();
+}
+
+bool ThumbEngine::get (double pos, QImage *image)
+{
+    ThumbRef thumb;
+    int      bucket;
+
+    if (!mutex || !image)
+        return false;
+
+    /* the bucket of the strip if decoded, or a request of the nearest keyframe */
+    mutex_lock(mutex);
+    if (url.empty() && !SDL_AtomicGet(&open_req)) {
+        mutex_unlock(mutex);
+        return false;
+    }
+    bucket = get_bucket(pos);
+    if (!SDL_AtomicGet(&open_req) && bucket >= 0 && AV_NOPTS_VALUE != strip[bucket])
+        thumb = cache.get(url, strip[bucket]);
+    if (!thumb) {
+        hover_pos = pos;
+        hover_req = true;
+    }
+    mutex_unlock(mutex);
+    if (!thumb) {
+        task.wake();
+        return false;
+    }
+    *image = to_image(thumb);
+
+    return true;
+}
+
+void ThumbEngine::set_cache_len (int len)
+{
+    if (mutex)
+        mutex_lock(mutex);
+    cache.set_capacity(len);
+    if (mutex)
+        mutex_unlock(mutex);
+}
+
+ThumbEngine::ThumbEngine (QObject *parent)
+    : QObject(parent), cache(THUMB_CACHE_LEN)
+{
+    session = -1;
+    mutex = NULL;
+    SDL_AtomicSet(&open_req, 0);
+    hover_pos = 0.0;
+    hover_req = false;
+    duration = 0.0;
+    strip_next = 0;
+    SDL_AtomicSet(&abort_req, 0);
+    avfctx = NULL;
+    dec = NULL;
+    sws = NULL;
+    frame = NULL;
+    vst_idx = -1;
+    low_priority = false;
+}
+
+ThumbEngine::~ThumbEngine ()
+{
+    close();
+}
@@ -0,0 +1,97 @@
+#ifndef _AVPLAYERWIDGET_THUMB_H_
+#define _AVPLAYERWIDGET_THUMB_H_
+
+#include <QObject>
+#include <QImage>
+#include <string>
+#include <vector>
+#include "avplayerwidget_global.h"
+#include "pool/pool.h"
+#include "thumb_cache.h"
+
+extern "C"
+{
+#include "libavformat/avformat.h"
+#include "libavcodec/avcodec.h"
+#include "libswscale/swscale.h"
+#include "SDL2/SDL.h"
+}
+
+/*
+* thumbnails of the progress bar,
+* the file is opened a second time with its own format and codec contexts, the playback is not touched,
+* a thumbnail is the nearest keyframe before a position, decoded with lowres and the non-keyframes skipped,
+* a task on its own worker decodes the hovered position first, then fills a strip of the whole file
+*/
+
+/* thumbnail size */
+#define THUMB_WIDTH          160     // the height keeps the display aspect ratio
+#define THUMB_MAX_HEIGHT     160
+
+/* thumbnails of the strip, pre-generated at low priority */
+#define THUMB_STRIP_LEN      100
+
+/* thumbnails cached, of all the files */
+#define THUMB_CACHE_LEN      512
+
+/* packets read to find a keyframe after a seek */
+#define THUMB_MAX_PACKETS    256
+
+class AVPLAYERWIDGET_EXPORT ThumbEngine : public QObject {
+    Q_OBJECT
+
+private:
+    /* task */
+    TaskPool             pool;        // own worker, a decode blocks on I/O
+    int                  session;     // -1 if not inited
+    Task                 task;
+
+    /* state, protected by mutex */
+    SDL_mutex *          mutex;
+    std::string          url;         // the file of strip and duration, empty if none
+    std::string          next_url;    // requested by open()
+    SDL_atomic_t         open_req;    // also read by interrupt_cb() without the mutex
+    double               hover_pos;
+    bool                 hover_req;
+    double               duration;    // 0 if unknown (unit: second)
+    std::vector<int64_t> strip;       // keyframe pts of the buckets, AV_NOPTS_VALUE if not decoded
+    int                  strip_next;  // the next bucket to be decoded
+    ThumbCache           cache;
+    SDL_atomic_t         abort_req;   // also read by interrupt_cb() without the mutex
+
+    /* decoder, used by the task only */
+    AVFormatContext *    avfctx;
+    AVCodecContext *     dec;
+    SwsContext *         sws;
+    AVFrame *            frame;
+    int                  vst_idx;
+    bool                 low_priority;
+
+signals:
+    void               thumb_ready  (double pos, const QImage &image); // the hovered position decoded
+
+private:
+    static int         thumb_proc   (void *args);
+    static int         interrupt_cb (void *args);
+    static QImage      to_image     (const ThumbRef &thumb);
+
+private:
+    int                open_file    (const std::string &url);
+    void               close_file   ();
+    int                decode_at    (double pos, ThumbRef *thumb, int64_t *pts);
+    int                scale        (ThumbRef *thumb);
+    int                get_bucket   (double pos) const;
+
+public:
+    int                init         ();
+    void               close        ();
+    void               open         (const char *url); // NULL to close the file
+    bool               get          (double pos, QImage *image); // false if not cached, thumb_ready() follows
+    void               set_cache_len (int len); // thumbnails cached, THUMB_CACHE_LEN by default
+
+public:
+    ThumbEngine                     (QObject *parent = nullptr);
+    ~ThumbEngine                    ();
+};
+
+#endif /* _AVPLAYERWIDGET_THUMB_H_ */
@@ -0,0 +1,78 @@
+#include "thumb_cache.h"
+
+ThumbRef ThumbCache::get (const std::string &url, int64_t pts)
+{
+    std::map<Key, std::list<Entry>::iterator>::iterator it = index.find(Key(url, pts));
+
+    if (it == index.end()) {
+        misses++;
+        return ThumbRef();
+    }
+
+    /* the most recent */
+    lru.splice(lru.begin(), lru, it->second);
+    hits++;
+
+    return it->second->thumb;
+}
+
+void ThumbCache::put (const std::string &url, int64_t pts, const ThumbRef &thumb)
+{
+    Key                                                 key(url, pts);
+    std::map<Key, std::list<Entry>::iterator>::iterator it = index.find(key);
+    Entry                                               entry;
+
+    if (it != index.end()) {
+        it->second->thumb = thumb;
+        lru.splice(lru.begin(), lru, it->second);
+        return;
+    }
+
+    entry.key = key;
+    entry.thumb = thumb;
+    lru.push_front(entry);
+    index[key] = lru.begin();
+
+    /* evict the least recent */
+    while ((int)lru.size() > capacity) {
+        index.erase(lru.back().key);
+        lru.pop_back();
+    }
+}
+
+void ThumbCache::clear ()
+{
+    lru.clear();
+    index.clear();
+}
+
+void ThumbCache::set_capacity (int capacity)
+{
+    this->capacity = capacity < 1 ? 1 : capacity;
+    while ((int)lru.size() > this->capacity) {
+        index.erase(lru.back().key);
+        lru.pop_back();
+    }
+}
+
+int ThumbCache::get_len () const
+{
+    return (int)lru.size();
+}
+
+int64_t ThumbCache::get_hits () const
+{
+    return hits;
+}
+
+int64_t ThumbCache::get_misses () const
+{
+    return misses;
+}
+
+ThumbCache::ThumbCache (int capacity)
+{
+    this->capacity = capacity < 1 ? 1 : capacity;
+    hits = 0;
+    misses = 0;
+}
@@ -0,0 +1,55 @@
+#ifndef _AVPLAYERWIDGET_THUMB_CACHE_H_
+#define _AVPLAYERWIDGET_THUMB_CACHE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <memory>
+
+/*
+* LRU cache of the thumbnails, keyed by the file and the pts of the keyframe decoded,
+* the thumbnails are shared, an evicted one lives while a reader holds it,
+* not thread-safe, locked by the owner
+*/
+
+/* a thumbnail, packed RGB24 */
+typedef struct Thumb {
+    int                  width;
+    int                  height;
+    std::vector<uint8_t> rgb;    // width * 3 bytes a line
+}Thumb;
+
+typedef std::shared_ptr<const Thumb> ThumbRef;
+
+class ThumbCache {
+private:
+    typedef std::pair<std::string, int64_t> Key;
+
+    typedef struct Entry {
+        Key      key;
+        ThumbRef thumb;
+    }Entry;
+
+private:
+    std::list<Entry>                            lru;      // the most recent first
+    std::map<Key, std::list<Entry>::iterator>   index;
+    int                                         capacity; // thumbnails
+    int64_t                                     hits;
+    int64_t                                     misses;
+
+public:
+    ThumbRef           get          (const std::string &url, int64_t pts); // NULL if not cached
+    void               put          (const std::string &url, int64_t pts, const ThumbRef &thumb);
+    void               clear        ();
+    void               set_capacity (int capacity);
+    int                get_len      () const;
+    int64_t            get_hits     () const;
+    int64_t            get_misses   () const;
+
+public:
+    ThumbCache         (int capacity);
+};
+
+#endif /* _AVPLAYERWIDGET_THUMB_CACHE_H_ */
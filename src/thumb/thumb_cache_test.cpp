@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+#include "thumb_cache.h"
+
+static ThumbRef make_thumb (int width)
+{
+    std::shared_ptr<Thumb> thumb(new Thumb);
+
+    thumb->width = width;
+    thumb->height = 1;
+    thumb->rgb.assign(width * 3, 0);
+
+    return thumb;
+}
+
+TEST(thumb_cache_test, lru)
+{
+    ThumbCache cache(2);
+
+    cache.put("/a.mkv", 0, make_thumb(1));
+    cache.put("/a.mkv", 90000, make_thumb(2));
+    cache.put("/b.mkv", 0, make_thumb(3));
+
+    /* the least recent is evicted */
+    EXPECT_EQ(2, cache.get_len());
+    EXPECT_FALSE(cache.get("/a.mkv", 0));
+    ASSERT_TRUE(cache.get("/a.mkv", 90000) != NULL);
+    EXPECT_EQ(3, cache.get("/b.mkv", 0)->width);
+
+    /* a hit makes an entry the most recent */
+    cache.get("/a.mkv", 90000);
+    cache.put("/c.mkv", 0, make_thumb(4));
+    EXPECT_TRUE(cache.get("/a.mkv", 90000) != NULL);
+    EXPECT_FALSE(cache.get("/b.mkv", 0));
+    EXPECT_EQ(2, cache.get_misses());
+}
+
+TEST(thumb_cache_test, shared)
+{
+    ThumbCache cache(1);
+    ThumbRef   held;
+
+    cache.put("/a.mkv", 0, make_thumb(1));
+    held = cache.get("/a.mkv", 0);
+
+    /* replaced and evicted, the reader still holds it */
+    cache.put("/a.mkv", 0, make_thumb(2));
+    cache.put("/b.mkv", 0, make_thumb(3));
+    EXPECT_EQ(1, held->width);
+    EXPECT_EQ(1, cache.get_len());
+
+    cache.set_capacity(0);
+    EXPECT_EQ(1, cache.get_len());
+    cache.clear();
+    EXPECT_EQ(0, cache.get_len());
+}
@@ -0,0 +1,306 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include "engine/engine.h"
+#include "syncprobe/syncprobe.h"
+#include "error/error.h"
+#include "log/log.h"
+#include "trace/trace.h"
+#include "lock/lock.h"
+#include "utils/utils.h"
+
+extern "C"
+{
+#include "libavutil/log.h"
+#include "SDL2/SDL.h"
+}
+
+#define FILENAME "kavbench.cpp"
+
+static Engine    engine;
+static SyncProbe probe;
+
+static void usage ()
+{
+    fprintf(stderr,
+            "usage: kavbench [options] file\n"
+            "  -fast           present the frames as soon as decoded (default)\n"
+            "  -realtime       present the frames on time\n"
+            "  -player         schedule the frames by the delay of the player\n"
+            "  -vsink name     video sink, null (default) or offscreen\n"
+            "  -size WxH       size of the offscreen surface (default %dx%d)\n"
+            "  -framedrop      drop the late video frames in realtime mode\n"
+            "  -t seconds      stop after so much media time\n"
+            "  -vn             ignore the video stream\n"
+            "  -an             ignore the audio stream\n"
+            "  -budget MB      size the queues to a memory budget (default %d)\n"
+            "  -sync           measure the A-V offset of a clip written by kavgen, player mode by default\n"
+            "  -sync_max ms    fail if the 95th percentile of the A-V offset is above ms\n"
+            "  -json           print the result as JSON\n"
+            "  -log file       write the player log to file\n"
+            "  -trace file     write a Chrome trace of the pipeline to file\n"
+            "  -locks          print the lock profile, built with LOCK_PROFILE\n"
+            "  -v              print the FFmpeg log\n",
+            ENGINE_DEF_WIDTH, ENGINE_DEF_HEIGHT, (int)(BUDGET_DEF_SIZE >> 20));
+}
+
+static void sig_handler (int sig)
+{
+    (void)sig;
+    engine.abort();
+}
+
+static const char *mode_name (int mode)
+{
+    switch (mode) {
+    case ENGINE_MODE_FAST:
+        return "fast";
+    case ENGINE_MODE_PLAYER:
+        return "player";
+    default:
+        return "realtime";
+    }
+}
+
+static void print_text (const char *url, EngineParams *params, EngineStats *s, int ret)
+{
+    printf("file:         %s\n", url);
+    printf("mode:         %s, %s video sink\n",
+           mode_name(params->mode),
+           ENGINE_VSINK_OFFSCREEN == params->vsink ? "offscreen" : "null");
+    printf("result:       %s\n", ret < 0 ? kerr2str(-ret) : "play over");
+    printf("elapsed:      %.3lfs, %.3lfs of media (x%.2lf)\n",
+           s->elapsed, s->media_time, s->elapsed > 0.0 ? s->media_time / s->elapsed : 0.0);
+    printf("video frames: %lld, %lld presented, %lld dropped\n",
+           (long long)s->vframes, (long long)s->rendered, (long long)s->dropped);
+    printf("decode fps:   %.2lf\n", s->elapsed > 0.0 ? s->vframes / s->elapsed : 0.0);
+    printf("audio frames: %lld, %lld samples, %lld underruns\n",
+           (long long)s->aframes, (long long)s->samples, (long long)s->underruns);
+    printf("A-V drift:    avg %.3lfms, max %.3lfms\n", s->drift_avg * 1000.0, s->drift_max * 1000.0);
+    printf("cpu time:     %.3lfs (%.1lf%% of a core)\n",
+           s->cpu_time, s->elapsed > 0.0 ? s->cpu_time * 100.0 / s->elapsed : 0.0);
+    printf("peak rss:     %.2lfMB\n", s->peak_rss / (1024.0 * 1024.0));
+    printf("peak memory:  %.2lfMB of packets, frames and buffers\n", s->peak_mem / (1024.0 * 1024.0));
+}
+
+static void print_json (const char *url, EngineParams *params, EngineStats *s, int ret)
+{
+    printf("{\"file\": \"");
+    for (const char *c = url; *c; c++) {
+        if ('"' == *c || '\\' == *c)
+            putchar('\\');
+        putchar(*c);
+    }
+    printf("\", \"mode\": \"%s\", \"vsink\": \"%s\", \"result\": \"%s\", ",
+           mode_name(params->mode),
+           ENGINE_VSINK_OFFSCREEN == params->vsink ? "offscreen" : "null",
+           ret < 0 ? kerr2str(-ret) : "play over");
+    printf("\"elapsed\": %.6lf, \"media_time\": %.6lf, ", s->elapsed, s->media_time);
+    printf("\"video_frames\": %lld, \"presented\": %lld, \"dropped\": %lld, \"decode_fps\": %.3lf, ",
+           (long long)s->vframes, (long long)s->rendered, (long long)s->dropped,
+           s->elapsed > 0.0 ? s->vframes / s->elapsed : 0.0);
+    printf("\"audio_frames\": %lld, \"samples\": %lld, \"underruns\": %lld, ",
+           (long long)s->aframes, (long long)s->samples, (long long)s->underruns);
+    printf("\"drift_avg_ms\": %.3lf, \"drift_max_ms\": %.3lf, ", s->drift_avg * 1000.0, s->drift_max * 1000.0);
+    printf("\"cpu_time\": %.6lf, \"peak_rss\": %lld, \"peak_mem\": %lld",
+           s->cpu_time, (long long)s->peak_rss, (long long)s->peak_mem);
+}
+
+static void print_sync_text (SyncReport *r, int ret)
+{
+    if (ret < 0) {
+        printf("A-V offset:   %s\n", kerr2str(-ret));
+        return;
+    }
+    printf("sync marks:   %d video, %d audio, %d matched\n", r->marks, r->beeps, r->pairs);
+    printf("A-V offset:   mean %.3lfms, mean abs %.3lfms, p95 %.3lfms, max %.3lfms\n",
+           r->mean * 1000.0, r->mean_abs * 1000.0, r->p95 * 1000.0, r->max * 1000.0);
+    printf("A-V drift:    %.3lfms per minute\n", r->drift * 60000.0);
+}
+
+static void print_sync_json (SyncReport *r, int ret)
+{
+    const std::vector<SyncPair> &pairs = probe.get_pairs();
+
+    if (ret < 0) {
+        printf(", \"sync\": {\"error\": \"%s\"}", kerr2str(-ret));
+        return;
+    }
+    printf(", \"sync\": {\"marks\": %d, \"beeps\": %d, \"pairs\": %d, ", r->marks, r->beeps, r->pairs);
+    printf("\"mean_ms\": %.3lf, \"mean_abs_ms\": %.3lf, \"p95_ms\": %.3lf, \"max_ms\": %.3lf, ",
+           r->mean * 1000.0, r->mean_abs * 1000.0, r->p95 * 1000.0, r->max * 1000.0);
+    printf("\"drift_ms_per_min\": %.3lf, \"offsets\": [", r->drift * 60000.0);
+
+    /* the offset over time, [pts, offset in ms] */
+    for (size_t i = 0; i < pairs.size(); i++)
+        printf("%s[%.3lf, %.3lf]", i ? ", " : "", pairs[i].pts, pairs[i].offset * 1000.0);
+    printf("]}");
+}
+
+#undef main
+int main (int argc, char *argv[])
+{
+    EngineParams params;
+    EngineStats  stats;
+    const char * url = NULL;
+    const char * log_file = NULL;
+    const char * trace_file = NULL;
+    bool         json = false;
+    bool         locks = false;
+    bool         verbose = false;
+    bool         sync = false;
+    bool         mode_set = false;
+    double       sync_max = 0.0;
+    SyncReport   report;
+    int          sync_ret = 0;
+    int          ret;
+
+    memset(&params, 0, sizeof(EngineParams));
+    params.mode = ENGINE_MODE_FAST;
+    params.vsink = ENGINE_VSINK_NULL;
+    params.asink = ENGINE_ASINK_NULL;
+    params.width = ENGINE_DEF_WIDTH;
+    params.height = ENGINE_DEF_HEIGHT;
+
+    /* parse options */
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool        has_val = i + 1 < argc;
+
+        if (!strcmp(arg, "-fast")) {
+            params.mode = ENGINE_MODE_FAST;
+            mode_set = true;
+        } else if (!strcmp(arg, "-realtime")) {
+            params.mode = ENGINE_MODE_REALTIME;
+            mode_set = true;
+        } else if (!strcmp(arg, "-player")) {
+            params.mode = ENGINE_MODE_PLAYER;
+            mode_set = true;
+        } else if (!strcmp(arg, "-vsink") && has_val) {
+            arg = argv[++i];
+            if (!strcmp(arg, "null")) {
+                params.vsink = ENGINE_VSINK_NULL;
+            } else if (!strcmp(arg, "offscreen")) {
+                params.vsink = ENGINE_VSINK_OFFSCREEN;
+            } else {
+                fprintf(stderr, "Unknown video sink %s.\n", arg);
+                return KEINVAL;
+            }
+        } else if (!strcmp(arg, "-size") && has_val) {
+            if (2 != sscanf(argv[++i], "%dx%d", &params.width, &params.height)
+                || params.width <= 0 || params.height <= 0)
+                {
+                fprintf(stderr, "Invalid size %s.\n", argv[i]);
+                return KEINVAL;
+            }
+        } else if (!strcmp(arg, "-framedrop")) {
+            params.frame_drop = true;
+        } else if (!strcmp(arg, "-t") && has_val) {
+            params.max_time = atof(argv[++i]);
+        } else if (!strcmp(arg, "-vn")) {
+            params.no_video = true;
+        } else if (!strcmp(arg, "-an")) {
+            params.no_audio = true;
+        } else if (!strcmp(arg, "-budget") && has_val) {
+            params.mem_budget = (int64_t)atoi(argv[++i]) << 20;
+        } else if (!strcmp(arg, "-sync")) {
+            sync = true;
+        } else if (!strcmp(arg, "-sync_max") && has_val) {
+            sync = true;
+            sync_max = atof(argv[++i]);
+        } else if (!strcmp(arg, "-json")) {
+            json = true;
+        } else if (!strcmp(arg, "-log") && has_val) {
+            log_file = argv[++i];
+        } else if (!strcmp(arg, "-trace") && has_val) {
+            trace_file = argv[++i];
+        } else if (!strcmp(arg, "-locks")) {
+            locks = true;
+        } else if (!strcmp(arg, "-v")) {
+            verbose = true;
+        } else if ('-' == arg[0] && arg[1]) {
+            usage();
+            return KEINVAL;
+        } else {
+            url = arg;
+        }
+    }
+    if (!url) {
+        usage();
+        return KEINVAL;
+    }
+    if (sync && !mode_set)
+        params.mode = ENGINE_MODE_PLAYER;
+
+    /* init log */
+    av_log_set_level(verbose ? AV_LOG_INFO : AV_LOG_ERROR);
+    if (log_file) {
+        ret = logger.init(log_file);
+        if (ret < 0) {
+            fprintf(stderr, "%s: %s.\n", kerr2str(-ret), log_file);
+            return -ret;
+        }
+    }
+
+    /* play */
+    ret = engine.init(&params);
+    if (ret < 0) {
+        fprintf(stderr, "Failed to init the engine: %s.\n", kerr2str(-ret));
+        return -ret;
+    }
+    ret = engine.open(url);
+    if (ret < 0) {
+        fprintf(stderr, "Failed to open %s: %s.\n", url, kerr2str(-ret));
+        engine.close();
+        return -ret;
+    }
+    if (sync)
+        engine.set_sync_probe(&probe);
+    signal(SIGINT, sig_handler);
+    if (trace_file)
+        trace_enable(true);
+    if (locks)
+        lock_reset();
+    ret = engine.run();
+    trace_enable(false);
+    signal(SIGINT, SIG_DFL);
+    engine.get_stats(&stats);
+    engine.close();
+
+    /* report, an interrupted run is reported as well */
+    if (sync)
+        sync_ret = probe.get_report(&report);
+    if (json) {
+        print_json(url, &params, &stats, ret);
+        if (sync)
+            print_sync_json(&report, sync_ret);
+        printf("}\n");
+    } else {
+        print_text(url, &params, &stats, ret);
+        if (sync)
+            print_sync_text(&report, sync_ret);
+    }
+    if (locks)
+        lock_report(json ? stderr : stdout);
+    if (log_file)
+        logger.close();
+    if (trace_file) {
+        int trace_ret = trace_dump(trace_file);
+        if (trace_ret < 0)
+            fprintf(stderr, "%s: %s.\n", kerr2str(-trace_ret), trace_file);
+    }
+
+    if (ret < 0 && KERROR(KEABORTED) != ret)
+        return -ret;
+    if (sync_ret < 0)
+        return -sync_ret;
+
+    /* a regression of the sync */
+    if (sync_max > 0.0 && report.p95 * 1000.0 > sync_max) {
+        fprintf(stderr, "A-V offset p95 %.3lfms is above %.3lfms.\n", report.p95 * 1000.0, sync_max);
+        return KEINVAL;
+    }
+
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "synth/synth.h"
+#include "error/error.h"
+#include "log/log.h"
+
+extern "C"
+{
+#include "libavutil/log.h"
+}
+
+#define FILENAME "kavgen.cpp"
+
+static void usage ()
+{
+    SynthParams params;
+
+    synth_default_params(&params);
+    fprintf(stderr,
+            "usage: kavgen [options] file\n"
+            "       kavgen [options] -matrix dir\n"
+            "  -vcodec name    video encoder, none for no video (default %s)\n"
+            "  -acodec name    audio encoder, none for no audio (default %s)\n"
+            "  -f name         muxer, guessed from the file name by default\n"
+            "  -s WxH          picture size (default %dx%d)\n"
+            "  -r fps          frame rate (default %d)\n"
+            "  -b bitrate      video bit rate (unit: bit/s)\n"
+            "  -ar rate        sample rate (default %d)\n"
+            "  -ac channels    channel count (default %d)\n"
+            "  -t seconds      duration (default %.0lf)\n"
+            "  -beep frames    frames between the sync marks (default %d)\n"
+            "  -matrix dir     write every clip of the benchmark matrix into dir\n"
+            "  -v              print the FFmpeg log\n",
+            params.vcodec, params.acodec, params.width, params.height, params.fps,
+            params.sample_rate, params.channels, params.duration, params.beep_interval);
+}
+
+/* write the clips of the matrix, the clips of missing encoders are reported and skipped */
+static int write_matrix (const char *dir, double duration)
+{
+    int failed = 0;
+
+    for (int i = 0; i < synth_nb_presets; i++) {
+        const SynthPreset *preset = &synth_presets[i];
+        SynthParams        params;
+        std::string        path = std::string(dir) + "/" + preset->name + "." + preset->ext;
+        int                ret;
+
+        synth_preset_params(preset, &params);
+        if (duration > 0.0)
+            params.duration = duration;
+        ret = synth_generate(&params, path.c_str());
+        printf("%-20s %s\n", preset->name, ret < 0 ? kerr2str(-ret) : path.c_str());
+        if (ret < 0)
+            failed++;
+    }
+
+    return failed == synth_nb_presets ? KERROR(KEWRITE_MEDIA_FILE_FAIL) : 0;
+}
+
+#undef main
+int main (int argc, char *argv[])
+{
+    SynthParams params;
+    const char *path = NULL;
+    const char *matrix = NULL;
+    double      duration = 0.0;
+    bool        verbose = false;
+    int         ret;
+
+    synth_default_params(&params);
+
+    /* parse options */
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool        has_val = i + 1 < argc;
+
+        if (!strcmp(arg, "-vcodec") && has_val) {
+            arg = argv[++i];
+            params.vcodec = strcmp(arg, "none") ? arg : NULL;
+        } else if (!strcmp(arg, "-acodec") && has_val) {
+            arg = argv[++i];
+            params.acodec = strcmp(arg, "none") ? arg : NULL;
+        } else if (!strcmp(arg, "-f") && has_val) {
+            params.format = argv[++i];
+        } else if (!strcmp(arg, "-s") && has_val) {
+            if (2 != sscanf(argv[++i], "%dx%d", &params.width, &params.height)) {
+                fprintf(stderr, "Invalid size %s.\n", argv[i]);
+                return KEINVAL;
+            }
+        } else if (!strcmp(arg, "-r") && has_val) {
+            params.fps = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-b") && has_val) {
+            params.bit_rate = atoll(argv[++i]);
+        } else if (!strcmp(arg, "-ar") && has_val) {
+            params.sample_rate = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-ac") && has_val) {
+            params.channels = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-t") && has_val) {
+            duration = atof(argv[++i]);
+            params.duration = duration;
+        } else if (!strcmp(arg, "-beep") && has_val) {
+            params.beep_interval = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-matrix") && has_val) {
+            matrix = argv[++i];
+        } else if (!strcmp(arg, "-v")) {
+            verbose = true;
+        } else if ('-' == arg[0] && arg[1]) {
+            usage();
+            return KEINVAL;
+        } else {
+            path = arg;
+        }
+    }
+    if (!path && !matrix) {
+        usage();
+        return KEINVAL;
+    }
+
+    av_log_set_level(verbose ? AV_LOG_INFO : AV_LOG_ERROR);
+    if (matrix)
+        ret = write_matrix(matrix, duration);
+    else
+        ret = synth_generate(&params, path);
+    if (ret < 0) {
+        fprintf(stderr, "Failed to write %s: %s.\n", matrix ? matrix : path, kerr2str(-ret));
+        return -ret;
+    }
+
+    return 0;
+}
@@ -0,0 +1,802 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "bench/bench.h"
+#include "thumb/thumb.h" // before utils.h, its min and max macros break <deque>
+#include "queue/packet_queue.h"
+#include "queue/frame_queue.h"
+#include "render/render.h"
+#include "inifile/inifile.h"
+#include "plstore/plstore.h"
+#include "plimport/plimport.h"
+#include "synth/synth.h"
+#include "error/error.h"
+#include "log/log.h"
+
+extern "C"
+{
+#include "libavutil/imgutils.h"
+#include "libavutil/channel_layout.h"
+#include "libavutil/time.h"
+#include "SDL2/SDL.h"
+}
+
+#define FILENAME "kavmicro.cpp"
+
+using namespace inifile;
+
+/* queue benchmarks */
+typedef struct QueueArgs {
+    int              batch;    // packets put before they are taken, single thread only
+    int              max_len;  // length of the frame queue
+}QueueArgs;
+
+typedef struct Producer {
+    PacketQueue *    pktq;
+    FrameQueue *     fq;
+    AVPacket *       pkt;
+    AVFrame *        frame;
+    int64_t          iters;
+    int              ret;
+}Producer;
+
+/* resample benchmarks */
+typedef struct ResampleArgs {
+    AVSampleFormat   src_fmt;
+    int              src_rate;
+    AVSampleFormat   tgt_fmt;
+    int              tgt_rate;
+}ResampleArgs;
+
+/* texture upload benchmarks */
+typedef struct UploadArgs {
+    AVPixelFormat    fmt;
+    int              width;
+    int              height;
+}UploadArgs;
+
+/* playlist load benchmarks */
+typedef struct PlaylistArgs {
+    std::string      path;
+    int              len;
+    bool             lookup;   // read every url as the playlist loader does
+}PlaylistArgs;
+
+/* logger benchmarks */
+typedef struct LogArgs {
+    bool             enabled;  // whether the info level is written
+}LogArgs;
+
+/* thumbnail benchmarks, a run fails if a hover takes longer than the target of the progress bar */
+#define THUMB_HOVER_BUDGET  50    // unit: millisecond
+#define THUMB_WAIT_TIMEOUT  1000  // a thumbnail not decoded by then is an error (unit: millisecond)
+
+typedef struct ThumbArgs {
+    ThumbEngine *    engine;
+    SDL_sem *        ready;    // posted by thumb_ready()
+    double           duration; // of the clip, a keyframe every second (unit: second)
+}ThumbArgs;
+
+static int pktq_put_get (void *args, int64_t iters, BenchCounters *counters)
+{
+    QueueArgs * qa = (QueueArgs *)args;
+    PacketQueue pktq;
+    AVPacket *  pkt = av_packet_alloc();
+    int         ret;
+
+    if (!pkt)
+        return KERROR(KENOMEM);
+    ret = pktq.init(NULL);
+    if (ret < 0)
+        goto fail;
+
+    /* the queue only keeps the pointer, the same packet is put again and again */
+    for (int64_t i = 0; i < iters; i += qa->batch) {
+        int n = (int)(iters - i < qa->batch ? iters - i : qa->batch);
+        for (int j = 0; j < n; j++) {
+            ret = pktq.put(pkt);
+            if (ret < 0)
+                goto fail;
+        }
+        for (int j = 0; j < n; j++)
+            pktq.get();
+    }
+    counters->items = iters;
+    ret = 0;
+fail:
+    av_packet_free(&pkt);
+
+    return ret;
+}
+
+static int pktq_producer (void *args)
+{
+    Producer *p = (Producer *)args;
+
+    for (int64_t i = 0; i < p->iters; i++) {
+        p->ret = p->pktq->put(p->pkt);
+        if (p->ret < 0)
+            break;
+    }
+    p->pktq->set_read_eof(true);
+
+    return 0;
+}
+
+static int pktq_contended (void *args, int64_t iters, BenchCounters *counters)
+{
+    PacketQueue  pktq;
+    Producer     p;
+    SDL_Thread * thr;
+    int64_t      got = 0;
+    int          ret;
+
+    (void)args;
+    memset(&p, 0, sizeof(Producer));
+    p.pkt = av_packet_alloc();
+    if (!p.pkt)
+        return KERROR(KENOMEM);
+    ret = pktq.init(NULL);
+    if (ret < 0)
+        goto fail;
+    p.pktq = &pktq;
+    p.iters = iters;
+
+    /* a demux thread and a decoder thread */
+    thr = SDL_CreateThread(pktq_producer, "pktq_producer", &p);
+    if (!thr)
+        GOTO_FAIL(KECREATE_THREAD_FAIL);
+    while (pktq.get())
+        got++;
+    SDL_WaitThread(thr, NULL);
+    if (p.ret < 0) {
+        ret = p.ret;
+        goto fail;
+    }
+    counters->items = got;
+    ret = 0;
+fail:
+    av_packet_free(&p.pkt);
+
+    return ret;
+}
+
+static int fq_producer (void *args)
+{
+    Producer *p = (Producer *)args;
+
+    for (int64_t i = 0; i < p->iters; i++) {
+        /* wait as the decoder does when the queue is full */
+        while (KERROR(KEAGAIN) == (p->ret = p->fq->put(p->frame, 0, 0.0, 0.0, 0)))
+            p->fq->wait_space(10);
+        if (p->ret < 0)
+            break;
+    }
+
+    return 0;
+}
+
+static int fq_contended (void *args, int64_t iters, BenchCounters *counters)
+{
+    QueueArgs *  qa = (QueueArgs *)args;
+    PacketQueue  pktq;
+    FrameQueue   fq;
+    Producer     p;
+    SDL_Thread * thr;
+    int          ret;
+
+    memset(&p, 0, sizeof(Producer));
+    p.frame = av_frame_alloc();
+    if (!p.frame)
+        return KERROR(KENOMEM);
+    ret = pktq.init(NULL);
+    if (ret < 0)
+        goto fail;
+    ret = fq.init(&pktq, qa->max_len);
+    if (ret < 0)
+        goto fail;
+    p.fq = &fq;
+    p.iters = iters;
+
+    /* a decoder thread and a render thread peeking before taking */
+    thr = SDL_CreateThread(fq_producer, "fq_producer", &p);
+    if (!thr)
+        GOTO_FAIL(KECREATE_THREAD_FAIL);
+    for (int64_t i = 0; i < iters; i++) {
+        Frame *f;
+        if (!fq.peek() || !(f = fq.get()))
+            break;
+        delete f; // the frame is owned by the producer
+    }
+    SDL_WaitThread(thr, NULL);
+    if (p.ret < 0) {
+        ret = p.ret;
+        goto fail;
+    }
+    counters->items = iters;
+    ret = 0;
+fail:
+    av_frame_free(&p.frame);
+
+    return ret;
+}
+
+static int resample (void *args, int64_t iters, BenchCounters *counters)
+{
+    ResampleArgs *ra = (ResampleArgs *)args;
+    Render        render(NULL, NULL, NULL, NULL, NULL);
+    AudioParams   ap_src;
+    AudioParams   ap_tgt;
+    SampleBuf     sample_buf;
+    AVFrame *     frame = av_frame_alloc();
+    int           ret;
+
+    memset(&sample_buf, 0, sizeof(SampleBuf));
+    if (!frame)
+        return KERROR(KENOMEM);
+
+    /* stereo frames of 1024 samples */
+    ap_src.sample_rate = ra->src_rate;
+    ap_src.channels = 2;
+    ap_src.channel_layout = AV_CH_LAYOUT_STEREO;
+    ap_src.sample_fmt = ra->src_fmt;
+    ap_src.nb_samples = 1024;
+    ap_tgt = ap_src;
+    ap_tgt.sample_rate = ra->tgt_rate;
+    ap_tgt.sample_fmt = ra->tgt_fmt;
+    ap_tgt.nb_samples = (int)av_rescale_rnd(1024, ra->tgt_rate, ra->src_rate, AV_ROUND_UP) + 256;
+    ret = render.init_arender(ap_src, ap_tgt);
+    if (ret < 0)
+        goto fail;
+    frame->format = ra->src_fmt;
+    frame->channel_layout = AV_CH_LAYOUT_STEREO;
+    frame->channels = 2;
+    frame->sample_rate = ra->src_rate;
+    frame->nb_samples = 1024;
+    if (av_frame_get_buffer(frame, 0) < 0)
+        GOTO_FAIL(KENOMEM);
+    av_samples_set_silence(frame->data, 0, 1024, 2, ra->src_fmt);
+
+    /* resample() claims room for nb_samples times the bytes of a sample */
+    sample_buf.buf = (Uint8 *)av_malloc((size_t)ap_tgt.nb_samples * ap_tgt.channels
+                                        * av_get_bytes_per_sample(ra->tgt_fmt)
+                                        * av_get_bytes_per_sample(ra->tgt_fmt));
+    if (!sample_buf.buf)
+        GOTO_FAIL(KENOMEM);
+    for (int64_t i = 0; i < iters; i++) {
+        ret = render.resample(frame, &sample_buf);
+        if (ret < 0)
+            goto fail;
+        counters->bytes += sample_buf.size;
+    }
+    counters->items = iters * 1024;
+    ret = 0;
+fail:
+    av_freep(&sample_buf.buf);
+    av_frame_free(&frame);
+
+    return ret;
+}
+
+static int upload (void *args, int64_t iters, BenchCounters *counters)
+{
+    UploadArgs *   ua = (UploadArgs *)args;
+    SDL_Surface *  surface;
+    SDL_Renderer * sdl_renderer = NULL;
+    SDL_Texture *  texture;
+    Render *       render = NULL;
+    Frame          vf;
+    int            ret;
+
+    memset(&vf, 0, sizeof(Frame));
+
+    /* the software renderer of the offscreen sink */
+    surface = SDL_CreateRGBSurfaceWithFormat(0, ua->width, ua->height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (!surface)
+        return KERROR(KECREATE_SDL_SURFACE_FAIL);
+    sdl_renderer = SDL_CreateSoftwareRenderer(surface);
+    if (!sdl_renderer)
+        GOTO_FAIL(KECREATE_SDL_RENDERER_FAIL);
+    render = _New Render(sdl_renderer, NULL, NULL, NULL, NULL);
+    if (!render)
+        GOTO_FAIL(KENOMEM);
+    render->init_vrender();
+    vf.frame = av_frame_alloc();
+    if (!vf.frame)
+        GOTO_FAIL(KENOMEM);
+    vf.frame->format = ua->fmt;
+    vf.frame->width = ua->width;
+    vf.frame->height = ua->height;
+    if (av_frame_get_buffer(vf.frame, 32) < 0)
+        GOTO_FAIL(KENOMEM);
+    for (int p = 0; p < AV_NUM_DATA_POINTERS && vf.frame->buf[p]; p++)
+        memset(vf.frame->buf[p]->data, 0x80, vf.frame->buf[p]->size);
+
+    /* the texture is created by the first upload and reused by the others */
+    for (int64_t i = 0; i < iters; i++) {
+        ret = render->render_video_frame(&vf, &texture);
+        if (ret < 0)
+            goto fail;
+    }
+    counters->items = iters;
+    counters->bytes = iters * av_image_get_buffer_size(ua->fmt, ua->width, ua->height, 1);
+    ret = 0;
+fail:
+    av_frame_free(&vf.frame);
+    delete render; // the texture is destroyed with render
+    if (sdl_renderer)
+        SDL_DestroyRenderer(sdl_renderer);
+    SDL_FreeSurface(surface);
+
+    return ret;
+}
+
+/* a playlist file of the format saved by the player */
+static int make_playlist (const std::string &path, int len)
+{
+    FILE *fp = fopen(path.c_str(), "w");
+
+    if (!fp)
+        return KERROR(KEINVAL);
+    fprintf(fp, "[PLAYLIST_VERSION]\nVER_ID=1.0\n[PLAY_HISTORY]\nURL=/home/user/Videos/clip_0.mkv\n");
+    fprintf(fp, "[PLAY_LIST]\nLIST_LEN=%d\n", len);
+    for (int i = 0; i < len; i++)
+        fprintf(fp, "URL%d=/home/user/Videos/library/season_%02d/episode_%05d_1080p_h264_aac.mkv\n",
+                i, i / 100, i);
+    fclose(fp);
+
+    return 0;
+}
+
+static int playlist_load (void *args, int64_t iters, BenchCounters *counters)
+{
+    PlaylistArgs *pa = (PlaylistArgs *)args;
+    FILE *        fp;
+    long          size;
+
+    fp = fopen(pa->path.c_str(), "rb");
+    if (!fp)
+        return KERROR(KEINVAL);
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fclose(fp);
+
+    for (int64_t i = 0; i < iters; i++) {
+        IniFile loader;
+        int     ret;
+        if (RET_OK != loader.load(pa->path))
+            return KERROR(KEINVAL);
+        if (!pa->lookup)
+            continue;
+        for (int j = 0; j < pa->len; j++) {
+            if (loader.getStringValue("PLAY_LIST", "URL" + std::to_string(j), ret).empty())
+                return KERROR(KEINVAL);
+        }
+    }
+    counters->items = iters * pa->len;
+    counters->bytes = iters * size;
+
+    return 0;
+}
+
+/* a playlist store of the same items */
+static int make_store (const std::string &path, int len)
+{
+    PlaylistStore store;
+    char          url[256];
+    int           ret;
+
+    remove(path.c_str());
+    ret = store.open(path);
+    if (ret < 0)
+        return ret;
+    store.set_history("/home/user/Videos/clip_0.mkv");
+    for (int i = 0; i < len; i++) {
+        snprintf(url, sizeof(url), "/home/user/Videos/library/season_%02d/episode_%05d_1080p_h264_aac.mkv",
+                 i / 100, i);
+        ret = store.add(url);
+        if (ret < 0)
+            return ret;
+    }
+    store.close();
+
+    return 0;
+}
+
+static int store_load (void *args, int64_t iters, BenchCounters *counters)
+{
+    PlaylistArgs *           pa = (PlaylistArgs *)args;
+    std::vector<std::string> urls;
+    FILE *                   fp;
+    long                     size;
+
+    fp = fopen(pa->path.c_str(), "rb");
+    if (!fp)
+        return KERROR(KEINVAL);
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fclose(fp);
+
+    for (int64_t i = 0; i < iters; i++) {
+        PlaylistStore store;
+        if (store.open(pa->path) < 0)
+            return KERROR(KEINVAL);
+        store.get_urls(urls);
+        if ((int)urls.size() != pa->len)
+            return KERROR(KEINVAL);
+        store.close();
+    }
+    counters->items = iters * pa->len;
+    counters->bytes = iters * size;
+
+    return 0;
+}
+
+/* an extended m3u as written by the schedulers */
+static int make_m3u (const std::string &path, int len)
+{
+    FILE *fp = fopen(path.c_str(), "wb");
+
+    if (!fp)
+        return KERROR(KEINVAL);
+    fprintf(fp, "#EXTM3U\r\n");
+    for (int i = 0; i < len; i++)
+        fprintf(fp, "#EXTINF:%d,Episode %05d\r\nlibrary/season_%02d/episode_%05d_1080p_h264_aac.mkv\r\n",
+                1200 + i % 600, i, i / 100, i);
+    fclose(fp);
+
+    return 0;
+}
+
+static int m3u_import (void *args, int64_t iters, BenchCounters *counters)
+{
+    PlaylistArgs *           pa = (PlaylistArgs *)args;
+    std::vector<ImportEntry> entries;
+    int64_t                  size = 0;
+    int                      n;
+
+    for (int64_t i = 0; i < iters; i++) {
+        PlaylistImport pl;
+        if (pl.open(pa->path) < 0)
+            return KERROR(KEINVAL);
+        n = 0;
+        do {
+            entries.clear();
+            if (pl.read(entries, PLIMPORT_BATCH) < 0)
+                return KERROR(KEINVAL);
+            for (size_t j = 0; j < entries.size(); j++)
+                size += entries[j].url.size;
+            n += (int)entries.size();
+        } while (!entries.empty());
+        if (n != pa->len)
+            return KERROR(KEINVAL);
+    }
+    counters->items = iters * pa->len;
+    counters->bytes = size;
+
+    return 0;
+}
+
+static int log_write (void *args, int64_t iters, BenchCounters *counters)
+{
+    LogArgs *la = (LogArgs *)args;
+
+    if (la->enabled)
+        logger.en_info();
+    else
+        logger.dis_info();
+    for (int64_t i = 0; i < iters; i++)
+        logger.info("Frame %lld presented, pts %.3lf, A-V %.3lfms.\n", (long long)i, i * 0.04, 1.5);
+    logger.en_info();
+    counters->items = iters;
+
+    return 0;
+}
+
+static int check_hover (int64_t start)
+{
+    int64_t elapsed = av_gettime_relative() - start;
+
+    if (elapsed > THUMB_HOVER_BUDGET * 1000) {
+        fprintf(stderr, "A hover took %.1lfms, over the budget of %dms.\n", elapsed / 1000.0, THUMB_HOVER_BUDGET);
+        return KERROR(KETIMEDOUT);
+    }
+
+    return 0;
+}
+
+/* the hover of a position seen before, the thumbnail of the cache */
+static int thumb_cached (void *args, int64_t iters, BenchCounters *counters)
+{
+    ThumbArgs *ta = (ThumbArgs *)args;
+    double     pos = ta->duration / 2;
+    QImage     image;
+    int64_t    start;
+    int        ret;
+
+    /* the first hover decodes it */
+    if (!ta->engine->get(pos, &image) && SDL_SemWaitTimeout(ta->ready, THUMB_WAIT_TIMEOUT))
+        return KERROR(KETIMEDOUT);
+
+    for (int64_t i = 0; i < iters; i++) {
+        start = av_gettime_relative();
+        if (!ta->engine->get(pos, &image))
+            return KERROR(KEINVAL);
+        ret = check_hover(start);
+        if (ret < 0)
+            return ret;
+    }
+    counters->items = iters;
+    counters->bytes = iters * image.byteCount();
+
+    return 0;
+}
+
+/*
+* the hover of a position not cached, until thumb_ready(),
+* the cache holds one thumbnail and the keyframes hovered in turn differ,
+* the strip filled meanwhile is the load of the real hover
+*/
+static int thumb_keyframe (void *args, int64_t iters, BenchCounters *counters)
+{
+    ThumbArgs *ta = (ThumbArgs *)args;
+    int        nb_keys = (int)ta->duration - 1;
+    QImage     image;
+    int64_t    start;
+    int        ret;
+
+    for (int64_t i = 0; i < iters; i++) {
+        start = av_gettime_relative();
+        if (!ta->engine->get(i % nb_keys + 0.5, &image) && SDL_SemWaitTimeout(ta->ready, THUMB_WAIT_TIMEOUT))
+            return KERROR(KETIMEDOUT);
+        ret = check_hover(start);
+        if (ret < 0)
+            return ret;
+    }
+    counters->items = iters;
+
+    return 0;
+}
+
+static void usage ()
+{
+    fprintf(stderr,
+            "usage: kavmicro [options]\n"
+            "  -filter str     run the benchmarks with str in the name\n"
+            "  -min_time sec   min time of a benchmark (default %.1lf)\n"
+            "  -json file      write the results as JSON, - for stdout\n"
+            "  -list           print the benchmark names\n",
+            BENCH_DEF_MIN_TIME);
+}
+
+#undef main
+int main (int argc, char *argv[])
+{
+    Bench       bench;
+    const char *json = NULL;
+    bool        list = false;
+    std::string tmp_dir;
+    std::string log_path;
+    bool        log_inited = false;
+    char        name[BENCH_MAX_NAME];
+    int         failed = 0;
+
+    /* parse options */
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool        has_val = i + 1 < argc;
+
+        if (!strcmp(arg, "-filter") && has_val) {
+            bench.set_filter(argv[++i]);
+        } else if (!strcmp(arg, "-min_time") && has_val) {
+            bench.set_min_time(atof(argv[++i]));
+        } else if (!strcmp(arg, "-json") && has_val) {
+            json = argv[++i];
+        } else if (!strcmp(arg, "-list")) {
+            list = true;
+        } else {
+            usage();
+            return KEINVAL;
+        }
+    }
+    av_log_set_level(AV_LOG_ERROR);
+    tmp_dir = getenv("TMPDIR") ? getenv("TMPDIR") : getenv("TEMP") ? getenv("TEMP") : "/tmp";
+
+/* run a benchmark, or print its name with -list */
+#define RUN(proc, args)                                         \
+    do {                                                        \
+        if (list) {                                             \
+            if (bench.is_selected(name))                        \
+                printf("%s\n", name);                           \
+        } else if (bench.run(name, proc, args) < 0) {           \
+            failed++;                                           \
+        }                                                       \
+    } while (0)
+
+    /* queues */
+    static const int batches[] = {1, 64};
+    for (size_t i = 0; i < ARRAY_ELEMS(batches); i++) {
+        QueueArgs qa = {batches[i], 0};
+        snprintf(name, sizeof(name), "PacketQueue/put_get/batch:%d", batches[i]);
+        RUN(pktq_put_get, &qa);
+    }
+    snprintf(name, sizeof(name), "PacketQueue/put_get/threads:2");
+    RUN(pktq_contended, NULL);
+    static const int fq_lens[] = {1, DEF_PICTQ_LEN, MAX_PICTQ_LEN};
+    for (size_t i = 0; i < ARRAY_ELEMS(fq_lens); i++) {
+        QueueArgs qa = {0, fq_lens[i]};
+        snprintf(name, sizeof(name), "FrameQueue/put_peek_get/threads:2/len:%d", fq_lens[i]);
+        RUN(fq_contended, &qa);
+    }
+
+    /* resample from the formats of the common decoders to the formats of the device */
+    static const AVSampleFormat src_fmts[] = {
+        AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_S16P, AV_SAMPLE_FMT_S32,
+        AV_SAMPLE_FMT_S32P, AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_DBLP
+    };
+    static const AVSampleFormat tgt_fmts[] = {AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_FLT};
+    for (size_t i = 0; i < ARRAY_ELEMS(src_fmts); i++) {
+        for (size_t j = 0; j < ARRAY_ELEMS(tgt_fmts); j++) {
+            ResampleArgs ra = {src_fmts[i], 48000, tgt_fmts[j], 48000};
+            snprintf(name, sizeof(name), "Render/resample/%s_to_%s",
+                     av_get_sample_fmt_name(src_fmts[i]), av_get_sample_fmt_name(tgt_fmts[j]));
+            RUN(resample, &ra);
+        }
+    }
+    ResampleArgs ra = {AV_SAMPLE_FMT_FLTP, 44100, AV_SAMPLE_FMT_S16, 48000};
+    snprintf(name, sizeof(name), "Render/resample/fltp_44100_to_s16_48000");
+    RUN(resample, &ra);
+
+    /* upload the pixel formats of the texture format map */
+    static const AVPixelFormat pix_fmts[] = {
+        AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUYV422, AV_PIX_FMT_UYVY422,
+        AV_PIX_FMT_RGB24, AV_PIX_FMT_BGR24, AV_PIX_FMT_RGB32, AV_PIX_FMT_RGB565
+    };
+    static const int sizes[][2] = {{1280, 720}, {1920, 1080}, {3840, 2160}};
+    for (size_t i = 0; i < ARRAY_ELEMS(pix_fmts); i++) {
+        for (size_t j = 0; j < ARRAY_ELEMS(sizes); j++) {
+            UploadArgs ua = {pix_fmts[i], sizes[j][0], sizes[j][1]};
+            snprintf(name, sizeof(name), "Render/render_video_image/%s/%dx%d",
+                     av_get_pix_fmt_name(pix_fmts[i]), sizes[j][0], sizes[j][1]);
+            RUN(upload, &ua);
+        }
+    }
+
+    /* playlist files */
+    static const int playlist_lens[] = {100, 1000, 10000};
+    for (size_t i = 0; i < ARRAY_ELEMS(playlist_lens); i++) {
+        for (int lookup = 0; lookup < 2; lookup++) {
+            PlaylistArgs pa;
+            pa.path = tmp_dir + "/kavmicro_" + std::to_string(playlist_lens[i]) + ".pl";
+            pa.len = playlist_lens[i];
+            pa.lookup = lookup;
+            snprintf(name, sizeof(name), "IniFile/%s/items:%d", lookup ? "load_lookup" : "load", pa.len);
+            if (!list && bench.is_selected(name) && make_playlist(pa.path, pa.len) < 0) {
+                fprintf(stderr, "Failed to write %s.\n", pa.path.c_str());
+                failed++;
+                continue;
+            }
+            RUN(playlist_load, &pa);
+            remove(pa.path.c_str());
+        }
+    }
+    static const int store_lens[] = {100, 1000, 10000, 50000};
+    for (size_t i = 0; i < ARRAY_ELEMS(store_lens); i++) {
+        PlaylistArgs pa;
+        pa.path = tmp_dir + "/kavmicro_" + std::to_string(store_lens[i]) + ".kpl";
+        pa.len = store_lens[i];
+        pa.lookup = true;
+        snprintf(name, sizeof(name), "PlaylistStore/load/items:%d", pa.len);
+        if (!list && bench.is_selected(name) && make_store(pa.path, pa.len) < 0) {
+            fprintf(stderr, "Failed to write %s.\n", pa.path.c_str());
+            failed++;
+            continue;
+        }
+        RUN(store_load, &pa);
+        remove(pa.path.c_str());
+    }
+    static const int m3u_lens[] = {1000, 100000};
+    for (size_t i = 0; i < ARRAY_ELEMS(m3u_lens); i++) {
+        PlaylistArgs pa;
+        pa.path = tmp_dir + "/kavmicro_" + std::to_string(m3u_lens[i]) + ".m3u8";
+        pa.len = m3u_lens[i];
+        pa.lookup = false;
+        snprintf(name, sizeof(name), "PlaylistImport/m3u/items:%d", pa.len);
+        if (!list && bench.is_selected(name) && make_m3u(pa.path, pa.len) < 0) {
+            fprintf(stderr, "Failed to write %s.\n", pa.path.c_str());
+            failed++;
+            continue;
+        }
+        RUN(m3u_import, &pa);
+        remove(pa.path.c_str());
+    }
+
+    /* thumbnails of the progress bar */
+    static const int thumb_sizes[][2] = {{854, 480}, {1920, 1080}};
+    for (size_t i = 0; i < ARRAY_ELEMS(thumb_sizes); i++) {
+        ThumbEngine engine;
+        SynthParams params;
+        ThumbArgs   ta;
+        std::string path = tmp_dir + "/kavmicro_thumb_" + std::to_string(thumb_sizes[i][1]) + "p.mkv";
+        char        cached[BENCH_MAX_NAME];
+        char        keyframe[BENCH_MAX_NAME];
+
+        snprintf(cached, sizeof(cached), "ThumbEngine/get/cached/%dp", thumb_sizes[i][1]);
+        snprintf(keyframe, sizeof(keyframe), "ThumbEngine/get/keyframe/%dp", thumb_sizes[i][1]);
+        if (list || (!bench.is_selected(cached) && !bench.is_selected(keyframe))) {
+            snprintf(name, sizeof(name), "%s", cached);
+            RUN(thumb_cached, NULL);
+            snprintf(name, sizeof(name), "%s", keyframe);
+            RUN(thumb_keyframe, NULL);
+            continue;
+        }
+
+        /* a clip of the default codec, a keyframe every second */
+        synth_default_params(&params);
+        params.acodec = NULL;
+        params.width = thumb_sizes[i][0];
+        params.height = thumb_sizes[i][1];
+        ta.engine = &engine;
+        ta.duration = params.duration;
+        ta.ready = SDL_CreateSemaphore(0);
+        if (!ta.ready || synth_generate(&params, path.c_str()) < 0 || engine.init() < 0) {
+            fprintf(stderr, "Failed to prepare %s.\n", path.c_str());
+            failed++;
+            if (ta.ready)
+                SDL_DestroySemaphore(ta.ready);
+            remove(path.c_str());
+            continue;
+        }
+        QObject::connect(&engine, &ThumbEngine::thumb_ready, [&ta] (double, const QImage &) { SDL_SemPost(ta.ready); });
+        engine.open(path.c_str());
+        snprintf(name, sizeof(name), "%s", cached);
+        RUN(thumb_cached, &ta);
+        engine.set_cache_len(1);
+        snprintf(name, sizeof(name), "%s", keyframe);
+        RUN(thumb_keyframe, &ta);
+        engine.close();
+        SDL_DestroySemaphore(ta.ready);
+        remove(path.c_str());
+    }
+
+    /* logger */
+    log_path = tmp_dir + "/kavmicro.log";
+    if (!list && (bench.is_selected("Logger/info/enabled") || bench.is_selected("Logger/info/disabled"))) {
+        if (logger.init(log_path.c_str()) < 0) {
+            fprintf(stderr, "Failed to open %s.\n", log_path.c_str());
+            return KELOG_FILE_OPEN_FAIL;
+        }
+        logger.dis_debug();
+        log_inited = true;
+    }
+    for (int enabled = 1; enabled >= 0; enabled--) {
+        LogArgs la = {enabled != 0};
+        snprintf(name, sizeof(name), "Logger/info/%s", enabled ? "enabled" : "disabled");
+        RUN(log_write, &la);
+    }
+#undef RUN
+    if (list)
+        return 0;
+
+    /* report */
+    if (!json) {
+        bench.print_text(stdout);
+    } else if (!strcmp(json, "-")) {
+        bench.print_json(stdout);
+    } else {
+        FILE *fp = fopen(json, "w");
+        if (!fp) {
+            fprintf(stderr, "Failed to write %s.\n", json);
+            return KEINVAL;
+        }
+        bench.print_json(fp);
+        fclose(fp);
+    }
+    if (log_inited) {
+        logger.close();
+        remove(log_path.c_str());
+    }
+
+    return failed ? KEINVAL : 0;
+}
@@ -0,0 +1,233 @@
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include "trace.h"
+#include "error/error.h"
+
+extern "C"
+{
+#include "libavutil/time.h"
+}
+
+#define FILENAME "trace.cpp"
+
+/* the spans being written while dumping are skipped, a writer moves on so much at most */
+#define TRACE_DUMP_MARGIN   256
+
+/* names of the threads, set before a span may be recorded */
+#define TRACE_MAX_THREADS   128
+
+/* rings allocated by trace_enable() besides one per named thread, for the threads of SDL and others */
+#define TRACE_SPARE_RINGS   4
+
+typedef struct TraceThreadName {
+    SDL_threadID     tid;
+    char             name[TRACE_MAX_NAME];
+}TraceThreadName;
+
+SDL_atomic_t        trace_on;
+static SDL_SpinLock trace_lock = 0;
+static SDL_TLSID    trace_tls = 0;
+static TraceRing *  trace_rings = NULL; // never freed, a span may be written at any time
+static TraceRing *  trace_spares = NULL; // allocated by trace_enable(), taken by the first span of a thread
+static int          nb_trace_rings = 0; // in both lists
+static int64_t      trace_start = 0;    // the spans before it are not dumped
+static TraceThreadName trace_names[TRACE_MAX_THREADS];
+static int          nb_trace_names = 0;
+
+static TraceRing *get_ring ()
+{
+    TraceRing *r;
+
+    r = (TraceRing *)SDL_TLSGet(trace_tls);
+    if (r)
+        return r;
+
+    /* first span of the thread, a spare is taken, nothing is allocated on the audio callback */
+    SDL_AtomicLock(&trace_lock);
+    r = trace_spares;
+    if (!r) { // the span is dropped
+        SDL_AtomicUnlock(&trace_lock);
+        return NULL;
+    }
+    trace_spares = r->next;
+    r->tid = SDL_ThreadID();
+    snprintf(r->name, TRACE_MAX_NAME, "thread %lu", (unsigned long)r->tid);
+    for (int i = 0; i < nb_trace_names; i++) {
+        if (trace_names[i].tid == r->tid)
+            strcpy(r->name, trace_names[i].name);
+    }
+    r->next = trace_rings;
+    trace_rings = r;
+    SDL_AtomicUnlock(&trace_lock);
+    SDL_TLSSet(trace_tls, r, NULL);
+
+    return r;
+}
+
+/* a spare for each named thread and a few more, called with trace_lock held */
+static void alloc_spares ()
+{
+    int nb_spares = 0;
+    int nb_used = 0;
+
+    for (TraceRing *r = trace_spares; r; r = r->next)
+        nb_spares++;
+    nb_used = nb_trace_rings - nb_spares;
+    while (nb_trace_rings < TRACE_MAX_THREADS
+           && nb_spares < nb_trace_names - nb_used + TRACE_SPARE_RINGS) {
+        TraceRing *r = _New TraceRing;
+        if (!r)
+            break;
+        SDL_AtomicSet(&r->pos, 0);
+        r->next = trace_spares;
+        trace_spares = r;
+        nb_spares++;
+        nb_trace_rings++;
+    }
+}
+
+void trace_enable (bool enable)
+{
+    SDL_AtomicLock(&trace_lock);
+    if (!trace_tls) // SDL never frees a TLS id
+        trace_tls = SDL_TLSCreate();
+    if (enable && !trace_start)
+        trace_start = av_gettime_relative();
+    if (enable)
+        alloc_spares();
+    SDL_AtomicUnlock(&trace_lock);
+    SDL_AtomicSet(&trace_on, enable && trace_tls ? 1 : 0);
+}
+
+bool trace_is_enabled ()
+{
+    return SDL_AtomicGet(&trace_on) != 0;
+}
+
+void trace_set_thread_name (const char *name)
+{
+    SDL_threadID tid = SDL_ThreadID();
+    int          i;
+
+    if (!name)
+        return;
+
+    /* the ring is taken from the spares by the first span of the thread */
+    SDL_AtomicLock(&trace_lock);
+    for (i = 0; i < nb_trace_names && trace_names[i].tid != tid; i++)
+        ;
+    if (i < TRACE_MAX_THREADS) {
+        trace_names[i].tid = tid;
+        snprintf(trace_names[i].name, TRACE_MAX_NAME, "%s", name);
+        if (i == nb_trace_names)
+            nb_trace_names++;
+    }
+    for (TraceRing *r = trace_rings; r; r = r->next) {
+        if (r->tid == tid)
+            snprintf(r->name, TRACE_MAX_NAME, "%s", name);
+    }
+
+    /* a thread started while tracing gets its ring here, not at its first span */
+    if (SDL_AtomicGet(&trace_on))
+        alloc_spares();
+    SDL_AtomicUnlock(&trace_lock);
+}
+
+void trace_reset ()
+{
+    /* the rings belong to their threads, the spans recorded are hidden by moving the start instead */
+    SDL_AtomicLock(&trace_lock);
+    trace_start = av_gettime_relative();
+    SDL_AtomicUnlock(&trace_lock);
+}
+
+int64_t trace_now ()
+{
+    return av_gettime_relative();
+}
+
+int64_t trace_begin ()
+{
+    return SDL_AtomicGet(&trace_on) ? av_gettime_relative() : -1;
+}
+
+void trace_end (const char *name, int64_t begin)
+{
+    TraceRing *r;
+    int        pos;
+
+    if (begin < 0)
+        return;
+    r = get_ring();
+    if (!r)
+        return;
+
+    /* the span is complete before it is counted */
+    pos = SDL_AtomicGet(&r->pos);
+    TraceEvent *e = &r->events[pos & (TRACE_RING_SIZE - 1)];
+    e->name = name;
+    e->begin = begin;
+    e->dur = av_gettime_relative() - begin;
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&r->pos, pos + 1);
+}
+
+static void write_string (FILE *fp, const char *s)
+{
+    fputc('"', fp);
+    for (; *s; s++) {
+        if ('"' == *s || '\\' == *s)
+            fputc('\\', fp);
+        if ((unsigned char)*s >= 0x20)
+            fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
+
+int trace_dump (const char *file_name)
+{
+    FILE *     fp;
+    TraceRing *rings;
+    int64_t    start_time;
+    bool       first = true;
+
+    if (!file_name)
+        return KERROR(KEINVAL);
+    fp = fopen(file_name, "w");
+    if (!fp)
+        return KERROR(KETRACE_FILE_WRITE_FAIL);
+
+    SDL_AtomicLock(&trace_lock);
+    rings = trace_rings;
+    start_time = trace_start;
+    SDL_AtomicUnlock(&trace_lock);
+
+    /* Chrome trace event format, complete events on a timeline starting at 0 */
+    fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    for (TraceRing *r = rings; r; r = r->next) {
+        int end = SDL_AtomicGet(&r->pos);
+        int start = end > TRACE_RING_SIZE - TRACE_DUMP_MARGIN ? end - (TRACE_RING_SIZE - TRACE_DUMP_MARGIN) : 0;
+
+        SDL_MemoryBarrierAcquire();
+        fprintf(fp, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %lu, \"args\": {\"name\": ",
+                first ? "" : ",\n", (unsigned long)r->tid);
+        write_string(fp, r->name);
+        fprintf(fp, "}}");
+        first = false;
+        for (int i = start; i < end; i++) {
+            TraceEvent *e = &r->events[i & (TRACE_RING_SIZE - 1)];
+            if (e->begin < start_time)
+                continue;
+            fprintf(fp, ",\n{\"name\": ");
+            write_string(fp, e->name ? e->name : "?");
+            fprintf(fp, ", \"cat\": \"kav\", \"ph\": \"X\", \"pid\": 1, \"tid\": %lu, \"ts\": %lld, \"dur\": %lld}",
+                    (unsigned long)r->tid, (long long)(e->begin - start_time), (long long)e->dur);
+        }
+    }
+    fprintf(fp, "\n]}\n");
+    if (fclose(fp))
+        return KERROR(KETRACE_FILE_WRITE_FAIL);
+
+    return 0;
+}
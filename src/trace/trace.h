@@ -0,0 +1,66 @@
+#ifndef _AVPLAYERWIDGET_TRACE_H_
+#define _AVPLAYERWIDGET_TRACE_H_
+
+#include <cstdint>
+#include "avplayerwidget_global.h"
+
+extern "C"
+{
+#include "SDL2/SDL.h"
+}
+
+/* spans kept per thread, the oldest are overwritten, a power of 2 */
+#define TRACE_RING_SIZE     16384
+#define TRACE_MAX_NAME      32
+
+/* a span of a thread, the name is a static string */
+typedef struct TraceEvent {
+    const char *     name;
+    int64_t          begin;    // unit: microsecond
+    int64_t          dur;      // unit: microsecond
+}TraceEvent;
+
+/* spans of a thread, written by the thread only, kept after it exits, allocated by trace_enable() */
+typedef struct TraceRing {
+    SDL_threadID     tid;
+    char             name[TRACE_MAX_NAME];
+    SDL_atomic_t     pos;      // spans written
+    TraceEvent       events[TRACE_RING_SIZE];
+    TraceRing *      next;
+}TraceRing;
+
+extern SDL_atomic_t  trace_on;
+
+/*
+* pipeline tracing,
+* the spans go to a ring of the thread and are dumped as a Chrome trace (chrome://tracing, Perfetto),
+* a disabled span costs an atomic load,
+* the rings are allocated when enabled, a thread finding no spare ring records nothing
+*/
+AVPLAYERWIDGET_EXPORT void    trace_enable          (bool enable);
+AVPLAYERWIDGET_EXPORT bool    trace_is_enabled      ();
+void                          trace_set_thread_name (const char *name); // shown for the spans of the current thread, cheap before enabled
+AVPLAYERWIDGET_EXPORT void    trace_reset           ();                 // drops the spans recorded, safe while recording
+AVPLAYERWIDGET_EXPORT int     trace_dump            (const char *file_name);
+int64_t trace_now             ();
+
+/* a span around a call, trace_end() does nothing if trace_begin() returned -1 */
+int64_t trace_begin           ();
+void    trace_end             (const char *name, int64_t begin);
+
+/* a span over a scope */
+class TraceSpan {
+private:
+    const char *     name;
+    int64_t          begin;
+
+public:
+    TraceSpan        (const char *name) : name(name), begin(trace_begin()) {}
+    ~TraceSpan       () { trace_end(name, begin); }
+};
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b)  TRACE_CONCAT2(a, b)
+#define TRACE_SCOPE(name)   TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name)
+
+#endif /* _AVPLAYERWIDGET_TRACE_H_ */
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <string>
+#include "trace.h"
+#include "error/error.h"
+#include "testutil/testutil.h"
+
+#define TEST_TRACE "trace_test.json"
+
+static int count (const std::string &s, const char *what)
+{
+    int    n = 0;
+    size_t pos = 0;
+
+    while ((pos = s.find(what, pos)) != std::string::npos) {
+        n++;
+        pos++;
+    }
+
+    return n;
+}
+
+static int span_proc (void *args)
+{
+    (void)args;
+    trace_set_thread_name("span thread");
+    for (int i = 0; i < 100; i++) {
+        TRACE_SCOPE("outer");
+        int64_t span = trace_begin();
+        trace_end("inner", span);
+    }
+
+    return 0;
+}
+
+TEST(trace_test, disabled)
+{
+    std::string s;
+
+    trace_enable(false);
+    trace_reset();
+    EXPECT_EQ(-1, trace_begin());
+    {
+        TRACE_SCOPE("not recorded");
+    }
+    ASSERT_EQ(0, trace_dump(TEST_TRACE));
+    s = read_file(TEST_TRACE);
+    EXPECT_EQ(std::string::npos, s.find("not recorded"));
+    EXPECT_EQ(0u, s.find("{\"displayTimeUnit\": \"ms\", \"traceEvents\": ["));
+    remove(TEST_TRACE);
+}
+
+TEST(trace_test, threads)
+{
+    SDL_Thread *threads[2];
+    std::string s;
+
+    trace_reset();
+    trace_enable(true);
+    EXPECT_TRUE(trace_is_enabled());
+    for (int i = 0; i < 2; i++)
+        threads[i] = SDL_CreateThread(span_proc, "span", NULL);
+    for (int i = 0; i < 2; i++)
+        SDL_WaitThread(threads[i], NULL);
+    trace_enable(false);
+
+    /* complete events of both threads, named */
+    ASSERT_EQ(0, trace_dump(TEST_TRACE));
+    s = read_file(TEST_TRACE);
+    EXPECT_EQ(200, count(s, "{\"name\": \"outer\", \"cat\": \"kav\", \"ph\": \"X\""));
+    EXPECT_EQ(200, count(s, "{\"name\": \"inner\""));
+    EXPECT_EQ(2, count(s, "\"args\": {\"name\": \"span thread\"}"));
+    EXPECT_EQ(s.size() - 4, s.rfind("\n]}\n"));
+
+    /* dropped by reset */
+    trace_reset();
+    ASSERT_EQ(0, trace_dump(TEST_TRACE));
+    EXPECT_EQ(0, count(read_file(TEST_TRACE), "\"outer\""));
+    remove(TEST_TRACE);
+}
+
+TEST(trace_test, wrap)
+{
+    std::string s;
+
+    /* only the newest spans are kept */
+    trace_reset();
+    trace_enable(true);
+    for (int i = 0; i < TRACE_RING_SIZE * 2; i++) {
+        int64_t span = trace_begin();
+        trace_end("wrap", span);
+    }
+    trace_enable(false);
+    ASSERT_EQ(0, trace_dump(TEST_TRACE));
+    s = read_file(TEST_TRACE);
+    EXPECT_GE(TRACE_RING_SIZE, count(s, "\"wrap\""));
+    EXPECT_LT(TRACE_RING_SIZE / 2, count(s, "\"wrap\""));
+    remove(TEST_TRACE);
+
+    EXPECT_EQ(KERROR(KETRACE_FILE_WRITE_FAIL), trace_dump("/nonexistent/dir/trace.json"));
+}
@@ -1,7 +1,17 @@
+#include <cstring>
 #include "utils.h"
 
 #ifdef _WIN32
 #include <Windows.h>
+#include <psapi.h>
+#include <io.h>
+#else
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 void init_dynload()
@@ -12,3 +22,186 @@ void init_dynload()
     SetDllDirectory(TEXT(""));
 #endif
 }
+
+double get_cpu_time ()
+{
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+        return 0.0;
+
+    /* 100-nanosecond intervals */
+    return ((((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime)
+            + (((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime)) / 1e7;
+#else
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) < 0)
+        return 0.0;
+
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+           + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+#endif
+}
+
+int64_t get_peak_rss ()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+
+    return (int64_t)counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) < 0)
+        return 0;
+
+#if defined(__APPLE__)
+    return (int64_t)usage.ru_maxrss;        // bytes
+#else
+    return (int64_t)usage.ru_maxrss * 1024; // kilobytes
+#endif
+#endif
+}
+
+int file_sync (FILE *fp)
+{
+    if (fflush(fp))
+        return -1;
+#ifdef _WIN32
+    return _commit(_fileno(fp));
+#else
+    return fsync(fileno(fp));
+#endif
+}
+
+int file_replace (const char *from, const char *to)
+{
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) ? 0 : -1;
+#else
+    return rename(from, to);
+#endif
+}
+
+int file_copy (const char *from, const char *to)
+{
+#ifdef _WIN32
+    return CopyFileA(from, to, FALSE) ? 0 : -1;
+#else
+    FILE * in;
+    FILE * out;
+    char   buf[65536];
+    size_t n;
+    int    ret = 0;
+
+    in = fopen(from, "rb");
+    if (!in)
+        return -1;
+    out = fopen(to, "wb");
+    if (!out) {
+        fclose(in);
+        return -1;
+    }
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        if (n != fwrite(buf, 1, n, out)) {
+            ret = -1;
+            break;
+        }
+    }
+    if (ferror(in))
+        ret = -1;
+    fclose(in);
+    if (file_sync(out))
+        ret = -1;
+    if (fclose(out))
+        ret = -1;
+
+    return ret;
+#endif
+}
+
+int file_truncate (FILE *fp, int64_t size)
+{
+    fflush(fp);
+#ifdef _WIN32
+    return _chsize_s(_fileno(fp), size) ? -1 : 0;
+#else
+    return ftruncate(fileno(fp), (off_t)size);
+#endif
+}
+
+int file_map (const char *path, MappedFile *m)
+{
+    memset(m, 0, sizeof(MappedFile));
+#ifdef _WIN32
+    LARGE_INTEGER size;
+    HANDLE        file;
+    HANDLE        mapping;
+
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (INVALID_HANDLE_VALUE == file)
+        return -1;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return -1;
+    }
+    m->file = file;
+    m->size = size.QuadPart;
+    if (!m->size)
+        return 0;
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping)
+        m->data = (const uint8_t *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!m->data) {
+        if (mapping)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        memset(m, 0, sizeof(MappedFile));
+        return -1;
+    }
+    m->mapping = mapping;
+#else
+    struct stat st;
+    void *      data;
+
+    m->fd = open(path, O_RDONLY);
+    if (m->fd < 0)
+        return -1;
+    if (fstat(m->fd, &st) < 0) {
+        close(m->fd);
+        return -1;
+    }
+    m->size = st.st_size;
+    if (!m->size)
+        return 0;
+    data = mmap(NULL, m->size, PROT_READ, MAP_PRIVATE, m->fd, 0);
+    if (MAP_FAILED == data) {
+        close(m->fd);
+        return -1;
+    }
+    m->data = (const uint8_t *)data;
+#endif
+
+    return 0;
+}
+
+void file_unmap (MappedFile *m)
+{
+#ifdef _WIN32
+    if (m->data)
+        UnmapViewOfFile(m->data);
+    if (m->mapping)
+        CloseHandle((HANDLE)m->mapping);
+    CloseHandle((HANDLE)m->file);
+#else
+    if (m->data)
+        munmap((void *)m->data, m->size);
+    close(m->fd);
+#endif
+    memset(m, 0, sizeof(MappedFile));
+}
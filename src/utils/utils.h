@@ -1,6 +1,9 @@
 #ifndef _AVPLAYERWIDGET_CMDUTILS_H_
 #define _AVPLAYERWIDGET_CMDUTILS_H_
 
+#include <cstdio>
+#include <cstdint>
+
 #ifdef max
 #undef max
 #endif
@@ -12,4 +15,29 @@
 
 void init_dynload();
 
+/* resource usage of the process */
+double  get_cpu_time  (); // user and system time (unit: second)
+int64_t get_peak_rss  (); // peak resident set size, 0 if unknown (unit: byte)
+
+/* files written beside and renamed over the old ones, a crash leaves one of them whole */
+int     file_sync     (FILE *fp); // flushes the stream to the disk
+int     file_replace  (const char *from, const char *to);
+int     file_copy     (const char *from, const char *to);
+int     file_truncate (FILE *fp, int64_t size); // cuts the file of the stream at size
+
+/* a file mapped for reading */
+typedef struct MappedFile {
+    const uint8_t * data;    // NULL if the file is empty
+    int64_t         size;
+#ifdef _WIN32
+    void *          file;    // HANDLE
+    void *          mapping;
+#else
+    int             fd;
+#endif
+}MappedFile;
+
+int     file_map      (const char *path, MappedFile *m);
+void    file_unmap    (MappedFile *m);
+
 #endif /* _AVPLAYERWIDGET_CMDUTILS_H_ */
@@ -3,6 +3,8 @@
 #include "vdev.h"
 #include "error/error.h"
 #include "log/log.h"
+#include "trace/trace.h"
+#include "lock/lock.h"
 
 extern "C" {
 #include "libavformat/avformat.h"
@@ -74,7 +76,7 @@ err:
     SDL_RenderPresent(renderer);
 
     /* create video device locker */
-    vdev_locker = SDL_CreateMutex();
+    vdev_locker = mutex_create("vdev_locker");
     if (!vdev_locker) {
         logger.fatal("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_MUTEX_FAIL), SDL_GetError());
         return KERROR(KECREATE_SDL_MUTEX_FAIL);
@@ -84,7 +86,7 @@ err:
     /* reset fps */
     fps = _fps = 0;
 
-    logger.debug("Vdev has been inited.\n");
+    KLOGD("Vdev has been inited.\n");
     return 0;
 }
 
@@ -96,16 +98,16 @@ void Vdev::close ()
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     if (locked)
-        SDL_UnlockMutex(vdev_locker);
+        mutex_unlock(vdev_locker);
     locked = false;
-    SDL_DestroyMutex(vdev_locker);
+    mutex_destroy(vdev_locker);
     parent = NULL;
     renderer = NULL;
     window = NULL;
     vdev_locker = NULL;
     fps = _fps = 0;
 
-    logger.debug("Vdev closed.\n");
+    KLOGD("Vdev closed.\n");
 }
 
 int Vdev::lock ()
@@ -113,7 +115,7 @@ int Vdev::lock ()
     if (!vdev_locker)
         return KERROR(KEUNINITED);
 
-    SDL_LockMutex(vdev_locker);
+    mutex_lock(vdev_locker);
     locked = true;
 
     /* clear renderer */  
@@ -131,7 +133,11 @@ int Vdev::unlock ()
         return KERROR(KEUNINITED);
 
     /* present */
+    int64_t span = trace_begin();
+    int64_t begin = av_gettime_relative();
     SDL_RenderPresent(renderer);
+    stage_stats_add(&stats, 1, 0, av_gettime_relative() - begin);
+    trace_end("present", span);
 
     /* compute fps */
     cur_time = av_gettime();
@@ -142,7 +148,7 @@ int Vdev::unlock ()
         _fps = 0;
     }
 
-    SDL_UnlockMutex(vdev_locker);
+    mutex_unlock(vdev_locker);
     locked = false;
 
     return 0;
@@ -167,7 +173,7 @@ int Vdev::upload_texture (SDL_Texture * texture, SDL_Rect rect)
 
 void Vdev::resize (int w, int h)
 {
-    SDL_LockMutex(vdev_locker);
+    mutex_lock(vdev_locker);
 
     this->w = w;
     this->h = h;
@@ -175,7 +181,7 @@ void Vdev::resize (int w, int h)
     if (window)
         SDL_SetWindowSize(window, w, h);
 
-    SDL_UnlockMutex(vdev_locker);
+    mutex_unlock(vdev_locker);
 }
 
 int Vdev::width () const
@@ -199,6 +205,11 @@ int Vdev::get_fps () const
     return vdev_locker ? fps : 0;
 }
 
+StageStats *Vdev::get_stats ()
+{
+    return &stats;
+}
+
 SDL_Renderer * Vdev::get_sdl_renderer () const
 {
     return renderer;
@@ -208,7 +219,7 @@ void Vdev::switch_fullscreen (bool fullscr)
 {
     if (!vdev_locker)
         return;
-    SDL_LockMutex(vdev_locker);
+    mutex_lock(vdev_locker);
     if (!fullscr) {
         parent->setWindowFlags(Qt::SubWindow);
         parent->showNormal();
@@ -216,7 +227,7 @@ void Vdev::switch_fullscreen (bool fullscr)
         parent->setWindowFlags(Qt::Window);
         parent->showFullScreen();
     }
-    SDL_UnlockMutex(vdev_locker);
+    mutex_unlock(vdev_locker);
 }
 
 Vdev::Vdev ()
@@ -225,6 +236,7 @@ Vdev::Vdev ()
     renderer = NULL;
     window = NULL;
     vdev_locker = NULL;
+    stage_stats_reset(&stats);
 }
 
 Vdev::~Vdev ()
@@ -2,6 +2,7 @@
 #define _AVPLAYERWIDGET_VDEV_H_
 
 #include <QWidget>
+#include "stats/stats.h"
 
 extern "C" {
 #include "libavformat/avformat.h"
@@ -34,6 +35,9 @@ private:
     int              fps;
     int              _fps;
 
+    /* statistics */
+    StageStats       stats;       // frames presented
+
 public:
     int            init              (QWidget *parent, bool hw_acce);
     void           close             ();
@@ -44,6 +48,7 @@ public:
     int            width             () const;
     int            height            () const;
     int            get_fps           () const;
+    StageStats *   get_stats         ();
     SDL_Renderer * get_sdl_renderer  () const;
     void           switch_fullscreen (bool fullscr);
 
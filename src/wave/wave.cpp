@@ -0,0 +1,356 @@
+#include <QFileInfo>
+#include <QDateTime>
+#include "wave.h"
+#include "error/error.h"
+#include "log/log.h"
+#include "lock/lock.h"
+
+#define FILENAME "wave.cpp"
+
+int WaveService::wave_proc (void *args)
+{
+    WaveService *w = (WaveService *)args;
+    std::string  url;
+    int          ret;
+
+    /* woken by open() and close() */
+    mutex_lock(w->mutex);
+    if (SDL_AtomicGet(&w->abort_req)) {
+        mutex_unlock(w->mutex);
+        w->close_file();
+        KLOGD("Waveform task stopped.\n");
+        return TASK_DONE;
+    }
+
+    /* a new file, the computation of the old one is dropped */
+    if (SDL_AtomicGet(&w->open_req)) {
+        url = w->next_url;
+        SDL_AtomicSet(&w->open_req, 0);
+        mutex_unlock(w->mutex);
+
+        w->close_file();
+        if (!url.empty())
+            w->open_file(url);
+        return TASK_AGAIN;
+    }
+    mutex_unlock(w->mutex);
+    if (!w->avfctx)
+        return TASK_WAIT;
+
+    /* the worker does nothing but this, lowered once */
+    if (!w->low_priority) {
+        SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+        w->low_priority = true;
+    }
+
+    /* a slice of packets, the requests are checked between the slices */
+    for (int i = 0; i < WAVE_TASK_SLICE; i++) {
+        ret = w->decode();
+        if (ret < 0) {
+            if (KERROR(KEABORTED) != ret)
+                logger.warning("Waveform of %s: %s.\n", w->url.c_str(), kerr2str(-ret));
+            w->close_file();
+            return TASK_AGAIN;
+        } else if (ret > 0) {
+            w->finish();
+            w->close_file();
+            return TASK_AGAIN;
+        }
+    }
+
+    return TASK_AGAIN;
+}
+
+int WaveService::interrupt_cb (void *args)
+{
+    WaveService *w = (WaveService *)args;
+
+    /* the file is replaced or the service closed */
+    return SDL_AtomicGet(&w->abort_req) || SDL_AtomicGet(&w->open_req);
+}
+
+int WaveService::open_file (const std::string &url)
+{
+    QFileInfo info(QString::fromStdString(url));
+    AVCodec * codec = NULL;
+    int64_t   in_layout;
+    int       ret;
+
+    /* the network streams would be downloaded as a whole */
+    if (std::string::npos != url.find("://") || !info.isFile())
+        return KERROR(KEINVAL);
+    size = info.size();
+    mtime = info.lastModified().toMSecsSinceEpoch() / 1000;
+
+    /* computed before */
+    if (!dir.empty() && !wave_read(dir + wave_cache_name(url), url, size, mtime, &buckets)) {
+        emit wave_ready(QString::fromStdString(url), QVector<WaveBucket>::fromStdVector(buckets));
+        return 0;
+    }
+
+    /* open input */
+    avfctx = avformat_alloc_context();
+    if (!avfctx)
+        return KERROR(KENOMEM);
+    avfctx->interrupt_callback.callback = interrupt_cb;
+    avfctx->interrupt_callback.opaque = this;
+    ret = avformat_open_input(&avfctx, url.c_str(), NULL, NULL);
+    if (ret < 0) {
+        logger.warning("%s: %s.\n", kerr2str(KEOPEN_INPUT_FAIL), av_err2str(ret));
+        GOTO_FAIL(KEOPEN_INPUT_FAIL);
+    }
+    ret = avformat_find_stream_info(avfctx, NULL);
+    if (ret < 0) {
+        logger.warning("%s: %s.\n", kerr2str(KEFIND_STREAM_INFO_FAIL), av_err2str(ret));
+        GOTO_FAIL(KEFIND_STREAM_INFO_FAIL);
+    }
+
+    /* the buckets are sized by the duration */
+    ast_idx = av_find_best_stream(avfctx, AVMEDIA_TYPE_AUDIO, -1, -1, &codec, 0);
+    if (ast_idx < 0 || !codec || AV_NOPTS_VALUE == avfctx->duration || avfctx->duration <= 0)
+        GOTO_FAIL(KENOAVST);
+    for (unsigned int i = 0; i < avfctx->nb_streams; i++)
+        if ((int)i != ast_idx)
+            avfctx->streams[i]->discard = AVDISCARD_ALL;
+
+    /* open decoder, a thread of its own is enough at low priority */
+    dec = avcodec_alloc_context3(codec);
+    if (!dec)
+        GOTO_FAIL(KENOMEM);
+    ret = avcodec_parameters_to_context(dec, avfctx->streams[ast_idx]->codecpar);
+    if (ret < 0) {
+        logger.warning("%s: %s.\n", kerr2str(KECOPY_CODEC_PARAMS_FAIL), av_err2str(ret));
+        GOTO_FAIL(KECOPY_CODEC_PARAMS_FAIL);
+    }
+    dec->thread_count = 1;
+    ret = avcodec_open2(dec, codec, NULL);
+    if (ret < 0) {
+        logger.warning("%s: %s.\n", kerr2str(KEOPEN_DECODER_FAIL), av_err2str(ret));
+        GOTO_FAIL(KEOPEN_DECODER_FAIL);
+    }
+    if (dec->sample_rate <= 0 || dec->channels <= 0)
+        GOTO_FAIL(KEWRONG_AUDIO_PARAMS);
+
+    /* downmix to mono float, the sample rate is kept */
+    in_layout = dec->channel_layout && av_get_channel_layout_nb_channels(dec->channel_layout) == dec->channels
+                ? (int64_t)dec->channel_layout : av_get_default_channel_layout(dec->channels);
+    swr = swr_alloc_set_opts(NULL, AV_CH_LAYOUT_MONO, AV_SAMPLE_FMT_FLT, dec->sample_rate,
+                             in_layout, dec->sample_fmt, dec->sample_rate, 0, NULL);
+    if (!swr || swr_init(swr) < 0)
+        GOTO_FAIL(KESWR_INIT_FAIL);
+    frame = av_frame_alloc();
+    if (!frame)
+        GOTO_FAIL(KENOMEM);
+
+    bucket_len = av_rescale(avfctx->duration, dec->sample_rate, (int64_t)AV_TIME_BASE * WAVE_BUCKETS) + 1;
+    buckets.assign(WAVE_BUCKETS, WaveBucket());
+    bucket = 0;
+    wave_accum_reset(&acc);
+    this->url = url;
+    KLOGD("Waveform of %s started, %lld samples a bucket.\n", url.c_str(), (long long)bucket_len);
+
+    return 0;
+fail:
+    close_file();
+
+    return ret;
+}
+
+void WaveService::close_file ()
+{
+    av_frame_free(&frame);
+    swr_free(&swr);
+    avcodec_free_context(&dec);
+    avformat_close_input(&avfctx);
+    ast_idx = -1;
+    url.clear();
+}
+
+int WaveService::decode ()
+{
+    AVPacket pkt;
+    int      ret;
+
+    av_init_packet(&pkt);
+    pkt.data = NULL;
+    pkt.size = 0;
+    ret = av_read_frame(avfctx, &pkt);
+    if (AVERROR_EXIT == ret)
+        return KERROR(KEABORTED);
+
+    /* drain the decoder at the end, a read error ends the stream as well */
+    if (ret < 0) {
+        avcodec_send_packet(dec, NULL);
+        ret = reduce();
+        return ret < 0 ? ret : 1;
+    }
+    if (ast_idx != pkt.stream_index) {
+        av_packet_unref(&pkt);
+        return 0;
+    }
+
+    /* a corrupt packet is a gap of the waveform only */
+    ret = avcodec_send_packet(dec, &pkt);
+    av_packet_unref(&pkt);
+    if (ret < 0 && AVERROR(EAGAIN) != ret)
+        return 0;
+
+    return reduce();
+}
+
+int WaveService::reduce ()
+{
+    float *p;
+    int    nb_samples;
+    int    len;
+    int    ret;
+
+    while (!(ret = avcodec_receive_frame(dec, frame))) {
+        /* convert */
+        nb_samples = swr_get_out_samples(swr, frame->nb_samples);
+        samples.resize(nb_samples > 0 ? nb_samples : 1);
+        p = &samples[0];
+        nb_samples = swr_convert(swr, (uint8_t **)&p, nb_samples,
+                                 (const uint8_t **)frame->extended_data, frame->nb_samples);
+        av_frame_unref(frame);
+        if (nb_samples < 0)
+            return KERROR(KESWR_CONVERT_FAIL);
+
+        /* fill the buckets in order, the samples over the duration go to the last one */
+        while (nb_samples > 0) {
+            len = bucket < WAVE_BUCKETS - 1 ? (int)FFMIN(nb_samples, bucket_len - acc.count) : nb_samples;
+            wave_reduce(p, len, &acc);
+            p += len;
+            nb_samples -= len;
+            if (bucket < WAVE_BUCKETS - 1 && acc.count >= bucket_len) {
+                buckets[bucket++] = wave_bucket(&acc);
+                wave_accum_reset(&acc);
+            }
+        }
+    }
+    if (AVERROR(EAGAIN) != ret && AVERROR_EOF != ret)
+        return KERROR(KERECEIVE_FRAME_FAIL);
+
+    return 0;
+}
+
+void WaveService::finish ()
+{
+    if (acc.count > 0)
+        buckets[bucket] = wave_bucket(&acc);
+
+    /* the waveform is shown without a cache file */
+    if (!dir.empty())
+        wave_write(dir + wave_cache_name(url), url, size, mtime, buckets);
+    emit wave_ready(QString::fromStdString(url), QVector<WaveBucket>::fromStdVector(buckets));
+
+    KLOGD("Waveform of %s finished.\n", url.c_str());
+}
+
+int WaveService::init (const char *dir)
+{
+    int ret;
+
+    if (session >= 0)
+        return KERROR(KEREINIT);
+
+    qRegisterMetaType<QVector<WaveBucket>>("QVector<WaveBucket>");
+
+    this->dir = dir ? dir : "";
+    if (!this->dir.empty() && '/' != this->dir.back() && '\\' != this->dir.back())
+        this->dir += '/';
+
+    ret = pool.init(1);
+    if (ret < 0)
+        return ret;
+    ret = pool.open_session();
+    if (ret < 0)
+        GOTO_FAIL(ret);
+    session = ret;
+
+    mutex = mutex_create("wave service");
+    if (!mutex) {
+        logger.FATALN("[%s: %d]%s: %s.\n", kerr2str(KECREATE_SDL_MUTEX_FAIL), SDL_GetError());
+        GOTO_FAIL(KECREATE_SDL_MUTEX_FAIL);
+    }
+
+    /* the task sleeps until a file is opened */
+    SDL_AtomicSet(&abort_req, 0);
+    SDL_AtomicSet(&open_req, 0);
+    task.init(wave_proc, this, "wave_task");
+    ret = pool.submit(&task, session);
+    if (ret < 0) {
+        logger.FATALN("[%s: %d]%s.\n", kerr2str(-ret));
+        goto fail;
+    }
+    KLOGD("Waveform service has been inited.\n");
+
+    return 0;
+fail:
+    close();
+
+    return ret;
+}
+
+void WaveService::close ()
+{
+    if (session < 0 && !mutex)
+        return;
+
+    /* the computation in progress is interrupted */
+    if (mutex) {
+        mutex_lock(mutex);
+        SDL_AtomicSet(&abort_req, 1);
+        mutex_unlock(mutex);
+        task.wake();
+        pool.join(&task);
+    }
+    if (session >= 0)
+        pool.close_session(session);
+    pool.close();
+    session = -1;
+    close_file();
+    if (mutex) {
+        mutex_destroy(mutex);
+        mutex = NULL;
+    }
+
+    KLOGD("Waveform service closed.\n");
+}
+
+void WaveService::open (const char *url)
+{
+    if (!mutex)
+        return;
+
+    mutex_lock(mutex);
+    next_url = url ? url : "";
+    SDL_AtomicSet(&open_req, 1);
+    mutex_unlock(mutex);
+    task.wake();
+}
+
+WaveService::WaveService (QObject *parent)
+    : QObject(parent)
+{
+    session = -1;
+    mutex = NULL;
+    SDL_AtomicSet(&open_req, 0);
+    SDL_AtomicSet(&abort_req, 0);
+    size = 0;
+    mtime = 0;
+    avfctx = NULL;
+    dec = NULL;
+    swr = NULL;
+    frame = NULL;
+    ast_idx = -1;
+    bucket = 0;
+    bucket_len = 1;
+    low_priority = false;
+    wave_accum_reset(&acc);
+}
+
+WaveService::~WaveService ()
+{
+    close();
+}
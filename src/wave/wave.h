@@ -0,0 +1,89 @@
+#ifndef _AVPLAYERWIDGET_WAVE_H_
+#define _AVPLAYERWIDGET_WAVE_H_
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <string>
+#include <vector>
+#include "avplayerwidget_global.h"
+#include "pool/pool.h"
+#include "wave_cache.h"
+
+extern "C"
+{
+#include "libavformat/avformat.h"
+#include "libavcodec/avcodec.h"
+#include "libswresample/swresample.h"
+#include "SDL2/SDL.h"
+}
+
+/*
+* waveform overview of the progress bar,
+* the whole audio stream is decoded once by a decoder of its own, downmixed to mono float and reduced per bucket,
+* the task runs on a worker of low priority in slices of packets, a new file or close() cancels it between them,
+* the result is written to the cache directory and emitted to the thread of the owner
+*/
+
+/* packets decoded in a run of the task */
+#define WAVE_TASK_SLICE      64
+
+Q_DECLARE_METATYPE(WaveBucket)
+
+class AVPLAYERWIDGET_EXPORT WaveService : public QObject {
+    Q_OBJECT
+
+private:
+    /* task */
+    TaskPool                pool;        // own worker, the playback workers are never competed
+    int                     session;     // -1 if not inited
+    Task                    task;
+
+    /* state, protected by mutex */
+    SDL_mutex *             mutex;
+    std::string             dir;         // of the cache files, with the separator
+    std::string             next_url;    // requested by open()
+    SDL_atomic_t            open_req;    // interrupt_cb() polls it unlocked
+    SDL_atomic_t            abort_req;   // polled as open_req
+
+    /* computation, used by the task only */
+    std::string             url;         // empty if none
+    int64_t                 size;
+    int64_t                 mtime;
+    AVFormatContext *       avfctx;
+    AVCodecContext *        dec;
+    SwrContext *            swr;
+    AVFrame *               frame;
+    int                     ast_idx;
+    std::vector<float>      samples;     // mono, converted from a frame
+    std::vector<WaveBucket> buckets;
+    WaveAccum               acc;         // of the current bucket
+    int                     bucket;
+    int64_t                 bucket_len;  // samples of a bucket
+    bool                    low_priority;
+
+signals:
+    void               wave_ready   (const QString &url, const QVector<WaveBucket> &buckets);
+
+private:
+    static int         wave_proc    (void *args);
+    static int         interrupt_cb (void *args);
+
+private:
+    int                open_file    (const std::string &url);
+    void               close_file   ();
+    int                decode       (); // 1 at the end of the stream
+    int                reduce       ();
+    void               finish       ();
+
+public:
+    int                init         (const char *dir); // cache directory, UTF-8
+    void               close        ();
+    void               open         (const char *url); // NULL to cancel
+
+public:
+    WaveService                     (QObject *parent = nullptr);
+    ~WaveService                    ();
+};
+
+#endif /* _AVPLAYERWIDGET_WAVE_H_ */
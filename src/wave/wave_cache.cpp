@@ -0,0 +1,214 @@
+#include <cstdio>
+#include <cmath>
+#include "wave_cache.h"
+#include "error/error.h"
+#include "log/log.h"
+#include "utils/utils.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+extern "C"
+{
+#include "libavutil/crc.h"
+#include "libavutil/intreadwrite.h"
+}
+
+#define FILENAME "wave_cache.cpp"
+
+#define WAVE_CACHE_HEADER    32            // without the url
+#define WAVE_BUCKET_SIZE     6
+
+void wave_accum_reset (WaveAccum *acc)
+{
+    acc->min = 0.0f;
+    acc->max = 0.0f;
+    acc->sum2 = 0.0;
+    acc->count = 0;
+}
+
+void wave_reduce (const float *samples, int nb_samples, WaveAccum *acc)
+{
+    float min = acc->min;
+    float max = acc->max;
+    float sum2 = 0.0f; // of this call, the float sum of a frame is exact enough
+    int   i = 0;
+
+    if (nb_samples <= 0)
+        return;
+    if (!acc->count)
+        min = max = samples[0];
+
+#ifdef WAVE_SSE2
+    /* 4 lanes, folded at the end */
+    if (nb_samples >= 4) {
+        __m128 vmin = _mm_set1_ps(min);
+        __m128 vmax = _mm_set1_ps(max);
+        __m128 vsum = _mm_setzero_ps();
+        float  lanes[4];
+
+        for (; i + 4 <= nb_samples; i += 4) {
+            __m128 v = _mm_loadu_ps(samples + i);
+            vmin = _mm_min_ps(vmin, v);
+            vmax = _mm_max_ps(vmax, v);
+            vsum = _mm_add_ps(vsum, _mm_mul_ps(v, v));
+        }
+        _mm_storeu_ps(lanes, vmin);
+        for (int j = 0; j < 4; j++)
+            min = lanes[j] < min ? lanes[j] : min;
+        _mm_storeu_ps(lanes, vmax);
+        for (int j = 0; j < 4; j++)
+            max = lanes[j] > max ? lanes[j] : max;
+        _mm_storeu_ps(lanes, vsum);
+        sum2 = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+#endif
+
+    for (; i < nb_samples; i++) {
+        min = samples[i] < min ? samples[i] : min;
+        max = samples[i] > max ? samples[i] : max;
+        sum2 += samples[i] * samples[i];
+    }
+
+    acc->min = min;
+    acc->max = max;
+    acc->sum2 += sum2;
+    acc->count += nb_samples;
+}
+
+static int16_t to_i16 (double v)
+{
+    v = v * 32767.0;
+    v = v > 32767.0 ? 32767.0 : (v < -32767.0 ? -32767.0 : v);
+
+    return (int16_t)lrint(v);
+}
+
+WaveBucket wave_bucket (const WaveAccum *acc)
+{
+    WaveBucket bucket = { 0, 0, 0 };
+
+    if (acc->count > 0) {
+        bucket.min = to_i16(acc->min);
+        bucket.max = to_i16(acc->max);
+        bucket.rms = to_i16(sqrt(acc->sum2 / acc->count));
+    }
+
+    return bucket;
+}
+
+std::string wave_cache_name (const std::string &url)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    char     name[32];
+
+    /* FNV-1a, the url in the file tells the collisions apart */
+    for (size_t i = 0; i < url.size(); i++) {
+        hash ^= (uint8_t)url[i];
+        hash *= 0x100000001B3ULL;
+    }
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+
+    return std::string(name) + WAVE_CACHE_EXT;
+}
+
+int wave_write (const std::string &path, const std::string &url,
+                int64_t size, int64_t mtime,
+                const std::vector<WaveBucket> &buckets)
+{
+    std::string          tmp_path = path + ".tmp";
+    std::vector<uint8_t> buf(WAVE_CACHE_HEADER + url.size() + buckets.size() * WAVE_BUCKET_SIZE + 4);
+    uint8_t *            p = &buf[0];
+    FILE *               fp;
+    int                  ret = 0;
+
+    if (url.size() > WAVE_MAX_URL)
+        return KERROR(KEINVAL);
+
+    AV_WL32(p, WAVE_CACHE_MAGIC);
+    AV_WL32(p + 4, WAVE_CACHE_VERSION);
+    AV_WL64(p + 8, size);
+    AV_WL64(p + 16, mtime);
+    AV_WL32(p + 24, (uint32_t)buckets.size());
+    AV_WL32(p + 28, (uint32_t)url.size());
+    p += WAVE_CACHE_HEADER;
+    url.copy((char *)p, url.size());
+    p += url.size();
+    for (size_t i = 0; i < buckets.size(); i++, p += WAVE_BUCKET_SIZE) {
+        AV_WL16(p, (uint16_t)buckets[i].min);
+        AV_WL16(p + 2, (uint16_t)buckets[i].max);
+        AV_WL16(p + 4, (uint16_t)buckets[i].rms);
+    }
+    AV_WL32(p, av_crc(av_crc_get_table(AV_CRC_32_IEEE_LE), 0, &buf[0], buf.size() - 4));
+
+    /* written beside, a reader never sees a torn file */
+    fp = fopen(tmp_path.c_str(), "wb");
+    if (!fp) {
+        logger.error("Failed to create waveform cache %s.\n", tmp_path.c_str());
+        return KERROR(KEPLAYLIST_WRITE_FAIL);
+    }
+    if (1 != fwrite(&buf[0], buf.size(), 1, fp) || file_sync(fp))
+        ret = KERROR(KEPLAYLIST_WRITE_FAIL);
+    fclose(fp);
+    if (!ret && file_replace(tmp_path.c_str(), path.c_str()))
+        ret = KERROR(KEPLAYLIST_WRITE_FAIL);
+    if (ret < 0) {
+        remove(tmp_path.c_str());
+        logger.error("Failed to write waveform cache %s.\n", path.c_str());
+    }
+
+    return ret;
+}
+
+int wave_read (const std::string &path, const std::string &url,
+               int64_t size, int64_t mtime,
+               std::vector<WaveBucket> *buckets)
+{
+    std::vector<uint8_t> buf;
+    const uint8_t *      p;
+    FILE *               fp;
+    long                 len;
+    uint32_t             nb_buckets;
+    uint32_t             url_size;
+
+    fp = fopen(path.c_str(), "rb");
+    if (!fp)
+        return KERROR(KEPLAYLIST_OPEN_FAIL);
+    if (fseek(fp, 0, SEEK_END) || (len = ftell(fp)) < WAVE_CACHE_HEADER + 4
+        || len > WAVE_CACHE_HEADER + WAVE_MAX_URL + WAVE_BUCKETS * WAVE_BUCKET_SIZE + 4
+        || fseek(fp, 0, SEEK_SET)) {
+        fclose(fp);
+        return KERROR(KEINVAL);
+    }
+    buf.resize(len);
+    if (1 != fread(&buf[0], len, 1, fp)) {
+        fclose(fp);
+        return KERROR(KEINVAL);
+    }
+    fclose(fp);
+
+    /* a torn, foreign or stale file is recomputed */
+    p = &buf[0];
+    nb_buckets = AV_RL32(p + 24);
+    url_size = AV_RL32(p + 28);
+    if (WAVE_CACHE_MAGIC != AV_RL32(p) || WAVE_CACHE_VERSION != AV_RL32(p + 4)
+        || nb_buckets > WAVE_BUCKETS || url_size > WAVE_MAX_URL
+        || (size_t)len != WAVE_CACHE_HEADER + url_size + nb_buckets * WAVE_BUCKET_SIZE + 4
+        || AV_RL32(p + len - 4) != av_crc(av_crc_get_table(AV_CRC_32_IEEE_LE), 0, p, len - 4))
+        return KERROR(KEINVAL);
+    if ((int64_t)AV_RL64(p + 8) != size || (int64_t)AV_RL64(p + 16) != mtime
+        || url.compare(0, std::string::npos, (const char *)p + WAVE_CACHE_HEADER, url_size))
+        return KERROR(KEINVAL);
+
+    p += WAVE_CACHE_HEADER + url_size;
+    buckets->resize(nb_buckets);
+    for (uint32_t i = 0; i < nb_buckets; i++, p += WAVE_BUCKET_SIZE) {
+        (*buckets)[i].min = (int16_t)AV_RL16(p);
+        (*buckets)[i].max = (int16_t)AV_RL16(p + 2);
+        (*buckets)[i].rms = (int16_t)AV_RL16(p + 4);
+    }
+
+    return 0;
+}
@@ -0,0 +1,55 @@
+#ifndef _AVPLAYERWIDGET_WAVE_CACHE_H_
+#define _AVPLAYERWIDGET_WAVE_CACHE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "avplayerwidget_global.h"
+
+/*
+* waveform overview of the audio stream, the peaks and the loudness of a fixed number of buckets,
+* the samples are reduced by an SSE2 kernel where the compiler targets it, a scalar loop elsewhere,
+* a waveform is cached as a file per media file, used while the size and the modification time are unchanged
+*
+* file:    magic (4) version (4) size (8) mtime (8) number of buckets (4) url, buckets, crc32 of all before (4)
+* url:     a size (4) and the bytes
+* bucket:  min (2) max (2) rms (2), integers are little-endian
+*/
+
+#define WAVE_BUCKETS         1024          // of a waveform
+
+#define WAVE_CACHE_MAGIC     0x5657414B    // "KAWV"
+#define WAVE_CACHE_VERSION   1
+#define WAVE_CACHE_EXT       ".wave"
+#define WAVE_MAX_URL         65536
+
+/* a bucket, scaled to 32767 as full scale */
+typedef struct WaveBucket {
+    int16_t min;
+    int16_t max;
+    int16_t rms;
+}WaveBucket;
+
+/* reduction of the samples of a bucket */
+typedef struct WaveAccum {
+    float   min;
+    float   max;
+    double  sum2;  // sum of the squares
+    int64_t count; // samples
+}WaveAccum;
+
+/* kernel */
+void        wave_accum_reset (WaveAccum *acc);
+void        wave_reduce      (const float *samples, int nb_samples, WaveAccum *acc);
+WaveBucket  wave_bucket      (const WaveAccum *acc);
+
+/* cache files */
+AVPLAYERWIDGET_EXPORT std::string wave_cache_name (const std::string &url); // file name in the cache directory
+AVPLAYERWIDGET_EXPORT int         wave_write      (const std::string &path, const std::string &url,
+                                                   int64_t size, int64_t mtime,
+                                                   const std::vector<WaveBucket> &buckets);
+AVPLAYERWIDGET_EXPORT int         wave_read       (const std::string &path, const std::string &url,
+                                                   int64_t size, int64_t mtime,
+                                                   std::vector<WaveBucket> *buckets); // KEINVAL if stale or torn
+
+#endif /* _AVPLAYERWIDGET_WAVE_CACHE_H_ */
@@ -0,0 +1,85 @@
+#include <cstdio>
+#include <cmath>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include "wave_cache.h"
+#include "error/error.h"
+#include "testutil/testutil.h"
+
+TEST(wave_cache_test, reduce)
+{
+    std::vector<float> samples(1027);
+    WaveAccum          acc;
+    WaveAccum          ref;
+    WaveBucket         bucket;
+
+    srand(1);
+    for (size_t i = 0; i < samples.size(); i++)
+        samples[i] = (float)rand() / RAND_MAX * 1.6f - 0.8f;
+    samples[513] = -0.9f;
+    samples[1026] = 0.95f;
+
+    /* a whole frame against the odd slices, tails included */
+    wave_accum_reset(&acc);
+    wave_reduce(&samples[0], (int)samples.size(), &acc);
+    wave_accum_reset(&ref);
+    for (size_t i = 0; i < samples.size(); i += 3)
+        wave_reduce(&samples[i], (int)(samples.size() - i < 3 ? samples.size() - i : 3), &ref);
+    EXPECT_EQ((int64_t)samples.size(), acc.count);
+    EXPECT_FLOAT_EQ(-0.9f, acc.min);
+    EXPECT_FLOAT_EQ(0.95f, acc.max);
+    EXPECT_FLOAT_EQ(ref.min, acc.min);
+    EXPECT_FLOAT_EQ(ref.max, acc.max);
+    EXPECT_NEAR(ref.sum2, acc.sum2, ref.sum2 * 1e-5);
+
+    /* a sine of full scale */
+    for (size_t i = 0; i < samples.size(); i++)
+        samples[i] = (float)sin(i * 0.05);
+    wave_accum_reset(&acc);
+    wave_reduce(&samples[0], (int)samples.size(), &acc);
+    bucket = wave_bucket(&acc);
+    EXPECT_NEAR(-32767, bucket.min, 10);
+    EXPECT_NEAR(32767, bucket.max, 10);
+    EXPECT_NEAR(32767 / sqrt(2.0), bucket.rms, 200);
+
+    /* an empty bucket is silence */
+    wave_accum_reset(&acc);
+    bucket = wave_bucket(&acc);
+    EXPECT_EQ(0, bucket.max);
+    EXPECT_EQ(0, bucket.rms);
+}
+
+TEST(wave_cache_test, file)
+{
+    std::string             path = test_path("wave_cache_test.wave");
+    std::vector<WaveBucket> buckets(WAVE_BUCKETS);
+    std::vector<WaveBucket> read;
+    FILE *                  fp;
+
+    for (int i = 0; i < WAVE_BUCKETS; i++) {
+        buckets[i].min = (int16_t)-i;
+        buckets[i].max = (int16_t)(i * 2);
+        buckets[i].rms = (int16_t)i;
+    }
+    remove(path.c_str());
+    ASSERT_EQ(0, wave_write(path, "/music/a.flac", 1000, 2000, buckets));
+    ASSERT_EQ(0, wave_read(path, "/music/a.flac", 1000, 2000, &read));
+    ASSERT_EQ(buckets.size(), read.size());
+    EXPECT_EQ(-1023, read[1023].min);
+    EXPECT_EQ(2046, read[1023].max);
+    EXPECT_EQ(1023, read[1023].rms);
+
+    /* stale or foreign */
+    EXPECT_EQ(KERROR(KEINVAL), wave_read(path, "/music/a.flac", 1000, 2001, &read));
+    EXPECT_EQ(KERROR(KEINVAL), wave_read(path, "/music/b.flac", 1000, 2000, &read));
+    EXPECT_NE(wave_cache_name("/music/a.flac"), wave_cache_name("/music/b.flac"));
+
+    /* torn */
+    fp = fopen(path.c_str(), "r+b");
+    ASSERT_TRUE(fp != NULL);
+    fseek(fp, 100, SEEK_SET);
+    fputc(0x5A, fp);
+    fclose(fp);
+    EXPECT_EQ(KERROR(KEINVAL), wave_read(path, "/music/a.flac", 1000, 2000, &read));
+    remove(path.c_str());
+}